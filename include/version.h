@@ -1,19 +1,19 @@
-/*
- This file is automatically modified by the build_version.py script
- to update the BUILD and BUILD_DATE values based on the
- current Git commit ID and current UTC date/time.
-
- FN_VERSION_MAJOR and FN_VERSION_MINOR should be manually updated
- as needed.
-*/
-
-#define FN_VERSION_MAJOR "2210"
-#define FN_VERSION_MINOR "0"
-
-#define FN_VERSION_BUILD "d1c551e0"
-
-#define FN_VERSION_DATE "2022-10-26 09:45:24"
-
-#define FN_VERSION_FULL "2210.0.d1c551e0"
-
-
+/*
+ This file is automatically modified by the build_version.py script
+ to update the BUILD and BUILD_DATE values based on the
+ current Git commit ID and current UTC date/time.
+
+ FN_VERSION_MAJOR and FN_VERSION_MINOR should be manually updated
+ as needed.
+*/
+
+#define FN_VERSION_MAJOR "2610"
+#define FN_VERSION_MINOR "0"
+
+#define FN_VERSION_BUILD "b9520ad"
+
+#define FN_VERSION_DATE "2026-10-19 15:16:10"
+
+#define FN_VERSION_FULL "2610.0.b9520ad"
+
+
@@ -8,6 +8,8 @@
 
 #include "EdUrlParser.h"
 
+#include <string.h>
+
 #include "utils.h"
 
 
@@ -18,6 +20,9 @@
 #define WALK_UNTIL3(POS, LEN, BUF, DELI1, DELI2, DELI3) for(;POS<LEN && BUF[POS]!=DELI1 && BUF[POS]!=DELI2 && BUF[POS]!=DELI3;POS++)
 #define CHECK_REMAIN_END(POS, LEN, REQ_LEN) if(LEN-POS < REQ_LEN) {_url_errorno=100; goto __PARSE_END; }
 #define WALK_CHAR(POS, BUF, DELI) if(BUF[POS++] != DELI) goto __PARSE_END
+// like WALK_CHAR, for buffers which are not terminated
+#define WALK_CHAR_LEN(POS, LEN, BUF, DELI) if(POS>=LEN || BUF[POS++] != DELI) goto __PARSE_END
+#define SET_PART(PART, POS, LEN) { PART.pos = POS; PART.len = LEN; }
 
 
 
@@ -32,16 +37,20 @@ EdUrlParser::~EdUrlParser() {
 
 
 
-string EdUrlParser::urlDecode(string str) {
+string EdUrlParser::urlDecode(const string &str) {
+	string decstr;
+	if (!urlDecode(str.data(), str.size(), decstr))
+		return "";
+	return decstr;
+}
+
+bool EdUrlParser::urlDecode(const char *buf, size_t len, string &decstr) {
 	int _url_errorno = 0;
 	size_t pos = 0, per = 0;
-	size_t len = str.size();
-	const char* buf = str.c_str();
-	string decstr;
-	_url_errorno = 0;
+	decstr.clear();
 	for (per = pos = 0;;) {
 		WALK_UNTIL2(pos, len, buf, '%', '+');
-		decstr.append(buf, per, pos - per);
+		decstr.append(buf + per, pos - per);
 		if (pos >= len)
 			goto __PARSE_END;
 		if (buf[pos] == '%') {
@@ -66,13 +75,14 @@ string EdUrlParser::urlDecode(string str) {
 			per = pos;
 		}
 	}
-	__PARSE_END: if (_url_errorno != 0)
-		return "";
-	return decstr;
-
+	__PARSE_END: if (_url_errorno != 0) {
+		decstr.clear();
+		return false;
+	}
+	return true;
 }
 
-string EdUrlParser::urlEncode(string s) {
+string EdUrlParser::urlEncode(const string &s) {
 	const char *ptr = s.c_str();
 	string enc;
 	char c;
@@ -102,7 +112,7 @@ void EdUrlParser::toHex(char* desthex, char c) {
 
 // #prgamas are to ignore warnings about variables being set and not used
 // __BEGIN_IGNORE_UNUSEDVARS
-int EdUrlParser::parsePath(vector<string>* folders, string pathstr) {
+int EdUrlParser::parsePath(vector<string>* folders, const string &pathstr) {
 	int _url_errorno = 0;
 	int path_pos = 0;
 	size_t pos = 0;
@@ -123,16 +133,18 @@ int EdUrlParser::parsePath(vector<string>* folders, string pathstr) {
 // __END_IGNORE_UNUSEDVARS
 
 // __BEGIN_IGNORE_UNUSEDVARS
-void EdUrlParser::parse() {
+bool EdUrlView::parse(const char *str, size_t len) {
 	int _url_errorno = 0;
-	const char *str = mRawUrl.c_str();
+	size_t pos;
+	size_t scheme_pos, host_pos, port_pos, path_pos, param_pos, tag_pos;
+
+	buf = str;
+	length = len;
+	scheme = hostName = port = path = query = fragment = {0, 0};
 
-	size_t pos, len;
-	int scheme_pos, host_pos, port_pos, path_pos, param_pos, tag_pos;
 	pos = 0;
-	len = mRawUrl.size();
 	WALK_SP(pos, len, str); // remove preceding spaces.
-	if (str[pos] == '/') {
+	if (pos < len && str[pos] == '/') {
 		goto __PARSE_HOST;
 	}
 
@@ -140,62 +152,120 @@ void EdUrlParser::parse() {
 	scheme_pos = pos;
 	WALK_UNTIL(pos, len, str, ':');
 	CHECK_LEN_END(pos, len);
-	scheme = mRawUrl.substr(scheme_pos, pos - scheme_pos);
+	SET_PART(scheme, scheme_pos, pos - scheme_pos);
 	CHECK_REMAIN_END(pos, len, 3);
-	WALK_CHAR(pos, str, ':');
-	WALK_CHAR(pos, str, '/');
+	WALK_CHAR_LEN(pos, len, str, ':');
+	WALK_CHAR_LEN(pos, len, str, '/');
 
 	// start host address
 	__PARSE_HOST:
-	WALK_CHAR(pos, str, '/');
+	WALK_CHAR_LEN(pos, len, str, '/');
 	host_pos = pos;
 	WALK_UNTIL3(pos, len, str, ':', '/', '?');
+	SET_PART(hostName, host_pos, pos - host_pos);
 	if (pos < len) {
-		hostName = mRawUrl.substr(host_pos, pos - host_pos);
 		if (str[pos] == ':')
 			goto __PARSE_PORT;
 		if (str[pos] == '/')
 			goto __PARSE_PATH;
 		if (str[pos] == '?')
 			goto __PARSE_PARAM;
-	} else {
-		hostName = mRawUrl.substr(host_pos, pos - host_pos);
 	}
 
 	__PARSE_PORT:
-	WALK_CHAR(pos, str, ':');
+	WALK_CHAR_LEN(pos, len, str, ':');
 	port_pos = pos;
 	WALK_UNTIL2(pos, len, str, '/', '?');
-	port = mRawUrl.substr(port_pos, pos - port_pos);
+	SET_PART(port, port_pos, pos - port_pos);
 	CHECK_LEN_END(pos, len);
 	if (str[pos] == '?')
 		goto __PARSE_PARAM;
 	__PARSE_PATH: path_pos = pos;
 	WALK_UNTIL(pos, len, str, '?');
-	path = mRawUrl.substr(path_pos, pos - path_pos);
+	SET_PART(path, path_pos, pos - path_pos);
 	CHECK_LEN_END(pos, len);
 	__PARSE_PARAM:
-	WALK_CHAR(pos, str, '?');
+	WALK_CHAR_LEN(pos, len, str, '?');
 	param_pos = pos;
 	WALK_UNTIL(pos, len, str, '#');
-	query = mRawUrl.substr(param_pos, pos - param_pos);
+	SET_PART(query, param_pos, pos - param_pos);
 	CHECK_LEN_END(pos, len);
 
 	// start parsing fragment
-	WALK_CHAR(pos, str, '#');
+	WALK_CHAR_LEN(pos, len, str, '#');
 	tag_pos = pos;
-	fragment = mRawUrl.substr(tag_pos, len - tag_pos);
-	__PARSE_END: return;
+	SET_PART(fragment, tag_pos, len - tag_pos);
+	return true;
+	__PARSE_END: return false;
 }
 // __END_IGNORE_UNUSEDVARS
 
-EdUrlParser* EdUrlParser::parseUrl(string urlstr) {
+bool EdUrlView::equals(const part &p, const char *s, bool ignore_case) const {
+	size_t i;
+	for (i = 0; i < p.len; i++) {
+		char a = buf[p.pos + i];
+		char b = s[i];
+		if (b == '\0')
+			return false;
+		if (ignore_case) {
+			if (a >= 'a' && a <= 'z')
+				a -= 'a' - 'A';
+			if (b >= 'a' && b <= 'z')
+				b -= 'a' - 'A';
+		}
+		if (a != b)
+			return false;
+	}
+	return s[i] == '\0';
+}
+
+bool EdUrlView::queryValue(const char *key, string &value, bool decode) const {
+	const char *str = buf + query.pos;
+	size_t len = query.len;
+	size_t key_len = strlen(key);
+	size_t pos = 0, item_pos, item_end;
+
+	while (pos < len) {
+		item_pos = pos;
+		WALK_UNTIL(pos, len, str, '&');
+		item_end = pos;
+		pos++;
+		if (item_end - item_pos > key_len && str[item_pos + key_len] == '='
+				&& strncmp(str + item_pos, key, key_len) == 0) {
+			const char *val = str + item_pos + key_len + 1;
+			size_t val_len = item_end - item_pos - key_len - 1;
+			if (decode)
+				return EdUrlParser::urlDecode(val, val_len, value);
+			value.assign(val, val_len);
+			return true;
+		}
+	}
+	return false;
+}
+
+void EdUrlParser::parse() {
+	EdUrlView view;
+	view.parse(mRawUrl.data(), mRawUrl.size());
+	view.assign(scheme, view.scheme);
+	view.assign(hostName, view.hostName);
+	view.assign(port, view.port);
+	view.assign(path, view.path);
+	view.assign(query, view.query);
+	view.assign(fragment, view.fragment);
+}
+
+EdUrlParser* EdUrlParser::parseUrl(const string &urlstr) {
 	EdUrlParser *url = new EdUrlParser;
 	url->mRawUrl = urlstr;
 	url->parse();
 	return url;
 }
 
+void EdUrlParser::reparseUrl(const string &urlstr) {
+	mRawUrl.assign(urlstr);
+	parse();
+}
+
 bool EdUrlParser::toChar(const char* hex, char *result) {
 	unsigned char nible[2];
 	unsigned char c, base;
@@ -216,15 +286,15 @@ bool EdUrlParser::toChar(const char* hex, char *result) {
 	return true;
 }
 
-size_t EdUrlParser::parseKeyValueMap(unordered_map<string, string> *kvmap, string rawstr, bool strict) {
+size_t EdUrlParser::parseKeyValueMap(unordered_map<string, string> *kvmap, const string &rawstr, bool strict) {
 	return parseKeyValue(rawstr, __kv_callback_map, kvmap, strict);
 }
 
-size_t EdUrlParser::parseKeyValueList(vector< query_kv_t > *kvvec, string rawstr, bool strict) {
+size_t EdUrlParser::parseKeyValueList(vector< query_kv_t > *kvvec, const string &rawstr, bool strict) {
 	return parseKeyValue(rawstr, __kv_callback_vec, kvvec, strict);
 }
 
-size_t EdUrlParser::parseKeyValue(string rawstr, __kv_callback kvcb, void* obj, bool strict) {
+size_t EdUrlParser::parseKeyValue(const string &rawstr, __kv_callback kvcb, void* obj, bool strict) {
 
 	int _url_errorno = 0;
 	const char *str = rawstr.c_str();
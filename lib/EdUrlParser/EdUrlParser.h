@@ -22,20 +22,55 @@ typedef struct {
 
 typedef int (*__kv_callback)(void* list, string k, string v);
 
+/*
+ * Non-owning URL parser. Parts of the URL are kept as offsets into the parsed
+ * buffer, which must outlive the view. Nothing is allocated during parsing,
+ * decoding and query lookup happen only when asked for.
+ */
+class EdUrlView {
+public:
+	struct part {
+		size_t pos;
+		size_t len;
+	};
+
+	const char *buf = nullptr;
+	size_t length = 0;
+	part scheme = {0, 0};
+	part hostName = {0, 0};
+	part port = {0, 0};
+	part path = {0, 0};
+	part query = {0, 0};
+	part fragment = {0, 0};
+
+	// Parse URL, returns false if the URL is incomplete (parts found so far are set)
+	bool parse(const char *url, size_t len);
+
+	const char *data(const part &p) const { return buf + p.pos; }
+	bool equals(const part &p, const char *s, bool ignore_case = false) const;
+	string str(const part &p) const { return string(buf + p.pos, p.len); }
+	void assign(string &dst, const part &p) const { dst.assign(buf + p.pos, p.len); }
+	// Find value of query parameter, value is URL decoded if requested
+	bool queryValue(const char *key, string &value, bool decode = true) const;
+};
+
 class EdUrlParser {
 private:
 	EdUrlParser();
 public:
 	virtual ~EdUrlParser();
-	static EdUrlParser* parseUrl(string urlstr);
-	static int parsePath(vector<string> *pdirlist, string pathstr);
-	static string urlDecode(string str);
+	static EdUrlParser* parseUrl(const string &urlstr);
+	// Parse another URL into existing object, strings reuse their buffers
+	void reparseUrl(const string &urlstr);
+	static int parsePath(vector<string> *pdirlist, const string &pathstr);
+	static string urlDecode(const string &str);
+	static bool urlDecode(const char *buf, size_t len, string &decstr);
 	static bool toChar(const char* hex, char *result);
-	static string urlEncode(string s);
+	static string urlEncode(const string &s);
 	static void toHex(char *desthex, char c);
-	static size_t parseKeyValueMap(unordered_map<string, string> *kvmap, string str, bool strict=true);
-	static size_t parseKeyValueList(vector< query_kv_t > *kvmap, string rawstr, bool strict=true);
-	static size_t parseKeyValue(string rawstr, __kv_callback kvcb, void* obj, bool strict);
+	static size_t parseKeyValueMap(unordered_map<string, string> *kvmap, const string &str, bool strict=true);
+	static size_t parseKeyValueList(vector< query_kv_t > *kvmap, const string &rawstr, bool strict=true);
+	static size_t parseKeyValue(const string &rawstr, __kv_callback kvcb, void* obj, bool strict);
 
 private:
 	void parse();
@@ -55,6 +55,16 @@ fsdir_entry &DirCache::new_entry()
     return _entries.back();
 }
 
+fsdir_entry *DirCache::find(const char *filename)
+{
+    for (fsdir_entry &entry : _entries)
+    {
+        if (strcmp(entry.filename, filename) == 0)
+            return &entry;
+    }
+    return nullptr;
+}
+
 void DirCache::apply_filter(const char *pattern, uint16_t diropts)
 {
     bool have_pattern = pattern != nullptr && pattern[0] != '\0';
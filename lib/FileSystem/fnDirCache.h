@@ -21,6 +21,8 @@ public:
     void apply_filter(const char *pattern, uint16_t diropts);
 
     bool empty() {return _entries.empty();}
+    // Find entry by name, all entries are searched regardless of filter
+    fsdir_entry *find(const char *filename);
 
     fsdir_entry *read();
     uint16_t tell();
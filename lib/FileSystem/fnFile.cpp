@@ -1,7 +1,29 @@
 #include "fnFile.h"
 
-#include "../../include/debug.h"
+#include <stdint.h>
 
-// nothing to do in base class
+#include "../../include/debug.h"
 
 FileHandler::~FileHandler() {};
+
+int FileHandler::truncate(long int size)
+{
+    Debug_printf("FileHandler::truncate %ld\n", size);
+    long int pos = tell();
+    if (pos < 0 || size < 0 || seek(0, SEEK_END) != 0)
+        return -1;
+
+    int result = 0;
+    if (tell() < size)
+    {
+        // relies on file system filling the gap, sparse where supported
+        uint8_t zero = 0;
+        if (seek(size - 1, SEEK_SET) != 0 || write(&zero, 1, 1) != 1)
+            result = -1;
+    }
+    else if (tell() > size)
+        result = -1; // can't shrink
+
+    seek(pos, SEEK_SET);
+    return result;
+}
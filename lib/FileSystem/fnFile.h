@@ -21,6 +21,10 @@ public:
     virtual size_t read(void *ptr, size_t size, size_t n) = 0;
     virtual size_t write(const void *ptr, size_t size, size_t n) = 0;
     virtual int flush() = 0;
+    // Set file size like ftruncate(), file position is not changed, returns 0 on success
+    // Default extends the file by writing its last byte, implementations with native way
+    // of setting the size (and shrinking the file) override it
+    virtual int truncate(long int size);
 };
 
 
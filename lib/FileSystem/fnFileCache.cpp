@@ -0,0 +1,267 @@
+#include "fnFileCache.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "compat_string.h"
+
+#include "../../include/debug.h"
+
+#include "fnConfig.h"
+#include "fnFsSD.h"
+
+#include "utils.h"
+
+#define FILECACHE_ENTRY_NAME_LEN 32 // hex MD5 of the key
+
+// Our global remote file cache
+FileCache fnFileCache;
+
+static bool is_entry_name(const char *name)
+{
+    if (strlen(name) != FILECACHE_ENTRY_NAME_LEN)
+        return false;
+    for (const char *p = name; *p; p++)
+    {
+        if (!((*p >= '0' && *p <= '9') || (*p >= 'a' && *p <= 'f')))
+            return false;
+    }
+    return true;
+}
+
+FileCache::FileCache()
+{
+    std::random_device rd;
+    _instance = rd();
+    set_size(CONFIG_DEFAULT_CACHE_SIZE_MB);
+}
+
+bool FileCache::start(const char *root)
+{
+    Debug_printf("FileCache: root \"%s\"\n", root);
+    return _fs.start(root);
+}
+
+void FileCache::set_size(int size_mb)
+{
+    _budget = (uint64_t)std::max(0, size_mb) * 1024 * 1024;
+}
+
+std::string FileCache::make_key(const char *host_url, const char *path, uint32_t size, time_t mtime, const char *etag)
+{
+    // fields separated by character which can not appear in URL or path
+    std::string key(host_url);
+    key += '\n';
+    key += path;
+    key += '\n';
+    key += std::to_string(size);
+    key += '\n';
+    if (etag != nullptr && etag[0] != '\0')
+        key += etag;
+    else
+        key += std::to_string((long long)mtime);
+    return key;
+}
+
+std::string FileCache::_entry_name(const std::string &key)
+{
+    return std::string(FILECACHE_DIR "/") + util_md5_hex(key.data(), key.length());
+}
+
+std::string FileCache::_temp_path(const char *suffix)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "/%08x-%u.%s", (unsigned)_instance, (unsigned)_seq++, suffix);
+    return std::string(FILECACHE_DIR) + name;
+}
+
+FileHandler *FileCache::open(const std::string &key, const char *mode)
+{
+    if (!_fs.running())
+        return nullptr;
+
+    std::string path = _entry_name(key);
+    if (!_fs.exists(path.c_str()))
+        return nullptr;
+
+    Debug_printf("FileCache: hit %s\n", path.c_str());
+    return _open_entry(path, mode);
+}
+
+FileHandler *FileCache::_open_entry(const std::string &path, const char *mode)
+{
+    // entry modification time is the time of last use
+    _fs.touch(path.c_str());
+
+    FileHandler *fh = _fs.filehandler_open(path.c_str(), FILE_READ);
+    if (fh == nullptr || strpbrk(mode, "wa+") == nullptr)
+        return fh;
+
+    // Changes are never written back to the host, keep them in a private copy
+    // so the cached entry stays unchanged
+    std::string work_path = _temp_path("wrk");
+    FileHandler *fh_work = _fs.filehandler_open(work_path.c_str(), "wb+");
+    if (fh_work == nullptr)
+    {
+        Debug_printf("FileCache: failed to create working copy %s\n", work_path.c_str());
+        fh->close();
+        return nullptr;
+    }
+
+    uint8_t buf[4096];
+    size_t count;
+    while ((count = fh->read(buf, 1, sizeof(buf))) > 0)
+    {
+        if (fh_work->write(buf, 1, count) != count)
+        {
+            Debug_printf("FileCache: failed to write working copy %s\n", work_path.c_str());
+            fh->close();
+            fh_work->close();
+            _fs.remove(work_path.c_str());
+            return nullptr;
+        }
+    }
+    fh->close();
+    fh_work->seek(0, SEEK_SET);
+#ifndef _WIN32
+    // the copy is gone once the file is closed, elsewhere it is left for _clean_stale()
+    _fs.remove(work_path.c_str());
+#endif
+    return fh_work;
+}
+
+FileHandler *FileCache::create(std::string &temp_path)
+{
+    if (!_fs.running())
+    {
+        Debug_println("FileCache: SD Filesystem is not running");
+        return nullptr;
+    }
+
+    // ensure cache directory exists
+    _fs.create_path(FILECACHE_DIR);
+    _clean_stale();
+
+    temp_path = _temp_path("tmp");
+    FileHandler *fh = _fs.filehandler_open(temp_path.c_str(), "wb+");
+    if (fh == nullptr)
+        Debug_printf("FileCache: failed to create %s\n", temp_path.c_str());
+    return fh;
+}
+
+FileHandler *FileCache::publish(FileHandler *fh, const std::string &temp_path, const std::string &key, const char *mode)
+{
+    fh->close();
+
+    std::string path = _entry_name(key);
+    // rename() does not replace existing file everywhere
+    _fs.remove(path.c_str());
+    if (!_fs.rename(temp_path.c_str(), path.c_str()))
+    {
+        Debug_printf("FileCache: failed to publish %s\n", path.c_str());
+        _fs.remove(temp_path.c_str());
+        return nullptr;
+    }
+    Debug_printf("FileCache: stored %s\n", path.c_str());
+
+    _evict(path);
+    return _open_entry(path, mode);
+}
+
+FileHandler *FileCache::use_once(FileHandler *fh, const std::string &temp_path)
+{
+    fh->seek(0, SEEK_SET);
+#ifndef _WIN32
+    // the file is gone once it is closed, elsewhere it is left for _clean_stale()
+    _fs.remove(temp_path.c_str());
+#endif
+    return fh;
+}
+
+void FileCache::discard(FileHandler *fh, const std::string &temp_path)
+{
+    fh->close();
+    _fs.remove(temp_path.c_str());
+}
+
+// Remove leftovers of interrupted downloads, old working copies and files
+// of previous cache versions
+void FileCache::_clean_stale()
+{
+    if (_cleaned.exchange(true))
+        return;
+
+    if (!_fs.dir_open(FILECACHE_DIR, "", 0))
+        return;
+
+    std::vector<std::string> stale;
+    time_t now = time(nullptr);
+    fsdir_entry *d;
+    while ((d = _fs.dir_read()) != nullptr)
+    {
+        if (!d->isDir && !is_entry_name(d->filename) && now - d->modified_time > FILECACHE_STALE_SECONDS)
+            stale.push_back(std::string(FILECACHE_DIR "/") + d->filename);
+    }
+    _fs.dir_close();
+
+    for (const std::string &path : stale)
+    {
+        Debug_printf("FileCache: removing stale %s\n", path.c_str());
+        _fs.remove(path.c_str());
+    }
+}
+
+// Remove least recently used entries until the cache fits into configured size,
+// entry which was just stored is kept even if it is over the budget alone
+void FileCache::_evict(const std::string &keep)
+{
+    struct cache_entry
+    {
+        std::string path;
+        uint64_t size;
+        time_t used;
+    };
+
+    uint64_t budget = _budget;
+
+    // instances storing entries at the same time would remove the same ones
+    std::lock_guard<std::mutex> lock(_evict_lock);
+    if (!_fs.dir_open(FILECACHE_DIR, "", 0))
+        return;
+
+    std::vector<cache_entry> entries;
+    uint64_t total = 0;
+    fsdir_entry *d;
+    while ((d = _fs.dir_read()) != nullptr)
+    {
+        if (d->isDir || !is_entry_name(d->filename))
+            continue;
+        cache_entry e;
+        e.path = std::string(FILECACHE_DIR "/") + d->filename;
+        e.size = d->size;
+        e.used = d->modified_time;
+        total += e.size;
+        entries.push_back(e);
+    }
+    _fs.dir_close();
+
+    if (total <= budget)
+        return;
+
+    std::sort(entries.begin(), entries.end(),
+              [](const cache_entry &a, const cache_entry &b) { return a.used < b.used; });
+
+    for (const cache_entry &e : entries)
+    {
+        if (total <= budget)
+            break;
+        if (e.path == keep)
+            continue;
+        Debug_printf("FileCache: evicting %s (%llu bytes)\n", e.path.c_str(), (unsigned long long)e.size);
+        if (_fs.remove(e.path.c_str()))
+            total -= e.size;
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef _FN_FILECACHE_
+#define _FN_FILECACHE_
+
+#include <stdint.h>
+#include <time.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+#include "fnFS.h"
+#include "fnFsSD.h"
+
+#define FILECACHE_DIR "/FujiNet/cache"
+#define FILECACHE_STALE_SECONDS 86400 // unfinished downloads and working copies older than this are removed
+
+/*
+ Persistent cache of files downloaded from remote hosts, stored in FujiNet directory on SD
+ or in the cache directory (-C option). One cache serves all instances of the process (-n
+ option), its functions may be called from several threads.
+
+ The key identifies the file (host URL and path) and its version (size and modification time
+ or ETag). Entries are stored under MD5 of the key, a changed file on the host is a miss
+ and its old entry ages out. Downloads are written into temporary file and renamed to the
+ entry name when complete, so partial downloads are never visible as entries. When the cache
+ grows over the budget ([General] cache_size in MB of the base config), least recently used
+ entries are removed.
+*/
+class FileCache
+{
+private:
+    uint32_t _instance;     // distinguishes temporary files of other processes sharing the directory
+    std::atomic<uint32_t> _seq{0};
+    std::atomic<bool> _cleaned{false};
+    std::atomic<uint64_t> _budget;
+    std::mutex _evict_lock;
+    FileSystemSDFAT _fs;    // cache root directory
+
+    std::string _entry_name(const std::string &key);
+    std::string _temp_path(const char *suffix);
+    FileHandler *_open_entry(const std::string &path, const char *mode);
+    void _clean_stale();
+    void _evict(const std::string &keep);
+
+public:
+    FileCache();
+
+    // Keep the cache under root directory, the FujiNet directory of SD by default
+    bool start(const char *root);
+    // Size of the cache in MB
+    void set_size(int size_mb);
+    // Directory other caches (disk image indexes) are kept in, nullptr if not started
+    FileSystemSDFAT *storage() { return _fs.running() ? &_fs : nullptr; };
+
+    static std::string make_key(const char *host_url, const char *path, uint32_t size, time_t mtime, const char *etag = nullptr);
+
+    // Open cached version of the file, nullptr if it is not in cache
+    // Entry is opened read-only, for writable modes a private working copy is returned
+    FileHandler *open(const std::string &key, const char *mode = FILE_READ);
+
+    // Start new entry, returns file to write the content into or nullptr on error
+    FileHandler *create(std::string &temp_path);
+    // Publish completed entry written into file returned by create(), then open it like open() does
+    FileHandler *publish(FileHandler *fh, const std::string &temp_path, const std::string &key, const char *mode = FILE_READ);
+    // Rewind file returned by create() for reading without storing it in the cache,
+    // when its version on the host is unknown; the file is removed once it is closed
+    FileHandler *use_once(FileHandler *fh, const std::string &temp_path);
+    // Drop unfinished entry
+    void discard(FileHandler *fh, const std::string &temp_path);
+};
+
+extern FileCache fnFileCache;
+
+#endif // _FN_FILECACHE_
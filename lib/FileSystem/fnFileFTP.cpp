@@ -0,0 +1,305 @@
+
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "fnFileFTP.h"
+#include "fnFileCache.h"
+#include "../../include/debug.h"
+
+
+FileHandlerFTP::FileHandlerFTP(const std::shared_ptr<fnFTP> &ftp, const char *path, uint32_t size,
+                               FileHandler *store, const std::string &store_path, const std::string &cache_key)
+{
+    Debug_println("new FileHandlerFTP");
+    _ftp = ftp;
+    _path = path;
+    _size = size;
+    _store = store;
+    _store_path = store_path;
+    _cache_key = cache_key;
+    if (_store != nullptr)
+        _present.resize(_block_count(), false);
+    _block_buf.resize(FTP_BLOCK_SIZE);
+}
+
+
+FileHandlerFTP::~FileHandlerFTP()
+{
+    Debug_println("delete FileHandlerFTP");
+    if (_ftp != nullptr) close(false);
+}
+
+
+bool FileHandlerFTP::start()
+{
+    return _size == 0 || _fetch_block(0);
+}
+
+
+int FileHandlerFTP::close(bool destroy)
+{
+    Debug_println("FileHandlerFTP::close");
+    if (_ftp != nullptr)
+    {
+        {
+            std::lock_guard<std::recursive_mutex> lock(_ftp->lock);
+            if (_stream_active())
+                _ftp->abort_transfer();
+        }
+        _ftp.reset();
+    }
+    if (_store != nullptr)
+    {
+        // keep the file if all of it has been retrieved
+        if (_present_count == _block_count())
+        {
+            FileHandler *fh = fnFileCache.publish(_store, _store_path, _cache_key);
+            if (fh != nullptr)
+                fh->close();
+        }
+        else
+            fnFileCache.discard(_store, _store_path);
+        _store = nullptr;
+    }
+    if (destroy) delete this;
+    return 0;
+}
+
+
+int FileHandlerFTP::seek(long int off, int whence)
+{
+    Debug_println("FileHandlerFTP::seek");
+    long int new_pos;
+    switch (whence)
+    {
+    case SEEK_SET:
+        new_pos = off;
+        break;
+    case SEEK_CUR:
+        new_pos = (long int)_pos + off;
+        break;
+    case SEEK_END:
+        new_pos = (long int)_size + off;
+        break;
+    default:
+        errno = EINVAL;
+        return -1;
+    }
+    if (new_pos < 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    _pos = (uint32_t)new_pos;
+    return 0;
+}
+
+
+long int FileHandlerFTP::tell()
+{
+    Debug_println("FileHandlerFTP::tell");
+    return (long)_pos;
+}
+
+
+size_t FileHandlerFTP::read(void *ptr, size_t size, size_t count)
+{
+    Debug_println("FileHandlerFTP::read");
+
+    if (_ftp == nullptr || size == 0 || _pos >= _size)
+        return 0;
+
+    size_t bytes_remaining = std::min(size * count, (size_t)(_size - _pos));
+    size_t bytes_read = 0;
+    uint8_t *dst = (uint8_t *)ptr;
+
+    while (bytes_remaining > 0)
+    {
+        uint32_t index = _pos / FTP_BLOCK_SIZE;
+        uint32_t offset = _pos % FTP_BLOCK_SIZE;
+        uint32_t len = (uint32_t)std::min(bytes_remaining, (size_t)(_block_len(index) - offset));
+
+        if (!_has_block(index) && !_fetch_block(index))
+            break;
+        if (!_copy_block(index, offset, dst + bytes_read, len))
+            break;
+
+        _pos += len;
+        bytes_read += len;
+        bytes_remaining -= len;
+    }
+    return bytes_read / size;
+}
+
+
+size_t FileHandlerFTP::write(const void *ptr, size_t size, size_t count)
+{
+    Debug_println("FileHandlerFTP::write - file is read-only");
+    errno = EBADF;
+    return 0;
+}
+
+
+int FileHandlerFTP::flush()
+{
+    return 0;
+}
+
+
+uint32_t FileHandlerFTP::_block_len(uint32_t index)
+{
+    uint32_t offset = index * FTP_BLOCK_SIZE;
+    return std::min((uint32_t)FTP_BLOCK_SIZE, _size - offset);
+}
+
+
+FileHandlerFTP::mem_block *FileHandlerFTP::_find_mem(uint32_t index)
+{
+    for (mem_block &b : _mem)
+    {
+        if (b.index == index)
+            return &b;
+    }
+    return nullptr;
+}
+
+
+bool FileHandlerFTP::_has_block(uint32_t index)
+{
+    if (_store != nullptr)
+        return _present[index];
+    return _find_mem(index) != nullptr;
+}
+
+
+bool FileHandlerFTP::_store_block(uint32_t index, const uint8_t *buf, uint32_t len)
+{
+    if (_store != nullptr)
+    {
+        if (_store->seek(index * FTP_BLOCK_SIZE, SEEK_SET) != 0 || _store->write(buf, 1, len) != len)
+        {
+            Debug_printf("FileHandlerFTP: failed to store block %u\n", index);
+            return false;
+        }
+        _present[index] = true;
+        _present_count++;
+        return true;
+    }
+
+    // replace least recently used block
+    mem_block *b;
+    if (_mem.size() < FTP_MEMORY_BLOCKS)
+    {
+        _mem.push_back(mem_block());
+        b = &_mem.back();
+    }
+    else
+    {
+        b = &*std::min_element(_mem.begin(), _mem.end(),
+                               [](const mem_block &x, const mem_block &y) { return x.used < y.used; });
+    }
+    b->index = index;
+    b->used = ++_use_counter;
+    b->data.assign(buf, buf + len);
+    return true;
+}
+
+
+bool FileHandlerFTP::_copy_block(uint32_t index, uint32_t offset, uint8_t *dst, uint32_t len)
+{
+    if (_store != nullptr)
+    {
+        return _store->seek(index * FTP_BLOCK_SIZE + offset, SEEK_SET) == 0
+            && _store->read(dst, 1, len) == len;
+    }
+
+    mem_block *b = _find_mem(index);
+    if (b == nullptr)
+        return false;
+    b->used = ++_use_counter;
+    memcpy(dst, b->data.data() + offset, len);
+    return true;
+}
+
+
+// Transfer is ours unless the FTP connection was used for something else since
+bool FileHandlerFTP::_stream_active()
+{
+    return _streaming && _ftp->transfer_id() == _transfer_id && _ftp->transfer_active();
+}
+
+
+bool FileHandlerFTP::_start_stream(uint32_t offset)
+{
+    if (_no_rest)
+        offset = 0;
+
+    Debug_printf("FileHandlerFTP: retrieving \"%s\" from %u\n", _path.c_str(), offset);
+    _streaming = false;
+    if (_ftp->open_file(_path, false, offset))
+    {
+        if (offset == 0)
+            return false;
+        // server without REST, every transfer has to start from the beginning
+        Debug_println("FileHandlerFTP: ranged retrieval failed, reading from start");
+        _no_rest = true;
+        offset = 0;
+        if (_ftp->open_file(_path, false, 0))
+            return false;
+    }
+    _streaming = true;
+    _transfer_id = _ftp->transfer_id();
+    _stream_pos = offset;
+    return true;
+}
+
+
+bool FileHandlerFTP::_read_stream(uint8_t *buf, uint32_t len)
+{
+    uint32_t received = 0;
+    while (received < len)
+    {
+        int n = _ftp->read_data(buf + received, len - received);
+        if (n <= 0)
+        {
+            Debug_printf("FileHandlerFTP: transfer ended at %u\n", _stream_pos + received);
+            return false;
+        }
+        received += n;
+    }
+    return true;
+}
+
+
+bool FileHandlerFTP::_fetch_block(uint32_t index)
+{
+    uint32_t offset = index * FTP_BLOCK_SIZE;
+    std::lock_guard<std::recursive_mutex> lock(_ftp->lock);
+
+    // continue running transfer if the block is ahead of it, otherwise start new one
+    if (!_stream_active() || _stream_pos > offset
+        || (!_no_rest && offset - _stream_pos > FTP_STREAM_SKIP_BLOCKS * FTP_BLOCK_SIZE))
+    {
+        if (!_start_stream(offset))
+            return false;
+    }
+
+    // blocks passed on the way are kept too
+    while (_stream_pos <= offset)
+    {
+        uint32_t i = _stream_pos / FTP_BLOCK_SIZE;
+        uint32_t len = _block_len(i);
+        if (!_read_stream(_block_buf.data(), len))
+        {
+            _streaming = false;
+            _ftp->abort_transfer();
+            return false;
+        }
+        _stream_pos += len;
+        if (!_has_block(i) && !_store_block(i, _block_buf.data(), len))
+            return false;
+    }
+    return true;
+}
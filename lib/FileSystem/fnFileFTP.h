@@ -0,0 +1,81 @@
+#ifndef _FN_FILEFTP_
+#define _FN_FILEFTP_
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "fnFTP.h"
+#include "fnFile.h"
+
+#define FTP_BLOCK_SIZE 16384        // unit of ranged reads and of data kept locally
+#define FTP_MEMORY_BLOCKS 16        // blocks kept in memory when there is no cache file
+#define FTP_STREAM_SKIP_BLOCKS 4    // forward gap which is read through instead of restarting transfer
+
+
+// Read-only file on FTP server which is read on demand. Blocks are retrieved with ranged
+// RETR (REST) as they are needed, sequential reads continue the running transfer.
+// Retrieved blocks are written into the cache file, once the whole file has been read
+// it is published to the file cache. Without cache file, recently used blocks are kept in memory.
+class FileHandlerFTP : public FileHandler
+{
+protected:
+    struct mem_block
+    {
+        uint32_t index;
+        uint64_t used;
+        std::vector<uint8_t> data;
+    };
+
+    std::shared_ptr<fnFTP> _ftp; // connection of the file system, used under its lock
+    std::string _path;
+    uint32_t _size;
+    uint32_t _pos = 0;
+
+    // running transfer
+    bool _streaming = false;
+    uint32_t _transfer_id = 0;
+    uint32_t _stream_pos = 0;
+    bool _no_rest = false;
+    std::vector<uint8_t> _block_buf;
+
+    // retrieved blocks
+    FileHandler *_store;
+    std::string _store_path;
+    std::string _cache_key;
+    std::vector<bool> _present;
+    uint32_t _present_count = 0;
+    std::vector<mem_block> _mem;
+    uint64_t _use_counter = 0;
+
+    uint32_t _block_count() { return (_size + FTP_BLOCK_SIZE - 1) / FTP_BLOCK_SIZE; }
+    uint32_t _block_len(uint32_t index);
+    mem_block *_find_mem(uint32_t index);
+    bool _has_block(uint32_t index);
+    bool _store_block(uint32_t index, const uint8_t *buf, uint32_t len);
+    bool _copy_block(uint32_t index, uint32_t offset, uint8_t *dst, uint32_t len);
+    bool _stream_active();
+    bool _start_stream(uint32_t offset);
+    bool _read_stream(uint8_t *buf, uint32_t len);
+    bool _fetch_block(uint32_t index);
+
+public:
+    // store is file from FileCache::create() or nullptr, it's published under cache_key when complete
+    FileHandlerFTP(const std::shared_ptr<fnFTP> &ftp, const char *path, uint32_t size,
+                   FileHandler *store, const std::string &store_path, const std::string &cache_key);
+    virtual ~FileHandlerFTP() override;
+
+    // Retrieve first block, fails if the file can't be read
+    bool start();
+
+    virtual int close(bool destroy=true) override;
+    virtual int seek(long int off, int whence) override;
+    virtual long int tell() override;
+    virtual size_t read(void *ptr, size_t size, size_t count) override;
+    virtual size_t write(const void *ptr, size_t size, size_t count) override;
+    virtual int flush() override;
+};
+
+
+#endif //_FN_FILEFTP_
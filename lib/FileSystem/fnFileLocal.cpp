@@ -1,4 +1,9 @@
-#include <unistd.h>  // for fsync
+#include <unistd.h>  // for fsync, ftruncate
+#if defined(_WIN32)
+#include <io.h>      // for _chsize_s
+#elif defined(__linux__)
+#include <fcntl.h>   // for fallocate
+#endif
 #include "fnFileLocal.h"
 
 #include "../../include/debug.h"
@@ -67,3 +72,22 @@ int FileHandlerLocal::flush()
     // ret = fsync(fileno(_fh)); // Since we might get reset at any moment, go ahead and sync the file (not clear if fflush does this)
     return ret;
 }
+
+
+int FileHandlerLocal::truncate(long int size)
+{
+    Debug_printf("FileHandlerLocal::truncate %ld\n", size);
+    if (fflush(_fh) != 0)
+        return -1;
+#if defined(_WIN32)
+    return _chsize_s(_fileno(_fh), size) == 0 ? 0 : -1;
+#else
+    int fd = fileno(_fh);
+#ifdef __linux__
+    // reserve the space without writing it, file system without support falls back to sparse file
+    if (fallocate(fd, 0, 0, size) == 0 && ftruncate(fd, size) == 0)
+        return 0;
+#endif
+    return ftruncate(fd, size);
+#endif
+}
@@ -20,6 +20,7 @@ public:
     virtual size_t read(void *ptr, size_t size, size_t n) override;
     virtual size_t write(const void *ptr, size_t size, size_t n) override;
     virtual int flush() override;
+    virtual int truncate(long int size) override;
 };
 
 
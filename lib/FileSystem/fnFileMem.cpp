@@ -1,6 +1,7 @@
 
 #include <errno.h>
 #include <string.h>
+#include <algorithm>
 
 #include "fnFileMem.h"
 #include "../../include/debug.h"
@@ -126,10 +127,13 @@ int FileHandlerMem::flush()
 
 // set new file size, allocate additional buffer space, if needed
 // (smaller than current file size can be set but it does not shrink allocated buffer)
+// buffer is at least doubled to avoid reallocation and copying on every write
 // return 0 on success, -1 on failure
 int FileHandlerMem::grow(long filesize)
 {
     long bufsize = 1024 * ((filesize + 1023) / 1024);
+    if (bufsize > _size && bufsize < 2 * _size)
+        bufsize = std::max(bufsize, std::min(2 * _size, (long)FILEMEM_MAXSIZE));
     Debug_printf("FileHandlerMem::grow - file size / buffer size: %ld / %ld\n", filesize, bufsize > _size ? bufsize : _size);
     // grow buffer, if needed
     if (bufsize > _size)
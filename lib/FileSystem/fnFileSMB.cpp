@@ -1,15 +1,46 @@
 
 #include <errno.h>
+#include <string.h>
+#if defined(_WIN32)
+#include <winsock2.h>
+#define poll WSAPoll
+#else
+#include <poll.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
 
 #include "fnFileSMB.h"
 #include "../../include/debug.h"
 
 
-FileHandlerSMB::FileHandlerSMB(struct smb2_context *smb, struct smb2fh *handle)
+smbConnection::~smbConnection()
+{
+    if (smb != nullptr)
+    {
+        smb2_disconnect_share(smb);
+        smb2_destroy_context(smb);
+    }
+}
+
+
+FileHandlerSMB::FileHandlerSMB(const std::shared_ptr<smbConnection> &conn, struct smb2fh *handle)
 {
     Debug_println("new FileHandlerSMB");
-    _smb = smb;
+    std::lock_guard<std::recursive_mutex> lock(conn->lock);
+    _conn = conn;
+    _smb = conn->smb;
     _handle = handle;
+
+    // end-of-file from open, no request to server
+    if (smb2_lseek(_smb, _handle, 0, SEEK_END, &_size) < 0)
+        _size = 0;
+    smb2_lseek(_smb, _handle, 0, SEEK_SET, nullptr);
+
+    uint32_t max_read = smb2_get_max_read_size(_smb);
+    if (max_read > 0 && max_read < _chunk_size)
+        _chunk_size = max_read;
 };
 
 
@@ -26,10 +57,13 @@ int FileHandlerSMB::close(bool destroy)
     int result = 0;
     if (_handle != nullptr) 
     {
+        std::lock_guard<std::recursive_mutex> lock(_conn->lock);
+        _drop_readahead();
         result = smb2_close(_smb, _handle);
         _handle = nullptr;
         _smb = nullptr;
     }
+    _conn.reset();
     if (destroy) delete this;
     return result;
 }
@@ -38,13 +72,21 @@ int FileHandlerSMB::close(bool destroy)
 int FileHandlerSMB::seek(long int off, int whence)
 {
     Debug_println("FileHandlerSMB::seek");
+    std::lock_guard<std::recursive_mutex> lock(_conn->lock);
     uint64_t new_pos;
+    if (whence == SEEK_CUR)
+    {
+        // file offset is tracked here, reads and writes are positioned
+        off += (long int)_pos;
+        whence = SEEK_SET;
+    }
     if (smb2_lseek(_smb, _handle, off, whence, &new_pos) < 0)
     {
         Debug_printf("%s\n", smb2_get_error(_smb));
         return -1;
     }
-    Debug_printf("new pos is %lu\n", new_pos);
+    _pos = new_pos;
+    Debug_printf("new pos is %lu\n", (unsigned long)new_pos);
     return 0;
 }
 
@@ -52,47 +94,185 @@ int FileHandlerSMB::seek(long int off, int whence)
 long int FileHandlerSMB::tell()
 {
     Debug_println("FileHandlerSMB::tell");
-    uint64_t pos;
-    if (smb2_lseek(_smb, _handle, 0, SEEK_CUR, &pos) < 0)
+    return (long)_pos;
+}
+
+
+void FileHandlerSMB::_request_cb(struct smb2_context *smb, int status, void *command_data, void *cb_data)
+{
+    smb_request *req = (smb_request *)cb_data;
+    if (req->owner == nullptr)
     {
-        Debug_printf("%s\n", smb2_get_error(_smb));
-        return -1;
+        // nobody waits for this one anymore
+        delete req;
+        return;
+    }
+    req->status = status;
+    req->done = true;
+}
+
+
+FileHandlerSMB::smb_request *FileHandlerSMB::_submit_read(uint64_t offset, uint32_t length)
+{
+    smb_request *req = new smb_request;
+    req->owner = this;
+    req->offset = offset;
+    req->length = length;
+    req->status = 0;
+    req->done = false;
+    req->buffer.resize(length);
+
+    int result = smb2_pread_async(_smb, _handle, req->buffer.data(), length, offset, _request_cb, req);
+    if (result < 0)
+    {
+        Debug_printf("smb2_pread_async failed: %s\n", smb2_get_error(_smb));
+        delete req;
+        return nullptr;
+    }
+    return req;
+}
+
+
+void FileHandlerSMB::_release(smb_request *req)
+{
+    if (req->done)
+        delete req;
+    else
+        req->owner = nullptr; // callback will free it
+}
+
+
+void FileHandlerSMB::_drop_readahead()
+{
+    for (smb_request *req : _readahead)
+        _release(req);
+    _readahead.clear();
+}
+
+
+// Keep the read-ahead window full, requests follow each other up to the end of file
+void FileHandlerSMB::_fill_readahead()
+{
+    while (!_readahead.empty() && _readahead.size() < SMB_READS_IN_FLIGHT)
+    {
+        uint64_t next = _readahead.back()->offset + _readahead.back()->length;
+        if (next >= _size)
+            break;
+        smb_request *req = _submit_read(next, _chunk_size);
+        if (req == nullptr)
+            break;
+        _readahead.push_back(req);
     }
-    return (long)pos;
+}
+
+
+// Process SMB traffic until the request is completed
+bool FileHandlerSMB::_wait(smb_request *req)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    while (!req->done)
+    {
+        struct pollfd pfd;
+        pfd.fd = smb2_get_fd(_smb);
+        pfd.events = smb2_which_events(_smb);
+        pfd.revents = 0;
+
+        int result = poll(&pfd, 1, SMB_POLL_TIMEOUT_MS);
+        if (result < 0 && errno != EINTR)
+        {
+            Debug_printf("FileHandlerSMB poll failed: %d - %s\n", errno, strerror(errno));
+            return false;
+        }
+        if (result > 0 && smb2_service(_smb, pfd.revents) < 0)
+        {
+            Debug_printf("%s\n", smb2_get_error(_smb));
+            return false;
+        }
+        if (!req->done && std::chrono::steady_clock::now() - start > std::chrono::milliseconds(SMB_IO_TIMEOUT_MS))
+        {
+            Debug_println("FileHandlerSMB request timeout");
+            return false;
+        }
+    }
+    return true;
 }
 
 
 size_t FileHandlerSMB::read(void *ptr, size_t size, size_t count)
 {
     Debug_println("FileHandlerSMB::read");
+    std::lock_guard<std::recursive_mutex> lock(_conn->lock);
 
     size_t bytes_remaining = size * count;
     size_t bytes_read = 0;
-    int result;
+
+    // read-ahead is kept only for sequential access
+    bool sequential = (_pos == _next_read);
+    if (!sequential)
+        _drop_readahead();
+
     while (bytes_remaining > 0)
     {
-        result = smb2_read(_smb, _handle, (uint8_t *)ptr, (uint32_t)bytes_remaining);
-        if (result < 0)
+        // drop requests we are already past
+        while (!_readahead.empty() && _readahead.front()->offset + _readahead.front()->length <= _pos)
         {
-            if (errno == EAGAIN)
-                continue;
-            else
-            {
-                Debug_printf("%s\n", smb2_get_error(_smb));
+            _release(_readahead.front());
+            _readahead.pop_front();
+        }
+
+        smb_request *req;
+        if (!_readahead.empty() && _readahead.front()->offset <= _pos)
+            req = _readahead.front();
+        else
+        {
+            uint32_t length = _chunk_size;
+            if (!sequential)
+                length = (uint32_t)std::min((size_t)_chunk_size, std::max(bytes_remaining, (size_t)SMB_RANDOM_READ_SIZE));
+            req = _submit_read(_pos, length);
+            if (req == nullptr)
                 break;
-            }
+            _readahead.push_front(req);
         }
-        else if (result == 0)
+
+        if (sequential || bytes_read > 0)
+            _fill_readahead();
+
+        if (!_wait(req))
         {
-            break; // EOF
+            _drop_readahead();
+            break;
         }
-        else
+
+        if (req->status < 0)
         {
-            bytes_read += result;
-            bytes_remaining -= result;
+            Debug_printf("SMB read error: %s\n", strerror(-req->status));
+            _drop_readahead();
+            break;
         }
+
+        uint64_t data_end = req->offset + req->status;
+        if (_pos >= data_end)
+        {
+            if (req->status < (int)req->length && data_end < _size)
+            {
+                // short read (server limits), request the rest
+                _readahead.pop_front();
+                _release(req);
+                continue;
+            }
+            break; // EOF
+        }
+
+        size_t n = std::min(bytes_remaining, (size_t)(data_end - _pos));
+        memcpy((uint8_t *)ptr + bytes_read, req->buffer.data() + (_pos - req->offset), n);
+        bytes_read += n;
+        bytes_remaining -= n;
+        _pos += n;
     }
 
+    _next_read = _pos;
+
     return (size_t)(size * count == bytes_read ? count : bytes_read / size);
 }
 
@@ -100,30 +280,96 @@ size_t FileHandlerSMB::read(void *ptr, size_t size, size_t count)
 size_t FileHandlerSMB::write(const void *ptr, size_t size, size_t count)
 {
     Debug_println("FileHandlerSMB::write");
+    std::lock_guard<std::recursive_mutex> lock(_conn->lock);
 
-    size_t bytes_remaining = size * count;
+    size_t bytes_total = size * count;
+    size_t bytes_submitted = 0;
     size_t bytes_written = 0;
-    int result;
-    while (bytes_remaining > 0)
+    bool failed = false;
+
+    // cached data may be overwritten
+    _drop_readahead();
+    _next_read = UINT64_MAX;
+
+    uint32_t max_write = smb2_get_max_write_size(_smb);
+    if (max_write == 0)
+        max_write = 65536;
+
+    // writes are positioned, several of them can be in flight and complete in any order
+    std::deque<smb_request *> in_flight;
+    std::deque<smb_request *> to_send;
+    while (bytes_submitted < bytes_total)
+    {
+        smb_request *req = new smb_request;
+        req->owner = this;
+        req->offset = _pos + bytes_submitted;
+        req->length = (uint32_t)std::min((size_t)max_write, bytes_total - bytes_submitted);
+        req->status = 0;
+        req->done = false;
+        // own copy of data, request may outlive caller's buffer on error
+        req->buffer.assign((const uint8_t *)ptr + bytes_submitted, (const uint8_t *)ptr + bytes_submitted + req->length);
+        to_send.push_back(req);
+        bytes_submitted += req->length;
+    }
+
+    while (!failed && (!to_send.empty() || !in_flight.empty()))
     {
-        result = smb2_write(_smb, _handle, (uint8_t *)ptr, (uint32_t)bytes_remaining);
-        if (result < 0)
+        while (!to_send.empty() && in_flight.size() < SMB_WRITES_IN_FLIGHT)
         {
-            if (errno == EAGAIN)
-                continue;
-            else
+            smb_request *req = to_send.front();
+            to_send.pop_front();
+            if (smb2_pwrite_async(_smb, _handle, req->buffer.data(), req->length, req->offset, _request_cb, req) < 0)
             {
-                Debug_printf("%s\n", smb2_get_error(_smb));
+                Debug_printf("smb2_pwrite_async failed: %s\n", smb2_get_error(_smb));
+                delete req;
+                failed = true;
                 break;
             }
+            in_flight.push_back(req);
         }
-        else
+
+        if (failed || in_flight.empty())
+            break;
+
+        smb_request *req = in_flight.front();
+        if (!_wait(req))
+        {
+            failed = true;
+            break;
+        }
+        in_flight.pop_front();
+
+        if (req->status < 0)
         {
-            bytes_written += result;
-            bytes_remaining -= result;
+            Debug_printf("SMB write error: %s\n", strerror(-req->status));
+            failed = true;
         }
+        else if (req->status < (int)req->length)
+        {
+            // short write (server limits), send the rest
+            bytes_written += req->status;
+            req->buffer.erase(req->buffer.begin(), req->buffer.begin() + req->status);
+            req->offset += req->status;
+            req->length -= req->status;
+            req->status = 0;
+            req->done = false;
+            to_send.push_front(req);
+            continue;
+        }
+        else
+            bytes_written += req->status;
+        delete req;
     }
 
+    for (smb_request *req : in_flight)
+        _release(req);
+    for (smb_request *req : to_send)
+        delete req;
+
+    _pos += bytes_written;
+    if (_pos > _size)
+        _size = _pos;
+
     return (size_t)(size * count == bytes_written ? count : bytes_written / size);
 }
 
@@ -131,6 +377,7 @@ size_t FileHandlerSMB::write(const void *ptr, size_t size, size_t count)
 int FileHandlerSMB::flush()
 {
     Debug_println("FileHandlerSMB::flush");
+    std::lock_guard<std::recursive_mutex> lock(_conn->lock);
     int result;
     if ((result = smb2_fsync(_smb, _handle)) != 0)
     {
@@ -139,3 +386,23 @@ int FileHandlerSMB::flush()
     }
     return 0;
 }
+
+
+int FileHandlerSMB::truncate(long int size)
+{
+    Debug_printf("FileHandlerSMB::truncate %ld\n", size);
+    std::lock_guard<std::recursive_mutex> lock(_conn->lock);
+
+    // cached data may be cut off
+    _drop_readahead();
+    _next_read = UINT64_MAX;
+
+    // SET_INFO with end-of-file, server allocates the space
+    if (smb2_ftruncate(_smb, _handle, (uint64_t)size) < 0)
+    {
+        Debug_printf("%s\n", smb2_get_error(_smb));
+        return -1;
+    }
+    _size = size;
+    return 0;
+}
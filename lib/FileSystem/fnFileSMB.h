@@ -3,18 +3,69 @@
 
 #include <stdint.h>
 #include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include <smb2/libsmb2.h>
 
 #include "fnFile.h"
 
+#define SMB_READ_CHUNK_SIZE 16384   // size of read-ahead request, limited by server max read size
+#define SMB_RANDOM_READ_SIZE 4096   // minimal read request for non-sequential access
+#define SMB_READS_IN_FLIGHT 4       // read-ahead window for sequential access, in requests
+#define SMB_WRITES_IN_FLIGHT 4
+#define SMB_POLL_TIMEOUT_MS 1000
+#define SMB_IO_TIMEOUT_MS 30000
+
+/*
+ SMB connection of a mounted share, shared by the file system and files opened from it,
+ the connection is closed when the last of them is gone. libsmb2 context is not thread-safe,
+ every use of it holds the lock, requests of other threads wait until a request (with its
+ poll and timeout) is completed.
+*/
+struct smbConnection
+{
+    struct smb2_context *smb = nullptr;
+    std::recursive_mutex lock;
+
+    ~smbConnection();
+};
 
 class FileHandlerSMB : public FileHandler
 {
 protected:
+    // Asynchronous read or write request
+    // Request is owned by file handler until it is completed. If the handler gives up
+    // on the request (I/O error, close), request is released by completion callback.
+    struct smb_request
+    {
+        FileHandlerSMB *owner;
+        uint64_t offset;
+        uint32_t length;
+        int status;     // bytes transferred or -errno
+        bool done;
+        std::vector<uint8_t> buffer;
+    };
+
+    std::shared_ptr<smbConnection> _conn;
     struct smb2_context *_smb;
     struct smb2fh *_handle;
+    uint64_t _pos = 0;          // file position, all reads and writes are positioned
+    uint64_t _size = 0;         // file size known from open and own writes
+    uint64_t _next_read = 0;    // position where sequential read continues
+    uint32_t _chunk_size = SMB_READ_CHUNK_SIZE;
+    std::deque<smb_request *> _readahead; // read requests in file order
+
+    static void _request_cb(struct smb2_context *smb, int status, void *command_data, void *cb_data);
+    smb_request *_submit_read(uint64_t offset, uint32_t length);
+    void _release(smb_request *req);
+    void _drop_readahead();
+    void _fill_readahead();
+    bool _wait(smb_request *req);
+
 public:
-    FileHandlerSMB(struct smb2_context *smb, struct smb2fh *handle);
+    FileHandlerSMB(const std::shared_ptr<smbConnection> &conn, struct smb2fh *handle);
     virtual ~FileHandlerSMB() override;
 
     virtual int close(bool destroy=true) override;
@@ -23,6 +74,7 @@ public:
     virtual size_t read(void *ptr, size_t size, size_t count) override;
     virtual size_t write(const void *ptr, size_t size, size_t count) override;
     virtual int flush() override;
+    virtual int truncate(long int size) override;
 };
 
 
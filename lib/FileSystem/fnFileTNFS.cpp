@@ -62,6 +62,9 @@ long int FileHandlerTNFS::tell()
 {
     Debug_println("FileHandlerTNFS::tell");
     uint32_t pos;
+    tnfsLock lock(_mountinfo);
+    if (!lock.owns_lock())
+        return -1;
     tnfsFileHandleInfo *pFileInf = _mountinfo->get_filehandleinfo(_handle);
     if (pFileInf == nullptr) 
     {
@@ -7,41 +7,23 @@
 
 #include "fnSystem.h"
 #include "fnFileMem.h"
-#include "fnFsSD.h"
+#include "fnFileFTP.h"
+#include "fnFileCache.h"
 
 #define MAX_CACHE_MEMFILE_SIZE  204800
-
-// TODO
-#include <openssl/md5.h>
-void get_md5_string(const unsigned char *buf, size_t size, char *result)
-{
-    unsigned char md5_result[MD5_DIGEST_LENGTH];
-    MD5(buf, size, md5_result);
-    for (int i=0; i < MD5_DIGEST_LENGTH; i++)
-    {
-        sprintf(&result[i * 2], "%02x",  md5_result[i]);
-    }
-}
+#define FTP_ONDEMAND_MIN_SIZE   (4 * FTP_BLOCK_SIZE) // smaller files are retrieved whole
+#define FTP_COPY_BUFFER_SIZE    16384
 
 FileSystemFTP::FileSystemFTP()
 {
     Debug_printf("FileSystemFTP::ctor\n");
-    _ftp = nullptr;
     _url = nullptr;
-    // invalidate _last_dir
-    _last_dir[0] = '\0';
 }
 
 FileSystemFTP::~FileSystemFTP()
 {
     Debug_printf("FileSystemFTP::dtor\n");
-    if (_started)
-    {
-        _dircache.clear();
-        _ftp->logout();
-    }
-    if (_ftp != nullptr)
-        delete _ftp;
+    // connection is logged out when the last open file is closed too
 }
 
 bool FileSystemFTP::start(const char *url, const char *user, const char *password)
@@ -54,15 +36,10 @@ bool FileSystemFTP::start(const char *url, const char *user, const char *passwor
     if(url == nullptr || url[0] == '\0')
         return false;
 
-    if (_ftp != nullptr)
-        delete _ftp;
-
-    _ftp = new fnFTP();
-    if (_ftp == nullptr)
-    {
-        Debug_printf("FileSystemFTP::start() - failed to create FTP client\n");
-        return false;
-    }
+    _ftp = std::shared_ptr<fnFTP>(new fnFTP(), [](fnFTP *ftp) {
+        ftp->logout();
+        delete ftp;
+    });
 
     _url = EdUrlParser::parseUrl(url);
     if (!isValidURL(_url))
@@ -71,6 +48,7 @@ bool FileSystemFTP::start(const char *url, const char *user, const char *passwor
         return false;
     }
 
+    std::lock_guard<std::recursive_mutex> lock(_ftp->lock);
     res = _ftp->login(
         user == nullptr ? "anonymous" : user,
         password == nullptr ? "fujinet@fujinet.online" : password,
@@ -120,135 +98,128 @@ FILE  *FileSystemFTP::file_open(const char *path, const char *mode)
 
 FileHandler *FileSystemFTP::filehandler_open(const char *path, const char *mode)
 {
-    FileHandler *fh = cache_file(path);
+    FileHandler *fh = cache_file(path, mode);
     return fh;
 }
 
+// get size and modification time of file from fresh listing of its parent directory
+// return false if file was not found
+bool FileSystemFTP::stat_file(const char *path, uint32_t &size, time_t &mtime)
+{
+    const char *slash = strrchr(path, '/');
+    std::string dir = slash == nullptr ? std::string("/") : std::string(path, slash - path + 1);
+    const char *name = slash == nullptr ? path : slash + 1;
+
+    DirCache listing;
+    if (!list_directory(dir.c_str(), listing))
+        return false;
+
+    fsdir_entry *entry = listing.find(name);
+    if (entry == nullptr || entry->isDir)
+        return false;
+    size = entry->size;
+    mtime = entry->modified_time;
+    return true;
+}
+
 // read file from FTP path and write it to cache file
-// return FileHandler* on success (memory or SD file), nullptr on error
-FileHandler *FileSystemFTP::cache_file(const char *path)
+// return FileHandler* on success (cache or memory file), nullptr on error
+FileHandler *FileSystemFTP::cache_file(const char *path, const char *mode)
 {
-    // open FTP file
-    if (_ftp->open_file(path, false))
+    // file which did not change on the server is opened from the cache
+    uint32_t remote_size;
+    time_t remote_mtime;
+    bool have_stat = stat_file(path, remote_size, remote_mtime);
+    if (have_stat)
     {
-        Debug_printf("FileSystemFTP::cache_file - Failed to open file\n");
-        return nullptr;
+        FileHandler *fh = fnFileCache.open(FileCache::make_key(_url->mRawUrl.c_str(), path, remote_size, remote_mtime), mode);
+        if (fh != nullptr)
+            return fh;
+
+        // larger read-only files are read on demand, mounting doesn't wait for the whole file
+        if (strpbrk(mode, "wa+") == nullptr && remote_size >= FTP_ONDEMAND_MIN_SIZE)
+        {
+            std::string temp_path;
+            FileHandler *store = fnFileCache.create(temp_path);
+            FileHandlerFTP *fh_ftp = new FileHandlerFTP(_ftp, path, remote_size, store, temp_path,
+                FileCache::make_key(_url->mRawUrl.c_str(), path, remote_size, remote_mtime));
+            if (fh_ftp->start())
+                return fh_ftp;
+            Debug_printf("FileSystemFTP::cache_file - Failed to open file\n");
+            fh_ftp->close();
+            return nullptr;
+        }
     }
 
-    // open cache memory file
-    FileHandler *fh = new FileHandlerMem;
-    if (fh == nullptr)
+    // open FTP file, the connection is ours until the download is complete
+    std::lock_guard<std::recursive_mutex> lock(_ftp->lock);
+    if (_ftp->open_file(path, false))
     {
-        Debug_println("FileSystemFTP::cache_file - failed to open memory file");
+        Debug_printf("FileSystemFTP::cache_file - Failed to open file\n");
         return nullptr;
     }
 
-    // copy FTP to file
+    // download into the cache, keep the file in memory if there is no SD
+    std::string temp_path;
+    FileHandler *fh = fnFileCache.create(temp_path);
+    bool use_memfile = fh == nullptr;
+    if (use_memfile)
+        fh = new FileHandlerMem;
 
-    uint8_t buf[1024];
-    int tmout_counter = 1 + FTP_TIMEOUT / 50;
+    // copy FTP to file, as fast as the data arrives
+    std::vector<uint8_t> buf(FTP_COPY_BUFFER_SIZE);
     size_t bytes_read = 0;
-    bool use_memfile = true;
     bool cancel = false;
+    int num_read;
 
-    do
+    while ((num_read = _ftp->read_data(buf.data(), buf.size())) > 0)
     {
-        int available = _ftp->data_available();
-        if (available == 0)
+        // write cache file
+        if (fh->write(buf.data(), 1, num_read) < (size_t)num_read)
         {
-            if (--tmout_counter == 0)
-            {
-                // no data & no control message
-                Debug_printf("FileSystemFTP::cache_file - Timeout\n");
-                cancel = true;
-                break;
-            }
-            fnSystem.delay(50); // wait for more data or control message
-            available = _ftp->data_available();
+            Debug_printf("FileSystemFTP::cache_file - write failed\n");
+            cancel = true;
+            break;
         }
-        
-        if (available > 0)
+        bytes_read += num_read;
+
+        // check if memory file is over limit
+        if (use_memfile && bytes_read > MAX_CACHE_MEMFILE_SIZE)
         {
-            Debug_printf("Reading FTP data\n");
-            while (available > 0)
-            {
-                // read FTP data
-                int to_read = available > sizeof(buf) ? sizeof(buf) : available;
-                if (_ftp->read_file(buf, to_read))
-                {
-                    Debug_printf("FileSystemFTP::cache_file - read failed\n");
-                    cancel = true;
-                    break;
-                }
-                // write cache file
-                if (fh->write(buf, 1, to_read) < to_read)
-                {
-                    Debug_printf("FileSystemFTP::cache_file - write failed\n");
-                    cancel = true;
-                    break;
-                }
-                bytes_read += to_read;
-
-                // check if memory file is over limit
-                if (use_memfile && bytes_read > MAX_CACHE_MEMFILE_SIZE)
-                {
-                    // for large files switch from memory to SD card
-                    if (!fnSDFAT.running())
-                    {
-                        Debug_println("FileSystemFTP::cache_file - SD Filesystem is not running");
-                        cancel = true;
-                        break;
-                    }
-
-                    // SD file path, use MD5 of host url and MD5 of file path
-                    char cache_path[] = "/FujiNet/cache/........-................................";
-                    get_md5_string((const unsigned char *)(_url->mRawUrl.c_str()), _url->mRawUrl.length(), cache_path + 15);
-                    get_md5_string((const unsigned char *)path, strlen(path), cache_path + 15 + 9);
-                    cache_path[15 + 8] = '-';
-                    Debug_printf("SD cache file: %s\n", cache_path);
-
-                    // ensure cache directory exists
-                    fnSDFAT.create_path("/FujiNet/cache");
-
-                    // open SD file
-                    FileHandler *fh_sd = fnSDFAT.filehandler_open(cache_path, "wb+");
-                    if (fh_sd == nullptr)
-                    {
-                        Debug_println("FileSystemFTP::cache_file - failed to open SD file");
-                        cancel = true;
-                        break;
-                    }
-
-                    // copy from memory to SD file
-                    size_t count = 0;
-                    fh->seek(0, SEEK_SET);
-                    do
-                    {
-                        count = fh->read(buf, 1, sizeof(buf));
-                        fh_sd->write(buf, 1, count);
-                    } while (count > 0);
-                    fh->close();
-                    // switch to file on SD
-                    fh = fh_sd;
-                    use_memfile = false;
-                }
-                // next batch
-                available = _ftp->data_available();
-            }
-            tmout_counter = 1 + FTP_TIMEOUT / 50; // reset timeout counter
+            Debug_println("FileSystemFTP::cache_file - file is too large for memory");
+            cancel = true;
+            break;
         }
-    } while (!cancel && _ftp->data_connected());
+    }
+    if (num_read < 0)
+    {
+        Debug_printf("FileSystemFTP::cache_file - read failed\n");
+        cancel = true;
+    }
     _ftp->close();
 
     if (cancel)
     {
-        fh->close();
+        if (use_memfile)
+            fh->close();
+        else
+            fnFileCache.discard(fh, temp_path);
         fh = nullptr;
     }
-    else
+    else if (use_memfile)
     {
         fh->seek(0, SEEK_SET);
     }
+    else if (!have_stat || remote_size != bytes_read)
+    {
+        // version of the file is unknown or it is changing on the server, don't cache it
+        Debug_printf("FileSystemFTP::cache_file - not caching unverified \"%s\"\n", path);
+        fh = fnFileCache.use_once(fh, temp_path);
+    }
+    else
+    {
+        fh = fnFileCache.publish(fh, temp_path, FileCache::make_key(_url->mRawUrl.c_str(), path, remote_size, remote_mtime), mode);
+    }
     return fh;
 }
 
@@ -268,7 +239,16 @@ bool FileSystemFTP::dir_open(const char  *path, const char *pattern, uint16_t di
     if (path == nullptr)
         return false;
 
-    if (strcmp(_last_dir, path) == 0 && !_dircache.empty())
+    dir_listing &listing = _dir_listings.get();
+    {
+        std::lock_guard<std::mutex> lock(_closed_lock);
+        if (strcmp(listing.last_dir, path) != 0 && strcmp(_closed_listing.last_dir, path) == 0)
+        {
+            listing = std::move(_closed_listing);
+            _closed_listing = dir_listing();
+        }
+    }
+    if (strcmp(listing.last_dir, path) == 0 && !listing.dircache.empty())
     {
         Debug_printf("Use directory cache\n");
     }
@@ -276,73 +256,93 @@ bool FileSystemFTP::dir_open(const char  *path, const char *pattern, uint16_t di
     {
         Debug_printf("Fill directory cache\n");
 
-        _dircache.clear();
-        // invalidate _last_dir
-        _last_dir[0] = '\0';
-
-        // List FTP directory
-        bool res;
-        res = _ftp->open_directory(path, "");
+        // invalidate last_dir
+        listing.last_dir[0] = '\0';
 
-        if (res)
-        {
-            Debug_printf("Failed to open directory\n");
+        if (!list_directory(path, listing.dircache))
             return false;
-        }
 
         // Remember last visited directory
-        strlcpy(_last_dir, path, MAX_PATHLEN);
+        strlcpy(listing.last_dir, path, MAX_PATHLEN);
+    }
+
+    // Apply pattern matching filter and sort entries
+    listing.dircache.apply_filter(pattern, diropts);
 
-        // Populate directory cache with entries
-        string filename;
-        long filesz;
-        bool is_dir;
-        fsdir_entry *fs_de;
+    return true;
+}
 
-        // get first directory entry
-        res = _ftp->read_directory(filename, filesz, is_dir);
-        while(res == false)
-        {
-            // skip hidden
-            if (filename[0] == '.')
-                continue;
+// List FTP directory into the directory cache
+bool FileSystemFTP::list_directory(const char *path, DirCache &dircache)
+{
+    dircache.clear();
+
+    std::lock_guard<std::recursive_mutex> lock(_ftp->lock);
+    bool res;
+    res = _ftp->open_directory(path, "");
 
+    if (res)
+    {
+        Debug_printf("Failed to open directory\n");
+        return false;
+    }
+
+    // Populate directory cache with entries
+    string filename;
+    long filesz;
+    time_t mtime;
+    bool is_dir;
+    fsdir_entry *fs_de;
+
+    // get first directory entry
+    res = _ftp->read_directory(filename, filesz, mtime, is_dir);
+    while(res == false)
+    {
+        // skip hidden
+        if (filename[0] != '.')
+        {
             // new dir entry
-            fs_de = &_dircache.new_entry();
+            fs_de = &dircache.new_entry();
 
             // set entry members
             strlcpy(fs_de->filename, filename.c_str(), sizeof(fs_de->filename));
             fs_de->isDir = is_dir;
             fs_de->size = (uint32_t)filesz;
-            fs_de->modified_time = 0; // TODO
-
-            // get next
-            res = _ftp->read_directory(filename, filesz, is_dir);
+            fs_de->modified_time = mtime;
         }
-    }
-
-    // Apply pattern matching filter and sort entries
-    _dircache.apply_filter(pattern, diropts);
 
+        // get next
+        res = _ftp->read_directory(filename, filesz, mtime, is_dir);
+    }
     return true;
 }
 
 fsdir_entry *FileSystemFTP::dir_read()
 {
-    return _dircache.read();
+    dir_listing *listing = _dir_listings.find();
+    return listing != nullptr ? listing->dircache.read() : nullptr;
 }
 
 void FileSystemFTP::dir_close()
 {
-    // _dircache.clear();
+    // directory cache is kept for the next dir_open() of the same path, state of the thread is dropped
+    dir_listing *listing = _dir_listings.find();
+    if (listing != nullptr)
+    {
+        std::lock_guard<std::mutex> lock(_closed_lock);
+        _closed_listing = std::move(*listing);
+    }
+    _dir_listings.release();
 }
 
 uint16_t FileSystemFTP::dir_tell()
 {
-    return _dircache.tell();
+    dir_listing *listing = _dir_listings.find();
+    return listing != nullptr ? listing->dircache.tell() : FNFS_INVALID_DIRPOS;
 }
 
 bool FileSystemFTP::dir_seek(uint16_t pos)
 {
-    return _dircache.seek(pos);
+    dir_listing *listing = _dir_listings.find();
+    return listing != nullptr && listing->dircache.seek(pos);
 }
@@ -3,11 +3,14 @@
 
 #include <stdint.h>
 #include <cstddef>
+#include <memory>
+#include <mutex>
 
 #include "EdUrlParser.h"
 #include "fnFTP.h"
 #include "fnFS.h"
 #include "fnDirCache.h"
+#include "threadState.h"
 
 
 class FileSystemFTP : public FileSystem
@@ -16,12 +19,21 @@ private:
     // parsed FTP URL
     EdUrlParser *_url;
 
-    // fnFTP instance
-    fnFTP *_ftp;
-
-    // directory cache
-    char _last_dir[MAX_PATHLEN];
-    DirCache _dircache;
+    // fnFTP instance, shared with files read on demand which may outlive us
+    // its lock serializes threads using the connection
+    std::shared_ptr<fnFTP> _ftp;
+
+    // directory cache, one per thread, so threads can list directories at the same time
+    struct dir_listing
+    {
+        char last_dir[MAX_PATHLEN] = "";
+        DirCache dircache;
+    };
+    ThreadState<dir_listing> _dir_listings;
+    // listing left by dir_close(), the next dir_open() of the same path from any thread takes it,
+    // so paging through a directory does not list it again
+    std::mutex _closed_lock;
+    dir_listing _closed_listing;
 
 public:
     FileSystemFTP();
@@ -48,10 +60,12 @@ public:
     uint16_t dir_tell() override;
     bool dir_seek(uint16_t pos) override;
 
-    FileHandler *cache_file(const char *path);
+    FileHandler *cache_file(const char *path, const char *mode = FILE_READ);
 
 protected:
     bool isValidURL(EdUrlParser *url);
+    bool list_directory(const char *path, DirCache &dircache);
+    bool stat_file(const char *path, uint32_t &size, time_t &mtime);
 };
 
 #endif // _FN_FSFTP_
\ No newline at end of file
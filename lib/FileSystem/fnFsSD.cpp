@@ -10,6 +10,7 @@
 #include <memory>
 #include <vector>
 #include <sys/stat.h>
+#include <utime.h>
 #include <errno.h>
 #include "compat_string.h"
 
@@ -32,14 +33,8 @@
 #endif
 
 // Our global SD interface
-FileSystemSDFAT fnSDFAT;
-
-/*
- We maintain directory information cached to allow
- for sorting and to provide telldir/seekdir
-*/
-std::vector<fsdir_entry> _dir_entries;
-uint16_t _dir_entry_current = 0;
+// SD directory of the instance running on this thread (-n option)
+thread_local FileSystemSDFAT fnSDFAT;
 
 bool _fssd_fsdir_sort_name_ascend(fsdir_entry &left, fsdir_entry &right)
 {
@@ -126,15 +121,17 @@ bool FileSystemSDFAT::dir_open(const char * path, const char * pattern, uint16_t
     // TODO: Add pattern and sorting options
 
     // Throw out any existing directory entry data
-    _dir_entries.clear();
-    _dir_entry_current = 0;
+    dir_listing &listing = _dir_listings.get();
+    listing.entries.clear();
+    listing.current = 0;
 
     char * fpath = _make_fullpath(path);
     Debug_printf("FileSystemSDFAT::dir_open - opendir \"%s\"\n", fpath);
-    _dir = opendir(fpath);
+    DIR *dir = opendir(fpath);
+    std::string dirpath(fpath);
     free(fpath);
 
-    if(_dir == nullptr)
+    if(dir == nullptr)
         return false;
 
     bool have_pattern = pattern != nullptr && pattern[0] != '\0';
@@ -147,7 +144,7 @@ bool FileSystemSDFAT::dir_open(const char * path, const char * pattern, uint16_t
     struct dirent *d;
     struct stat s;
 
-    while((d = readdir(_dir)) != nullptr)
+    while((d = readdir(dir)) != nullptr)
     {
         // // An empty name indicates the end of the directory
         // if(finfo.fname[0] == '\0')
@@ -186,13 +183,11 @@ bool FileSystemSDFAT::dir_open(const char * path, const char * pattern, uint16_t
 
         // Copy the data we want into the record
         strlcpy(entry->filename, d->d_name, sizeof(entry->filename));
-        fpath = _make_fullpath(entry->filename);
-        if(stat(fpath, &s) == 0)
+        if(stat((dirpath + "/" + d->d_name).c_str(), &s) == 0)
         {
             entry->size = s.st_size;
             entry->modified_time = s.st_mtime;
         }
-        free(fpath);
     }
 
     // Choose the appropriate sorting function
@@ -211,12 +206,12 @@ bool FileSystemSDFAT::dir_open(const char * path, const char * pattern, uint16_t
     std::sort(store_files.begin(), store_files.end(), sortfn);
 
     // Combine the folder and file entries
-    _dir_entries.reserve( store_directories.size() + store_files.size() );
-    _dir_entries = store_directories; // This copies the contents from one vector to the other
-    _dir_entries.insert( _dir_entries.end(), store_files.begin(), store_files.end() );
+    listing.entries.reserve( store_directories.size() + store_files.size() );
+    listing.entries = store_directories; // This copies the contents from one vector to the other
+    listing.entries.insert( listing.entries.end(), store_files.begin(), store_files.end() );
 
     // Future operations will be performed on the cache
-    closedir(_dir);
+    closedir(dir);
 
     return true;
 }
@@ -224,16 +219,16 @@ bool FileSystemSDFAT::dir_open(const char * path, const char * pattern, uint16_t
 void FileSystemSDFAT::dir_close()
 {
     // Throw out any existing directory entry data
-    _dir_entries.clear();
-    _dir_entry_current = 0;
+    _dir_listings.release();
 }
 
 fsdir_entry * FileSystemSDFAT::dir_read()
 {
-    if(_dir_entry_current < _dir_entries.size())
+    dir_listing *listing = _dir_listings.find();
+    if(listing != nullptr && listing->current < listing->entries.size())
     {
-        //Debug_printf("#%d = \"%s\"\n", _dir_entry_current, _dir_entries[_dir_entry_current].filename);
-        return &_dir_entries[_dir_entry_current++];
+        //Debug_printf("#%d = \"%s\"\n", listing->current, listing->entries[listing->current].filename);
+        return &listing->entries[listing->current++];
     }
     else
         return nullptr;
@@ -241,17 +236,19 @@ fsdir_entry * FileSystemSDFAT::dir_read()
 
 uint16_t FileSystemSDFAT::dir_tell()
 {
-    if(_dir_entries.empty())
+    dir_listing *listing = _dir_listings.find();
+    if(listing == nullptr || listing->entries.empty())
         return FNFS_INVALID_DIRPOS;
     else
-        return _dir_entry_current;
+        return listing->current;
 }
 
 bool FileSystemSDFAT::dir_seek(uint16_t pos)
 {
-    if(pos < _dir_entries.size())
+    dir_listing *listing = _dir_listings.find();
+    if(listing != nullptr && pos < listing->entries.size())
     {
-        _dir_entry_current = pos;
+        listing->current = pos;
         return true;
     }
     else
@@ -383,6 +380,15 @@ bool FileSystemSDFAT::rename(const char* pathFrom, const char* pathTo)
     return (i == 0);
 }
 
+// Sets modification time of the file to current time
+bool FileSystemSDFAT::touch(const char* path)
+{
+    char * fpath = _make_fullpath(path);
+    int i = utime(fpath, nullptr);
+    free(fpath);
+    return (i == 0);
+}
+
 uint64_t FileSystemSDFAT::card_size()
 {
     return _card_capacity;
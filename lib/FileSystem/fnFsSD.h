@@ -3,12 +3,21 @@
 
 // #include "esp_vfs_fat.h"
 #include <stdio.h>
+#include <vector>
 #include "fnFS.h"
+#include "threadState.h"
 
 class FileSystemSDFAT : public FileSystem
 {
 private:
-    DIR * _dir;
+    // Directory read into memory for sorting and to provide telldir/seekdir,
+    // one per thread, so threads can list directories at the same time
+    struct dir_listing
+    {
+        std::vector<fsdir_entry> entries;
+        uint16_t current = 0;
+    };
+    ThreadState<dir_listing> _dir_listings;
     uint64_t _card_capacity = 0;
 public:
     bool start(const char *sd_path = nullptr);
@@ -34,6 +43,7 @@ public:
     bool dir_seek(uint16_t) override;
 
     bool create_path(const char *fullpath);
+    bool touch(const char *path);
     
     uint64_t card_size();
     uint64_t total_bytes();
@@ -41,6 +51,6 @@ public:
     const char *partition_type();
 };
 
-extern FileSystemSDFAT fnSDFAT;
+extern thread_local FileSystemSDFAT fnSDFAT;
 
 #endif // _FN_FSSD_
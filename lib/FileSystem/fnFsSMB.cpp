@@ -15,21 +15,14 @@ FileSystemSMB::FileSystemSMB()
     Debug_printf("FileSystemSMB::ctor\n");
     _smb = nullptr;
     _url = nullptr;
-    // invalidate _last_dir
-    _last_dir[0] = '/';
-    _last_dir[1] = '\0';
 }
 
 FileSystemSMB::~FileSystemSMB()
 {
     Debug_printf("FileSystemSMB::dtor\n");
-    if (_started)
-    {
-        _dircache.clear();
-        smb2_disconnect_share(_smb);
+    if (_url != nullptr)
         smb2_destroy_url(_url);
-        smb2_destroy_context(_smb);
-    }
+    // connection is closed when the last open file is closed too
 }
 
 bool FileSystemSMB::start(const char *url, const char *user, const char *password)
@@ -42,13 +35,16 @@ bool FileSystemSMB::start(const char *url, const char *user, const char *passwor
     if(url == nullptr || url[0] == '\0')
         return false;
 
-    _smb = smb2_init_context();
+    _conn = std::make_shared<smbConnection>();
+    _smb = _conn->smb = smb2_init_context();
     if (_smb == nullptr) 
     {
         Debug_printf("FileSystemSMB::start() - failed to init SMB2 context\n");
         return false;
     }
 
+    std::lock_guard<std::recursive_mutex> lock(_conn->lock);
+
     _url = smb2_parse_url(_smb, url);
     if (_url == nullptr) 
     {
@@ -84,6 +80,10 @@ bool FileSystemSMB::start(const char *url, const char *user, const char *passwor
 
 bool FileSystemSMB::exists(const char *path)
 {
+    if (!_started)
+        return false;
+
+    std::lock_guard<std::recursive_mutex> lock(_conn->lock);
     smb2_stat_64 st;
     int smb_error = smb2_stat(_smb, path, &st);
 
@@ -92,9 +92,11 @@ bool FileSystemSMB::exists(const char *path)
 
 bool FileSystemSMB::remove(const char *path)
 {
-    if(path == nullptr)
+    if(!_started || path == nullptr)
         return false;
 
+    std::lock_guard<std::recursive_mutex> lock(_conn->lock);
+
     // Figure out if this is a file or directory
     smb2_stat_64 st;
     if (0 != smb2_stat(_smb, path, &st))
@@ -114,6 +116,10 @@ bool FileSystemSMB::remove(const char *path)
 
 bool FileSystemSMB::rename(const char *pathFrom, const char *pathTo)
 {
+    if (!_started)
+        return false;
+
+    std::lock_guard<std::recursive_mutex> lock(_conn->lock);
     int smb_error = smb2_rename(_smb, pathFrom, pathTo);
     return smb_error == 0;    
 }
@@ -163,16 +169,21 @@ FileHandler *FileSystemSMB::filehandler_open(const char *path, const char *mode)
         }
     }
 
+    std::lock_guard<std::recursive_mutex> lock(_conn->lock);
     if ((fh = smb2_open(_smb, smb_path, O_RDONLY)) == nullptr) // TODO use open_flags
     {
         return nullptr;
     }
 
-    return new FileHandlerSMB(_smb, fh);
+    return new FileHandlerSMB(_conn, fh);
 }
 
 bool FileSystemSMB::is_dir(const char *path)
 {
+    if (!_started)
+        return false;
+
+    std::lock_guard<std::recursive_mutex> lock(_conn->lock);
     smb2_stat_64 st;
     if (smb2_stat(_smb, path, &st) != 0)
         return false;
@@ -191,7 +202,16 @@ bool FileSystemSMB::dir_open(const char  *path, const char *pattern, uint16_t di
     if (smb_path != nullptr && smb_path[0] == '/')
         smb_path += 1;
 
-    if (strcmp(_last_dir, smb_path) == 0)
+    dir_listing &listing = _dir_listings.get();
+    {
+        std::lock_guard<std::mutex> lock(_closed_lock);
+        if (strcmp(listing.last_dir, smb_path) != 0 && strcmp(_closed_listing.last_dir, smb_path) == 0)
+        {
+            listing = std::move(_closed_listing);
+            _closed_listing = dir_listing();
+        }
+    }
+    if (strcmp(listing.last_dir, smb_path) == 0)
     {
         Debug_printf("Use directory cache\n");
     }
@@ -199,10 +219,12 @@ bool FileSystemSMB::dir_open(const char  *path, const char *pattern, uint16_t di
     {
         Debug_printf("Fill directory cache\n");
 
-        _dircache.clear();
-        // invalidate _last_dir
-        _last_dir[0] = '/';
-        _last_dir[1] = '\0';
+        listing.dircache.clear();
+        // invalidate last_dir
+        listing.last_dir[0] = '/';
+        listing.last_dir[1] = '\0';
+
+        std::lock_guard<std::recursive_mutex> lock(_conn->lock);
 
         // Open SMB directory
         struct smb2dir *smb_dir;
@@ -215,7 +237,7 @@ bool FileSystemSMB::dir_open(const char  *path, const char *pattern, uint16_t di
         }
 
         // Remember last visited directory
-        strlcpy(_last_dir, smb_path, MAX_PATHLEN);
+        strlcpy(listing.last_dir, smb_path, MAX_PATHLEN);
 
         // Populate directory cache with entries
         smb2dirent *smb_de;
@@ -232,7 +254,7 @@ bool FileSystemSMB::dir_open(const char  *path, const char *pattern, uint16_t di
                 continue;
 
             // new dir entry
-            fs_de = &_dircache.new_entry();
+            fs_de = &listing.dircache.new_entry();
 
             // set entry members
             strlcpy(fs_de->filename, smb_de->name, sizeof(fs_de->filename));
@@ -249,27 +271,37 @@ bool FileSystemSMB::dir_open(const char  *path, const char *pattern, uint16_t di
     }
 
     // Apply pattern matching filter and sort entries
-    _dircache.apply_filter(pattern, diropts);
+    listing.dircache.apply_filter(pattern, diropts);
 
     return true;
 }
 
 fsdir_entry *FileSystemSMB::dir_read()
 {
-    return _dircache.read();
+    dir_listing *listing = _dir_listings.find();
+    return listing != nullptr ? listing->dircache.read() : nullptr;
 }
 
 void FileSystemSMB::dir_close()
 {
-    // _dircache.clear();
+    // directory cache is kept for the next dir_open() of the same path, state of the thread is dropped
+    dir_listing *listing = _dir_listings.find();
+    if (listing != nullptr)
+    {
+        std::lock_guard<std::mutex> lock(_closed_lock);
+        _closed_listing = std::move(*listing);
+    }
+    _dir_listings.release();
 }
 
 uint16_t FileSystemSMB::dir_tell()
 {
-    return _dircache.tell();
+    dir_listing *listing = _dir_listings.find();
+    return listing != nullptr ? listing->dircache.tell() : FNFS_INVALID_DIRPOS;
 }
 
 bool FileSystemSMB::dir_seek(uint16_t pos)
 {
-    return _dircache.seek(pos);
+    dir_listing *listing = _dir_listings.find();
+    return listing != nullptr && listing->dircache.seek(pos);
 }
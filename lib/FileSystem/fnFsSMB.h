@@ -3,21 +3,35 @@
 
 #include <stdint.h>
 #include <cstddef>
+#include <memory>
+#include <mutex>
 #include <smb2/libsmb2.h>
 
 #include "fnFS.h"
 #include "fnDirCache.h"
+#include "fnFileSMB.h"
+#include "threadState.h"
 
 
 class FileSystemSMB : public FileSystem
 {
 private:
+    // connection, shared with open files which may outlive us
+    std::shared_ptr<smbConnection> _conn;
     struct smb2_context *_smb;
     struct smb2_url *_url;
 
-    // directory cache
-    char _last_dir[MAX_PATHLEN];
-    DirCache _dircache;
+    // directory cache, one per thread, so threads can list directories at the same time
+    struct dir_listing
+    {
+        char last_dir[MAX_PATHLEN] = "/"; // "/" is never a valid SMB path, see dir_open()
+        DirCache dircache;
+    };
+    ThreadState<dir_listing> _dir_listings;
+    // listing left by dir_close(), the next dir_open() of the same path from any thread takes it,
+    // so paging through a directory does not list it again
+    std::mutex _closed_lock;
+    dir_listing _closed_listing;
 
 public:
     FileSystemSMB();
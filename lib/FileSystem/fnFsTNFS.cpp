@@ -211,20 +211,21 @@ bool FileSystemTNFS::dir_open(const char * path, const char *pattern, uint16_t d
     if(TNFS_RESULT_SUCCESS == tnfs_opendirx(&_mountinfo, path, s_opt, d_opt, pattern, 0))
     {
         // Save the directory for later use, making sure it starts and ends with '/''
+        char *dirpath = _dir_listings.get().dirpath;
         if(path[0] != '/')
         {
-            _current_dirpath[0] = '/';
-            strlcpy(_current_dirpath + 1, path, sizeof(_current_dirpath)-1);
+            dirpath[0] = '/';
+            strlcpy(dirpath + 1, path, TNFS_MAX_FILELEN-1);
         } 
         else
         {
-            strlcpy(_current_dirpath, path, sizeof(_current_dirpath));
+            strlcpy(dirpath, path, TNFS_MAX_FILELEN);
         }
-        int l = strlen(_current_dirpath);
-        if((l > 0) && (l < sizeof(_current_dirpath) -2) && (_current_dirpath[l -1] != '/'))
+        int l = strlen(dirpath);
+        if((l > 0) && (l < TNFS_MAX_FILELEN -2) && (dirpath[l -1] != '/'))
         {
-            _current_dirpath[l] = '/';
-            _current_dirpath[l+1] = '\0';
+            dirpath[l] = '/';
+            dirpath[l+1] = '\0';
         }
 
         return true;
@@ -240,15 +241,16 @@ fsdir_entry * FileSystemTNFS::dir_read()
 
     tnfsStat fstat;
 
-    _direntry.filename[0] = '\0';
-    if(TNFS_RESULT_SUCCESS != tnfs_readdirx(&_mountinfo, &fstat, _direntry.filename, sizeof(_direntry.filename)))
+    fsdir_entry &direntry = _dir_listings.get().entry;
+    direntry.filename[0] = '\0';
+    if(TNFS_RESULT_SUCCESS != tnfs_readdirx(&_mountinfo, &fstat, direntry.filename, sizeof(direntry.filename)))
         return nullptr;
 
-    _direntry.size = fstat.filesize;
-    _direntry.modified_time = fstat.m_time;
-    _direntry.isDir = fstat.isDir;
+    direntry.size = fstat.filesize;
+    direntry.modified_time = fstat.m_time;
+    direntry.isDir = fstat.isDir;
 
-    return &_direntry;
+    return &direntry;
 }
 
 void FileSystemTNFS::dir_close()
@@ -256,7 +258,7 @@ void FileSystemTNFS::dir_close()
     if(!_started)
         return;
     tnfs_closedir(&_mountinfo);
-    _current_dirpath[0] = '\0';
+    _dir_listings.release();
 }
 
 uint16_t FileSystemTNFS::dir_tell()
@@ -2,14 +2,22 @@
 #define _FN_FSTNFS_
 
 #include "fnFS.h"
+#include "threadState.h"
 #include "tnfslib.h"
 
 class FileSystemTNFS : public FileSystem
 {
 private:
+    // Directory being listed by a thread, the mount keeps the open handle of each thread
+    struct dir_listing
+    {
+        fsdir_entry entry;
+        char dirpath[TNFS_MAX_FILELEN];
+    };
+
     tnfsMountInfo _mountinfo;
     uint64_t _last_dns_refresh;
-    char _current_dirpath[TNFS_MAX_FILELEN];
+    ThreadState<dir_listing> _dir_listings;
 
 public:
     FileSystemTNFS();
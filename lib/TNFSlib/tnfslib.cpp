@@ -48,6 +48,9 @@ int tnfs_mount(tnfsMountInfo *m_info)
     if (m_info == nullptr)
         return -1;
 
+    tnfsLock lock(m_info);
+    if (!lock.owns_lock())
+        return TNFS_RESULT_TRY_AGAIN;
     // Unmount if we happen to have sesssion
     if (m_info->session != TNFS_INVALID_SESSION)
         tnfs_umount(m_info);
@@ -110,6 +113,9 @@ int tnfs_umount(tnfsMountInfo *m_info)
     if (m_info == nullptr)
         return -1;
 
+    tnfsLock lock(m_info);
+    if (!lock.owns_lock())
+        return TNFS_RESULT_TRY_AGAIN;
     tnfsPacket packet;
     packet.command = TNFS_CMD_UNMOUNT;
 
@@ -135,6 +141,9 @@ int tnfs_open(tnfsMountInfo *m_info, const char *filepath, uint16_t open_mode, u
     if (m_info == nullptr || filepath == nullptr || file_handle == nullptr)
         return -1;
 
+    tnfsLock lock(m_info);
+    if (!lock.owns_lock())
+        return TNFS_RESULT_TRY_AGAIN;
     *file_handle = TNFS_INVALID_HANDLE;
 
     // Find a free slot in our table of file handles
@@ -224,6 +233,9 @@ int tnfs_close(tnfsMountInfo *m_info, int16_t file_handle)
     if (m_info == nullptr || false == TNFS_VALID_AS_UINT8(file_handle))
         return -1;
 
+    tnfsLock lock(m_info);
+    if (!lock.owns_lock())
+        return TNFS_RESULT_TRY_AGAIN;
     // Find info on this handle
     tnfsFileHandleInfo *pFileInf = m_info->get_filehandleinfo(file_handle);
     if (pFileInf == nullptr)
@@ -438,6 +450,9 @@ int tnfs_read(tnfsMountInfo *m_info, int16_t file_handle, uint8_t *buffer, uint1
         buffer == nullptr || bufflen > (TNFS_PAYLOAD_SIZE - 3) || resultlen == nullptr)
         return -1;
 
+    tnfsLock lock(m_info);
+    if (!lock.owns_lock())
+        return TNFS_RESULT_TRY_AGAIN;
     *resultlen = 0;
 
     // Find info on this handle
@@ -489,6 +504,9 @@ int tnfs_write(tnfsMountInfo *m_info, int16_t file_handle, uint8_t *buffer, uint
         buffer == nullptr || bufflen > (TNFS_PAYLOAD_SIZE - 3) || resultlen == nullptr)
         return -1;
 
+    tnfsLock lock(m_info);
+    if (!lock.owns_lock())
+        return TNFS_RESULT_TRY_AGAIN;
     *resultlen = 0;
 
     // Find info on this handle
@@ -574,6 +592,9 @@ int tnfs_lseek(tnfsMountInfo *m_info, int16_t file_handle, int32_t position, uin
     if (m_info == nullptr || false == TNFS_VALID_AS_UINT8(file_handle))
         return -1;
 
+    tnfsLock lock(m_info);
+    if (!lock.owns_lock())
+        return TNFS_RESULT_TRY_AGAIN;
     // Make sure we're using a valid seek type
     if (type != SEEK_SET && type != SEEK_CUR && type != SEEK_END)
         return TNFS_RESULT_INVALID_ARGUMENT;
@@ -634,7 +655,7 @@ int tnfs_lseek(tnfsMountInfo *m_info, int16_t file_handle, int32_t position, uin
 }
 
 /*
-    Opens directory and stores directory handle in tnfsMountInfo.dir_handle
+    Opens directory and stores directory handle of calling thread in tnfsMountInfo
     sortopts = zero or more TNFS_DIRSORT flags
     diropts = zero or more TNFS_DIROPT flags
     pattern = zero-terminated wildcard pattern string
@@ -646,6 +667,9 @@ int tnfs_opendirx(tnfsMountInfo *m_info, const char *directory, uint8_t sortopts
     if (m_info == nullptr || directory == nullptr)
         return -1;
 
+    tnfsLock lock(m_info);
+    if (!lock.owns_lock())
+        return TNFS_RESULT_TRY_AGAIN;
 #define OFFSET_OPENDIRX_DIROPT 0
 #define OFFSET_OPENDIRX_SORTOPT 1
 #define OFFSET_OPENDIRX_MAXRESULTS 2
@@ -685,9 +709,8 @@ int tnfs_opendirx(tnfsMountInfo *m_info, const char *directory, uint8_t sortopts
     {
         if (packet.payload[0] == TNFS_RESULT_SUCCESS)
         {
-            m_info->dir_handle = packet.payload[1];
-            m_info->dir_entries = TNFS_UINT16_FROM_LOHI_BYTEPTR(packet.payload + 2);
-            Debug_printf("Directory opened, handle ID: %hd, entries: %u\n", m_info->dir_handle, m_info->dir_entries);
+            m_info->set_dir_handle(packet.payload[1], TNFS_UINT16_FROM_LOHI_BYTEPTR(packet.payload + 2));
+            Debug_printf("Directory opened, handle ID: %hd, entries: %u\n", m_info->get_dir_handle(), m_info->get_dir_entries());
         }
         return packet.payload[0];
     }
@@ -721,15 +744,22 @@ void _readdirx_fill_response(tnfsDirCacheEntry *pCached, tnfsStat *filestat, cha
 }
 
 /*
-    Reads next available file using open directory handle specified in
-    tnfsMountInfo.dir_handle
+    Reads next available file using open directory handle of calling thread
+    kept in tnfsMountInfo
     dir_entry filled with filename up to dir_entry_len
  returns: 0: success, -1: failed to deliver/receive packet, other: TNFS error result code
 */
 int tnfs_readdirx(tnfsMountInfo *m_info, tnfsStat *filestat, char *dir_entry, int dir_entry_len)
 {
+    if (m_info == nullptr)
+        return -1;
+
+    tnfsLock lock(m_info);
+    if (!lock.owns_lock())
+        return TNFS_RESULT_TRY_AGAIN;
     // Check for a valid open handle ID
-    if (m_info == nullptr || false == TNFS_VALID_AS_UINT8(m_info->dir_handle))
+    int16_t dir_handle = m_info->get_dir_handle();
+    if (false == TNFS_VALID_AS_UINT8(dir_handle))
         return -1;
 
     // See if we have an entry in our directory cache to return first
@@ -759,7 +789,7 @@ int tnfs_readdirx(tnfsMountInfo *m_info, tnfsStat *filestat, char *dir_entry, in
 
     tnfsPacket packet;
     packet.command = TNFS_CMD_READDIRX;
-    packet.payload[0] = m_info->dir_handle;
+    packet.payload[0] = dir_handle;
     // Number of responses to read
     packet.payload[1] = TNFS_MAX_DIRCACHE_ENTRIES;
 
@@ -827,7 +857,15 @@ int tnfs_readdirx(tnfsMountInfo *m_info, tnfsStat *filestat, char *dir_entry, in
 */
 int tnfs_telldir(tnfsMountInfo *m_info, uint16_t *position)
 {
-    if (m_info == nullptr || false == TNFS_VALID_AS_UINT8(m_info->dir_handle))
+    if (m_info == nullptr)
+        return -1;
+
+    tnfsLock lock(m_info);
+    if (!lock.owns_lock())
+        return TNFS_RESULT_TRY_AGAIN;
+    // Check for a valid open handle ID
+    int16_t dir_handle = m_info->get_dir_handle();
+    if (false == TNFS_VALID_AS_UINT8(dir_handle))
         return -1;
 
     if(position == nullptr)
@@ -843,7 +881,7 @@ int tnfs_telldir(tnfsMountInfo *m_info, uint16_t *position)
 
     tnfsPacket packet;
     packet.command = TNFS_CMD_TELLDIR;
-    packet.payload[0] = m_info->dir_handle;
+    packet.payload[0] = dir_handle;
 
     if (_tnfs_transaction(m_info, packet, 1))
     {
@@ -861,7 +899,15 @@ int tnfs_telldir(tnfsMountInfo *m_info, uint16_t *position)
 */
 int tnfs_seekdir(tnfsMountInfo *m_info, uint16_t position)
 {
-    if (m_info == nullptr || false == TNFS_VALID_AS_UINT8(m_info->dir_handle))
+    if (m_info == nullptr)
+        return -1;
+
+    tnfsLock lock(m_info);
+    if (!lock.owns_lock())
+        return TNFS_RESULT_TRY_AGAIN;
+    // Check for a valid open handle ID
+    int16_t dir_handle = m_info->get_dir_handle();
+    if (false == TNFS_VALID_AS_UINT8(dir_handle))
         return -1;
 
     // A SEEKDIR will always invalidate our directory cache
@@ -869,7 +915,7 @@ int tnfs_seekdir(tnfsMountInfo *m_info, uint16_t position)
 
     tnfsPacket packet;
     packet.command = TNFS_CMD_SEEKDIR;
-    packet.payload[0] = m_info->dir_handle;
+    packet.payload[0] = dir_handle;
     uint32_t pos = position;
     TNFS_UINT32_TO_LOHI_BYTEPTR(pos, packet.payload + 1);
 
@@ -885,24 +931,28 @@ int tnfs_seekdir(tnfsMountInfo *m_info, uint16_t position)
 */
 int tnfs_closedir(tnfsMountInfo *m_info)
 {
-    if (m_info == nullptr || false == TNFS_VALID_AS_UINT8(m_info->dir_handle))
+    if (m_info == nullptr)
         return -1;
 
-    // Throw out any existing cached directory entries
-    m_info->empty_dircache();
+    // Directory state of the thread is dropped whatever the server says,
+    // a handle it failed to close is gone with the session
+    int16_t dir_handle = m_info->get_dir_handle();
+    m_info->release_dir();
+
+    // Check for a valid open handle ID
+    if (false == TNFS_VALID_AS_UINT8(dir_handle))
+        return -1;
+
+    tnfsLock lock(m_info);
+    if (!lock.owns_lock())
+        return TNFS_RESULT_TRY_AGAIN;
 
     tnfsPacket packet;
     packet.command = TNFS_CMD_CLOSEDIR;
-    packet.payload[0] = m_info->dir_handle;
+    packet.payload[0] = dir_handle;
 
     if (_tnfs_transaction(m_info, packet, 1))
-    {
-        if (packet.payload[0] == TNFS_RESULT_SUCCESS)
-        {
-            m_info->dir_handle = TNFS_INVALID_HANDLE;
-        }
         return packet.payload[0];
-    }
     return -1;
 }
 
@@ -915,6 +965,9 @@ int tnfs_mkdir(tnfsMountInfo *m_info, const char *directory)
     if (m_info == nullptr || directory == nullptr)
         return -1;
 
+    tnfsLock lock(m_info);
+    if (!lock.owns_lock())
+        return TNFS_RESULT_TRY_AGAIN;
     tnfsPacket packet;
     packet.command = TNFS_CMD_MKDIR;
 
@@ -938,6 +991,9 @@ int tnfs_rmdir(tnfsMountInfo *m_info, const char *directory)
     if (m_info == nullptr || directory == nullptr)
         return -1;
 
+    tnfsLock lock(m_info);
+    if (!lock.owns_lock())
+        return TNFS_RESULT_TRY_AGAIN;
     tnfsPacket packet;
     packet.command = TNFS_CMD_RMDIR;
 
@@ -961,6 +1017,9 @@ int tnfs_stat(tnfsMountInfo *m_info, tnfsStat *filestat, const char *filepath)
     if (m_info == nullptr || filepath == nullptr || filestat == nullptr)
         return -1;
 
+    tnfsLock lock(m_info);
+    if (!lock.owns_lock())
+        return TNFS_RESULT_TRY_AGAIN;
     tnfsPacket packet;
     packet.command = TNFS_CMD_STAT;
 
@@ -1015,6 +1074,9 @@ int tnfs_unlink(tnfsMountInfo *m_info, const char *filepath)
     if (m_info == nullptr || filepath == nullptr)
         return -1;
 
+    tnfsLock lock(m_info);
+    if (!lock.owns_lock())
+        return TNFS_RESULT_TRY_AGAIN;
     tnfsPacket packet;
     packet.command = TNFS_CMD_UNLINK;
 
@@ -1039,6 +1101,9 @@ int tnfs_rename(tnfsMountInfo *m_info, const char *old_filepath, const char *new
     if (m_info == nullptr || old_filepath == nullptr || new_filepath == nullptr)
         return -1;
 
+    tnfsLock lock(m_info);
+    if (!lock.owns_lock())
+        return TNFS_RESULT_TRY_AGAIN;
     tnfsPacket packet;
     packet.command = TNFS_CMD_RENAME;
 
@@ -1064,6 +1129,9 @@ int tnfs_chmod(tnfsMountInfo *m_info, const char *filepath, uint16_t mode)
     if (m_info == nullptr || filepath == nullptr)
         return -1;
 
+    tnfsLock lock(m_info);
+    if (!lock.owns_lock())
+        return TNFS_RESULT_TRY_AGAIN;
     tnfsPacket packet;
     packet.command = TNFS_CMD_CHMOD;
 
@@ -1091,6 +1159,9 @@ int tnfs_size(tnfsMountInfo *m_info, uint32_t *size)
     if (m_info == nullptr || size == nullptr)
         return -1;
 
+    tnfsLock lock(m_info);
+    if (!lock.owns_lock())
+        return TNFS_RESULT_TRY_AGAIN;
     tnfsPacket packet;
     packet.command = TNFS_CMD_SIZE;
 
@@ -1115,6 +1186,9 @@ int tnfs_free(tnfsMountInfo *m_info, uint32_t *size)
     if (m_info == nullptr || size == nullptr)
         return -1;
 
+    tnfsLock lock(m_info);
+    if (!lock.owns_lock())
+        return TNFS_RESULT_TRY_AGAIN;
     tnfsPacket packet;
     packet.command = TNFS_CMD_FREE;
 
@@ -1159,6 +1233,9 @@ int tnfs_chdir(tnfsMountInfo *m_info, const char *dirpath)
     if (m_info == nullptr || dirpath == nullptr)
         return -1;
 
+    tnfsLock lock(m_info);
+    if (!lock.owns_lock())
+        return TNFS_RESULT_TRY_AGAIN;
     // Check for ".."
     if (dirpath[0] == '.' && dirpath[1] == '.' && dirpath[2] == '\0')
     {
@@ -1,8 +1,25 @@
 
 #include "tnfslibMountInfo.h"
 
+#include <chrono>
+
 #include "compat_string.h"
 
+// Limit of lock wait set by the calling thread, see tnfsLock
+static thread_local int _lock_wait_ms = -1;
+
+void tnfs_set_lock_wait(int wait_ms)
+{
+    _lock_wait_ms = wait_ms;
+}
+
+tnfsLock::tnfsLock(tnfsMountInfo *m_info) : _lock(m_info->lock, std::defer_lock)
+{
+    if (_lock_wait_ms < 0)
+        _lock.lock();
+    else
+        _lock.try_lock_for(std::chrono::milliseconds(_lock_wait_ms));
+}
 
 tnfsMountInfo::tnfsMountInfo(const char *host_name, uint16_t host_port)
 {
@@ -25,24 +42,15 @@ tnfsMountInfo::~tnfsMountInfo()
         if (_file_handles[i] != nullptr)
             delete _file_handles[i];
     }
-    // Delete any remaining directory cache entries
-    empty_dircache();
 }
 
 // Empty the current contents of the directory cache
 void tnfsMountInfo::empty_dircache()
 {
-    for (int i = 0; i < TNFS_MAX_DIRCACHE_ENTRIES; i++)
-    {
-        if (_dir_cache[i] != nullptr)
-        {
-            delete _dir_cache[i];
-            _dir_cache[i] = nullptr;
-        }
-    }
-    _dir_cache_current = 0;
-    _dir_cache_count = 0;
-    _dir_cache_eof = false;
+    tnfsDirInfo &dir = _dirs.get();
+    dir.cache.clear();
+    dir.cache_current = 0;
+    dir.cache_eof = false;
 }
 
 /*
@@ -51,12 +59,12 @@ void tnfsMountInfo::empty_dircache()
 */
 tnfsDirCacheEntry * tnfsMountInfo::new_dircache_entry()
 {
-    if(_dir_cache_count >= TNFS_MAX_DIRCACHE_ENTRIES)
+    tnfsDirInfo &dir = _dirs.get();
+    if(dir.cache.size() >= TNFS_MAX_DIRCACHE_ENTRIES)
         return nullptr;
 
-    _dir_cache[_dir_cache_count] = new tnfsDirCacheEntry();
-    _dir_cache_count ++;
-    return _dir_cache[_dir_cache_count - 1];
+    dir.cache.emplace_back();
+    return &dir.cache.back();
 }
 
 /*
@@ -65,11 +73,12 @@ tnfsDirCacheEntry * tnfsMountInfo::new_dircache_entry()
 */
 tnfsDirCacheEntry * tnfsMountInfo::next_dircache_entry()
 {
-    if(_dir_cache_current >= _dir_cache_count)
+    tnfsDirInfo *dir = _dirs.find();
+    if(dir == nullptr || dir->cache_current >= dir->cache.size())
         return nullptr;
 
-    _dir_cache_current++;
-    return _dir_cache[_dir_cache_current - 1];
+    dir->cache_current++;
+    return &dir->cache[dir->cache_current - 1];
 }
 
 /*
@@ -79,9 +88,27 @@ tnfsDirCacheEntry * tnfsMountInfo::next_dircache_entry()
 */
 int tnfsMountInfo::tell_dircache_entry()
 {
-    if(_dir_cache_current >= _dir_cache_count)
+    tnfsDirInfo *dir = _dirs.find();
+    if(dir == nullptr || dir->cache_current >= dir->cache.size())
         return -1;
-    return _dir_cache[_dir_cache_current]->dirpos;
+    return dir->cache[dir->cache_current].dirpos;
+}
+
+/*
+ Returns the open directory handle of the calling thread
+ or TNFS_INVALID_HANDLE if it has none
+*/
+int16_t tnfsMountInfo::get_dir_handle()
+{
+    tnfsDirInfo *dir = _dirs.find();
+    return dir != nullptr ? dir->handle : TNFS_INVALID_HANDLE;
+}
+
+void tnfsMountInfo::set_dir_handle(int16_t handle, uint16_t entries)
+{
+    tnfsDirInfo &dir = _dirs.get();
+    dir.handle = handle;
+    dir.entries = entries;
 }
 
 /*
@@ -3,8 +3,11 @@
 
 // #include <lwip/netdb.h>
 #include <cstdint>
+#include <mutex>
+#include <vector>
 
 #include "fnDNS.h"
+#include "threadState.h"
 
 
 #define TNFS_DEFAULT_PORT 16384
@@ -14,6 +17,7 @@
 #define TNFS_MAX_BACKOFF_DELAY 3000 // Longest we'll wait if server sends us a EAGAIN error
 #define TNFS_MAX_FILE_HANDLES 8 // Max number of file handles we'll open to the server
 #define TNFS_MAX_FILELEN 256
+#define TNFS_BUS_LOCK_WAIT TNFS_TIMEOUT // Longest the bus waits for a mount used by other thread, see tnfsLock
 
 #define TNFS_FILE_CACHE_SIZE 512 // 4 * 128 fits in a single packet when TNFS_MAX_READWRITE_PAYLOAD is 512
 
@@ -50,15 +54,27 @@ struct tnfsDirCacheEntry
     char entryname[TNFS_MAX_FILELEN];
 };
 
-// Everything we need to know about and keep track of for the server we're talking to
+// Directory opened by one thread and its entries cached from responses to TNFS_READDIRX
+struct tnfsDirInfo
+{
+    int16_t handle = TNFS_INVALID_HANDLE; // Stored from server's response to TNFS_OPENDIRX
+    uint16_t entries = 0; // Stored from server's response to TNFS_OPENDIRX
+    std::vector<tnfsDirCacheEntry> cache;
+    uint16_t cache_current = 0;
+    bool cache_eof = false;
+};
+
+/*
+ Everything we need to know about and keep track of for the server we're talking to.
+ Requests to the server share the session and sequence numbers, tnfslib functions hold
+ the lock of the mount for a whole request. Open directories are kept per thread,
+ so threads listing directories on the same mount do not move each other's position.
+*/
 class tnfsMountInfo
 {
 private:
     tnfsFileHandleInfo * _file_handles[TNFS_MAX_FILE_HANDLES] = { nullptr }; // Stored from server's responses to TNFS_OPEN
-    tnfsDirCacheEntry * _dir_cache[TNFS_MAX_DIRCACHE_ENTRIES] = { nullptr };
-    uint16_t _dir_cache_current = 0;
-    uint16_t _dir_cache_count = 0;
-    bool _dir_cache_eof = false;
+    ThreadState<tnfsDirInfo> _dirs;
 
 public:
     ~tnfsMountInfo();
@@ -77,9 +93,17 @@ public:
 
     int tell_dircache_entry();
     void empty_dircache();
-    uint16_t count_dircache() { return _dir_cache_count; };
-    void set_dircache_eof() { _dir_cache_eof = true; };
-    bool get_dircache_eof() { return _dir_cache_eof; };
+    uint16_t count_dircache() { tnfsDirInfo *dir = _dirs.find(); return dir != nullptr ? dir->cache.size() : 0; };
+    void set_dircache_eof() { _dirs.get().cache_eof = true; };
+    bool get_dircache_eof() { tnfsDirInfo *dir = _dirs.find(); return dir != nullptr && dir->cache_eof; };
+
+    // Directory handle of calling thread
+    int16_t get_dir_handle();
+    uint16_t get_dir_entries() { tnfsDirInfo *dir = _dirs.find(); return dir != nullptr ? dir->entries : 0; };
+    void set_dir_handle(int16_t handle, uint16_t entries);
+    void release_dir() { _dirs.release(); };
+
+    std::recursive_timed_mutex lock; // Held during requests, they may call each other (session recovery)
 
     // These char[] sizes are abitrary...
     char hostname[64] = { '\0' };
@@ -95,9 +119,26 @@ public:
     uint8_t max_retries = TNFS_RETRIES;
     int timeout_ms = TNFS_TIMEOUT;
     uint8_t current_sequence_num = 0; // Updated with each transaction to the server
+};
 
-    int16_t dir_handle = TNFS_INVALID_HANDLE; // Stored from server's response to TNFS_OPENDIR
-    uint16_t dir_entries = 0; // Stored from server's response to TNFS_OPENDIRX
+/*
+ Lock of the mount held by a request. The request keeps it through all its retries, when the
+ server does not answer other threads using the mount wait up to max_retries * (timeout_ms +
+ retry delay). Threads which can't wait that long set a limit with tnfs_set_lock_wait(), like
+ the bus (the computer gives up on the command and all devices on the bus would stall), their
+ request fails with TNFS_RESULT_TRY_AGAIN if the mount stays busy.
+*/
+class tnfsLock
+{
+private:
+    std::unique_lock<std::recursive_timed_mutex> _lock;
+
+public:
+    tnfsLock(tnfsMountInfo *m_info);
+    bool owns_lock() { return _lock.owns_lock(); };
 };
 
+// Longest wait of calling thread for mount used by other thread, in milliseconds, -1 waits as long as needed
+void tnfs_set_lock_wait(int wait_ms);
+
 #endif // _TNFSLIB_MOUNTINFO_H
@@ -330,6 +330,7 @@ void systemBus::_sio_process_queue()
  * If CMD line not asserted but MODEM is active, give it a chance to read incoming data
  * Throw out stray input on SIO if neither of the above two are true
  * Give NETWORK devices an opportunity to signal available data
+ * Give devices an opportunity to do deferred work (e.g. write out cached disk sectors)
  */
 void systemBus::service()
 {
@@ -356,11 +357,6 @@ void systemBus::service()
 //             return; // break!
 //         }
 //     }
-//     else if (_cpmDev != nullptr && _cpmDev->cpmActive)
-//     {
-//         _cpmDev->sio_handle_cpm();
-//         return; // break!
-//     }
 
 //     // check if cassette is mounted first
 //     if (_fujiDev->cassette()->is_mounted())
@@ -411,8 +407,13 @@ void systemBus::service()
     {
         idle = (_modemDev->sio_handle_modem() <= 0);
     }
+    // Pass console data of CP/M running on its own thread
+    else if (_cpmDev != nullptr && _cpmDev->cpmActive)
+    {
+        idle = (_cpmDev->sio_handle_cpm() <= 0);
+    }
     else
-    // Neither CMD nor active modem, so throw out any stray input data
+    // Neither CMD nor active modem or CP/M, so throw out any stray input data
     {
         // flush UART input
         if (fnSioCom.get_sio_mode() == SioCom::sio_mode::SERIAL)
@@ -426,6 +427,13 @@ void systemBus::service()
             _netDev[i]->sio_poll_interrupt();
     }
 
+    // Let devices do deferred work between commands
+    if (!fnSioCom.command_asserted())
+    {
+        for (auto devicep : _daisyChain)
+            devicep->sio_idle();
+    }
+
     // poll with 1 ms interval
     //   true  = SIO port needs handling
     //   false = no SIO "event" ocurred within interval
@@ -435,6 +443,40 @@ void systemBus::service()
     //     fnSystem.delay_microseconds(500);
 }
 
+/*
+ Replay SIO capture recorded with fnSioCom.start_recording()
+ * Computer side of the capture is played by ReplaySioPort, command frames are processed as usual
+ * Responses of devices are compared with recorded responses, processing time is measured per command
+ * Devices should be set up (disks mounted etc.) as they were during recording
+ * Returns number of failures, -1 if capture cannot be loaded
+ */
+int systemBus::replay(const char *capture_path)
+{
+    ReplaySioPort *port = fnSioCom.get_replay_port();
+    if (!port->load(capture_path))
+        return -1;
+
+    SioCom::sio_mode mode = fnSioCom.get_sio_mode();
+    fnSioCom.reset_sio_port(SioCom::sio_mode::REPLAY);
+
+    while (!port->finished())
+    {
+        if (fnSioCom.command_asserted())
+        {
+            uint64_t start_us = fnSystem.micros();
+            _sio_process_cmd();
+            port->end_command(fnSystem.micros() - start_us);
+        }
+        else
+            port->skip_idle_input();
+    }
+
+    int failures = port->report(stdout);
+
+    fnSioCom.reset_sio_port(mode);
+    return failures;
+}
+
 // Setup SIO bus
 void systemBus::setup()
 {
@@ -481,10 +523,10 @@ void systemBus::addDevice(virtualDevice *pDevice, int device_id)
     // {
     //     _cassetteDev = (sioCassette *)pDevice;
     // }
-    // else if (device_id == SIO_DEVICEID_CPM)
-    // {
-    //     _cpmDev = (sioCPM *)pDevice;
-    // }
+    else if (device_id == SIO_DEVICEID_CPM)
+    {
+        _cpmDev = (sioCPM *)pDevice;
+    }
     else if (device_id == SIO_DEVICEID_PRINTER)
     {
         _printerdev = (sioPrinter *)pDevice;
@@ -730,5 +772,5 @@ void systemBus::setUltraHigh(bool _enable, int _ultraHighBaud)
     }
 }
 
-systemBus SIO; // Global SIO object
+thread_local systemBus SIO; // Global SIO object, one per instance thread
 #endif /* BUILD_ATARI */
@@ -109,7 +109,7 @@ class systemBus;      // declare early so can be friend
 class sioNetwork;  // declare here so can reference it, but define in network.h
 // class sioUDPStream; // declare here so can reference it, but define in udpstream.h
 // class sioCassette; // Cassette forward-declaration.
-// class sioCPM;      // CPM device.
+class sioCPM;      // CPM device.
 class sioPrinter;  // Printer device
 
 class virtualDevice
@@ -191,6 +191,9 @@ protected:
     // Optional shutdown/reboot cleanup routine
     virtual void shutdown(){};
 
+    // Optional deferred work, called from the service loop while no command is pending
+    virtual void sio_idle(){};
+
 public:
     /**
      * @brief get the SIO device Number (1-255)
@@ -252,7 +255,7 @@ private:
     sioNetwork *_netDev[8] = {nullptr};
     // sioMIDIMaze *_midiDev = nullptr;
     // sioCassette *_cassetteDev = nullptr;
-    // sioCPM *_cpmDev = nullptr;
+    sioCPM *_cpmDev = nullptr;
     sioPrinter *_printerdev = nullptr;
 
     int _sioBaud = SIO_STANDARD_BAUDRATE;
@@ -271,6 +274,7 @@ public:
     void setup();
     void service();
     void shutdown();
+    int replay(const char *capture_path);                       // Replay recorded SIO capture, returns number of failures
 
     int numDevices();
     void addDevice(virtualDevice *pDevice, int device_id);
@@ -296,11 +300,11 @@ public:
 
     // sioCassette *getCassette() { return _cassetteDev; }
     sioPrinter *getPrinter() { return _printerdev; }
-    // sioCPM *getCPM() { return _cpmDev; }
+    sioCPM *getCPM() { return _cpmDev; }
 
     // QueueHandle_t qSioMessages = nullptr;
 };
 
-extern systemBus SIO;
+extern thread_local systemBus SIO;
 
 #endif // guard
@@ -6,9 +6,11 @@
  * It uses SioPort for data exchange and to control SIO lines
  * SioPort can be physical serial port (SerialSioPort) to communicate with real Atari computer
  * or network SIO (NetSio = SIO over UDP) for use with Altirra Atari Emulator
+ * or replay of recorded SIO traffic (ReplaySioPort)
+ * All traffic can be recorded into capture file (SioRecorder)
  */
 
-SioCom fnSioCom;
+thread_local SioCom fnSioCom;
 
 SioCom::SioCom() : _sio_mode(sio_mode::SERIAL), _sioPort(&_serialSio) {}
 
@@ -18,6 +20,7 @@ void SioCom::begin(int baud)
         _sioPort->begin(baud);
     else
         _sioPort->begin(get_baudrate());
+    _recorder.record_baudrate(get_baudrate());
 }
 
 void SioCom::end() 
@@ -38,6 +41,7 @@ bool SioCom::poll(int ms)
 void SioCom::set_baudrate(uint32_t baud) 
 { 
     _sioPort->set_baudrate(baud); 
+    _recorder.record_baudrate(baud);
 }
 
 uint32_t SioCom::get_baudrate()
@@ -47,22 +51,28 @@ uint32_t SioCom::get_baudrate()
 
 bool SioCom::command_asserted() 
 {
-    return _sioPort->command_asserted();
+    bool level = _sioPort->command_asserted();
+    _recorder.record_command(level);
+    return level;
 }
 
 bool SioCom::motor_asserted() 
 {
-    return _sioPort->motor_asserted();
+    bool level = _sioPort->motor_asserted();
+    _recorder.record_motor(level);
+    return level;
 }
 
 void SioCom::set_proceed(bool level)
 {
     _sioPort->set_proceed(level);
+    _recorder.record_proceed(level);
 }
 
 void SioCom::set_interrupt(bool level)
 {
     _sioPort->set_interrupt(level);
+    _recorder.record_interrupt(level);
 }
 
 int SioCom::available() 
@@ -83,31 +93,39 @@ void SioCom::flush_input()
 // read single byte
 int SioCom::read()
 {
-    return _sioPort->read();
+    int result = _sioPort->read();
+    _recorder.record_rx_byte(result);
+    return result;
 }
 
 // read bytes into buffer
 size_t SioCom::read(uint8_t *buffer, size_t length, bool command_mode)
 {
-    return _sioPort->read(buffer, length, command_mode);
+    size_t result = _sioPort->read(buffer, length, command_mode);
+    _recorder.record_rx(buffer, length, result, command_mode);
+    return result;
 }
 
 // alias to read
 size_t SioCom::readBytes(uint8_t *buffer, size_t length, bool command_mode)
 {
-    return  _sioPort->read(buffer, length, command_mode);
+    return read(buffer, length, command_mode);
 }
 
 // write single byte
 ssize_t SioCom::write(uint8_t b)
 {
-    return _sioPort->write(b);
+    ssize_t result = _sioPort->write(b);
+    _recorder.record_tx(&b, 1);
+    return result;
 }
 
 // write buffer
 ssize_t SioCom::write(const uint8_t *buffer, size_t size) 
 {
-    return _sioPort->write(buffer, size);
+    ssize_t result = _sioPort->write(buffer, size);
+    _recorder.record_tx(buffer, size);
+    return result;
 }
 
 // write C-string
@@ -210,11 +228,13 @@ const char* SioCom::get_netsio_host(int &port)
 void SioCom::netsio_late_sync(uint8_t c)
 {
     _netSio.set_sync_ack_byte(c);
+    _recorder.record_tx(&c, 1); // ACK byte is sent to computer later, with sync response
 }
 
 void SioCom::netsio_empty_sync()
 {
     _netSio.send_empty_sync();
+    _recorder.record_empty_sync();
 }
 
 void SioCom::netsio_write_size(int write_size)
@@ -230,6 +250,9 @@ void SioCom::set_sio_mode(sio_mode mode)
     case sio_mode::NETSIO:
         _sioPort = &_netSio;
         break;
+    case sio_mode::REPLAY:
+        _sioPort = &_replaySio;
+        break;
     default:
         _sioPort = &_serialSio;
     }
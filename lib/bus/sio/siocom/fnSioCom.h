@@ -6,6 +6,8 @@
 #include "sioport.h"
 #include "serialsio.h"
 #include "netsio.h"
+#include "sioreplay.h"
+#include "siocapture.h"
 
 /*
  * SIO Communication class
@@ -13,6 +15,8 @@
  * It uses SioPort for data exchange and to control SIO lines
  * SioPort can be physical serial port (SerialSioPort) to communicate with real Atari computer
  * or network SIO (NetSio = SIO over UDP) for use with Altirra Atari Emulator
+ * or replay of recorded SIO traffic (ReplaySioPort)
+ * All traffic can be recorded into capture file (SioRecorder)
  */
 
 class SioCom
@@ -22,7 +26,8 @@ public:
     enum sio_mode
     {
         SERIAL = 0,
-        NETSIO
+        NETSIO,
+        REPLAY
     };
 
 private:
@@ -30,6 +35,8 @@ private:
     SioPort *_sioPort;
     SerialSioPort _serialSio;
     NetSioPort _netSio;
+    ReplaySioPort _replaySio;
+    SioRecorder _recorder;
 
     size_t _print_number(unsigned long n, uint8_t base);
 
@@ -84,6 +91,13 @@ public:
     void netsio_empty_sync();
     void netsio_write_size(int write_size);
 
+    // SIO traffic capture
+    bool start_recording(const char *path) { return _recorder.start(path); }
+    void stop_recording() { _recorder.stop(); }
+
+    // specific to ReplaySioPort
+    ReplaySioPort *get_replay_port() { return &_replaySio; }
+
     // get/set SIO mode
     sio_mode get_sio_mode() {return _sio_mode;}
     void set_sio_mode(sio_mode mode);
@@ -91,6 +105,6 @@ public:
     void reset_sio_port(sio_mode mode);
 };
 
-extern SioCom fnSioCom;
+extern thread_local SioCom fnSioCom;
 
 #endif // SIOCOM_H
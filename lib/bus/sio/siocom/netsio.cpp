@@ -610,7 +610,7 @@ bool NetSioPort::motor_asserted(void)
 
 void NetSioPort::set_proceed(bool level)
 {
-    static int last_level = -1; // 0,1 or -1 for unknown
+    static thread_local int last_level = -1; // 0,1 or -1 for unknown
     int new_level = level ? 0 : 1;
 
     if (!_initialized)
@@ -627,7 +627,7 @@ void NetSioPort::set_proceed(bool level)
 
 void NetSioPort::set_interrupt(bool level)
 {
-    static int last_level = -1; // 0,1 or -1 for unknown
+    static thread_local int last_level = -1; // 0,1 or -1 for unknown
     int new_level = level ? 0 : 1;
 
     if (!_initialized)
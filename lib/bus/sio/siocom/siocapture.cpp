@@ -0,0 +1,181 @@
+#include "siocapture.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "../../include/debug.h"
+
+SioRecorder::~SioRecorder()
+{
+    stop();
+}
+
+bool SioRecorder::start(const char *path)
+{
+    stop();
+
+    _file = fopen(path, "wb");
+    if (_file == nullptr)
+    {
+        Debug_printf("SIO capture: failed to create \"%s\": %d - %s\n", path, errno, strerror(errno));
+        return false;
+    }
+
+    // records are small, keep them in large buffer instead of hitting the disk for every one
+    _write_buffer = (char *)malloc(SIOCAP_WRITE_BUFFER_SIZE);
+    if (_write_buffer != nullptr)
+        setvbuf(_file, _write_buffer, _IOFBF, SIOCAP_WRITE_BUFFER_SIZE);
+
+    uint8_t header[SIOCAP_HEADER_SIZE];
+    memcpy(header, SIOCAP_MAGIC, SIOCAP_HEADER_SIZE - 1);
+    header[SIOCAP_HEADER_SIZE - 1] = SIOCAP_VERSION;
+    fwrite(header, 1, sizeof(header), _file);
+
+    _start = std::chrono::steady_clock::now();
+    _command_level = _motor_level = _proceed_level = _interrupt_level = -1;
+
+    Debug_printf("SIO capture: recording to \"%s\"\n", path);
+    return true;
+}
+
+void SioRecorder::stop()
+{
+    if (_file == nullptr)
+        return;
+
+    fclose(_file);
+    _file = nullptr;
+    free(_write_buffer);
+    _write_buffer = nullptr;
+    Debug_println("SIO capture: recording stopped");
+}
+
+void SioRecorder::write_record(uint8_t type, const uint8_t *data, uint16_t len)
+{
+    uint64_t ts = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - _start).count();
+
+    uint8_t header[SIOCAP_RECORD_HEADER_SIZE];
+    header[0] = type;
+    for (int i = 0; i < 8; i++)
+        header[1 + i] = (uint8_t)(ts >> (8 * i));
+    header[9] = len & 0xFF;
+    header[10] = len >> 8;
+
+    fwrite(header, 1, sizeof(header), _file);
+    if (len > 0)
+        fwrite(data, 1, len, _file);
+}
+
+void SioRecorder::write_level(uint8_t type, int &last_level, bool level)
+{
+    if (_file == nullptr || last_level == (int)level)
+        return;
+
+    last_level = level;
+    uint8_t b = level;
+    write_record(type, &b, 1);
+}
+
+void SioRecorder::record_rx(const uint8_t *buffer, size_t length, size_t result, bool command_mode)
+{
+    if (_file == nullptr)
+        return;
+
+    size_t n = result < length ? result : length;
+
+    if (command_mode)
+    {
+        // keep the read() result too, it is length + 1 if COMMAND was deasserted during read
+        uint8_t frame[1 + 16];
+        if (n > sizeof(frame) - 1)
+            n = sizeof(frame) - 1;
+        frame[0] = (uint8_t)result;
+        memcpy(frame + 1, buffer, n);
+        write_record(SIOCAP_CMD_FRAME, frame, (uint16_t)(n + 1));
+    }
+    else
+        write_record(SIOCAP_RX, buffer, (uint16_t)n);
+}
+
+void SioRecorder::record_rx_byte(int b)
+{
+    if (_file == nullptr)
+        return;
+
+    if (b < 0)
+        write_record(SIOCAP_RX_TIMEOUT, nullptr, 0);
+    else
+    {
+        uint8_t c = b;
+        write_record(SIOCAP_RX, &c, 1);
+    }
+}
+
+void SioRecorder::record_tx(const uint8_t *buffer, size_t size)
+{
+    if (_file == nullptr || size == 0)
+        return;
+
+    write_record(SIOCAP_TX, buffer, (uint16_t)size);
+}
+
+void SioRecorder::record_empty_sync()
+{
+    if (_file == nullptr)
+        return;
+
+    write_record(SIOCAP_EMPTY_SYNC, nullptr, 0);
+}
+
+void SioRecorder::record_baudrate(uint32_t baud)
+{
+    if (_file == nullptr)
+        return;
+
+    uint8_t b[4];
+    for (int i = 0; i < 4; i++)
+        b[i] = (uint8_t)(baud >> (8 * i));
+    write_record(SIOCAP_BAUD, b, sizeof(b));
+}
+
+bool SioRecorder::load(const char *path, std::vector<sio_capture_record> &records)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == nullptr)
+    {
+        Debug_printf("SIO capture: failed to open \"%s\": %d - %s\n", path, errno, strerror(errno));
+        return false;
+    }
+
+    uint8_t header[SIOCAP_RECORD_HEADER_SIZE];
+    if (fread(header, 1, SIOCAP_HEADER_SIZE, f) != SIOCAP_HEADER_SIZE ||
+        memcmp(header, SIOCAP_MAGIC, SIOCAP_HEADER_SIZE - 1) != 0 ||
+        header[SIOCAP_HEADER_SIZE - 1] != SIOCAP_VERSION)
+    {
+        Debug_printf("SIO capture: \"%s\" is not a capture file\n", path);
+        fclose(f);
+        return false;
+    }
+
+    records.clear();
+    while (fread(header, 1, sizeof(header), f) == sizeof(header))
+    {
+        sio_capture_record rec;
+        rec.type = header[0];
+        rec.timestamp = 0;
+        for (int i = 0; i < 8; i++)
+            rec.timestamp |= (uint64_t)header[1 + i] << (8 * i);
+        uint16_t len = header[9] | (header[10] << 8);
+
+        rec.data.resize(len);
+        if (len > 0 && fread(rec.data.data(), 1, len, f) != len)
+            break; // truncated record
+        records.push_back(std::move(rec));
+    }
+
+    fclose(f);
+    Debug_printf("SIO capture: loaded %u records from \"%s\"\n", (unsigned)records.size(), path);
+    return true;
+}
@@ -0,0 +1,92 @@
+#ifndef SIOCAPTURE_H
+#define SIOCAPTURE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <chrono>
+#include <vector>
+
+/*
+ * SIO traffic capture
+ * SioRecorder writes everything passing through SioCom into capture file,
+ * ReplaySioPort (sioreplay.h) plays it back to check device responses and timing.
+ *
+ * File starts with 8 byte header: "FNSIOCP" followed by format version byte.
+ * Header is followed by records, all multi-byte values are little-endian:
+ *   uint8_t  record type (SIOCAP_*)
+ *   uint64_t timestamp, microseconds from monotonic clock since recording start
+ *   uint16_t payload length
+ *   uint8_t  payload[length]
+ */
+
+#define SIOCAP_MAGIC "FNSIOCP"
+#define SIOCAP_VERSION 1
+#define SIOCAP_HEADER_SIZE 8
+#define SIOCAP_RECORD_HEADER_SIZE 11
+
+#define SIOCAP_WRITE_BUFFER_SIZE 65536
+
+// Computer -> device
+#define SIOCAP_RX           0x01 // data read from computer, payload = bytes returned by read
+#define SIOCAP_CMD_FRAME    0x02 // command frame read, payload = read() result byte followed by frame bytes
+#define SIOCAP_RX_TIMEOUT   0x03 // single byte read() failed, no payload
+// Device -> computer
+#define SIOCAP_TX           0x04 // data written to computer
+#define SIOCAP_EMPTY_SYNC   0x05 // NetSIO: command was not handled by any device
+// Line state, payload[0] = level
+#define SIOCAP_COMMAND      0x10 // observed change of COMMAND line
+#define SIOCAP_MOTOR        0x20 // observed change of MOTOR line
+#define SIOCAP_PROCEED      0x30 // PROCEED line set by device
+#define SIOCAP_INTERRUPT    0x40 // INTERRUPT line set by device
+// Port settings
+#define SIOCAP_BAUD         0x80 // payload = uint32_t baud rate
+
+struct sio_capture_record
+{
+    uint8_t type;
+    uint64_t timestamp;
+    std::vector<uint8_t> data;
+};
+
+/*
+ * Capture file writer
+ */
+class SioRecorder
+{
+private:
+    FILE *_file = nullptr;
+    char *_write_buffer = nullptr;
+    std::chrono::steady_clock::time_point _start;
+
+    int _command_level = -1; // 0,1 or -1 for unknown
+    int _motor_level = -1;
+    int _proceed_level = -1;
+    int _interrupt_level = -1;
+
+    void write_record(uint8_t type, const uint8_t *data, uint16_t len);
+    void write_level(uint8_t type, int &last_level, bool level);
+
+public:
+    ~SioRecorder();
+
+    bool start(const char *path);
+    void stop();
+    bool active() { return _file != nullptr; }
+
+    void record_rx(const uint8_t *buffer, size_t length, size_t result, bool command_mode);
+    void record_rx_byte(int b);
+    void record_tx(const uint8_t *buffer, size_t size);
+    void record_empty_sync();
+    void record_command(bool level) { write_level(SIOCAP_COMMAND, _command_level, level); }
+    void record_motor(bool level) { write_level(SIOCAP_MOTOR, _motor_level, level); }
+    void record_proceed(bool level) { write_level(SIOCAP_PROCEED, _proceed_level, level); }
+    void record_interrupt(bool level) { write_level(SIOCAP_INTERRUPT, _interrupt_level, level); }
+    void record_baudrate(uint32_t baud);
+
+    // read all records from capture file, returns false if file is not valid capture
+    static bool load(const char *path, std::vector<sio_capture_record> &records);
+};
+
+#endif // SIOCAPTURE_H
@@ -0,0 +1,329 @@
+#ifdef BUILD_ATARI
+
+#include "sioreplay.h"
+
+#include <string.h>
+#include <algorithm>
+#include <map>
+
+#include "../../include/debug.h"
+
+ReplaySioPort::ReplaySioPort() :
+    _input(0),
+    _rx_offset(0),
+    _command_asserted(false),
+    _motor_asserted(false),
+    _baud(SIOPORT_DEFAULT_BAUD),
+    _stalls(0),
+    _diverged(0),
+    _current(-1),
+    _current_open(false)
+{}
+
+bool ReplaySioPort::load(const char *path)
+{
+    if (!SioRecorder::load(path, _records))
+        return false;
+
+    _input = 0;
+    _rx_offset = 0;
+    _command_asserted = false;
+    _motor_asserted = false;
+    _stalls = 0;
+    _diverged = 0;
+    _current = -1;
+    _current_open = false;
+
+    // collect recorded responses for every command frame
+    _results.clear();
+    uint64_t frame_ts = 0;
+    for (auto &rec : _records)
+    {
+        if (rec.type == SIOCAP_CMD_FRAME)
+        {
+            command_result res;
+            memset(res.frame, 0, sizeof(res.frame));
+            if (rec.data.size() > 1)
+                memcpy(res.frame, rec.data.data() + 1, std::min(sizeof(res.frame), rec.data.size() - 1));
+            res.recorded_us = 0;
+            res.replay_us = 0;
+            _results.push_back(res);
+            frame_ts = rec.timestamp;
+        }
+        else if (rec.type == SIOCAP_TX && !_results.empty())
+        {
+            command_result &res = _results.back();
+            res.expected.insert(res.expected.end(), rec.data.begin(), rec.data.end());
+            res.recorded_us = rec.timestamp - frame_ts;
+        }
+    }
+    return true;
+}
+
+// next record with data or signal from computer, nullptr at the end of capture
+const sio_capture_record *ReplaySioPort::next_input()
+{
+    while (_input < _records.size())
+    {
+        const sio_capture_record &rec = _records[_input];
+        switch (rec.type)
+        {
+        case SIOCAP_RX:
+            if (rec.data.size() > _rx_offset)
+                return &rec;
+            break;
+        case SIOCAP_CMD_FRAME:
+        case SIOCAP_RX_TIMEOUT:
+        case SIOCAP_COMMAND:
+        case SIOCAP_MOTOR:
+            return &rec;
+        default:
+            break;
+        }
+        _input++;
+        _rx_offset = 0;
+    }
+    return nullptr;
+}
+
+void ReplaySioPort::consume_input()
+{
+    _input++;
+    _rx_offset = 0;
+    _stalls = 0;
+}
+
+// called when bus waits for something else than capture provides
+// returns true if the capture record was skipped
+bool ReplaySioPort::stalled()
+{
+    if (++_stalls < REPLAY_STALL_LIMIT)
+        return false;
+
+    Debug_printf("SIO replay: bus does not follow capture, skipping record %u\n", (unsigned)_input);
+    _diverged++;
+    consume_input();
+    return true;
+}
+
+void ReplaySioPort::apply_line_events()
+{
+    const sio_capture_record *rec;
+    while ((rec = next_input()) != nullptr)
+    {
+        if (rec->type == SIOCAP_MOTOR)
+        {
+            _motor_asserted = rec->data.size() > 0 && rec->data[0];
+            consume_input();
+        }
+        else if (rec->type == SIOCAP_COMMAND)
+        {
+            // one COMMAND change per poll, as it was observed during recording
+            _command_asserted = rec->data.size() > 0 && rec->data[0];
+            consume_input();
+            break;
+        }
+        else
+            break;
+    }
+}
+
+bool ReplaySioPort::finished()
+{
+    return next_input() == nullptr;
+}
+
+void ReplaySioPort::skip_idle_input()
+{
+    const sio_capture_record *rec = next_input();
+    if (rec != nullptr && rec->type != SIOCAP_COMMAND && rec->type != SIOCAP_MOTOR)
+    {
+        Debug_printf("SIO replay: skipping idle input record %u\n", (unsigned)_input);
+        consume_input();
+    }
+}
+
+void ReplaySioPort::end_command(uint64_t elapsed_us)
+{
+    if (!_current_open)
+        return;
+    _results[_current].replay_us = elapsed_us;
+    _current_open = false;
+}
+
+void ReplaySioPort::begin(int baud)
+{
+    _baud = baud;
+}
+
+void ReplaySioPort::end()
+{
+}
+
+bool ReplaySioPort::poll(int ms)
+{
+    // no waiting for replay, bus is driven by systemBus::replay()
+    return false;
+}
+
+void ReplaySioPort::set_baudrate(uint32_t baud)
+{
+    _baud = baud;
+}
+
+uint32_t ReplaySioPort::get_baudrate()
+{
+    return _baud;
+}
+
+bool ReplaySioPort::command_asserted()
+{
+    size_t before = _input;
+    apply_line_events();
+
+    if (finished())
+        _command_asserted = false;
+    else if (_command_asserted && _input == before)
+        stalled();
+
+    return _command_asserted;
+}
+
+bool ReplaySioPort::motor_asserted()
+{
+    apply_line_events();
+    return _motor_asserted;
+}
+
+int ReplaySioPort::available()
+{
+    const sio_capture_record *rec = next_input();
+    if (rec == nullptr || rec->type == SIOCAP_RX_TIMEOUT)
+        return 1; // let the read() fail
+    if (rec->type == SIOCAP_RX)
+        return rec->data.size() - _rx_offset;
+    stalled();
+    return 0;
+}
+
+int ReplaySioPort::read()
+{
+    const sio_capture_record *rec = next_input();
+    if (rec == nullptr)
+        return -1;
+
+    if (rec->type == SIOCAP_RX)
+    {
+        int b = rec->data[_rx_offset++];
+        if (_rx_offset >= rec->data.size())
+            consume_input();
+        return b;
+    }
+
+    if (rec->type == SIOCAP_RX_TIMEOUT)
+        consume_input();
+    return -1;
+}
+
+size_t ReplaySioPort::read(uint8_t *buffer, size_t length, bool command_mode)
+{
+    const sio_capture_record *rec = next_input();
+    if (rec == nullptr)
+        return 0;
+
+    if (command_mode)
+    {
+        if (rec->type != SIOCAP_CMD_FRAME || rec->data.empty())
+            return 0;
+
+        size_t result = rec->data[0];
+        memcpy(buffer, rec->data.data() + 1, std::min(length, rec->data.size() - 1));
+        consume_input();
+
+        // responses are collected from now on for this command
+        _current++;
+        _current_open = true;
+        return result;
+    }
+
+    // one read() call per recorded read, short reads are replayed as short reads
+    if (rec->type != SIOCAP_RX)
+        return 0;
+
+    size_t n = std::min(length, rec->data.size() - _rx_offset);
+    memcpy(buffer, rec->data.data() + _rx_offset, n);
+    _rx_offset += n;
+    if (_rx_offset >= rec->data.size())
+        consume_input();
+    return n;
+}
+
+ssize_t ReplaySioPort::write(uint8_t b)
+{
+    return write(&b, 1);
+}
+
+ssize_t ReplaySioPort::write(const uint8_t *buffer, size_t size)
+{
+    if (_current >= 0 && _current < (int)_results.size())
+        _results[_current].actual.insert(_results[_current].actual.end(), buffer, buffer + size);
+    return size;
+}
+
+static uint64_t _percentile(std::vector<uint64_t> &sorted, int p)
+{
+    if (sorted.empty())
+        return 0;
+    return sorted[(sorted.size() - 1) * p / 100];
+}
+
+int ReplaySioPort::report(FILE *out)
+{
+    int failed = 0;
+    int replayed = _current + 1;
+
+    // device:command -> latencies
+    std::map<uint16_t, std::vector<uint64_t>> recorded;
+    std::map<uint16_t, std::vector<uint64_t>> replayed_us;
+
+    for (int i = 0; i < replayed && i < (int)_results.size(); i++)
+    {
+        command_result &res = _results[i];
+        uint16_t key = (res.frame[0] << 8) | res.frame[1];
+
+        if (res.actual != res.expected)
+        {
+            size_t pos = 0;
+            while (pos < res.actual.size() && pos < res.expected.size() && res.actual[pos] == res.expected[pos])
+                pos++;
+            fprintf(out, "MISMATCH #%d %02X %02X %02X %02X: response differs at byte %u (expected %u bytes, got %u)\n",
+                    i, res.frame[0], res.frame[1], res.frame[2], res.frame[3],
+                    (unsigned)pos, (unsigned)res.expected.size(), (unsigned)res.actual.size());
+            failed++;
+        }
+
+        recorded[key].push_back(res.recorded_us);
+        replayed_us[key].push_back(res.replay_us);
+    }
+
+    fprintf(out, "\nDEV CMD  COUNT  RECORDED p50/p99 [us]  REPLAY min/p50/p99/max [us]\n");
+    for (auto &it : replayed_us)
+    {
+        std::vector<uint64_t> &rep = it.second;
+        std::vector<uint64_t> &rec = recorded[it.first];
+        std::sort(rep.begin(), rep.end());
+        std::sort(rec.begin(), rec.end());
+        fprintf(out, " %02X  %02X %6u  %10llu/%-10llu  %8llu/%llu/%llu/%llu\n",
+                it.first >> 8, it.first & 0xFF, (unsigned)rep.size(),
+                (unsigned long long)_percentile(rec, 50), (unsigned long long)_percentile(rec, 99),
+                (unsigned long long)rep.front(), (unsigned long long)_percentile(rep, 50),
+                (unsigned long long)_percentile(rep, 99), (unsigned long long)rep.back());
+    }
+
+    fprintf(out, "\nSIO replay: %d of %u commands replayed, %d mismatched, %d capture divergences\n",
+            replayed, (unsigned)_results.size(), failed, _diverged);
+
+    return failed + _diverged + ((int)_results.size() - replayed);
+}
+
+#endif /* BUILD_ATARI */
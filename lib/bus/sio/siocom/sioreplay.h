@@ -0,0 +1,90 @@
+#ifndef SIOREPLAY_H
+#define SIOREPLAY_H
+
+#include <stdio.h>
+#include <vector>
+
+#include "sioport.h"
+#include "siocapture.h"
+
+// Number of polls without any progress in capture before the replay gives up waiting
+// for expected input and skips the capture record
+#define REPLAY_STALL_LIMIT 100
+
+/*
+ * Implementation of SIO Port which plays computer side of recorded SIO capture
+ * Command frames, data frames and COMMAND/MOTOR line changes are fed from the capture,
+ * data written by devices are collected per command and compared with recorded responses
+ */
+
+class ReplaySioPort : public SioPort
+{
+public:
+    struct command_result
+    {
+        uint8_t frame[5];
+        std::vector<uint8_t> expected;  // recorded response
+        std::vector<uint8_t> actual;    // response during replay
+        uint64_t recorded_us;           // command frame to last response byte, as recorded
+        uint64_t replay_us;             // command processing time during replay
+    };
+
+private:
+    std::vector<sio_capture_record> _records;
+    size_t _input;          // next record to check for computer side input
+    size_t _rx_offset;      // bytes already read from current SIOCAP_RX record
+    bool _command_asserted;
+    bool _motor_asserted;
+    uint32_t _baud;
+    int _stalls;
+    int _diverged;
+
+    std::vector<command_result> _results;
+    int _current;           // index of command being processed
+    bool _current_open;     // command frame was read, end_command() was not called yet
+
+    const sio_capture_record *next_input();
+    void consume_input();
+    bool stalled();
+    void apply_line_events();
+
+public:
+    ReplaySioPort();
+
+    bool load(const char *path);
+    bool finished();
+    // skip capture input which was not consumed by bus during idle time (e.g. stray data)
+    void skip_idle_input();
+    // command processing finished, store processing time
+    void end_command(uint64_t elapsed_us);
+    // print mismatches and latency statistics, returns number of failed commands
+    int report(FILE *out);
+
+    virtual void begin(int baud) override;
+    virtual void end() override;
+    virtual bool poll(int ms) override;
+
+    virtual void set_baudrate(uint32_t baud) override;
+    virtual uint32_t get_baudrate() override;
+
+    virtual bool command_asserted() override;
+    virtual bool motor_asserted() override;
+    virtual void set_proceed(bool level) override {};
+    virtual void set_interrupt(bool level) override {};
+
+    virtual int available() override;
+    virtual void flush() override {};
+    virtual void flush_input() override {};
+
+    // read single byte
+    virtual int read() override;
+    // read bytes into buffer
+    virtual size_t read(uint8_t *buffer, size_t length, bool command_mode=false) override;
+
+    // write single byte
+    virtual ssize_t write(uint8_t b) override;
+    // write buffer
+    virtual ssize_t write(const uint8_t *buffer, size_t size) override;
+};
+
+#endif // SIOREPLAY_H
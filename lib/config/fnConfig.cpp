@@ -1,6 +1,7 @@
 #include "fnConfig.h"
 
-#include <sstream>
+#include <algorithm>
+#include <climits>
 #include <string>
 #include <sys/stat.h>
 #include "compat_string.h"
@@ -13,13 +14,182 @@
 #include "fnSystem.h"
 #include "utils.h"
 
-#define CONFIG_FILEBUFFSIZE 2048
-
 #define CONFIG_DEFAULT_SNTPSERVER "pool.ntp.org"
 
 #define PHONEBOOK_CHAR_WIDTH 12 
 
-fnConfig Config;
+// Each instance (-n option) runs on its own thread with its own configuration
+thread_local fnConfig Config;
+
+const char * const fnConfig::_host_type_names[HOSTTYPE_INVALID] = {
+    "SD",
+    "TNFS"
+};
+const char * const fnConfig::_mount_mode_names[MOUNTMODE_INVALID] = {
+    "r",
+    "w"
+};
+
+const char * const fnConfig::_serial_command_pin_names[SERIAL_COMMAND_INVALID] = {
+    "none",
+    "DSR",
+    "CTS",
+    "RI"
+};
+
+const char * const fnConfig::_serial_proceed_pin_names[SERIAL_PROCEED_INVALID] = {
+    "none",
+    "DTR",
+    "RTS"
+};
+
+const char * const fnConfig::_sniffer_format_names[SNIFFER_FORMAT_INVALID] = {
+    "text",
+    "binary"
+};
+
+// Storage of key value, S is type of the section structure
+#define VALUE(S, section, field) \
+    &fnConfig::_value_of<fnConfig::S, &fnConfig::section, decltype(fnConfig::S::field), &fnConfig::S::field>
+#define SLOT_VALUE(S, slots, field) \
+    &fnConfig::_slot_value_of<fnConfig::S, sizeof(fnConfig::slots) / sizeof(fnConfig::slots[0]), &fnConfig::slots, \
+                              decltype(fnConfig::S::field), &fnConfig::S::field>
+
+#define CFG_BOOL(section, name, value) { fnConfig::section, name, fnConfig::KEY_BOOL, value, 0, 1, 0, nullptr, 0 }
+#define CFG_BOOL_NAMED(section, name, value, names) { fnConfig::section, name, fnConfig::KEY_BOOL, value, 0, 1, 0, names, 0 }
+#define CFG_INT(section, name, value, min, max, fallback) { fnConfig::section, name, fnConfig::KEY_INT, value, min, max, fallback, nullptr, 0 }
+#define CFG_SLOT(section, name, value, slots, fallback, flags) { fnConfig::section, name, fnConfig::KEY_SLOT, value, 0, (slots) - 1, fallback, nullptr, flags }
+#define CFG_STRING(section, name, value, flags) { fnConfig::section, name, fnConfig::KEY_STRING, value, 0, 0, 0, nullptr, flags }
+#define CFG_CHARS(section, name, value, size) { fnConfig::section, name, fnConfig::KEY_CHARS, value, 0, size, 0, nullptr, 0 }
+#define CFG_ENUM(section, name, value, names, count, fallback, flags) { fnConfig::section, name, fnConfig::KEY_ENUM, value, 0, (count) - 1, fallback, names, flags }
+
+/*
+ Schema of the configuration file. Sections are written in this order, keys of a section
+ in the order they are declared.
+*/
+struct fnConfigSchema
+{
+    static constexpr const char *cassette_button_names[2] = {"0 Play", "1 Record"};
+    static constexpr const char *cassette_pulldown_names[2] = {"0 B Button Press", "1 Pulldown Resistor"};
+
+    static constexpr fnConfig::config_section sections[] = {
+        { fnConfig::SECTION_GENERAL, "General", 0 },
+        { fnConfig::SECTION_SERIAL, "Serial", 0 },
+        { fnConfig::SECTION_WIFI, "WiFi", 0 },
+        { fnConfig::SECTION_BT, "Bluetooth", 0 },
+        { fnConfig::SECTION_NETWORK, "Network", 0 },
+        { fnConfig::SECTION_HOST, "Host", MAX_HOST_SLOTS },
+        { fnConfig::SECTION_MOUNT, "Mount", MAX_MOUNT_SLOTS },
+#ifdef PRINTER_CLASS
+        { fnConfig::SECTION_PRINTER, "Printer", MAX_PRINTER_SLOTS },
+#endif
+        { fnConfig::SECTION_TAPE, "Tape", MAX_TAPE_SLOTS },
+        { fnConfig::SECTION_MODEM, "Modem", 0 },
+        { fnConfig::SECTION_PHONEBOOK, "Phonebook", MAX_PB_SLOTS },
+        { fnConfig::SECTION_CASSETTE, "Cassette", 0 },
+        { fnConfig::SECTION_CPM, "CPM", 0 },
+        { fnConfig::SECTION_DEVICE_ENABLE, "ENABLE", 0 },
+        { fnConfig::SECTION_NETSIO, "NetSIO", 0 },
+    };
+
+    static constexpr fnConfig::config_key keys[] = {
+        CFG_STRING(SECTION_GENERAL, "devicename", VALUE(general_info, _general, devicename), 0),
+        CFG_INT(SECTION_GENERAL, "hsioindex", VALUE(general_info, _general, hsio_index), HSIO_DISABLED_INDEX, 16, SIO_HISPEED_INDEX),
+        CFG_BOOL(SECTION_GENERAL, "rotationsounds", VALUE(general_info, _general, rotation_sounds)),
+        CFG_BOOL(SECTION_GENERAL, "configenabled", VALUE(general_info, _general, config_enabled)),
+        CFG_INT(SECTION_GENERAL, "boot_mode", VALUE(general_info, _general, boot_mode), INT_MIN, INT_MAX, 0),
+        CFG_STRING(SECTION_GENERAL, "timezone", VALUE(general_info, _general, timezone), fnConfig::KEY_FLAG_OMIT_EMPTY),
+        CFG_BOOL(SECTION_GENERAL, "fnconfig_on_spifs", VALUE(general_info, _general, fnconfig_spifs)),
+        CFG_BOOL(SECTION_GENERAL, "status_wait_enabled", VALUE(general_info, _general, status_wait_enabled)),
+        CFG_INT(SECTION_GENERAL, "cache_size", VALUE(general_info, _general, cache_size_mb), INT_MIN, INT_MAX, 0),
+        CFG_BOOL(SECTION_GENERAL, "disk_write_back", VALUE(general_info, _general, disk_write_back)),
+        CFG_BOOL(SECTION_GENERAL, "disk_overlay", VALUE(general_info, _general, disk_overlay)),
+        CFG_STRING(SECTION_GENERAL, "voice_output", VALUE(general_info, _general, voice_output), fnConfig::KEY_FLAG_OMIT_EMPTY),
+        CFG_BOOL(SECTION_GENERAL, "printer_enabled", VALUE(general_info, _general, printer_enabled)),
+
+        CFG_STRING(SECTION_SERIAL, "port", VALUE(serial_info, _serial, port), 0),
+        CFG_ENUM(SECTION_SERIAL, "command", VALUE(serial_info, _serial, command),
+                 fnConfig::_serial_command_pin_names, fnConfig::SERIAL_COMMAND_INVALID, fnConfig::SERIAL_COMMAND_DSR, 0),
+        CFG_ENUM(SECTION_SERIAL, "proceed", VALUE(serial_info, _serial, proceed),
+                 fnConfig::_serial_proceed_pin_names, fnConfig::SERIAL_PROCEED_INVALID, fnConfig::SERIAL_PROCEED_DTR, 0),
+
+        CFG_BOOL(SECTION_WIFI, "enabled", VALUE(wifi_info, _wifi, enabled)),
+        CFG_STRING(SECTION_WIFI, "SSID", VALUE(wifi_info, _wifi, ssid), 0),
+        // TODO: Encrypt passphrase!
+        CFG_STRING(SECTION_WIFI, "passphrase", VALUE(wifi_info, _wifi, passphrase), 0),
+
+        CFG_STRING(SECTION_BT, "devicename", VALUE(bt_info, _bt, bt_devname), 0),
+        CFG_BOOL(SECTION_BT, "enabled", VALUE(bt_info, _bt, bt_status)),
+        CFG_INT(SECTION_BT, "baud", VALUE(bt_info, _bt, bt_baud), INT_MIN, INT_MAX, 0),
+
+        CFG_CHARS(SECTION_NETWORK, "sntpserver", VALUE(network_info, _network, sntpserver), sizeof(fnConfig::network_info::sntpserver)),
+
+        CFG_ENUM(SECTION_HOST, "type", SLOT_VALUE(host_info, _host_slots, type),
+                 fnConfig::_host_type_names, fnConfig::HOSTTYPE_INVALID, fnConfig::HOSTTYPE_INVALID, fnConfig::KEY_FLAG_REQUIRED),
+        CFG_STRING(SECTION_HOST, "name", SLOT_VALUE(host_info, _host_slots, name), 0),
+
+        CFG_SLOT(SECTION_MOUNT, "hostslot", SLOT_VALUE(mount_info, _mount_slots, host_slot), MAX_HOST_SLOTS, HOST_SLOT_INVALID, fnConfig::KEY_FLAG_REQUIRED),
+        CFG_STRING(SECTION_MOUNT, "path", SLOT_VALUE(mount_info, _mount_slots, path), 0),
+        CFG_ENUM(SECTION_MOUNT, "mode", SLOT_VALUE(mount_info, _mount_slots, mode),
+                 fnConfig::_mount_mode_names, fnConfig::MOUNTMODE_INVALID, fnConfig::MOUNTMODE_INVALID, 0),
+
+#ifdef PRINTER_CLASS
+        { fnConfig::SECTION_PRINTER, "type", fnConfig::KEY_INT, SLOT_VALUE(printer_info, _printer_slots, type),
+          0, PRINTER_CLASS::printer_type::PRINTER_INVALID - 1, PRINTER_CLASS::printer_type::PRINTER_INVALID, nullptr, fnConfig::KEY_FLAG_REQUIRED },
+        CFG_SLOT(SECTION_PRINTER, "port", SLOT_VALUE(printer_info, _printer_slots, port), 4, 0, 0),
+#endif
+
+        CFG_SLOT(SECTION_TAPE, "hostslot", SLOT_VALUE(mount_info, _tape_slots, host_slot), MAX_HOST_SLOTS, HOST_SLOT_INVALID, fnConfig::KEY_FLAG_REQUIRED),
+        CFG_STRING(SECTION_TAPE, "path", SLOT_VALUE(mount_info, _tape_slots, path), 0),
+        CFG_ENUM(SECTION_TAPE, "mode", SLOT_VALUE(mount_info, _tape_slots, mode),
+                 fnConfig::_mount_mode_names, fnConfig::MOUNTMODE_INVALID, fnConfig::MOUNTMODE_INVALID, 0),
+
+        CFG_BOOL(SECTION_MODEM, "modem_enabled", VALUE(modem_info, _modem, modem_enabled)),
+        CFG_BOOL(SECTION_MODEM, "sniffer_enabled", VALUE(modem_info, _modem, sniffer_enabled)),
+        CFG_ENUM(SECTION_MODEM, "sniffer_format", VALUE(modem_info, _modem, sniffer_format),
+                 fnConfig::_sniffer_format_names, fnConfig::SNIFFER_FORMAT_INVALID, fnConfig::SNIFFER_FORMAT_TEXT, 0),
+
+        CFG_STRING(SECTION_PHONEBOOK, "number", SLOT_VALUE(phbook_info, _phonebook_slots, phnumber), fnConfig::KEY_FLAG_REQUIRED),
+        CFG_STRING(SECTION_PHONEBOOK, "host", SLOT_VALUE(phbook_info, _phonebook_slots, hostname), 0),
+        CFG_STRING(SECTION_PHONEBOOK, "port", SLOT_VALUE(phbook_info, _phonebook_slots, port), 0),
+
+        CFG_BOOL_NAMED(SECTION_CASSETTE, "play_record", VALUE(cassette_info, _cassette, button), cassette_button_names),
+        CFG_BOOL_NAMED(SECTION_CASSETTE, "pulldown", VALUE(cassette_info, _cassette, pulldown), cassette_pulldown_names),
+        CFG_BOOL(SECTION_CASSETTE, "cassette_enabled", VALUE(cassette_info, _cassette, cassette_enabled)),
+
+        CFG_STRING(SECTION_CPM, "ccp", VALUE(cpm_info, _cpm, ccp), 0),
+
+        CFG_BOOL(SECTION_DEVICE_ENABLE, "enable_device_slot_1", VALUE(device_enable_info, _denable, device_1_enabled)),
+        CFG_BOOL(SECTION_DEVICE_ENABLE, "enable_device_slot_2", VALUE(device_enable_info, _denable, device_2_enabled)),
+        CFG_BOOL(SECTION_DEVICE_ENABLE, "enable_device_slot_3", VALUE(device_enable_info, _denable, device_3_enabled)),
+        CFG_BOOL(SECTION_DEVICE_ENABLE, "enable_device_slot_4", VALUE(device_enable_info, _denable, device_4_enabled)),
+        CFG_BOOL(SECTION_DEVICE_ENABLE, "enable_device_slot_5", VALUE(device_enable_info, _denable, device_5_enabled)),
+        CFG_BOOL(SECTION_DEVICE_ENABLE, "enable_device_slot_6", VALUE(device_enable_info, _denable, device_6_enabled)),
+        CFG_BOOL(SECTION_DEVICE_ENABLE, "enable_device_slot_7", VALUE(device_enable_info, _denable, device_7_enabled)),
+        CFG_BOOL(SECTION_DEVICE_ENABLE, "enable_device_slot_8", VALUE(device_enable_info, _denable, device_8_enabled)),
+
+        CFG_BOOL(SECTION_NETSIO, "enabled", VALUE(netsio_info, _netsio, netsio_enabled)),
+        CFG_STRING(SECTION_NETSIO, "host", VALUE(netsio_info, _netsio, host), 0),
+        CFG_INT(SECTION_NETSIO, "port", VALUE(netsio_info, _netsio, port), 1, 65535, CONFIG_DEFAULT_NETSIO_PORT),
+    };
+};
+
+#undef VALUE
+#undef SLOT_VALUE
+#undef CFG_BOOL
+#undef CFG_BOOL_NAMED
+#undef CFG_INT
+#undef CFG_SLOT
+#undef CFG_STRING
+#undef CFG_CHARS
+#undef CFG_ENUM
+
+constexpr const char *fnConfigSchema::cassette_button_names[2];
+constexpr const char *fnConfigSchema::cassette_pulldown_names[2];
+constexpr fnConfig::config_section fnConfigSchema::sections[];
+constexpr fnConfig::config_key fnConfigSchema::keys[];
+
+static_assert(MAX_PB_SLOTS <= 32 && MAX_HOST_SLOTS <= 32 && MAX_MOUNT_SLOTS <= 32, "slots of a section are kept in 32 bit mask");
 
 // Initialize some defaults
 fnConfig::fnConfig()
@@ -27,6 +197,18 @@ fnConfig::fnConfig()
     strlcpy(_network.sntpserver, CONFIG_DEFAULT_SNTPSERVER, sizeof(_network.sntpserver));
 }
 
+fnConfig::~fnConfig()
+{
+    // write pending changes before exit
+    {
+        std::lock_guard<std::mutex> lock(_save_mutex);
+        _save_exit = true;
+    }
+    _save_cv.notify_all();
+    if (_save_thread.joinable())
+        _save_thread.join();
+}
+
 void fnConfig::store_udpstream_host(const char host_ip[64])
 {
     strlcpy(_network.udpstream_host, host_ip, sizeof(_network.udpstream_host));
@@ -43,7 +225,7 @@ void fnConfig::store_general_devicename(const char *devicename)
         return;
 
     _general.devicename = devicename;
-    _dirty = true;
+    _mark_dirty(SECTION_GENERAL);
 }
 
 void fnConfig::store_general_timezone(const char *timezone)
@@ -52,7 +234,7 @@ void fnConfig::store_general_timezone(const char *timezone)
         return;
 
     _general.timezone = timezone;
-    _dirty = true;
+    _mark_dirty(SECTION_GENERAL);
 }
 
 void fnConfig::store_general_rotation_sounds(bool rotation_sounds)
@@ -61,7 +243,7 @@ void fnConfig::store_general_rotation_sounds(bool rotation_sounds)
         return;
 
     _general.rotation_sounds = rotation_sounds;
-    _dirty = true;
+    _mark_dirty(SECTION_GENERAL);
 }
 
 void fnConfig::store_general_config_enabled(bool config_enabled)
@@ -70,7 +252,7 @@ void fnConfig::store_general_config_enabled(bool config_enabled)
         return;
 
     _general.config_enabled = config_enabled;
-    _dirty = true;
+    _mark_dirty(SECTION_GENERAL);
 }
 void fnConfig::store_general_status_wait_enabled(bool status_wait_enabled)
 {
@@ -78,7 +260,39 @@ void fnConfig::store_general_status_wait_enabled(bool status_wait_enabled)
         return;
 
     _general.status_wait_enabled = status_wait_enabled;
-    _dirty = true;
+    _mark_dirty(SECTION_GENERAL);
+}
+void fnConfig::store_general_cache_size(int cache_size_mb)
+{
+    if (_general.cache_size_mb == cache_size_mb)
+        return;
+
+    _general.cache_size_mb = cache_size_mb;
+    _mark_dirty(SECTION_GENERAL);
+}
+void fnConfig::store_general_disk_write_back(bool disk_write_back)
+{
+    if (_general.disk_write_back == disk_write_back)
+        return;
+
+    _general.disk_write_back = disk_write_back;
+    _mark_dirty(SECTION_GENERAL);
+}
+void fnConfig::store_general_disk_overlay(bool disk_overlay)
+{
+    if (_general.disk_overlay == disk_overlay)
+        return;
+
+    _general.disk_overlay = disk_overlay;
+    _mark_dirty(SECTION_GENERAL);
+}
+void fnConfig::store_general_voice_output(const char *voice_output)
+{
+    if (_general.voice_output.compare(voice_output) == 0)
+        return;
+
+    _general.voice_output = voice_output;
+    _mark_dirty(SECTION_GENERAL);
 }
 void fnConfig::store_general_boot_mode(uint8_t boot_mode)
 {
@@ -86,7 +300,7 @@ void fnConfig::store_general_boot_mode(uint8_t boot_mode)
         return;
     
     _general.boot_mode = boot_mode;
-    _dirty = true;
+    _mark_dirty(SECTION_GENERAL);
 }
 
 void fnConfig::store_general_hsioindex(int hsio_index)
@@ -95,7 +309,7 @@ void fnConfig::store_general_hsioindex(int hsio_index)
         return;
 
     _general.hsio_index = hsio_index;
-    _dirty = true;
+    _mark_dirty(SECTION_GENERAL);
 }
 
 void fnConfig::store_serial_port(const char *port)
@@ -104,7 +318,7 @@ void fnConfig::store_serial_port(const char *port)
         return;
 
     _serial.port = port;
-    _dirty = true;
+    _mark_dirty(SECTION_SERIAL);
 }
 
 void fnConfig::store_serial_command(serial_command_pin command_pin)
@@ -113,7 +327,7 @@ void fnConfig::store_serial_command(serial_command_pin command_pin)
         return;
 
     _serial.command = command_pin;
-    _dirty = true;
+    _mark_dirty(SECTION_SERIAL);
 }
 
 void fnConfig::store_serial_proceed(serial_proceed_pin proceed_pin)
@@ -122,7 +336,7 @@ void fnConfig::store_serial_proceed(serial_proceed_pin proceed_pin)
         return;
 
     _serial.proceed = proceed_pin;
-    _dirty = true;
+    _mark_dirty(SECTION_SERIAL);
 }
 
 void fnConfig::store_general_fnconfig_spifs(bool fnconfig_spifs)
@@ -131,7 +345,7 @@ void fnConfig::store_general_fnconfig_spifs(bool fnconfig_spifs)
         return;
 
     _general.fnconfig_spifs = fnconfig_spifs;
-    _dirty = true;
+    _mark_dirty(SECTION_GENERAL);
 }
 
 /* Replaces stored SSID with up to num_octets bytes, but stops if '\0' is reached
@@ -143,7 +357,7 @@ void fnConfig::store_wifi_ssid(const char *ssid_octets, int num_octets)
 
     Debug_println("new SSID provided");
 
-    _dirty = true;
+    _mark_dirty(SECTION_WIFI);
     _wifi.ssid.clear();
     for (int i = 0; i < num_octets; i++)
     {
@@ -160,7 +374,7 @@ void fnConfig::store_wifi_passphrase(const char *passphrase_octets, int num_octe
 {
     if (_wifi.passphrase.compare(0, num_octets, passphrase_octets) == 0)
         return;
-    _dirty = true;
+    _mark_dirty(SECTION_WIFI);
     _wifi.passphrase.clear();
     for (int i = 0; i < num_octets; i++)
     {
@@ -175,25 +389,25 @@ void fnConfig::store_wifi_passphrase(const char *passphrase_octets, int num_octe
 void fnConfig::store_wifi_enabled(bool status)
 {
     _wifi.enabled = status;
-    _dirty = true;
+    _mark_dirty(SECTION_WIFI);
 }
 
 void fnConfig::store_bt_status(bool status)
 {
     _bt.bt_status = status;
-    _dirty = true;
+    _mark_dirty(SECTION_BT);
 }
 
 void fnConfig::store_bt_baud(int baud)
 {
     _bt.bt_baud = baud;
-    _dirty = true;
+    _mark_dirty(SECTION_BT);
 }
 
 void fnConfig::store_bt_devname(std::string devname)
 {
     _bt.bt_devname = devname;
-    _dirty = true;
+    _mark_dirty(SECTION_BT);
 }
 
 std::string fnConfig::get_general_label()
@@ -226,7 +440,7 @@ void fnConfig::store_host(uint8_t num, const char *hostname, host_type_t type)
     {
         if (_host_slots[num].type == type && _host_slots[num].name.compare(hostname) == 0)
             return;
-        _dirty = true;
+        _mark_dirty(SECTION_HOST, num);
         _host_slots[num].type = type;
         _host_slots[num].name = hostname;
     }
@@ -238,7 +452,7 @@ void fnConfig::clear_host(uint8_t num)
     {
         if (_host_slots[num].type == HOSTTYPE_INVALID && _host_slots[num].name.length() == 0)
             return;
-        _dirty = true;
+        _mark_dirty(SECTION_HOST, num);
         _host_slots[num].type = HOSTTYPE_INVALID;
         _host_slots[num].name.clear();
     }
@@ -251,7 +465,6 @@ void fnConfig::store_general_interface_url(const char *url)
 
     _general.interface_url = url;
     // this option is not stored in config file
-    // _dirty = true;
 }
 
 void fnConfig::store_general_config_path(const char *file_path)
@@ -261,7 +474,6 @@ void fnConfig::store_general_config_path(const char *file_path)
 
     _general.config_file_path = file_path;
     // this option is not stored in config file
-    // _dirty = true;
 }
 
 void fnConfig::store_general_SD_path(const char *dir_path)
@@ -271,7 +483,15 @@ void fnConfig::store_general_SD_path(const char *dir_path)
 
     _general.SD_dir_path = dir_path;
     // this option is not stored in config file
-    // _dirty = true;
+}
+
+void fnConfig::store_general_cache_path(const char *dir_path)
+{
+    if (_general.cache_dir_path.compare(dir_path) == 0)
+        return;
+
+    _general.cache_dir_path = dir_path;
+    // this option is not stored in config file
 }
 
 void fnConfig::store_netsio_enabled(bool enabled) {
@@ -279,7 +499,7 @@ void fnConfig::store_netsio_enabled(bool enabled) {
         return;
 
     _netsio.netsio_enabled = enabled;
-    _dirty = true;
+    _mark_dirty(SECTION_NETSIO);
 }
 
 void fnConfig::store_netsio_host(const char *host) {
@@ -287,7 +507,7 @@ void fnConfig::store_netsio_host(const char *host) {
         return;
 
     _netsio.host = host;
-    _dirty = true;
+    _mark_dirty(SECTION_NETSIO);
 }
 
 void fnConfig::store_netsio_port(int port) {
@@ -295,7 +515,7 @@ void fnConfig::store_netsio_port(int port) {
         return;
 
     _netsio.port = port;
-    _dirty = true;
+    _mark_dirty(SECTION_NETSIO);
 }
 
 std::string fnConfig::get_mount_path(uint8_t num, mount_type_t mounttype)
@@ -344,7 +564,7 @@ void fnConfig::store_mount(uint8_t num, int hostslot, const char *path, mount_mo
     {
         if (_mount_slots[num].host_slot == hostslot && _mount_slots[num].mode == mode && _mount_slots[num].path.compare(path) == 0)
             return;
-        _dirty = true;
+        _mark_dirty(SECTION_MOUNT, num);
         _mount_slots[num].host_slot = hostslot;
         _mount_slots[num].mode = mode;
         _mount_slots[num].path = path;
@@ -357,7 +577,7 @@ void fnConfig::store_mount(uint8_t num, int hostslot, const char *path, mount_mo
     {
         if (_tape_slots[num].host_slot == hostslot && _tape_slots[num].mode == mode && _tape_slots[num].path.compare(path) == 0)
             return;
-        _dirty = true;
+        _mark_dirty(SECTION_TAPE, num);
         _tape_slots[num].host_slot = hostslot;
         _tape_slots[num].mode = mode;
         _tape_slots[num].path = path;
@@ -373,7 +593,7 @@ void fnConfig::clear_mount(uint8_t num, mount_type_t mounttype)
     {
         if (_mount_slots[num].host_slot == HOST_SLOT_INVALID && _mount_slots[num].mode == MOUNTMODE_INVALID && _mount_slots[num].path.length() == 0)
             return;
-        _dirty = true;
+        _mark_dirty(SECTION_MOUNT, num);
         _mount_slots[num].path.clear();
         _mount_slots[num].host_slot = HOST_SLOT_INVALID;
         _mount_slots[num].mode = MOUNTMODE_INVALID;
@@ -385,7 +605,7 @@ void fnConfig::clear_mount(uint8_t num, mount_type_t mounttype)
     {
         if (_tape_slots[num].host_slot == HOST_SLOT_INVALID && _tape_slots[num].mode == MOUNTMODE_INVALID && _tape_slots[num].path.length() == 0)
             return;
-        _dirty = true;
+        _mark_dirty(SECTION_TAPE, num);
         _tape_slots[num].path.clear();
         _tape_slots[num].host_slot = HOST_SLOT_INVALID;
         _tape_slots[num].mode = MOUNTMODE_INVALID;
@@ -436,7 +656,7 @@ bool fnConfig::add_pb_number(const char *pbnum, const char *pbhost, const char *
         _phonebook_slots[i].phnumber = pbnum;
         _phonebook_slots[i].hostname = pbhost;
         _phonebook_slots[i].port = pbport;
-        _dirty = true;
+        _mark_dirty(SECTION_PHONEBOOK, i);
         save();
         return true;
     }
@@ -455,7 +675,7 @@ bool fnConfig::del_pb_number(const char *pbnum)
         _phonebook_slots[i].phnumber.clear();
         _phonebook_slots[i].hostname.clear();
         _phonebook_slots[i].port.clear();
-        _dirty = true;
+        _mark_dirty(SECTION_PHONEBOOK, i);
         save();
         return true;
     }
@@ -469,9 +689,9 @@ void fnConfig::clear_pb(void)
         _phonebook_slots[i].phnumber.clear();
         _phonebook_slots[i].hostname.clear();
         _phonebook_slots[i].port.clear();
+        _mark_dirty(SECTION_PHONEBOOK, i);
     }
     save();
-    _dirty = true;
 }
 std::string fnConfig::get_pb_entry(uint8_t n)
 {
@@ -509,7 +729,7 @@ void fnConfig::store_printer_enabled(bool printer_enabled)
         return;
 
     _general.printer_enabled = printer_enabled;
-    _dirty = true;
+    _mark_dirty(SECTION_GENERAL);
 }
 
 // Saves printer type stored in configuration for printer slot
@@ -520,7 +740,7 @@ void fnConfig::store_printer_type(uint8_t num, PRINTER_CLASS::printer_type ptype
     {
         if (_printer_slots[num].type != ptype)
         {
-            _dirty = true;
+            _mark_dirty(SECTION_PRINTER, num);
             _printer_slots[num].type = ptype;
         }
     }
@@ -534,7 +754,7 @@ void fnConfig::store_printer_port(uint8_t num, int port)
     {
         if (_printer_slots[num].port != port)
         {
-            _dirty = true;
+            _mark_dirty(SECTION_PRINTER, num);
             _printer_slots[num].port = port;
         }
     }
@@ -547,7 +767,7 @@ void fnConfig::store_modem_enabled(bool modem_enabled)
         return;
 
     _modem.modem_enabled = modem_enabled;
-    _dirty = true;
+    _mark_dirty(SECTION_MODEM);
 }
 
 // Saves ENABLE or DISABLE Modem Sniffer
@@ -568,8 +788,25 @@ void fnConfig::store_modem_sniffer_enabled(bool modem_sniffer_enabled)
         return;
 
     _modem.sniffer_enabled = modem_sniffer_enabled;
-    _dirty = true;
+    _mark_dirty(SECTION_MODEM);
+#endif /* BUILD_ATARI */
+}
+
+// Saves Modem Sniffer output format
+void fnConfig::store_modem_sniffer_format(sniffer_format_t format)
+{
+    if (format >= SNIFFER_FORMAT_INVALID)
+        return;
+
+#ifdef BUILD_ATARI
+    sioR->get_modem_sniffer()->setFormat((ModemSniffer::sniffer_format)format);
 #endif /* BUILD_ATARI */
+
+    if (_modem.sniffer_format == format)
+        return;
+
+    _modem.sniffer_format = format;
+    _mark_dirty(SECTION_MODEM);
 }
 
 bool fnConfig::get_cassette_buttons()
@@ -592,7 +829,7 @@ void fnConfig::store_cassette_buttons(bool button)
     if (_cassette.button != button)
     {
         _cassette.button = button;
-        _dirty = true;
+        _mark_dirty(SECTION_CASSETTE);
     }
 }
 
@@ -601,7 +838,7 @@ void fnConfig::store_cassette_pulldown(bool pulldown)
     if (_cassette.pulldown != pulldown)
     {
         _cassette.pulldown = pulldown;
-        _dirty = true;
+        _mark_dirty(SECTION_CASSETTE);
     }
 }
 
@@ -610,7 +847,7 @@ void fnConfig::store_cassette_enabled(bool cassette_enabled)
     if (_cassette.cassette_enabled != cassette_enabled)
     {
         _cassette.cassette_enabled = cassette_enabled;
-        _dirty = true;
+        _mark_dirty(SECTION_CASSETTE);
     }
 }
 
@@ -621,7 +858,7 @@ void fnConfig::store_ccp_filename(std::string filename)
         return;
 
     _cpm.ccp = filename;
-    _dirty = true;
+    _mark_dirty(SECTION_CPM);
 }
 
 void fnConfig::store_device_slot_enable_1(bool enable)
@@ -629,7 +866,7 @@ void fnConfig::store_device_slot_enable_1(bool enable)
     if (_denable.device_1_enabled != enable)
     {
         _denable.device_1_enabled = enable;
-        _dirty = true;
+        _mark_dirty(SECTION_DEVICE_ENABLE);
     }
 }
 
@@ -638,7 +875,7 @@ void fnConfig::store_device_slot_enable_2(bool enable)
     if (_denable.device_2_enabled != enable)
     {
         _denable.device_2_enabled = enable;
-        _dirty = true;
+        _mark_dirty(SECTION_DEVICE_ENABLE);
     }
 }
 
@@ -647,7 +884,7 @@ void fnConfig::store_device_slot_enable_3(bool enable)
     if (_denable.device_3_enabled != enable)
     {
         _denable.device_3_enabled = enable;
-        _dirty = true;
+        _mark_dirty(SECTION_DEVICE_ENABLE);
     }
 }
 
@@ -656,7 +893,7 @@ void fnConfig::store_device_slot_enable_4(bool enable)
     if (_denable.device_4_enabled != enable)
     {
         _denable.device_4_enabled = enable;
-        _dirty = true;
+        _mark_dirty(SECTION_DEVICE_ENABLE);
     }
 }
 
@@ -665,7 +902,7 @@ void fnConfig::store_device_slot_enable_5(bool enable)
     if (_denable.device_5_enabled != enable)
     {
         _denable.device_5_enabled = enable;
-        _dirty = true;
+        _mark_dirty(SECTION_DEVICE_ENABLE);
     }
 }
 
@@ -674,7 +911,7 @@ void fnConfig::store_device_slot_enable_6(bool enable)
     if (_denable.device_6_enabled != enable)
     {
         _denable.device_6_enabled = enable;
-        _dirty = true;
+        _mark_dirty(SECTION_DEVICE_ENABLE);
     }
 }
 
@@ -683,7 +920,7 @@ void fnConfig::store_device_slot_enable_7(bool enable)
     if (_denable.device_7_enabled != enable)
     {
         _denable.device_7_enabled = enable;
-        _dirty = true;
+        _mark_dirty(SECTION_DEVICE_ENABLE);
     }
 }
 
@@ -692,7 +929,7 @@ void fnConfig::store_device_slot_enable_8(bool enable)
     if (_denable.device_8_enabled != enable)
     {
         _denable.device_8_enabled = enable;
-        _dirty = true;
+        _mark_dirty(SECTION_DEVICE_ENABLE);
     }
 }
 
@@ -736,169 +973,161 @@ bool fnConfig::get_device_slot_enable_8()
     return _denable.device_8_enabled;
 }
 
-/* Save configuration data to SPIFFS. If SD is mounted, save a backup copy there.
+bool fnConfig::_is_dirty()
+{
+    for (int i = 0; i < SECTION_UNKNOWN; i++)
+        if (_dirty_slots[i] != 0)
+            return true;
+    return false;
+}
+
+void fnConfig::mark_dirty()
+{
+    for (const config_section &section : fnConfigSchema::sections)
+        _dirty_slots[section.section] = section.slots > 0 ? (1u << section.slots) - 1 : 1;
+}
+
+/* Regenerate text of sections changed since last save() and schedule the file for writing,
+   see _save_task(). Sections which did not change are written as they were loaded.
 */
 void fnConfig::save()
 {
 
     Debug_printf("fnConfig::save \"%s\"\n", _general.config_file_path.c_str());
 
-    if (!_dirty)
+    if (!_is_dirty())
     {
         Debug_println("fnConfig::save not dirty, not saving");
         return;
     }
 
-    // We're going to write a stringstream so that we have only one write to file at the end
-    std::stringstream ss;
-
-#define LINETERM "\r\n"
-
-    // GENERAL
-    ss << "[General]" LINETERM;
-    ss << "devicename=" << _general.devicename << LINETERM;
-    ss << "hsioindex=" << _general.hsio_index << LINETERM;
-    ss << "rotationsounds=" << _general.rotation_sounds << LINETERM;
-    ss << "configenabled=" << _general.config_enabled << LINETERM;
-    ss << "boot_mode=" << _general.boot_mode << LINETERM;
-    if (_general.timezone.empty() == false)
-        ss << "timezone=" << _general.timezone << LINETERM;
-    ss << "fnconfig_on_spifs=" << _general.fnconfig_spifs << LINETERM;
-    ss << "status_wait_enabled=" << _general.status_wait_enabled << LINETERM;
-    ss << "printer_enabled=" << _general.printer_enabled << LINETERM;
-
-    ss << LINETERM;
-
-    // SERIAL
-    ss << LINETERM << "[Serial]" << LINETERM;
-    ss << "port=" << _serial.port << LINETERM;
-    ss << "command=" << std::string(_serial_command_pin_names[_serial.command]) << LINETERM;
-    ss << "proceed=" << std::string(_serial_proceed_pin_names[_serial.proceed]) << LINETERM;
-
-    // WIFI
-    ss << LINETERM << "[WiFi]" LINETERM;
-    ss << "enabled=" << _wifi.enabled << LINETERM;
-    ss << "SSID=" << _wifi.ssid << LINETERM;
-    // TODO: Encrypt passphrase!
-    ss << "passphrase=" << _wifi.passphrase << LINETERM;
-
-    // BLUETOOTH
-    ss << LINETERM << "[Bluetooth]" LINETERM;
-    ss << "devicename=" << _bt.bt_devname << LINETERM;
-    ss << "enabled=" << _bt.bt_status << LINETERM;
-    ss << "baud=" << _bt.bt_baud << LINETERM;
-
-    // NETWORK
-    ss << LINETERM << "[Network]" LINETERM;
-    ss << "sntpserver=" << _network.sntpserver << LINETERM;
-
-    // HOSTS
-    int i;
-    for (i = 0; i < MAX_HOST_SLOTS; i++)
+    for (const config_section &section : fnConfigSchema::sections)
     {
-        if (_host_slots[i].type != HOSTTYPE_INVALID)
-        {
-            ss << LINETERM << "[Host" << (i + 1) << "]" LINETERM;
-            ss << "type=" << _host_type_names[_host_slots[i].type] << LINETERM;
-            ss << "name=" << _host_slots[i].name << LINETERM;
-        }
+        uint32_t dirty = _dirty_slots[section.section];
+        _dirty_slots[section.section] = 0;
+        for (int i = 0; dirty != 0; i++, dirty >>= 1)
+            if (dirty & 1)
+                _update_block(section, i);
     }
 
-    // MOUNTS
-    for (i = 0; i < MAX_MOUNT_SLOTS; i++)
-    {
-        if (_mount_slots[i].host_slot >= 0)
-        {
-            ss << LINETERM << "[Mount" << (i + 1) << "]" LINETERM;
-            ss << "hostslot=" << (_mount_slots[i].host_slot + 1) << LINETERM; // Write host slot as 1-based
-            ss << "path=" << _mount_slots[i].path << LINETERM;
-            ss << "mode=" << _mount_mode_names[_mount_slots[i].mode] << LINETERM;
-        }
-    }
+    // Hand the results to background writer, callers (SIO, web UI) do not wait for the file
+    std::string result;
+    for (const ini_block &block : _blocks)
+        result += block.text;
+    _queue_save(_general.config_file_path, result);
+}
 
-    // PRINTERS
-    for (i = 0; i < MAX_PRINTER_SLOTS; i++)
-    {
-        if (_printer_slots[i].type != PRINTER_CLASS::printer_type::PRINTER_INVALID)
-        {
-            ss << LINETERM << "[Printer" << (i + 1) << "]" LINETERM;
-            ss << "type=" << _printer_slots[i].type << LINETERM;
-            ss << "port=" << (_printer_slots[i].port + 1) << LINETERM; // Write port # as 1-based
-        }
-    }
+void fnConfig::_queue_save(const std::string &path, std::string &content)
+{
+    std::lock_guard<std::mutex> lock(_save_mutex);
 
-    // TAPES
-    for (i = 0; i < MAX_TAPE_SLOTS; i++)
+    // nothing to do if the file already has the content, drop write of superseded content
+    if (!_save_busy && path == _saved_path && content == _saved_content)
     {
-        if (_tape_slots[i].host_slot >= 0)
-        {
-            ss << LINETERM << "[Tape" << (i + 1) << "]" LINETERM;
-            ss << "hostslot=" << (_tape_slots[i].host_slot + 1) << LINETERM; // Write host slot as 1-based
-            ss << "path=" << _tape_slots[i].path << LINETERM;
-            ss << "mode=" << _mount_mode_names[_tape_slots[i].mode] << LINETERM;
-        }
+        Debug_println("fnConfig::save no changes, not saving");
+        _save_pending = false;
+        _save_content.clear();
+        _save_cv.notify_all();
+        return;
     }
 
-    // MODEM
-    ss << LINETERM << "[Modem]" << LINETERM;
-    ss << "modem_enabled=" << _modem.modem_enabled << LINETERM;
-    ss << "sniffer_enabled=" << _modem.sniffer_enabled << LINETERM;
+    // coalesce with write which is already scheduled
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (!_save_pending)
+        _save_first = now;
+    _save_last = now;
+    _save_path = path;
+    _save_content.swap(content);
+    _save_pending = true;
+
+    if (!_save_thread.joinable())
+        _save_thread = std::thread(&fnConfig::_save_task, this);
+    _save_cv.notify_all();
+}
 
-    //PHONEBOOK
-    for (i = 0; i < MAX_PB_SLOTS; i++)
+void fnConfig::flush()
+{
+    std::unique_lock<std::mutex> lock(_save_mutex);
+    if (!_save_pending && !_save_busy)
+        return;
+    _save_now = true;
+    _save_cv.notify_all();
+    _save_cv.wait(lock, [this] { return !_save_pending && !_save_busy; });
+    _save_now = false;
+}
+
+void fnConfig::_save_task()
+{
+    std::unique_lock<std::mutex> lock(_save_mutex);
+    while (true)
     {
-        if (!_phonebook_slots[i].phnumber.empty())
+        _save_cv.wait(lock, [this] { return _save_pending || _save_exit; });
+        if (!_save_pending)
+            break;
+
+        // wait until changes settle down
+        while (!_save_now && !_save_exit)
         {
-            ss << LINETERM << "[Phonebook" << (i+1) << "]" LINETERM;
-            ss << "number=" << _phonebook_slots[i].phnumber << LINETERM;
-            ss << "host=" << _phonebook_slots[i].hostname << LINETERM;
-            ss << "port=" << _phonebook_slots[i].port << LINETERM;
+            std::chrono::steady_clock::time_point deadline = std::min(
+                _save_last + std::chrono::milliseconds(CONFIG_SAVE_DELAY_MS),
+                _save_first + std::chrono::milliseconds(CONFIG_SAVE_MAX_DELAY_MS));
+            if (std::chrono::steady_clock::now() >= deadline)
+                break;
+            _save_cv.wait_until(lock, deadline);
         }
+        // scheduled write was cancelled meanwhile
+        if (!_save_pending)
+            continue;
+
+        std::string path = _save_path;
+        std::string content;
+        content.swap(_save_content);
+        _save_pending = false;
+        _save_busy = true;
+
+        lock.unlock();
+        bool ok = _write_file(path, content);
+        lock.lock();
+
+        _save_busy = false;
+        if (ok)
+        {
+            _saved_path = path;
+            _saved_content.swap(content);
+        }
+        _save_cv.notify_all();
     }
+}
 
-    // CASSETTE
-    ss << LINETERM << "[Cassette]" << LINETERM;
-    ss << "play_record=" << ((_cassette.button) ? "1 Record" : "0 Play") << LINETERM;
-    ss << "pulldown=" << ((_cassette.pulldown) ? "1 Pulldown Resistor" : "0 B Button Press") << LINETERM;
-    ss << "cassette_enabled=" << _cassette.cassette_enabled << LINETERM;
-
-    // CPM
-    ss << LINETERM << "[CPM]" << LINETERM;
-    ss << "ccp=" << _cpm.ccp << LINETERM;
-
-    // ENABLE DEVICE SLOTS
-    ss << LINETERM << "[ENABLE]" << LINETERM;
-    ss << "enable_device_slot_1=" << _denable.device_1_enabled << LINETERM;
-    ss << "enable_device_slot_2=" << _denable.device_2_enabled << LINETERM;
-    ss << "enable_device_slot_3=" << _denable.device_3_enabled << LINETERM;
-    ss << "enable_device_slot_4=" << _denable.device_4_enabled << LINETERM;
-    ss << "enable_device_slot_5=" << _denable.device_5_enabled << LINETERM;
-    ss << "enable_device_slot_6=" << _denable.device_6_enabled << LINETERM;
-    ss << "enable_device_slot_7=" << _denable.device_7_enabled << LINETERM;
-    ss << "enable_device_slot_8=" << _denable.device_8_enabled << LINETERM;
-
-    // NETSIO
-    ss << LINETERM << "[NetSIO]" << LINETERM;
-    ss << "enabled=" << _netsio.netsio_enabled << LINETERM;
-    ss << "host=" << _netsio.host << LINETERM;
-    ss << "port=" << _netsio.port << LINETERM;
-
-    // Write the results out
-    // FILE *fout = fnSPIFFS.file_open(CONFIG_FILENAME, FILE_WRITE);
-    FILE *fout = fopen(_general.config_file_path.c_str(), FILE_WRITE);
+// Write the file next to the config and rename it over, the config is never left half written
+bool fnConfig::_write_file(const std::string &path, const std::string &content)
+{
+    std::string temp_path = path + ".tmp";
+    FILE *fout = fopen(temp_path.c_str(), FILE_WRITE);
     if (fout == nullptr)
     {
         Debug_printf("Failed to open config file\n");
-        return;
+        return false;
+    }
+    size_t z = fwrite(content.c_str(), 1, content.length(), fout);
+    if (fclose(fout) != 0 || z != content.length())
+    {
+        Debug_printf("Failed to write config file\n");
+        remove(temp_path.c_str());
+        return false;
+    }
+#if defined(_WIN32)
+    // rename() does not replace existing file
+    remove(path.c_str());
+#endif
+    if (rename(temp_path.c_str(), path.c_str()) != 0)
+    {
+        Debug_printf("Failed to replace config file\n");
+        remove(temp_path.c_str());
+        return false;
     }
-    std::string result = ss.str();
-    size_t z = fwrite(result.c_str(), 1, result.length(), fout);
-    (void)z; // Get around unused var
     Debug_printf("fnConfig::save wrote %u bytes\n", (unsigned)z);
-    fclose(fout);
-
-    _dirty = false;
-
+    return true;
 }
 
 /* Load configuration data from SPIFFS. If no config file exists in SPIFFS,
@@ -911,25 +1140,26 @@ void fnConfig::load()
     struct stat st;
     if (stat(_general.config_file_path.c_str(), &st) < 0)
     {
-        _dirty = true; // We have a new (blank) config, so we treat it as needing to be saved
+        mark_dirty(); // We have a new (blank) config, so we treat it as needing to be saved
         Debug_println("No config found - starting fresh!");
         return; // No local copy - ABORT
     }
     // Read INI file into buffer (for speed)
     // Then look for sections and handle each
-    FILE *fin = fopen(_general.config_file_path.c_str(), FILE_READ_TEXT);
+    FILE *fin = fopen(_general.config_file_path.c_str(), FILE_READ);
     if (fin == nullptr)
     {
         Debug_printf("Failed to open config file\n");
         return;
     }
-    char *inibuffer = (char *)malloc(CONFIG_FILEBUFFSIZE);
+    char *inibuffer = (char *)malloc(st.st_size + 1);
     if (inibuffer == nullptr)
     {
-        Debug_printf("Failed to allocate %d bytes to read config file\n", CONFIG_FILEBUFFSIZE);
+        Debug_printf("Failed to allocate %d bytes to read config file\n", (int)st.st_size + 1);
+        fclose(fin);
         return;
     }
-    int i = fread(inibuffer, 1, CONFIG_FILEBUFFSIZE - 1, fin);
+    int i = fread(inibuffer, 1, st.st_size, fin);
     fclose(fin);
 
     Debug_printf("fnConfig::load read %d bytes from config file\n", i);
@@ -941,633 +1171,309 @@ void fnConfig::load()
         return;
     }
     inibuffer[i] = '\0';
-    // Put the data in a stringstream
-    std::stringstream ss;
-    ss << inibuffer;
+    std::string content(inibuffer, i);
     free(inibuffer);
 
-    std::string line;
-    while (_read_line(ss, line) >= 0)
+    // Split the file into sections, keeping their text for save(), and read the keys
+    _lineterm = (content.find('\n') == std::string::npos || content.find("\r\n") != std::string::npos) ? "\r\n" : "\n";
+    _blocks.clear();
+    const config_section *section = nullptr;
+    int index = 0;
+    size_t pos = 0;
+    while (pos < content.length())
     {
-        int index = 0;
-        switch (_find_section_in_line(line, index))
-        {
-        case SECTION_GENERAL:
-            _read_section_general(ss);
-            break;
-        case SECTION_WIFI:
-            _read_section_wifi(ss);
-            break;
-        case SECTION_BT:
-            _read_section_bt(ss);
-            break;
-        case SECTION_NETWORK:
-            _read_section_network(ss);
-            break;
-        case SECTION_HOST:
-            _read_section_host(ss, index);
-            break;
-        case SECTION_MOUNT:
-            _read_section_mount(ss, index);
-            break;
-        case SECTION_PRINTER:
-            _read_section_printer(ss, index);
-            break;
-        case SECTION_TAPE: // Oscar put this here to handle server/path to CAS files
-            _read_section_tape(ss, index);
-            break;
-        case SECTION_MODEM:
-            _read_section_modem(ss);
-            break;
-        case SECTION_CASSETTE: //Jeff put this here to handle tape drive configuration (pulldown and play/record)
-            _read_section_cassette(ss);
-            break;
-        case SECTION_CPM:
-            _read_section_cpm(ss);
-            break;
-        case SECTION_PHONEBOOK: //Mauricio put this here to handle the phonebook
-            _read_section_phonebook(ss, index);
-            break;
-        case SECTION_DEVICE_ENABLE: // Thom put this here to handle explicit device enables in adam
-            _read_section_device_enable(ss);
-            break;
-        case SECTION_SERIAL:
-            _read_section_serial(ss);
-            break;
-        case SECTION_NETSIO:
-            _read_section_netsio(ss);
-            break;
-        case SECTION_UNKNOWN:
-            break;
-        }
-    }
-    _dirty = false;
+        size_t eol = content.find('\n', pos);
+        eol = (eol == std::string::npos) ? content.length() : eol + 1;
+        std::string line = content.substr(pos, eol - pos);
+        util_string_trim(line);
 
-    _dirty = false;
-}
-
-void fnConfig::_read_section_general(std::stringstream &ss)
-{
-    std::string line;
-    // Read lines until one starts with '[' which indicates a new section
-    while (_read_line(ss, line, '[') >= 0)
-    {
-        std::string name;
-        std::string value;
-        if (_split_name_value(line, name, value))
+        if (line[0] == '[')
         {
-            if (strcasecmp(name.c_str(), "devicename") == 0)
-            {
-                _general.devicename = value;
-            }
-            else if (strcasecmp(name.c_str(), "hsioindex") == 0)
-            {
-                int index = atoi(value.c_str());
-                // if (index >= 0 && index < 10)
-                if (index >= -1 && index <= 10 || index == 16) // -1(HSIO disabled),0..10,16
-                    _general.hsio_index = index;
-            }
-            else if (strcasecmp(name.c_str(), "timezone") == 0)
-            {
-                _general.timezone = value;
-            }
-            else if (strcasecmp(name.c_str(), "rotationsounds") == 0)
-            {
-                _general.rotation_sounds = util_string_value_is_true(value);
-            }
-            else if (strcasecmp(name.c_str(), "configenabled") == 0)
-            {
-                _general.config_enabled = util_string_value_is_true(value);
-            }
-            else if (strcasecmp(name.c_str(), "boot_mode") == 0)
-            {
-                int mode = atoi(value.c_str());
-                _general.boot_mode = mode;
-            }
-            else if (strcasecmp(name.c_str(), "fnconfig_on_spifs") == 0)
-            {
-                _general.fnconfig_spifs = util_string_value_is_true(value);
-            }
-            else if (strcasecmp(name.c_str(), "status_wait_enabled") == 0)
-            {
-                _general.status_wait_enabled = util_string_value_is_true(value);
-            }
-            else if (strcasecmp(name.c_str(), "printer_enabled") == 0)
-            {
-                _general.printer_enabled = util_string_value_is_true(value);
-            }
+            section = _find_section(line, index);
+            if (section == nullptr)
+                Debug_printf("fnConfig::load keeping unknown section %s\n", line.c_str());
+            ini_block block;
+            block.section = section ? section->section : SECTION_UNKNOWN;
+            block.index = section ? index : 0;
+            _blocks.push_back(block);
         }
-    }
-}
-
-void fnConfig::_read_section_network(std::stringstream &ss)
-{
-    std::string line;
-    // Read lines until one starts with '[' which indicates a new section
-    while (_read_line(ss, line, '[') >= 0)
-    {
-        std::string name;
-        std::string value;
-        if (_split_name_value(line, name, value))
+        else
         {
-            if (strcasecmp(name.c_str(), "sntpserver") == 0)
+            // text before first section
+            if (_blocks.empty())
             {
-                strlcpy(_network.sntpserver, value.c_str(), sizeof(_network.sntpserver));
+                ini_block block;
+                block.section = SECTION_UNKNOWN;
+                block.index = 0;
+                _blocks.push_back(block);
             }
-        }
-    }
-}
 
-void fnConfig::_read_section_serial(std::stringstream &ss)
-{
-    std::string line;
-    // Read lines until one starts with '[' which indicates a new section
-    while (_read_line(ss, line, '[') >= 0)
-    {
-        std::string name;
-        std::string value;
-        if (_split_name_value(line, name, value))
-        {
-            if (strcasecmp(name.c_str(), "port") == 0)
-            {
-                _serial.port = value;
-            }
-            else if (strcasecmp(name.c_str(), "command") == 0)
-            {
-                _serial.command = serial_command_from_string(value.c_str());
-            }
-            else if (strcasecmp(name.c_str(), "proceed") == 0)
-            {
-                _serial.proceed = serial_proceed_from_string(value.c_str());
-            }
+            std::string name;
+            std::string value;
+            const config_key *key;
+            if (section != nullptr && _split_name_value(line, name, value) &&
+                (key = _find_key(section->section, name)) != nullptr)
+                _read_key(*key, index, value);
         }
+        _blocks.back().text.append(content, pos, eol - pos);
+        pos = eol;
     }
-}
-
-void fnConfig::_read_section_wifi(std::stringstream &ss)
-{
-    // Throw out any existing data
-    _wifi.ssid.clear();
-    _wifi.passphrase.clear();
-
-    std::string line;
-    // Read lines until one starts with '[' which indicates a new section
-    while (_read_line(ss, line, '[') >= 0)
-    {
-        std::string name;
-        std::string value;
-        if (_split_name_value(line, name, value))
-        {
-            if (strcasecmp(name.c_str(), "SSID") == 0)
-            {
-                _wifi.ssid = value;
-            }
-            else if (strcasecmp(name.c_str(), "passphrase") == 0)
-            {
-                _wifi.passphrase = value;
-            }
-            else if (strcasecmp(name.c_str(), "enabled") == 0)
-            {
-                if (strcasecmp(value.c_str(), "1") == 0)
-                    _wifi.enabled = true;
-                else
-                    _wifi.enabled = false;
-            }
 
-        }
-    }
+    for (uint32_t &dirty : _dirty_slots)
+        dirty = 0;
 }
 
-void fnConfig::_read_section_bt(std::stringstream &ss)
+/*
+Looks for [SectionNameX] where X is an integer
+Returns the section found and sets index to X - 1 if the section has slots
+*/
+const fnConfig::config_section *fnConfig::_find_section(const std::string &line, int &index)
 {
-    std::string line;
-    // Read lines until one starts with '[' which indicates a new section
-    while (_read_line(ss, line, '[') >= 0)
+    size_t b2 = line.find_last_of(']');
+    if (b2 == std::string::npos)
+        return nullptr;
+    std::string name = line.substr(1, b2 - 1);
+
+    for (const config_section &section : fnConfigSchema::sections)
     {
-        std::string name;
-        std::string value;
-        if (_split_name_value(line, name, value))
+        if (section.slots == 0)
         {
-            if (strcasecmp(name.c_str(), "enabled") == 0)
-            {
-                if (strcasecmp(value.c_str(), "1") == 0)
-                    _bt.bt_status = true;
-                else
-                    _bt.bt_status = false; 
-            }
-            else if (strcasecmp(name.c_str(), "baud") == 0)
+            if (strcasecmp(section.name, name.c_str()) == 0)
             {
-                _bt.bt_baud = stoi(value);
-            }
-            else if (strcasecmp(name.c_str(), "devicename") == 0)
-            {
-                _bt.bt_devname = value;
+                index = 0;
+                return &section;
             }
+            continue;
         }
-    }}
-
-void fnConfig::_read_section_host(std::stringstream &ss, int index)
-{
-    // Throw out any existing data for this index
-    _host_slots[index].type = HOSTTYPE_INVALID;
-    _host_slots[index].name.clear();
 
-    std::string line;
-    // Read lines until one starts with '[' which indicates a new section
-    while (_read_line(ss, line, '[') >= 0)
-    {
-        std::string name;
-        std::string value;
-        if (_split_name_value(line, name, value))
+        size_t len = strlen(section.name);
+        if (strncasecmp(section.name, name.c_str(), len) == 0 && name.length() > len && isdigit(name[len]))
         {
-            if (strcasecmp(name.c_str(), "name") == 0)
-            {
-                _host_slots[index].name = value;
-            }
-            else if (strcasecmp(name.c_str(), "type") == 0)
+            index = atoi(name.c_str() + len) - 1;
+            if (index < 0 || index >= section.slots)
             {
-                _host_slots[index].type = host_type_from_string(value.c_str());
+                Debug_println("Invalid index value - discarding");
+                return nullptr;
             }
+            return &section;
         }
     }
+    return nullptr;
 }
 
-void fnConfig::_read_section_mount(std::stringstream &ss, int index)
+const fnConfig::config_key *fnConfig::_find_key(section_match section, const std::string &name)
 {
-    // Throw out any existing data for this index
-    _mount_slots[index].host_slot = HOST_SLOT_INVALID;
-    _mount_slots[index].mode = MOUNTMODE_INVALID;
-    _mount_slots[index].path.clear();
-
-    std::string line;
-    // Read lines until one starts with '[' which indicates a new section
-    while (_read_line(ss, line, '[') >= 0)
-    {
-        std::string name;
-        std::string value;
-        if (_split_name_value(line, name, value))
-        {
-            if (strcasecmp(name.c_str(), "hostslot") == 0)
-            {
-                int slot = atoi(value.c_str()) - 1;
-                if (slot < 0 || slot >= MAX_HOST_SLOTS)
-                    slot = HOST_SLOT_INVALID;
-                _mount_slots[index].host_slot = slot;
-                //Debug_printf("config mount %d hostslot=%d\n", index, slot);
-            }
-            else if (strcasecmp(name.c_str(), "mode") == 0)
-            {
-                _mount_slots[index].mode = mount_mode_from_string(value.c_str());
-                //Debug_printf("config mount %d mode=%d (\"%s\")\n", index, _mount_slots[index].mode, value.c_str());
-            }
-            else if (strcasecmp(name.c_str(), "path") == 0)
-            {
-                _mount_slots[index].path = value;
-                //Debug_printf("config mount %d path=\"%s\"\n", index, value.c_str());
-            }
-        }
-    }
+    for (const config_key &key : fnConfigSchema::keys)
+        if (key.section == section && strcasecmp(key.name, name.c_str()) == 0)
+            return &key;
+    return nullptr;
 }
 
-void fnConfig::_read_section_tape(std::stringstream &ss, int index)
+// Store value read from the file
+void fnConfig::_read_key(const config_key &key, int index, const std::string &value)
 {
-    // Throw out any existing data for this index
-    _tape_slots[index].host_slot = HOST_SLOT_INVALID;
-    _tape_slots[index].mode = MOUNTMODE_INVALID;
-    _tape_slots[index].path.clear();
+    void *p = key.value(*this, index);
+    int number = 0;
 
-    std::string line;
-    // Read lines until one starts with '[' which indicates a new section
-    while (_read_line(ss, line, '[') >= 0)
+    switch (key.type)
     {
-        std::string name;
-        std::string value;
-        if (_split_name_value(line, name, value))
-        {
-            if (strcasecmp(name.c_str(), "hostslot") == 0)
-            {
-                int slot = atoi(value.c_str()) - 1;
-                if (slot < 0 || slot >= MAX_HOST_SLOTS)
-                    slot = HOST_SLOT_INVALID;
-                _mount_slots[index].host_slot = slot;
-                //Debug_printf("config mount %d hostslot=%d\n", index, slot);
-            }
-            else if (strcasecmp(name.c_str(), "mode") == 0)
-            {
-                _mount_slots[index].mode = mount_mode_from_string(value.c_str());
-                //Debug_printf("config mount %d mode=%d (\"%s\")\n", index, _mount_slots[index].mode, value.c_str());
-            }
-            else if (strcasecmp(name.c_str(), "path") == 0)
-            {
-                _mount_slots[index].path = value;
-                //Debug_printf("config mount %d path=\"%s\"\n", index, value.c_str());
-            }
-        }
+    case KEY_BOOL:
+        *(bool *)p = util_string_value_is_true(value);
+        return;
+    case KEY_STRING:
+        *(std::string *)p = value;
+        return;
+    case KEY_CHARS:
+        strlcpy((char *)p, value.c_str(), key.max);
+        return;
+    case KEY_INT:
+        number = atoi(value.c_str());
+        break;
+    case KEY_SLOT:
+        number = atoi(value.c_str()) - 1;
+        break;
+    case KEY_ENUM:
+        for (number = key.min; number <= key.max; number++)
+            if (strcasecmp(key.names[number], value.c_str()) == 0)
+                break;
+        break;
     }
+
+    if (number < key.min || number > key.max)
+        number = key.fallback;
+    // int and enum values have the same size
+    memcpy(p, &number, sizeof(number));
 }
 
-void fnConfig::_read_section_printer(std::stringstream &ss, int index)
+// Text of key value to write, false if the key is not written
+bool fnConfig::_key_text(const config_key &key, int index, std::string &text)
 {
-    // Throw out any existing data for this index
-    _printer_slots[index].type = PRINTER_CLASS::printer_type::PRINTER_INVALID;
+    void *p = key.value(*this, index);
+    int number = 0;
 
-    std::string line;
-    // Read lines until one starts with '[' which indicates a new section
-    while (_read_line(ss, line, '[') >= 0)
+    switch (key.type)
     {
-        std::string name;
-        std::string value;
-        if (_split_name_value(line, name, value))
-        {
-            if (strcasecmp(name.c_str(), "type") == 0)
-            {
-                int type = atoi(value.c_str());
-                if (type < 0 || type >= PRINTER_CLASS::printer_type::PRINTER_INVALID)
-                    type = PRINTER_CLASS::printer_type::PRINTER_INVALID;
-
-                _printer_slots[index].type = (PRINTER_CLASS::printer_type)type;
-                //Debug_printf("config printer %d type=%d\n", index, type);
-            }
-            else if (strcasecmp(name.c_str(), "port") == 0)
-            {
-                int port = atoi(value.c_str()) - 1;
-                if (port < 0 || port > 3)
-                    port = 0;
+    case KEY_BOOL:
+        if (key.names != nullptr)
+            text = key.names[*(bool *)p ? 1 : 0];
+        else
+            text = *(bool *)p ? "1" : "0";
+        return true;
+    case KEY_STRING:
+        text = *(std::string *)p;
+        return !(text.empty() && (key.flags & KEY_FLAG_OMIT_EMPTY));
+    case KEY_CHARS:
+        text = (char *)p;
+        return !(text.empty() && (key.flags & KEY_FLAG_OMIT_EMPTY));
+    case KEY_INT:
+    case KEY_SLOT:
+    case KEY_ENUM:
+        memcpy(&number, p, sizeof(number));
+        break;
+    }
 
-                _printer_slots[index].port = port;
-                //Debug_printf("config printer %d port=%d\n", index, port + 1);
-            }
-        }
+    if (number < key.min || number > key.max)
+    {
+        text.clear();
+        return false;
     }
+    if (key.type == KEY_ENUM)
+        text = key.names[number];
+    else
+        text = std::to_string(key.type == KEY_SLOT ? number + 1 : number);
+    return true;
 }
 
-void fnConfig::_read_section_modem(std::stringstream &ss)
+// Sections with required key are written only when the key has valid value (host slot of a mount...)
+bool fnConfig::_section_in_use(const config_section &section, int index)
 {
-    std::string line;
-
-    // Read lines until one starts with '[' which indicates a new section
-    while (_read_line(ss, line, '[') >= 0)
-    {
-        std::string name;
-        std::string value;
-        if (_split_name_value(line, name, value))
-        {
-            if (strcasecmp(name.c_str(), "modem_enabled") == 0)
-                _modem.modem_enabled = util_string_value_is_true(value);
-            else if (strcasecmp(name.c_str(), "sniffer_enabled") == 0)
-                _modem.sniffer_enabled = util_string_value_is_true(value);
-        }
-    }
+    std::string text;
+    for (const config_key &key : fnConfigSchema::keys)
+        if (key.section == section.section && (key.flags & KEY_FLAG_REQUIRED) && (!_key_text(key, index, text) || text.empty()))
+            return false;
+    return true;
 }
 
-void fnConfig::_read_section_cassette(std::stringstream &ss)
+/* Text of the section with current values. Lines of keys are updated in the old text,
+   comments and unknown keys are kept, missing keys are added after the last key.
+*/
+std::string fnConfig::_section_text(const config_section &section, int index, const std::string *old_text)
 {
-    std::string line;
-    // Read lines until one starts with '[' which indicates a new section
-    while (_read_line(ss, line, '[') >= 0)
+    std::vector<bool> written(sizeof(fnConfigSchema::keys) / sizeof(fnConfigSchema::keys[0]), false);
+    std::string text;
+    std::string tail; // blank lines after last key
+    std::string value;
+
+    if (old_text != nullptr)
     {
-        std::string name;
-        std::string value;
-        if (_split_name_value(line, name, value))
+        size_t pos = 0;
+        while (pos < old_text->length())
         {
-            if (strcasecmp(name.c_str(), "play_record") == 0)
-            {
-                _cassette.button = util_string_value_is_true(value);
-            }
-            else if (strcasecmp(name.c_str(), "pulldown") == 0)
+            size_t eol = old_text->find('\n', pos);
+            eol = (eol == std::string::npos) ? old_text->length() : eol + 1;
+            std::string line = old_text->substr(pos, eol - pos);
+            pos = eol;
+
+            std::string trimmed = line;
+            util_string_trim(trimmed);
+            if (trimmed.empty())
             {
-                _cassette.pulldown = util_string_value_is_true(value);
+                tail += line;
+                continue;
             }
-            else if (strcasecmp(name.c_str(), "cassette_enabled") == 0)
+            text += tail;
+            tail.clear();
+
+            std::string name;
+            const config_key *key;
+            if (text.empty() || !_split_name_value(trimmed, name, value) ||
+                (key = _find_key(section.section, name)) == nullptr)
             {
-                _cassette.cassette_enabled = util_string_value_is_true(value);
+                // header, comments and unknown keys
+                if (line.back() != '\n')
+                    line += _lineterm;
+                text += line;
+                continue;
             }
+
+            // key which was written already is a duplicate
+            size_t k = key - fnConfigSchema::keys;
+            if (written[k])
+                continue;
+            written[k] = true;
+            if (_key_text(*key, index, value))
+                text += std::string(key->name) + "=" + value + _lineterm;
         }
     }
-}
-
-void fnConfig::_read_section_cpm(std::stringstream &ss)
-{
-    std::string line;
-
-    // Read lines until one starts with '[' which indicates a new section
-    while (_read_line(ss, line, '[') >= 0)
+    else
     {
-        std::string name;
-        std::string value;
-        if (_split_name_value(line, name, value))
-        {
-            if (strcasecmp(name.c_str(), "ccp") == 0)
-                _cpm.ccp = value;
-        }
+        text = "[" + std::string(section.name);
+        if (section.slots > 0)
+            text += std::to_string(index + 1);
+        text += "]";
+        text += _lineterm;
+        tail = _lineterm;
     }
-}
-
-void fnConfig::_read_section_device_enable(std::stringstream &ss)
-{
-    std::string line;
 
-    // Read lines until one starts with '[' which indicates a new section
-    while (_read_line(ss, line, '[') >= 0)
+    for (const config_key &key : fnConfigSchema::keys)
     {
-        std::string name;
-        std::string value;
-        if (_split_name_value(line, name, value))
-        {
-            if (strcasecmp(name.c_str(), "enable_device_slot_1") == 0)
-                _denable.device_1_enabled = atoi(value.c_str());
-            else if (strcasecmp(name.c_str(), "enable_device_slot_2") == 0)
-                _denable.device_2_enabled = atoi(value.c_str());
-            else if (strcasecmp(name.c_str(), "enable_device_slot_3") == 0)
-                _denable.device_3_enabled = atoi(value.c_str());
-            else if (strcasecmp(name.c_str(), "enable_device_slot_4") == 0)
-                _denable.device_4_enabled = atoi(value.c_str());
-            else if (strcasecmp(name.c_str(), "enable_device_slot_5") == 0)
-                _denable.device_5_enabled = atoi(value.c_str());
-            else if (strcasecmp(name.c_str(), "enable_device_slot_6") == 0)
-                _denable.device_6_enabled = atoi(value.c_str());
-            else if (strcasecmp(name.c_str(), "enable_device_slot_7") == 0)
-                _denable.device_7_enabled = atoi(value.c_str());
-            else if (strcasecmp(name.c_str(), "enable_device_slot_8") == 0)
-                _denable.device_8_enabled = atoi(value.c_str());
-        }
+        if (key.section != section.section || written[&key - fnConfigSchema::keys])
+            continue;
+        if (_key_text(key, index, value))
+            text += std::string(key.name) + "=" + value + _lineterm;
     }
+    return text + tail;
 }
 
-void fnConfig::_read_section_phonebook(std::stringstream &ss, int index)
+// Replace text of the section with current values, add it to the file or remove it when not in use
+void fnConfig::_update_block(const config_section &section, int index)
 {
-    // Throw out any existing data for this index
-    _phonebook_slots[index].phnumber.clear();
-    _phonebook_slots[index].hostname.clear();
-    _phonebook_slots[index].port.clear();
+    int order = &section - fnConfigSchema::sections;
+    auto block_order = [](const ini_block &block) {
+        for (const config_section &s : fnConfigSchema::sections)
+            if (s.section == block.section)
+                return (int)(&s - fnConfigSchema::sections);
+        return -1;
+    };
 
-    std::string line;
-    // Read lines until one starts with '[' which indicates a new section
-    while (_read_line(ss, line, '[') >= 0)
+    // new section goes before first section which comes after it in the schema
+    size_t insert_at = _blocks.size();
+    for (size_t i = 0; i < _blocks.size(); i++)
     {
-        std::string name;
-        std::string value;
-        if (_split_name_value(line, name, value))
+        ini_block &block = _blocks[i];
+        if (block.section == section.section && block.index == index)
         {
-            if (strcasecmp(name.c_str(), "number") == 0)
-            {
-                _phonebook_slots[index].phnumber = value;
-            }
-            else if (strcasecmp(name.c_str(), "host") == 0)
-            {
-                _phonebook_slots[index].hostname = value;
-            }
-            else if (strcasecmp(name.c_str(), "port") == 0)
-            {
-                _phonebook_slots[index].port = value;
-            }
+            if (_section_in_use(section, index))
+                block.text = _section_text(section, index, &block.text);
+            else
+                _blocks.erase(_blocks.begin() + i);
+            return;
         }
+        int o = block_order(block);
+        if (insert_at == _blocks.size() && (o > order || (o == order && block.index > index)))
+            insert_at = i;
     }
-}
 
-void fnConfig::_read_section_netsio(std::stringstream &ss)
-{
-    std::string line;
-    // Read lines until one starts with '[' which indicates a new section
-    while (_read_line(ss, line, '[') >= 0)
-    {
-        std::string name;
-        std::string value;
-        if (_split_name_value(line, name, value))
-        {
-            if (strcasecmp(name.c_str(), "enabled") == 0)
-            {
-                _netsio.netsio_enabled = util_string_value_is_true(value);
-            }
-            else if (strcasecmp(name.c_str(), "host") == 0)
-            {
-                _netsio.host = value;
-            }
-            else if (strcasecmp(name.c_str(), "port") == 0)
-            {
-                int port = atoi(value.c_str());
-                if (port <= 0 || port > 65535) 
-                    port = CONFIG_DEFAULT_NETSIO_PORT;
-                _netsio.port = port;
-            }
-        }
-    }
-}
+    if (!_section_in_use(section, index))
+        return;
 
-/*
-Looks for [SectionNameX] where X is an integer
-Returns which SectionName was found and sets index to X if X is an integer
-*/
-fnConfig::section_match fnConfig::_find_section_in_line(std::string &line, int &index)
-{
-    // Look for something in brackets
-    size_t b1 = line.find_first_of('[');
-    if (b1 != std::string::npos)
+    // keep empty line between sections
+    if (insert_at > 0)
     {
-        b1++; // skip the opening bracket
-        size_t b2 = line.find_last_of(']');
-        if (b2 != std::string::npos)
-        {
-            std::string s1 = line.substr(b1, b2 - b1);
-            //Debug_printf("examining \"%s\"\n", s1.c_str());
-            if (strncasecmp("Host", s1.c_str(), 4) == 0)
-            {
-                index = atoi((const char *)(s1.c_str() + 4)) - 1;
-                if (index < 0 || index >= MAX_HOST_SLOTS)
-                {
-                    Debug_println("Invalid index value - discarding");
-                    return SECTION_UNKNOWN;
-                }
-                //Debug_printf("Found HOST %d\n", index);
-                return SECTION_HOST;
-            }
-            else if (strncasecmp("Mount", s1.c_str(), 5) == 0)
-            {
-                index = atoi((const char *)(s1.c_str() + 5)) - 1;
-                if (index < 0 || index >= MAX_MOUNT_SLOTS)
-                {
-                    Debug_println("Invalid index value - discarding");
-                    return SECTION_UNKNOWN;
-                }
-                //Debug_printf("Found MOUNT %d\n", index);
-                return SECTION_MOUNT;
-            }
-            else if (strncasecmp("Printer", s1.c_str(), 7) == 0)
-            {
-                index = atoi((const char *)(s1.c_str() + 7) - 1);
-                if (index < 0 || index >= MAX_PRINTER_SLOTS)
-                {
-                    Debug_println("Invalid index value - discarding");
-                    return SECTION_UNKNOWN;
-                }
-                //Debug_printf("Found PRINTER %d\n", index);
-                return SECTION_PRINTER;
-            }
-            else if (strncasecmp("WiFi", s1.c_str(), 4) == 0)
-            {
-                //Debug_printf("Found WIFI\n");
-                return SECTION_WIFI;
-            }
-            else if (strncasecmp("Bluetooth", s1.c_str(), 9) == 0)
-            {
-                //Debug_printf("Found Bluetooth\n");
-                return SECTION_BT;
-            }
-            else if (strncasecmp("General", s1.c_str(), 7) == 0)
-            {
-                // Debug_printf("Found General\n");
-                return SECTION_GENERAL;
-            }
-            else if (strncasecmp("Network", s1.c_str(), 7) == 0)
-            {
-                // Debug_printf("Found Network\n");
-                return SECTION_NETWORK;
-            }
-            else if (strncasecmp("Tape", s1.c_str(), 4) == 0)
-            {
-                index = atoi((const char *)(s1.c_str() + 4)) - 1;
-                if (index < 0 || index >= MAX_TAPE_SLOTS)
-                {
-                    Debug_println("Invalid index value - discarding");
-                    return SECTION_UNKNOWN;
-                }
-                // Debug_printf("Found Cassette\n");
-                return SECTION_TAPE;
-            }
-            else if (strncasecmp("Cassette", s1.c_str(), 8) == 0)
-            {
-                return SECTION_CASSETTE;
-            }
-            else if (strncasecmp("Phonebook", s1.c_str(), 9) == 0)
-            {
-                index = atoi((const char *)(s1.c_str() + 9)) - 1;
-                if (index < 0 || index >= MAX_PB_SLOTS)
-                {
-                    Debug_println("Invalid index value - discarding");
-                    return SECTION_UNKNOWN;
-                }
-                //Debug_printf("Found Phonebook Entry %d\n", index);
-                return SECTION_PHONEBOOK;
-            }
-            else if (strncasecmp("Modem", s1.c_str(), 8) == 0)
-            {
-                return SECTION_MODEM;
-            }
-            else if (strncasecmp("CPM", s1.c_str(), 8) == 0)
-            {
-                return SECTION_CPM;
-            }
-            else if (strncasecmp("Serial", s1.c_str(), 6) == 0)
-            {
-                return SECTION_SERIAL;
-            }
-            else if (strncasecmp("NetSIO", s1.c_str(), 6) == 0)
-            {
-                return SECTION_NETSIO;
-            }
-        }
+        std::string &prev = _blocks[insert_at - 1].text;
+        if (!prev.empty() && prev.back() != '\n')
+            prev += _lineterm;
+        size_t last = prev.length() >= 2 ? prev.rfind('\n', prev.length() - 2) : std::string::npos;
+        last = (last == std::string::npos) ? 0 : last + 1;
+        if (prev.find_first_not_of(" \t\r\n", last) != std::string::npos)
+            prev += _lineterm;
     }
-    return SECTION_UNKNOWN;
+
+    ini_block block;
+    block.section = section.section;
+    block.index = index;
+    block.text = _section_text(section, index, nullptr);
+    _blocks.insert(_blocks.begin() + insert_at, block);
 }
 
 fnConfig::host_type_t fnConfig::host_type_from_string(const char *str)
@@ -1621,44 +1527,11 @@ bool fnConfig::_split_name_value(std::string &line, std::string &name, std::stri
     return false;
 }
 
-int fnConfig::_read_line(std::stringstream &ss, std::string &line, char abort_if_starts_with)
+fnConfig::sniffer_format_t fnConfig::sniffer_format_from_string(const char *str)
 {
-    line.erase();
-
-    char c;
-    size_t count = 0;
-    size_t err = 0;
-    bool iseof = false;
-    bool have_read_non_whitespace = false;
-    std::streampos linestart = ss.tellg();
-
-    while ((iseof = ss.eof()) == false)
-    {
-        ss.read(&c, 1);
-
-        // Consume the next character after \r if it's a \n
-        if (c == '\r')
-        {
-            if (ss.peek() == '\n')
-                ss.read(&c, 1);
-            break;
-        }
-        if (c == '\n')
-            break;
-
-        // Rewind to start of line if we found the abort character
-        if (have_read_non_whitespace == false && abort_if_starts_with != '\0' && abort_if_starts_with == c)
-        {
-            ss.seekg(linestart);
-            err = -1;
+    int i = 0;
+    for (; i < sniffer_formats::SNIFFER_FORMAT_INVALID; i++)
+        if (strcasecmp(_sniffer_format_names[i], str) == 0)
             break;
-        }
-        if (have_read_non_whitespace == false)
-            have_read_non_whitespace = (c != 32 && c != 9);
-
-        line += c;
-        count++;
-    }
-
-    return (iseof || err) ? -1 : count;
+    return (sniffer_format_t)i;
 }
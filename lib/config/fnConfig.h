@@ -2,6 +2,12 @@
 #define _FN_CONFIG_H
 
 #include <string>
+#include <vector>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <type_traits>
 
 #include "printer.h"
 
@@ -23,6 +29,13 @@
 
 #define CONFIG_DEFAULT_NETSIO_PORT 9997
 
+#define CONFIG_SAVE_DELAY_MS 500      // quiet time before changed config is written
+#define CONFIG_SAVE_MAX_DELAY_MS 3000 // longest time a change can wait for the write
+
+#define CONFIG_DEFAULT_CACHE_SIZE_MB 64 // disk cache for files from remote hosts
+#define CONFIG_DEFAULT_DISK_WRITE_BACK false // hold written disk sectors and write them in batches
+#define CONFIG_DEFAULT_DISK_OVERLAY false // keep writes to read-only remote disk images in overlay on SD
+
 class fnConfig
 {
 public:
@@ -72,6 +85,16 @@ public:
     // typedef serial_proceed_pin serial_proceed_pin_t;
     serial_proceed_pin serial_proceed_from_string(const char *str);
 
+    // values match ModemSniffer::sniffer_format
+    enum sniffer_formats
+    {
+        SNIFFER_FORMAT_TEXT = 0,
+        SNIFFER_FORMAT_BINARY,
+        SNIFFER_FORMAT_INVALID
+    };
+    typedef sniffer_formats sniffer_format_t;
+    sniffer_format_t sniffer_format_from_string(const char *str);
+
     // GENERAL
     std::string get_general_devicename() { return _general.devicename; };
     std::string get_general_label();
@@ -94,12 +117,22 @@ public:
     void store_general_fnconfig_spifs(bool fnconfig_spifs);
     bool get_general_status_wait_enabled() { return _general.status_wait_enabled; }
     void store_general_status_wait_enabled(bool status_wait_enabled);
+    int get_general_cache_size() { return _general.cache_size_mb; }
+    void store_general_cache_size(int cache_size_mb);
+    bool get_general_disk_write_back() { return _general.disk_write_back; }
+    void store_general_disk_write_back(bool disk_write_back);
+    bool get_general_disk_overlay() { return _general.disk_overlay; }
+    void store_general_disk_overlay(bool disk_overlay);
+    std::string get_general_voice_output() { return _general.voice_output; }
+    void store_general_voice_output(const char *voice_output);
     std::string get_general_interface_url() { return _general.interface_url; };
     void store_general_interface_url(const char *url);
     std::string get_general_config_path() { return _general.config_file_path; };
     void store_general_config_path(const char *file_path);
     std::string get_general_SD_path() { return _general.SD_dir_path; };
     void store_general_SD_path(const char *dir_path);
+    std::string get_general_cache_path() { return _general.cache_dir_path; };
+    void store_general_cache_path(const char *dir_path);
 
     const char * get_network_sntpserver() { return _network.sntpserver; };
 
@@ -165,6 +198,8 @@ public:
     bool get_modem_enabled() { return _modem.modem_enabled; };
     void store_modem_sniffer_enabled(bool modem_sniffer_enabled);
     bool get_modem_sniffer_enabled() { return _modem.sniffer_enabled; };
+    void store_modem_sniffer_format(sniffer_format_t format);
+    sniffer_format_t get_modem_sniffer_format() { return _modem.sniffer_format; };
 
     // CASSETTE
     bool get_cassette_buttons();
@@ -206,32 +241,39 @@ public:
     void store_netsio_port(int port);
 
     void load();
+    // Rewrite sections with changed settings and schedule write of the file, it is written
+    // in background when there are no more changes for CONFIG_SAVE_DELAY_MS
     void save();
+    // Write scheduled changes now and wait until they are on disk
+    void flush();
 
-    void mark_dirty() { _dirty = true; };
+    // Write all sections on next save()
+    void mark_dirty();
 
     fnConfig();
+    ~fnConfig();
 
 private:
-    bool _dirty = false;
-
-    int _read_line(std::stringstream &ss, std::string &line, char abort_if_starts_with = '\0');
-
-    void _read_section_general(std::stringstream &ss);
-    void _read_section_serial(std::stringstream &ss);
-    void _read_section_wifi(std::stringstream &ss);
-    void _read_section_bt(std::stringstream &ss);
-    void _read_section_network(std::stringstream &ss);
-    void _read_section_host(std::stringstream &ss, int index);
-    void _read_section_mount(std::stringstream &ss, int index);
-    void _read_section_printer(std::stringstream &ss, int index);
-    void _read_section_tape(std::stringstream &ss, int index);    
-    void _read_section_modem(std::stringstream &ss);
-    void _read_section_cassette(std::stringstream &ss);
-    void _read_section_phonebook(std::stringstream &ss, int index);
-    void _read_section_cpm(std::stringstream &ss);
-    void _read_section_device_enable(std::stringstream &ss);
-    void _read_section_netsio(std::stringstream &ss);
+    friend struct fnConfigSchema;
+
+    // background writer
+    std::thread _save_thread;
+    std::mutex _save_mutex;
+    std::condition_variable _save_cv;
+    std::string _save_path;         // scheduled write
+    std::string _save_content;
+    bool _save_pending = false;
+    bool _save_busy = false;
+    bool _save_now = false;
+    bool _save_exit = false;
+    std::chrono::steady_clock::time_point _save_first; // first and last change since last write
+    std::chrono::steady_clock::time_point _save_last;
+    std::string _saved_path;        // what is on disk
+    std::string _saved_content;
+
+    void _queue_save(const std::string &path, std::string &content);
+    void _save_task();
+    static bool _write_file(const std::string &path, const std::string &content);
 
     enum section_match
     {
@@ -252,31 +294,93 @@ private:
         SECTION_NETSIO,
         SECTION_UNKNOWN
     };
-    section_match _find_section_in_line(std::string &line, int &index);
-    bool _split_name_value(std::string &line, std::string &name, std::string &value);
 
-    const char * _host_type_names[HOSTTYPE_INVALID] = {
-        "SD",
-        "TNFS"
+    /*
+     Configuration keys are declared once in the schema (fnConfigSchema in fnConfig.cpp), which
+     says in which section each key is, how its value is written and where it is stored.
+     Settings are kept in the typed structures below, getters read them directly and setters
+     mark only the section they change. save() regenerates changed sections in the text of
+     the file loaded, other sections, comments and unknown keys are kept as they are.
+    */
+    enum key_type
+    {
+        KEY_BOOL,   // bool, "0"/"1" or names[] of false and true
+        KEY_INT,    // int or enum, number within min..max, fallback otherwise
+        KEY_SLOT,   // int, 0-based slot within min..max written 1-based, fallback otherwise
+        KEY_STRING, // std::string
+        KEY_CHARS,  // char array of max bytes
+        KEY_ENUM    // enum, one of names[min..max], fallback otherwise
     };
-    const char * _mount_mode_names[MOUNTMODE_INVALID] = {
-        "r",
-        "w"
+
+    enum key_flags
+    {
+        KEY_FLAG_REQUIRED = 0x01,  // section is written only when this key has valid value
+        KEY_FLAG_OMIT_EMPTY = 0x02 // empty string is not written
     };
 
-    const char * _serial_command_pin_names[SERIAL_COMMAND_INVALID] = {
-        "none",
-        "DSR",
-        "CTS",
-        "RI"
+    struct config_key
+    {
+        section_match section;
+        const char *name;
+        key_type type;
+        void *(*value)(fnConfig &config, int index); // storage of value in section (slot) index
+        int min;
+        int max;
+        int fallback;
+        const char *const *names;
+        uint8_t flags;
     };
 
-    const char * _serial_proceed_pin_names[SERIAL_PROCEED_INVALID] = {
-        "none",
-        "DTR",
-        "RTS"
+    struct config_section
+    {
+        section_match section;
+        const char *name; // [name] or [nameN] for sections with slots
+        int slots;        // 0 for single section
     };
 
+    // Text of a section in the file, text before first section and unknown sections are kept as SECTION_UNKNOWN
+    struct ini_block
+    {
+        section_match section;
+        int index;
+        std::string text; // header and following lines up to next section
+    };
+
+    template <class S, S fnConfig::*Section, class T, T S::*Field>
+    static void *_value_of(fnConfig &config, int)
+    {
+        static_assert(!std::is_enum<T>::value || sizeof(T) == sizeof(int), "enum keys are stored as int");
+        return &(config.*Section.*Field);
+    }
+    template <class S, int N, S (fnConfig::*Slots)[N], class T, T S::*Field>
+    static void *_slot_value_of(fnConfig &config, int index)
+    {
+        static_assert(!std::is_enum<T>::value || sizeof(T) == sizeof(int), "enum keys are stored as int");
+        return &((config.*Slots)[index].*Field);
+    }
+
+    uint32_t _dirty_slots[SECTION_UNKNOWN] = {}; // bit per slot of sections changed since last save()
+    std::vector<ini_block> _blocks;
+    const char *_lineterm = "\r\n"; // line end used in the file loaded
+
+    void _mark_dirty(section_match section, int index = 0) { _dirty_slots[section] |= 1u << index; };
+    bool _is_dirty();
+
+    const config_section *_find_section(const std::string &line, int &index);
+    const config_key *_find_key(section_match section, const std::string &name);
+    void _read_key(const config_key &key, int index, const std::string &value);
+    bool _key_text(const config_key &key, int index, std::string &text);
+    bool _section_in_use(const config_section &section, int index);
+    std::string _section_text(const config_section &section, int index, const std::string *old_text);
+    void _update_block(const config_section &section, int index);
+    bool _split_name_value(std::string &line, std::string &name, std::string &value);
+
+    static const char * const _host_type_names[HOSTTYPE_INVALID];
+    static const char * const _mount_mode_names[MOUNTMODE_INVALID];
+    static const char * const _serial_command_pin_names[SERIAL_COMMAND_INVALID];
+    static const char * const _serial_proceed_pin_names[SERIAL_PROCEED_INVALID];
+    static const char * const _sniffer_format_names[SNIFFER_FORMAT_INVALID];
+
     struct host_info
     {
         host_type_t type = HOSTTYPE_INVALID;
@@ -343,6 +447,10 @@ private:
         int boot_mode = 0;
         bool fnconfig_spifs = true;
         bool status_wait_enabled = true;
+        int cache_size_mb = CONFIG_DEFAULT_CACHE_SIZE_MB;
+        bool disk_write_back = CONFIG_DEFAULT_DISK_WRITE_BACK;
+        bool disk_overlay = CONFIG_DEFAULT_DISK_OVERLAY;
+        std::string voice_output; // SAM voice device output, "wav:<file>" or "pipe:<command>", empty to disable
     #ifdef BUILD_ADAM
         bool printer_enabled = false; // Not by default.
     #else
@@ -351,6 +459,7 @@ private:
         std::string interface_url = WEB_SERVER_LISTEN_URL; // default URL to serve web interface
         std::string config_file_path = CONFIG_FILENAME; // default path to load/save config file (program CWD)
         std::string SD_dir_path = SD_CARD_DIR; // default path to load/save config file
+        std::string cache_dir_path; // directory of caches shared by instances, SD if empty
     };
 
     struct serial_info
@@ -371,6 +480,7 @@ private:
     {
         bool modem_enabled = true;
         bool sniffer_enabled = false;
+        sniffer_format_t sniffer_format = SNIFFER_FORMAT_TEXT;
     };
 
     struct cassette_info
@@ -422,6 +532,6 @@ private:
     phbook_info _phonebook_slots[MAX_PB_SLOTS];
 };
 
-extern fnConfig Config;
+extern thread_local fnConfig Config;
 
 #endif //_FN_CONFIG_H
@@ -993,9 +993,6 @@ bool lynxNetwork::parseURL()
     string url;
     string unit = deviceSpec.substr(0, deviceSpec.find_first_of(":") + 1);
 
-    if (urlParser != nullptr)
-        delete urlParser;
-
     // Prepend prefix, if set.
     if (prefix.length() > 0)
         deviceSpec = unit + prefix + deviceSpec.substr(deviceSpec.find(":") + 1);
@@ -1024,7 +1021,11 @@ bool lynxNetwork::parseURL()
 
     // chop off front of device name for URL, and parse it.
     url = deviceSpec.substr(deviceSpec.find(":") + 1);
-    urlParser = EdUrlParser::parseUrl(url);
+    // reuse parser of previous open, its strings keep their buffers
+    if (urlParser == nullptr)
+        urlParser = EdUrlParser::parseUrl(url);
+    else
+        urlParser->reparseUrl(url);
 
     Debug_printf("lynxNetwork::parseURL transformed to (%s, %s)\n", deviceSpec.c_str(), url.c_str());
 
@@ -11,15 +11,16 @@
 # include "sio/printer.h"
 # include "sio/printerlist.h"
 # include "sio/siocpm.h"
-// # include "sio/voice.h"
+# include "sio/voice.h"
 # include "sio/fuji.h"
 
-    sioApeTime apeTime;
-    // sioVoice sioV;
+    // one set of devices per instance thread (-n option)
+    thread_local sioApeTime apeTime;
+    thread_local sioVoice sioV;
     // sioUDPStream udpDev;
     // sioCassette sioC; // now part of sioFuji theFuji object
-    sioModem *sioR;
-    // sioCPM sioZ;
+    thread_local sioModem *sioR;
+    thread_local sioCPM sioZ;
 #endif
 
 #ifdef BUILD_RS232
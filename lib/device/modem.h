@@ -3,7 +3,7 @@
 
 #ifdef BUILD_ATARI
 # include "sio/modem.h"
-  extern sioModem *sioR;
+  extern thread_local sioModem *sioR;
 #endif
 
 #ifdef BUILD_RS232
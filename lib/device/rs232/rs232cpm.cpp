@@ -11,6 +11,9 @@
 #include "fnFS.h"
 #include "fnFsSD.h"
 
+// Fuji device for host/device slot BDOS calls, see abstraction_fujinet.h
+static rs232Fuji *cpmFuji = &theFuji;
+
 #include "../runcpm/globals.h"
 #include "../runcpm/abstraction_fujinet.h"
 #include "../runcpm/ram.h"     // ram.h - Implements the RAM
@@ -3,6 +3,7 @@
 #include "cassette.h"
 
 #include <cstring>
+#include <algorithm>
 
 #include "../../include/debug.h"
 
@@ -55,7 +56,7 @@ static void gpio_isr_handler(void *arg)
     }
 }
 
-softUART casUART;
+thread_local softUART casUART;
 
 uint8_t softUART::available()
 {
@@ -196,12 +197,14 @@ void sioCassette::mount_cassette_file(FILE *f, size_t fz)
 #endif
 
     tape_offset = 0;
+    tape_record_index = 0;
     if (cassetteMode == cassette_mode_t::playback)
     {
         Debug_printf("Cassette image filesize = %u\n", (unsigned)fz);
         _file = f;
         filesize = fz;
-        check_for_FUJI_file();
+        if (!load_tape())
+            return;
     }
     else
     {
@@ -222,7 +225,12 @@ void sioCassette::sio_enable_cassette()
     cassetteActive = true;
 
     if (cassetteMode == cassette_mode_t::playback)
+    {
         fnSioCom.set_baudrate(CASSETTE_BAUD);
+        current_baud = CASSETTE_BAUD;
+        // tape starts moving, wait for the gap of pending record
+        schedule_next_record(std::chrono::steady_clock::now());
+    }
 
     if (cassetteMode == cassette_mode_t::record && tape_offset == 0)
     {
@@ -290,13 +298,8 @@ void sioCassette::sio_handle_cassette()
 {
     if (cassetteMode == cassette_mode_t::playback)
     {
-        if (tape_flags.FUJI)
-            tape_offset = send_FUJI_tape_block(tape_offset);
-        else
-            tape_offset = send_tape_block(tape_offset);
-
-        // if after trying to send data, still at the start, then turn off tape
-        if (tape_offset == 0 || !cassetteActive)
+        // at the end of tape, turn off tape
+        if (!play_tape() || !cassetteActive)
         {
             sio_disable_cassette();
         }
@@ -311,6 +314,7 @@ void sioCassette::rewind()
 {
     // Is this all that's needed? -tschak
     tape_offset = 0;
+    tape_record_index = 0;
 }
 
 void sioCassette::set_buttons(bool play_record)
@@ -331,6 +335,11 @@ void sioCassette::set_pulldown(bool resistor)
             pulldown = resistor;
 }
 
+void sioCassette::set_accelerated(bool fast)
+{
+    accelerated = fast;
+}
+
 void sioCassette::Clear_atari_sector_buffer(uint16_t len)
 {
     //Maze atari_sector_buffer
@@ -343,74 +352,39 @@ void sioCassette::Clear_atari_sector_buffer(uint16_t len)
     } while (len);
 }
 
-size_t sioCassette::send_tape_block(size_t offset)
+// Read whole tape image into memory and split it into records
+bool sioCassette::load_tape()
 {
-    unsigned char *p = atari_sector_buffer + BLOCK_LEN - 1;
-    unsigned char i, r;
-
-    // if (offset < FileInfo.vDisk->size) {	//data record
-    if (offset < filesize)
-    { //data record
-#ifdef DEBUG
-        //print_str(35,132,2,Yellow,window_bg, (char*) atari_sector_buffer);
-        //sprintf_P((char*)atari_sector_buffer,PSTR("Block %u / %u "),offset/BLOCK_LEN+1,(FileInfo.vDisk->size-1)/BLOCK_LEN+1);
-        Debug_printf("Block %u of %u \r\n", (unsigned)(offset / BLOCK_LEN + 1), (unsigned)(filesize / BLOCK_LEN + 1));
-#endif
-        //read block
-        //r = faccess_offset(FILE_ACCESS_READ, offset, BLOCK_LEN);
-        fseek(_file, offset, SEEK_SET);
-        r = fread(atari_sector_buffer, 1, BLOCK_LEN, _file);
+    tape_data.clear();
+    tape_records.clear();
+    tape_record_index = 0;
 
-        //shift buffer 3 bytes right
-        for (i = 0; i < BLOCK_LEN; i++)
-        {
-            *(p + 3) = *p;
-            p--;
-        }
-        if (r < BLOCK_LEN)
-        {                                  //no full record?
-            atari_sector_buffer[2] = 0xfa; //mark partial record
-            atari_sector_buffer[130] = r;  //set size in last byte
-        }
-        else
-            atari_sector_buffer[2] = 0xfc; //mark full record
-
-        offset += r;
+    tape_data.resize(filesize);
+    fseek(_file, 0, SEEK_SET);
+    if (filesize > 0 && fread(tape_data.data(), 1, filesize, _file) != filesize)
+    {
+        Debug_println("Failed to read CAS file");
+        tape_data.clear();
+        return false;
     }
+
+    check_for_FUJI_file();
+    if (tape_flags.FUJI)
+        parse_FUJI_tape();
     else
-    { //this is the last/end record
-#ifdef DEBUG
-        //print_str_P(35, 132, 2, Yellow, window_bg, PSTR("End  "));
-        Debug_println("CASSETTE END");
-#endif
-        Clear_atari_sector_buffer(BLOCK_LEN + 3);
-        atari_sector_buffer[2] = 0xfe; //mark end record
-        offset = 0;
-    }
-    atari_sector_buffer[0] = 0x55; //sync marker
-    atari_sector_buffer[1] = 0x55;
-    // USART_Send_Buffer(atari_sector_buffer, BLOCK_LEN + 3);
-    fnSioCom.write(atari_sector_buffer, BLOCK_LEN + 3);
-    //USART_Transmit_Byte(get_checksum(atari_sector_buffer, BLOCK_LEN + 3));
-    fnSioCom.write(sio_checksum(atari_sector_buffer, BLOCK_LEN + 3));
-    fnSioCom.flush(); // wait for all data to be sent just like a tape
-    // _delay_ms(300); //PRG(0-N) + PRWT(0.25s) delay
-    fnSystem.delay(300);
-    return (offset);
+        parse_raw_tape();
+
+    Debug_printf("Cassette tape has %u records\n", (unsigned)tape_records.size());
+    return true;
 }
 
 void sioCassette::check_for_FUJI_file()
 {
-    struct tape_FUJI_hdr *hdr = (struct tape_FUJI_hdr *)atari_sector_buffer;
-    uint8_t *p = hdr->chunk_type;
-
-    // faccess_offset(FILE_ACCESS_READ, 0, sizeof(struct tape_FUJI_hdr));
-    fseek(_file, 0, SEEK_SET);
-    fread(atari_sector_buffer, 1, sizeof(struct tape_FUJI_hdr), _file);
-    if (p[0] == 'F' && //search for FUJI header
-        p[1] == 'U' &&
-        p[2] == 'J' &&
-        p[3] == 'I')
+    if (tape_data.size() >= sizeof(struct tape_FUJI_hdr) &&
+        tape_data[0] == 'F' && //search for FUJI header
+        tape_data[1] == 'U' &&
+        tape_data[2] == 'J' &&
+        tape_data[3] == 'I')
     {
         tape_flags.FUJI = 1;
             Debug_println("FUJI File Found");
@@ -432,130 +406,167 @@ void sioCassette::check_for_FUJI_file()
     return;
 }
 
-size_t sioCassette::send_FUJI_tape_block(size_t offset)
+// Collect "data" chunks of FUJI file, handling baud changes along the way
+void sioCassette::parse_FUJI_tape()
 {
-    size_t r;
-    uint16_t gap, len;
-    uint16_t buflen = 256;
-    unsigned char first = 1;
-    struct tape_FUJI_hdr *hdr = (struct tape_FUJI_hdr *)atari_sector_buffer;
-    uint8_t *p = hdr->chunk_type;
-
-    size_t starting_offset = offset;
+    size_t offset = 0;
+    uint16_t record_baud = baud;
 
-    while (offset < filesize) // FileInfo.vDisk->size)
+    while (offset + sizeof(struct tape_FUJI_hdr) <= tape_data.size())
     {
-        // looking for a data header while handling baud changes along the way
-#ifdef DEBUG
-        Debug_printf("Offset: %u\r\n", (unsigned)offset);
-#endif
-        fseek(_file, offset, SEEK_SET);
-        fread(atari_sector_buffer, 1, sizeof(struct tape_FUJI_hdr), _file);
-        len = hdr->chunk_length;
+        struct tape_FUJI_hdr *hdr = (struct tape_FUJI_hdr *)(tape_data.data() + offset);
+        uint8_t *p = hdr->chunk_type;
+        uint16_t len = hdr->chunk_length;
+        size_t data_offset = offset + sizeof(struct tape_FUJI_hdr);
+
+        if (data_offset + len > tape_data.size())
+        {
+            Debug_printf("Truncated chunk at offset %u\n", (unsigned)offset);
+            len = tape_data.size() - data_offset;
+        }
 
         if (p[0] == 'd' && //is a data header?
             p[1] == 'a' &&
             p[2] == 't' &&
             p[3] == 'a')
         {
-            block++;
-            break;
+            tape_record rec;
+            rec.baud = record_baud;
+            rec.gap = hdr->irg_length;
+            rec.offset = data_offset;
+            rec.length = len;
+            tape_records.push_back(rec);
         }
         else if (p[0] == 'b' && //is a baud header?
                  p[1] == 'a' &&
                  p[2] == 'u' &&
                  p[3] == 'd')
         {
-            if (tape_flags.turbo) //ignore baud hdr
-                continue;
-            baud = hdr->irg_length;
-            fnSioCom.set_baudrate(baud);
+            if (!tape_flags.turbo && hdr->irg_length > 0) //ignore baud hdr
+                record_baud = hdr->irg_length;
         }
-        offset += sizeof(struct tape_FUJI_hdr) + len;
+        offset = data_offset + len;
     }
+}
 
-    // TO DO : check that "data" record was actually found - not done by SDrive until after IRG by checking offset<filesize
+// Raw file (no FUJI header): wrap every 128 bytes into standard tape record, finish with end record
+void sioCassette::parse_raw_tape()
+{
+    std::vector<uint8_t> records;
+    size_t offset = 0;
 
-    gap = hdr->irg_length; //save GAP
-    len = hdr->chunk_length;
-#ifdef DEBUG
-    Debug_printf("Baud: %u Length: %u Gap: %u ", baud, len, gap);
-#endif
+    for (;;)
+    {
+        size_t r = 0;
+        Clear_atari_sector_buffer(BLOCK_LEN + 3);
+        if (offset < filesize)
+        { //data record
+            r = std::min((size_t)BLOCK_LEN, filesize - offset);
+            memcpy(atari_sector_buffer + 3, tape_data.data() + offset, r);
+            if (r < BLOCK_LEN)
+            {                                  //no full record?
+                atari_sector_buffer[2] = 0xfa; //mark partial record
+                atari_sector_buffer[130] = r;  //set size in last byte
+            }
+            else
+                atari_sector_buffer[2] = 0xfc; //mark full record
+        }
+        else
+            atari_sector_buffer[2] = 0xfe; //mark end record
 
-    // TO DO : turn on LED
-    // fnLedManager.set(eLed::LED_BUS, true);
-    while (gap--)
+        atari_sector_buffer[0] = 0x55; //sync marker
+        atari_sector_buffer[1] = 0x55;
+        atari_sector_buffer[BLOCK_LEN + 3] = sio_checksum(atari_sector_buffer, BLOCK_LEN + 3);
+
+        tape_record rec;
+        rec.baud = baud;
+        rec.gap = tape_records.empty() ? 0 : CASSETTE_RAW_GAP_MS;
+        rec.offset = records.size();
+        rec.length = BLOCK_LEN + 4;
+        tape_records.push_back(rec);
+        records.insert(records.end(), atari_sector_buffer, atari_sector_buffer + BLOCK_LEN + 4);
+
+        if (r == 0)
+            break;
+        offset += r;
+    }
+
+    // records are sent from tape_data
+    tape_data.swap(records);
+}
+
+uint16_t sioCassette::record_gap(const tape_record &rec)
+{
+    if (!accelerated)
+        return rec.gap;
+
+    // long leader gives the OS time to start reading a new file, keep part of it
+    uint16_t min_gap = rec.gap > CASSETTE_ACCELERATED_LEADER_MS ? CASSETTE_ACCELERATED_LEADER_MS : CASSETTE_ACCELERATED_IRG_MS;
+    return rec.gap < min_gap ? rec.gap : min_gap;
+}
+
+// Set time of pending record: gap after given time point (end of previous record)
+void sioCassette::schedule_next_record(std::chrono::steady_clock::time_point after)
+{
+    next_record_time = after;
+    if (tape_record_index < tape_records.size())
+        next_record_time += std::chrono::milliseconds(record_gap(tape_records[tape_record_index]));
+}
+
+// Send pending record if its time has come, otherwise wait a while but don't block bus for the whole gap
+// Returns false at the end of tape
+bool sioCassette::play_tape()
+{
+    if (tape_record_index >= tape_records.size())
     {
-        fnSystem.delay_microseconds(999); // shave off a usec for the MOTOR pin check
-        if (has_pulldown() && !motor_line() && gap > 1000)
+        Debug_println("CASSETTE END");
+        tape_record_index = 0;
+        return false;
+    }
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (now < next_record_time)
+    {
+        uint64_t wait = std::chrono::duration_cast<std::chrono::microseconds>(next_record_time - now).count();
+        // Atari turned MOTOR off during a long gap: hold the tape, the whole gap
+        // is played again once the motor runs (multi-stage loaders, pause/resume)
+        if (has_pulldown() && !motor_line() && wait > 1000000)
         {
-            // fnLedManager.set(eLed::LED_BUS, false);
-            return starting_offset;
+            schedule_next_record(now);
+            fnSystem.delay_microseconds(CASSETTE_POLL_US);
+            return true;
         }
+        fnSystem.delay_microseconds(wait > CASSETTE_POLL_US ? CASSETTE_POLL_US : wait);
+        return true;
     }
-    // fnLedManager.set(eLed::LED_BUS, false);
 
-#ifdef DEBUG
-    // wait until after delay for new line so can see it in timestamp
-    Debug_printf("\r\n");
-#endif
+    // keep schedule exact, unless we are late too much (e.g. bus was busy)
+    std::chrono::steady_clock::time_point start = next_record_time;
+    if (now - next_record_time > std::chrono::milliseconds(CASSETTE_MAX_LATE_MS))
+        start = now;
 
-    if (offset < filesize)
+    const tape_record &rec = tape_records[tape_record_index++];
+    if (rec.baud != current_baud)
     {
-        // data record
-#ifdef DEBUG
-        Debug_printf("Block %u\r\n", block);
-#endif
-        // read block in 256 byte (or fewer) chunks
-        offset += sizeof(struct tape_FUJI_hdr); //skip chunk hdr
-        while (len)
-        {
-            if (len > 256)
-            {
-                buflen = 256;
-                len -= 256;
-            }
-            else
-            {
-                buflen = len;
-                len = 0;
-            }
+        fnSioCom.set_baudrate(rec.baud);
+        current_baud = rec.baud;
+    }
 
-            fseek(_file, offset, SEEK_SET);
-            r = fread(atari_sector_buffer, 1, buflen, _file);
-            offset += r;
+    const uint8_t *data = tape_data.data() + rec.offset;
+    if (rec.length >= 3 && data[2] == 0xfe)
+        block = 0; // resets block counter for next section
+    else
+        block++;
 
 #ifdef DEBUG
-            Debug_printf("Sending %u bytes\r\n", buflen);
-            for (int i = 0; i < buflen; i++)
-                Debug_printf("%02x ", atari_sector_buffer[i]);
-#endif
-            fnSioCom.write(atari_sector_buffer, buflen);
-            fnSioCom.flush(); // wait for all data to be sent just like a tape
-#ifdef DEBUG
-            Debug_printf("\r\n");
+    Debug_printf("Block %u, Baud: %u Length: %u Gap: %u\n", block, rec.baud, rec.length, record_gap(rec));
 #endif
+    fnSioCom.write(data, rec.length);
+    fnSioCom.flush(); // wait for all data to be sent just like a tape
 
-            if (first && atari_sector_buffer[2] == 0xfe)
-            {
-                // resets block counter for next section
-                block = 0;
-            }
-            first = 0;
-        }
-        /*         if (block == 0)
-        {
-            // TO DO : why does Sdrive do this?
-            //_delay_ms(200); //add an end gap to be sure
-            fnSystem.delay(200);
-        } */
-    }
-    else
-    {
-        //block = 0;
-        offset = 0;
-    }
-    return (offset);
+    // next record follows after this one is transmitted (10 bits per byte) and after its gap
+    schedule_next_record(start + std::chrono::microseconds((uint64_t)rec.length * 10 * 1000000 / rec.baud));
+    return true;
 }
 
 size_t sioCassette::receive_FUJI_tape_block(size_t offset)
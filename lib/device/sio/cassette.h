@@ -1,6 +1,9 @@
 #ifndef CASSETTE_H
 #define CASSETTE_H
 
+#include <chrono>
+#include <vector>
+
 #include "../../include/pinmap.h"
 
 #include "bus.h"
@@ -12,6 +15,13 @@
 #define STARTBIT 0
 #define STOPBIT 9
 
+// Playback timing
+#define CASSETTE_RAW_GAP_MS 300              // PRG(0-N) + PRWT(0.25s) between records of raw (non-FUJI) file
+#define CASSETTE_ACCELERATED_IRG_MS 50       // shortest gap between records OS still handles
+#define CASSETTE_ACCELERATED_LEADER_MS 1000  // shortest leader before first record of a file
+#define CASSETTE_POLL_US 5000                // longest wait in one sio_handle_cassette() call
+#define CASSETTE_MAX_LATE_MS 100             // reschedule from now if playback is late more than this
+
 enum class cassette_mode_t
 {
     playback = 0,
@@ -107,6 +117,8 @@ public:
     bool get_buttons();
     void set_buttons(bool play_record);
     void set_pulldown(bool resistor);
+    bool is_accelerated() { return accelerated; };
+    void set_accelerated(bool fast);
 
 private:
     // stuff from SDrive Arduino sketch
@@ -132,9 +144,32 @@ private:
     unsigned short block;
     unsigned short baud;
 
-    size_t send_tape_block(size_t offset);
+    // Playback engine
+    // Whole tape is loaded on mount and split into records, records are then sent
+    // at times given by inter-record gaps, measured on monotonic clock
+    struct tape_record
+    {
+        uint16_t baud;
+        uint16_t gap;    // gap before the record, ms
+        size_t offset;   // record data in tape_data
+        uint16_t length;
+    };
+
+    std::vector<uint8_t> tape_data;
+    std::vector<tape_record> tape_records;
+    size_t tape_record_index = 0;
+    std::chrono::steady_clock::time_point next_record_time;
+    unsigned short current_baud = CASSETTE_BAUD;
+    bool accelerated = false; // shrink gaps to minimum
+
+    bool load_tape();
     void check_for_FUJI_file();
-    size_t send_FUJI_tape_block(size_t offset);
+    void parse_FUJI_tape();
+    void parse_raw_tape();
+    uint16_t record_gap(const tape_record &rec);
+    void schedule_next_record(std::chrono::steady_clock::time_point after);
+    bool play_tape();
+
     size_t receive_FUJI_tape_block(size_t offset);
 };
 
@@ -29,7 +29,7 @@
 #define SIO_DISKCMD_PERCOM_WRITE 0x4F
 
 // External ref to fuji object.
-extern sioFuji theFuji;
+extern thread_local sioFuji theFuji;
 
 sioDisk::sioDisk()
 {
@@ -121,18 +121,22 @@ void sioDisk::sio_status()
 #define DRIVE_DEFAULT_TIMEOUT_810 0xE0
 #define DRIVE_DEFAULT_TIMEOUT_XF551 0xFE
 
-    uint8_t _status[4];
-    _status[0] = 0x00;
-    _status[1] = ~DISK_CTRL_STATUS_CLEAR; // Negation of default clear status
-    _status[2] = DRIVE_DEFAULT_TIMEOUT_810;
-    _status[3] = 0x00;
-
-    if (_disk != nullptr)
-        _disk->status(_status);
+    // Repeated polls get the same frame, unless held sectors have to be written out first
+    if (!_status_valid || (_disk != nullptr && _disk->held()))
+    {
+        _status_frame[0] = 0x00;
+        _status_frame[1] = ~DISK_CTRL_STATUS_CLEAR; // Negation of default clear status
+        _status_frame[2] = DRIVE_DEFAULT_TIMEOUT_810;
+        _status_frame[3] = 0x00;
+
+        if (_disk != nullptr)
+            _disk->status(_status_frame);
+        _status_valid = true;
+    }
 
-    Debug_printf("response: 0x%02x, 0x%02x, 0x%02x\n", _status[0], _status[1], _status[2]);
+    Debug_printf("response: 0x%02x, 0x%02x, 0x%02x\n", _status_frame[0], _status_frame[1], _status_frame[2]);
 
-    bus_to_computer(_status, sizeof(_status), false);
+    bus_to_computer(_status_frame, sizeof(_status_frame), false);
 }
 
 // Disk format
@@ -201,6 +205,8 @@ mediatype_t sioDisk::mount(FileHandler *f, const char *filename, uint32_t disksi
     //  DiskType::discover_disktype(filename) can detect CAS and WAV files
     Debug_printf("disk MOUNT (%d)\n", disk_type);
 
+    _status_valid = false;
+
     // Destroy any existing MediaType
     if (_disk != nullptr)
     {
@@ -240,6 +246,7 @@ mediatype_t sioDisk::mount(FileHandler *f, const char *filename, uint32_t disksi
     default:
         device_active = true;
         _disk = new MediaTypeATR();
+        _disk->_disk_readonly = readonly;
         if (host != nullptr)
         {
             _disk->_disk_host = host;
@@ -261,6 +268,8 @@ void sioDisk::unmount()
 {
     Debug_print("disk UNMOUNT\n");
 
+    _status_valid = false;
+
     if (_disk != nullptr) 
     {
         _disk->unmount();
@@ -270,6 +279,27 @@ void sioDisk::unmount()
     }
 }
 
+// Let mounted media write out held back sectors
+void sioDisk::sio_idle()
+{
+    if (_disk != nullptr)
+        _disk->idle();
+}
+
+// Returns TRUE if an error condition occurred
+bool sioDisk::overlay_merge()
+{
+    if (_disk == nullptr)
+        return true;
+    return _disk->overlay_merge();
+}
+
+void sioDisk::overlay_discard()
+{
+    if (_disk != nullptr)
+        _disk->overlay_discard();
+}
+
 // Create blank disk
 bool sioDisk::write_blank(FileHandler *f, uint16_t sectorSize, uint16_t numSectors)
 {
@@ -291,6 +321,13 @@ void sioDisk::sio_process(uint32_t commanddata, uint8_t checksum)
         (cmdFrame.comnd != SIO_DISKCMD_STATUS && cmdFrame.comnd != SIO_DISKCMD_HSIO_INDEX))
         return;
 
+    // Image file may be on the host which is creating new disk
+    theFuji.wait_new_disk();
+
+    // Any other command may change what STATUS reports
+    if (cmdFrame.comnd != SIO_DISKCMD_STATUS && cmdFrame.comnd != SIO_DISKCMD_HSIO_STATUS)
+        _status_valid = false;
+
     Debug_print("disk sio_process()\n");
 
     switch (cmdFrame.comnd)
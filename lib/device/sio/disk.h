@@ -10,11 +10,16 @@ class sioDisk : public virtualDevice
 private:
     MediaType *_disk = nullptr;
 
+    // STATUS frame, kept until the next command or media change
+    uint8_t _status_frame[4];
+    bool _status_valid = false;
+
     void sio_read();
     void sio_write(bool verify);
     void sio_format();
     void sio_status() override;
     void sio_process(uint32_t commanddata, uint8_t checksum) override;
+    void sio_idle() override;
 
     void derive_percom_block(uint16_t numSectors);
     void sio_read_percom_block();
@@ -24,10 +29,17 @@ private:
 public:
     sioDisk();
     fujiHost *host;
+    bool readonly = true;
     mediatype_t mount(FileHandler *f, const char *filename, uint32_t disksize, mediatype_t disk_type = MEDIATYPE_UNKNOWN);
     void unmount();
     bool write_blank(FileHandler *f, uint16_t sectorSize, uint16_t numSectors);
 
+    // Copy-on-write overlay of read-only remote image, see DiskOverlay
+    bool overlay_merge();
+    void overlay_discard();
+    uint32_t overlay_sectors() { return _disk == nullptr ? 0 : _disk->overlay_sectors(); };
+    FileHandler *fileh() { return _disk == nullptr ? nullptr : _disk->fileh(); };
+
     mediatype_t disktype() { return _disk == nullptr ? MEDIATYPE_UNKNOWN : _disk->_disktype; };
 
     ~sioDisk();
@@ -7,12 +7,14 @@
 #include <cstdint>
 #include <cstring>
 #include <errno.h>
+#include <algorithm>
 #include <libgen.h>
 #include "compat_string.h"
 
 #include "../../../include/debug.h"
 
 #include "fnSystem.h"
+#include "fujiHostMounter.h"
 #include "fnConfig.h"
 #include "fnFsSPIFFS.h"
 #include "fnDummyWiFi.h"
@@ -20,10 +22,10 @@
 #include "led.h"
 #include "utils.h"
 
-sioFuji theFuji; // global fuji device object
+thread_local sioFuji theFuji; // global fuji device object, one per instance thread
 
 //sioDisk sioDiskDevs[MAX_HOSTS];
-sioNetwork sioNetDevs[MAX_NETWORK_DEVICES];
+thread_local sioNetwork sioNetDevs[MAX_NETWORK_DEVICES];
 
 bool _validate_host_slot(uint8_t slot, const char *dmsg = nullptr);
 bool _validate_device_slot(uint8_t slot, const char *dmsg = nullptr);
@@ -127,6 +129,16 @@ void sioFuji::sio_status()
     return;
 }
 
+// Result of NEW DISK which continues in background, see new_disk_status
+void sioFuji::sio_new_disk_status()
+{
+    Debug_println("Fuji cmd: NEW DISK STATUS");
+
+    uint8_t status = _new_disk.status();
+
+    bus_to_computer(&status, sizeof(status), false);
+}
+
 // Reset FujiNet
 void sioFuji::sio_reset_fujinet()
 {
@@ -312,6 +324,7 @@ int sioFuji::sio_disk_image_mount(bool siomode, int slot)
                  disk.filename, disk.host_slot, flag, deviceSlot + 1);
 
     disk.disk_dev.host = &_fnHosts[disk.host_slot];
+    disk.disk_dev.readonly = options != DISK_ACCESS_MODE_WRITE;
 
     disk.fileh = host.filehandler_open(disk.filename, disk.filename, sizeof(disk.filename), flag);
 
@@ -352,18 +365,10 @@ void sioFuji::sio_copy_file()
     // FILE *destFile;
     FileHandler *sourceFile;
     FileHandler *destFile;
-    char *dataBuf;
+    uint8_t dataBuf[COPY_BUFFER_SIZE];
     unsigned char sourceSlot;
     unsigned char destSlot;
 
-    dataBuf = (char *)malloc(532);
-
-    if (dataBuf == nullptr)
-    {
-        sio_error();
-        return;
-    }
-
     memset(&csBuf, 0, sizeof(csBuf));
 
     ck = bus_to_peripheral(csBuf, sizeof(csBuf));
@@ -431,6 +436,7 @@ void sioFuji::sio_copy_file()
 
     if (destFile == nullptr)
     {
+        sourceFile->close();
         sio_error();
         return;
     }
@@ -438,7 +444,7 @@ void sioFuji::sio_copy_file()
     size_t count = 0;
     do
     {
-        count = sourceFile->read(dataBuf, 1, 532);
+        count = sourceFile->read(dataBuf, 1, sizeof(dataBuf));
         destFile->write(dataBuf, 1, count);
     } while (count > 0);
 
@@ -447,53 +453,46 @@ void sioFuji::sio_copy_file()
     // copyEnd:
     sourceFile->close();
     destFile->close();
-    free(dataBuf);
 }
 
 // Mount all
+// Hosts are connected concurrently, disks are mounted as soon as their own host is ready
 int sioFuji::mount_all(bool siomode)
 {
     bool nodisks = true; // Check at the end if no disks are in a slot and disable config
+    bool failed = false;
+    uint64_t start = fnSystem.millis();
+    fujiHostMounter mounter;
 
     for (int i = 0; i < 8; i++)
     {
-        fujiDisk &disk = _fnDisks[i];
-        fujiHost &host = _fnHosts[disk.host_slot];
-        char flag[4] = {'r', 'b', 0, 0};
-
-        if (disk.access_mode == DISK_ACCESS_MODE_WRITE)
-            flag[2] = '+';
-
-        if (disk.host_slot != 0xFF)
+        if (_fnDisks[i].host_slot != 0xFF)
         {
             nodisks = false; // We have a disk in a slot
 
-            if (host.mount() == false)
-            {
-                return _on_error(siomode);
-            }
-
-            Debug_printf("Selecting '%s' from host #%u as %s on D%u:\n",
-                         disk.filename, disk.host_slot, flag, i + 1);
-
-            disk.fileh = host.filehandler_open(disk.filename, disk.filename, sizeof(disk.filename), flag);
+            if (!_validate_host_slot(_fnDisks[i].host_slot, "mount_all"))
+                failed = true;
+            else
+                mounter.add(&_fnHosts[_fnDisks[i].host_slot]);
+        }
+    }
 
-            if (disk.fileh == nullptr)
-            {
-                return _on_error(siomode);
-            }
+    mounter.mount([this, &failed](fujiHost *host, bool mounted) {
+        for (int i = 0; i < 8; i++)
+        {
+            fujiDisk &disk = _fnDisks[i];
+            if (disk.host_slot != host->slotid)
+                continue;
 
-            // We've gotten this far, so make sure our bootable CONFIG disk is disabled
-            boot_config = false;
-            status_wait_count = 0;
+            if (!mounted || !_mount_all_disk(i, *host))
+                failed = true;
+        }
+    });
 
-            // We need the file size for loading XEX files and for CASSETTE, so get that too
-            disk.disk_size = host.file_size(disk.fileh);
+    Debug_printf("mount_all %s in %llu ms\n", failed ? "failed" : "done", (unsigned long long)(fnSystem.millis() - start));
 
-            // And now mount it
-            disk.disk_type = disk.disk_dev.mount(disk.fileh, disk.filename, disk.disk_size);
-        }
-    }
+    if (failed)
+        return _on_error(siomode);
 
     if (nodisks) {
         // No disks in a slot, disable config
@@ -503,6 +502,38 @@ int sioFuji::mount_all(bool siomode)
     return _on_ok(siomode);
 }
 
+// Open and mount disk image of mount_all from its host, which is already mounted
+bool sioFuji::_mount_all_disk(int slot, fujiHost &host)
+{
+    fujiDisk &disk = _fnDisks[slot];
+    char flag[4] = {'r', 'b', 0, 0};
+
+    if (disk.access_mode == DISK_ACCESS_MODE_WRITE)
+        flag[2] = '+';
+
+    Debug_printf("Selecting '%s' from host #%u as %s on D%u:\n",
+                 disk.filename, disk.host_slot, flag, slot + 1);
+
+    disk.disk_dev.host = &host;
+    disk.disk_dev.readonly = disk.access_mode != DISK_ACCESS_MODE_WRITE;
+
+    disk.fileh = host.filehandler_open(disk.filename, disk.filename, sizeof(disk.filename), flag);
+
+    if (disk.fileh == nullptr)
+        return false;
+
+    // We've gotten this far, so make sure our bootable CONFIG disk is disabled
+    boot_config = false;
+    status_wait_count = 0;
+
+    // We need the file size for loading XEX files and for CASSETTE, so get that too
+    disk.disk_size = host.file_size(disk.fileh);
+
+    // And now mount it
+    disk.disk_type = disk.disk_dev.mount(disk.fileh, disk.filename, disk.disk_size);
+    return true;
+}
+
 // Set boot mode
 void sioFuji::sio_set_boot_mode()
 {
@@ -767,6 +798,36 @@ int sioFuji::sio_disk_image_umount(bool siomode, int slot)
     return _on_ok(siomode);
 }
 
+/*
+ Merge copy-on-write overlay of disk image in device slot aux1 into the image on its host,
+ with DISK_OVERLAY_DISCARD in aux2 the overlay is dropped instead (see DiskOverlay)
+*/
+int sioFuji::sio_disk_overlay(bool siomode, int slot, bool discard)
+{
+    uint8_t deviceSlot = siomode ? cmdFrame.aux1 : slot;
+    if (siomode)
+        discard = cmdFrame.aux2 & DISK_OVERLAY_DISCARD;
+
+    Debug_printf("Fuji cmd: DISK OVERLAY %s 0x%02X\n", discard ? "DISCARD" : "MERGE", deviceSlot);
+
+    if (deviceSlot >= MAX_DISK_DEVICES || _fnDisks[deviceSlot].fileh == nullptr)
+        return _on_error(siomode);
+
+    if (discard)
+        _fnDisks[deviceSlot].disk_dev.overlay_discard();
+    else
+    {
+        bool err = _fnDisks[deviceSlot].disk_dev.overlay_merge();
+        // image was reopened after the merge
+        if (_fnDisks[deviceSlot].disk_dev.fileh() != nullptr)
+            _fnDisks[deviceSlot].fileh = _fnDisks[deviceSlot].disk_dev.fileh();
+        if (err)
+            return _on_error(siomode);
+    }
+
+    return _on_ok(siomode);
+}
+
 // Disk Image Rotate
 /*
   We rotate disks my changing their disk device ID's. That prevents
@@ -1023,6 +1084,82 @@ void sioFuji::sio_close_directory()
     sio_complete();
 }
 
+/*
+ Search index of files inside disk images of the host (see fujiImageIndex) for file named
+ like the pattern, * and ? wildcards can be used. Images found are read by READ FOUND IMAGE.
+ With FIND_IN_IMAGES_REBUILD in aux2, building of the index is started instead.
+ Searching host which is not indexed yet fails and starts indexing it.
+*/
+void sioFuji::sio_find_in_images()
+{
+    Debug_println("Fuji cmd: FIND IN IMAGES");
+
+    char pattern[256];
+    uint8_t hostSlot = cmdFrame.aux1;
+    uint8_t ck = bus_to_peripheral((uint8_t *)&pattern, sizeof(pattern));
+
+    if (sio_checksum((uint8_t *)&pattern, sizeof(pattern)) != ck)
+    {
+        sio_error();
+        return;
+    }
+    if (!_validate_host_slot(hostSlot))
+    {
+        sio_error();
+        return;
+    }
+    pattern[sizeof(pattern) - 1] = '\0';
+
+    const char *hostname = _fnHosts[hostSlot].get_hostname();
+    _found_images.clear();
+
+    if (cmdFrame.aux2 & FIND_IN_IMAGES_REBUILD)
+    {
+        if (fnImageIndex.build(hostname))
+            sio_complete();
+        else
+            sio_error();
+        return;
+    }
+
+    std::vector<fujiImageIndex::result> results;
+    if (!fnImageIndex.find(hostname, pattern, results, MAX_FOUND_IMAGES))
+    {
+        Debug_printf("Host \"%s\" is not indexed\n", hostname);
+        fnImageIndex.build(hostname);
+        sio_error();
+        return;
+    }
+
+    for (const fujiImageIndex::result &r : results)
+    {
+        if (std::find(_found_images.begin(), _found_images.end(), r.image) == _found_images.end())
+            _found_images.push_back(r.image);
+    }
+    sio_complete();
+}
+
+// Path of image number aux2 found by FIND IN IMAGES, 0x7F 0x7F after the last one
+void sioFuji::sio_read_found_image()
+{
+    uint8_t maxlen = cmdFrame.aux1;
+    uint8_t num = cmdFrame.aux2;
+    Debug_printf("Fuji cmd: READ FOUND IMAGE %hu (max=%hu)\n", num, maxlen);
+
+    char entry[256];
+    memset(entry, 0, sizeof(entry));
+
+    if (num >= _found_images.size())
+    {
+        entry[0] = 0x7F;
+        entry[1] = 0x7F;
+    }
+    else
+        util_ellipsize(_found_images[num].c_str(), entry, maxlen);
+
+    bus_to_computer((uint8_t *)entry, maxlen, false);
+}
+
 // Get network adapter configuration
 void sioFuji::sio_get_adapter_config()
 {
@@ -1105,10 +1242,26 @@ void sioFuji::sio_new_disk()
         return;
     }
 
-    bool ok = disk.disk_dev.write_blank(disk.fileh, newDisk.sectorSize, newDisk.numSectors);
-    disk.fileh->close();
+    // Image is created in background, the command completes as soon as it's done or after
+    // NEW_DISK_WAIT_MS, then the result is reported by NEW DISK STATUS
+    sioDisk *disk_dev = &disk.disk_dev;
+    FileHandler *fileh = disk.fileh;
+    uint16_t sectorSize = newDisk.sectorSize;
+    uint16_t numSectors = newDisk.numSectors;
+    _new_disk.start([disk_dev, fileh, sectorSize, numSectors]() {
+        bool ok = disk_dev->write_blank(fileh, sectorSize, numSectors);
+        fileh->close();
+        return ok;
+    });
+
+    if (!_new_disk.wait(NEW_DISK_WAIT_MS))
+    {
+        Debug_print("sio_new_disk continues in background\n");
+        sio_complete();
+        return;
+    }
 
-    if (ok == false)
+    if (_new_disk.status() != NEW_DISK_STATUS_OK)
     {
         Debug_print("sio_new_disk Data write failed\n");
         sio_error();
@@ -1569,6 +1722,10 @@ void sioFuji::sio_process(uint32_t commanddata, uint8_t checksum)
 
     Debug_println("sioFuji::sio_process() called");
 
+    // New disk is being created on the host, only status can be polled meanwhile
+    if (cmdFrame.comnd != FUJICMD_STATUS && cmdFrame.comnd != FUJICMD_NEW_DISK_STATUS)
+        _new_disk.wait();
+
     switch (cmdFrame.comnd)
     {
     case FUJICMD_HSIO_INDEX:
@@ -1723,6 +1880,22 @@ void sioFuji::sio_process(uint32_t commanddata, uint8_t checksum)
         sio_late_ack();
         sio_enable_udpstream();
         break;
+    case FUJICMD_FIND_IN_IMAGES:
+        sio_late_ack();
+        sio_find_in_images();
+        break;
+    case FUJICMD_READ_FOUND_IMAGE:
+        sio_ack();
+        sio_read_found_image();
+        break;
+    case FUJICMD_DISK_OVERLAY:
+        sio_late_ack();
+        sio_disk_overlay();
+        break;
+    case FUJICMD_NEW_DISK_STATUS:
+        sio_ack();
+        sio_new_disk_status();
+        break;
     default:
         sio_nak();
     }
@@ -3,6 +3,8 @@
 
 #include <cstdint>
 #include <cstring>
+#include <string>
+#include <vector>
 
 #include "bus.h"
 #include "network.h"
@@ -10,6 +12,8 @@
 
 #include "fujiHost.h"
 #include "fujiDisk.h"
+#include "fujiDiskCreator.h"
+#include "fujiImageIndex.h"
 #include "fujiCmd.h"
 
 #define MAX_HOSTS 8
@@ -21,6 +25,12 @@
 
 #define MAX_APPKEY_LEN 64
 
+#define COPY_BUFFER_SIZE 4096
+
+#define MAX_FOUND_IMAGES 255             // images kept by FIND IN IMAGES
+#define FIND_IN_IMAGES_REBUILD 0x01      // aux2 flag, build index of the host instead of search
+#define DISK_OVERLAY_DISCARD 0x01        // aux2 flag, discard overlay instead of merging it
+
 #define READ_DEVICE_SLOTS_DISKS1 0x00
 #define READ_DEVICE_SLOTS_TAPE 0x10
 
@@ -74,9 +84,14 @@ private:
 
     int _on_ok(bool siomode);
     int _on_error(bool siomode, int rc=-1);
+    bool _mount_all_disk(int slot, fujiHost &host);
 
     appkey _current_appkey;
 
+    fujiDiskCreator _new_disk;
+
+    std::vector<std::string> _found_images; // by FIND IN IMAGES
+
 protected:
     void sio_reset_fujinet();          // 0xFF
     void sio_net_get_ssid();           // 0xFE
@@ -114,6 +129,10 @@ protected:
     void sio_set_boot_config();        // 0xD9
     void sio_copy_file();              // 0xD8
     void sio_set_boot_mode();          // 0xD6
+    void sio_find_in_images();         // 0xB1
+    void sio_read_found_image();       // 0xB0
+    int sio_disk_overlay(bool siomode=true, int slot=-1, bool discard=false); // 0xB3
+    void sio_new_disk_status();        // 0xB2
 
     void sio_status() override;
     void sio_process(uint32_t commanddata, uint8_t checksum) override;
@@ -129,6 +148,9 @@ public:
     
     sioDisk *bootdisk();
 
+    // Wait for disk image being created by NEW DISK
+    void wait_new_disk() { _new_disk.wait(); };
+
     sioNetwork *network();
 
     // sioCassette *cassette() { return &_cassetteDev; };
@@ -153,6 +175,6 @@ public:
     sioFuji();
 };
 
-extern sioFuji theFuji;
+extern thread_local sioFuji theFuji;
 
 #endif // FUJI_H
\ No newline at end of file
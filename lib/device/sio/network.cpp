@@ -61,6 +61,8 @@ sioNetwork::sioNetwork()
  */
 sioNetwork::~sioNetwork()
 {
+    worker_stop();
+
     receiveBuffer->clear();
     transmitBuffer->clear();
     specialBuffer->clear();
@@ -109,6 +111,10 @@ void sioNetwork::sio_open()
 
     // Reset status buffer
     status.reset();
+    {
+        std::lock_guard<std::mutex> lock(publishedMutex);
+        writeError = 0;
+    }
 
     // Parse and instantiate protocol
     parse_and_instantiate_protocol();
@@ -134,6 +140,9 @@ void sioNetwork::sio_open()
     // Everything good, start the interrupt timer!
     timer_start();
 
+    // and the I/O worker
+    worker_start();
+
     // Go ahead and send an interrupt, so Atari knows to get status.
     sio_assert_interrupt();
 
@@ -156,6 +165,7 @@ void sioNetwork::sio_close()
     sio_ack();
 
     status.reset();
+    publish_status(false);
 
     // If no protocol enabled, we just signal complete, and return.
     if (protocol == nullptr)
@@ -213,6 +223,9 @@ void sioNetwork::sio_read()
     // And send off to the computer
     bus_to_computer((uint8_t *)receiveBuffer->data(), num_bytes, err);
     receiveBuffer->erase(0, num_bytes);
+
+    // bytes waiting changed, wait for next status from worker
+    publish_status(false);
 }
 
 /**
@@ -258,17 +271,10 @@ bool sioNetwork::sio_read_channel(unsigned short num_bytes)
 void sioNetwork::sio_write()
 {
     unsigned short num_bytes = sio_get_aux();
-    uint8_t *newData;
     bool err = false;
 
-    newData = (uint8_t *)malloc(num_bytes);
     Debug_printf("sioNetwork::sio_write( %d bytes)\n", num_bytes);
 
-    if (newData == nullptr)
-    {
-        Debug_printf("Could not allocate %u bytes.\n", num_bytes);
-    }
-
     // If protocol isn't connected, then return not connected.
     if (protocol == nullptr)
     {
@@ -279,10 +285,10 @@ void sioNetwork::sio_write()
 
     sio_late_ack();
 
-    // Get the data from the Atari
-    bus_to_peripheral(newData, num_bytes);
-    *transmitBuffer += string((char *)newData, num_bytes);
-    free(newData);
+    // Get the data from the Atari, straight to the end of transmit buffer
+    size_t tx_len = transmitBuffer->length();
+    transmitBuffer->resize(tx_len + num_bytes);
+    bus_to_peripheral((uint8_t *)&(*transmitBuffer)[tx_len], num_bytes);
 
     // Do the channel write
     err = sio_write_channel(num_bytes);
@@ -308,7 +314,14 @@ bool sioNetwork::sio_write_channel(unsigned short num_bytes)
     switch (channelMode)
     {
     case PROTOCOL:
-        err = protocol->write(num_bytes);
+        if (workerRun)
+        {
+            // leave the data for the I/O worker, errors are reported by next status
+            pendingWriteLen = num_bytes;
+            workerWake.notify_one();
+        }
+        else
+            err = protocol->write(num_bytes);
         break;
     case JSON:
         Debug_printf("JSON Not Handled.\n");
@@ -398,12 +411,20 @@ void sioNetwork::sio_status_channel()
     {
     case PROTOCOL:
         err = protocol->status(&status);
+        // the worker keeps the snapshot up to date from now on
+        publish_status(true, err);
+        statusFromSnapshot = worker.joinable();
         break;
     case JSON:
         sio_status_channel_json(&status);
         break;
     }
 
+    {
+        std::lock_guard<std::mutex> lock(publishedMutex);
+        status.error = take_status_error(status.error);
+    }
+
     // Serialize status into status bytes
     serialized_status[0] = status.rxBytesWaiting & 0xFF;
     serialized_status[1] = status.rxBytesWaiting >> 8;
@@ -417,6 +438,30 @@ void sioNetwork::sio_status_channel()
     bus_to_computer(serialized_status, sizeof(serialized_status), err);
 }
 
+bool sioNetwork::sio_status_snapshot()
+{
+    uint8_t serialized_status[4];
+    bool err;
+
+    if (!statusFromSnapshot)
+        return false;
+
+    {
+        std::lock_guard<std::mutex> lock(publishedMutex);
+        if (!publishedValid)
+            return false;
+        serialized_status[0] = publishedStatus.rxBytesWaiting & 0xFF;
+        serialized_status[1] = publishedStatus.rxBytesWaiting >> 8;
+        serialized_status[2] = publishedStatus.connected;
+        serialized_status[3] = take_status_error(publishedStatus.error);
+        err = publishedError;
+    }
+
+    sio_ack();
+    bus_to_computer(serialized_status, sizeof(serialized_status), err);
+    return true;
+}
+
 /**
  * Get Prefix
  */
@@ -785,6 +830,34 @@ void sioNetwork::sio_process(uint32_t commanddata, uint8_t checksum)
     Debug_printf("sioNetwork::sio_process 0x%02hx '%c': 0x%02hx, 0x%02hx\n",
                  cmdFrame.comnd, cmdFrame.comnd, cmdFrame.aux1, cmdFrame.aux2);
 
+    // Status polls are answered from the worker's snapshot, even while it talks to the server
+    if (cmdFrame.comnd == 'S' && sio_status_snapshot())
+        return;
+
+    // Commands which close or replace the protocol stop its I/O worker first
+    switch (cmdFrame.comnd)
+    {
+    case 'O':
+    case 'C':
+    case 0x20: // RENAME
+    case 0x21: // DELETE
+    case 0x23: // LOCK
+    case 0x24: // UNLOCK
+    case 0x2A: // MKDIR
+    case 0x2B: // RMDIR
+        worker_stop();
+        break;
+    }
+
+    std::lock_guard<std::mutex> lock(protocolMutex);
+
+    // Data from previous Write must reach the protocol before anything else
+    flush_transmit();
+
+    // Read, Write and special commands change the channel, next Status asks protocol again
+    if (cmdFrame.comnd != 'S')
+        statusFromSnapshot = false;
+
     switch (cmdFrame.comnd)
     {
     case 0x3F:
@@ -825,18 +898,116 @@ void sioNetwork::sio_poll_interrupt()
         if (protocol->interruptEnable == false)
             return;
 
-        protocol->fromInterrupt = true;
-        protocol->status(&status);
-        protocol->fromInterrupt = false;
+        // Status is polled by the I/O worker, use its latest snapshot
+        NetworkStatus ns;
+        {
+            std::lock_guard<std::mutex> lock(publishedMutex);
+            if (!publishedValid)
+                return;
+            ns = publishedStatus;
+        }
 
-        if (status.rxBytesWaiting > 0 || status.connected == 0)
+        if (ns.rxBytesWaiting > 0 || ns.connected == 0)
             sio_assert_interrupt();
         else
             sio_clear_interrupt();
 
-        reservedSave = status.connected;
-        errorSave = status.error;
+        reservedSave = ns.connected;
+        errorSave = ns.error;
+    }
+}
+
+/** I/O WORKER *****************************************************************/
+
+void sioNetwork::worker_start()
+{
+    if (worker.joinable())
+        return;
+
+    workerRun = true;
+    worker = std::thread(&sioNetwork::worker_loop, this);
+}
+
+void sioNetwork::worker_stop()
+{
+    if (!worker.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(protocolMutex);
+        workerRun = false;
     }
+    workerWake.notify_one();
+    worker.join();
+
+    publish_status(false);
+}
+
+/**
+ * Poll the open protocol off the bus thread. Protocol status reads waiting data into
+ * receiveBuffer, so a slow server only holds up commands for this N: unit. Published status
+ * drives interrupts and answers repeated SIO Status polls.
+ */
+void sioNetwork::worker_loop()
+{
+    std::unique_lock<std::mutex> lock(protocolMutex);
+
+    while (workerRun)
+    {
+        flush_transmit();
+
+        if (protocol != nullptr)
+        {
+            protocol->fromInterrupt = true;
+            bool err = protocol->status(&status);
+            protocol->fromInterrupt = false;
+            publish_status(true, err);
+        }
+
+        workerWake.wait_for(lock, std::chrono::milliseconds(NETWORK_WORKER_POLL_MS),
+                            [this] { return !workerRun || pendingWriteLen > 0; });
+    }
+}
+
+void sioNetwork::flush_transmit()
+{
+    if (pendingWriteLen == 0)
+        return;
+
+    unsigned short len = pendingWriteLen;
+    pendingWriteLen = 0;
+
+    if (protocol == nullptr || channelMode != PROTOCOL)
+        return;
+
+    if (protocol->write(len))
+    {
+        Debug_printf("sioNetwork::flush_transmit() - write failed, error %u\n", protocol->error);
+        status.error = protocol->error;
+        // protocol status would overwrite it before the computer asks
+        std::lock_guard<std::mutex> lock(publishedMutex);
+        writeError = protocol->error;
+    }
+}
+
+uint8_t sioNetwork::take_status_error(uint8_t error)
+{
+    if (writeError == 0)
+        return error;
+    error = writeError;
+    writeError = 0;
+    return error;
+}
+
+void sioNetwork::publish_status(bool valid, bool err)
+{
+    std::lock_guard<std::mutex> lock(publishedMutex);
+    if (valid)
+    {
+        publishedStatus = status;
+        publishedError = err;
+    }
+    publishedValid = valid;
 }
 
 /** PRIVATE METHODS ************************************************************/
@@ -1007,9 +1178,6 @@ bool sioNetwork::parseURL()
     string url;
     string unit = deviceSpec.substr(0, deviceSpec.find_first_of(":") + 1);
 
-    if (urlParser != nullptr)
-        delete urlParser;
-
     // Prepend prefix, if set.
     if (prefix.length() > 0)
         deviceSpec = unit + prefix + deviceSpec.substr(deviceSpec.find(":") + 1);
@@ -1038,7 +1206,11 @@ bool sioNetwork::parseURL()
 
     // chop off front of device name for URL, and parse it.
     url = deviceSpec.substr(deviceSpec.find(":") + 1);
-    urlParser = EdUrlParser::parseUrl(url);
+    // reuse parser of previous open, its strings keep their buffers
+    if (urlParser == nullptr)
+        urlParser = EdUrlParser::parseUrl(url);
+    else
+        urlParser->reparseUrl(url);
 
     Debug_printf("sioNetwork::parseURL transformed to (%s, %s)\n", deviceSpec.c_str(), url.c_str());
 
@@ -5,6 +5,9 @@
 
 #include <string>
 #include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include "bus.h"
 
@@ -26,6 +29,11 @@
 #define OUTPUT_BUFFER_SIZE 65535
 #define SPECIAL_BUFFER_SIZE 256
 
+/**
+ * How often the I/O worker polls the open protocol for new data (ms)
+ */
+#define NETWORK_WORKER_POLL_MS 5
+
 class sioNetwork : public virtualDevice
 {
 
@@ -249,6 +257,83 @@ private:
      */
     unsigned short json_bytes_remaining=0;
 
+    /**
+     * Background I/O worker, runs while a protocol channel is open. It polls protocol status,
+     * which prefetches inbound data into receiveBuffer, and sends data left by SIO Write.
+     */
+    std::thread worker;
+
+    /**
+     * Guards protocol, buffers and channel state shared by the SIO command handlers and the worker
+     */
+    std::mutex protocolMutex;
+
+    /**
+     * Wakes the worker up before its poll interval elapses
+     */
+    std::condition_variable workerWake;
+
+    /**
+     * Worker should keep running, guarded by protocolMutex
+     */
+    bool workerRun = false;
+
+    /**
+     * Length of SIO Write data in transmitBuffer not yet passed to protocol, guarded by protocolMutex
+     */
+    unsigned short pendingWriteLen = 0;
+
+    /**
+     * Status snapshot published by the worker for sio_poll_interrupt() and SIO Status
+     */
+    std::mutex publishedMutex;
+    NetworkStatus publishedStatus;
+    bool publishedError = false;
+    bool publishedValid = false;
+
+    /**
+     * Error of Write data passed to protocol after the Write was acknowledged, kept until
+     * the next SIO Status reports it, guarded by publishedMutex
+     */
+    uint8_t writeError = 0;
+
+    /**
+     * SIO Status can be answered from the published snapshot. Set by Status read from protocol,
+     * cleared by any other command. Used only on SIO thread.
+     */
+    bool statusFromSnapshot = false;
+
+    /**
+     * Start the I/O worker, called with protocolMutex held
+     */
+    void worker_start();
+
+    /**
+     * Stop the I/O worker and wait for it, must be called without protocolMutex held
+     */
+    void worker_stop();
+
+    /**
+     * I/O worker thread body
+     */
+    void worker_loop();
+
+    /**
+     * Pass pending SIO Write data to protocol, called with protocolMutex held
+     */
+    void flush_transmit();
+
+    /**
+     * Publish status snapshot for sio_poll_interrupt() and SIO Status
+     */
+    void publish_status(bool valid, bool err = false);
+
+    /**
+     * Error byte for SIO Status: pending Write error once, otherwise the given error
+     * Called with publishedMutex held
+     */
+    uint8_t take_status_error(uint8_t error);
+
     /**
      * Instantiate protocol object
      * @return bool TRUE if protocol successfully called open(), FALSE if protocol could not open
@@ -324,6 +409,12 @@ private:
      */
     void sio_status_channel();
 
+    /**
+     * @brief answer SIO Status from published snapshot, without waiting for the protocol
+     * @return true if answered, false if status has to be read from protocol
+     */
+    bool sio_status_snapshot();
+
     /**
      * @brief get JSON status (# of bytes in receive channel)
      */
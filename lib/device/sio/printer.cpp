@@ -155,14 +155,7 @@ void sioPrinter::sio_status()
   delay. This Timeout is associated with printer timeout
   discussed earlier. 
 */
-    uint8_t status[4];
-
-    status[0] = 0;
-    status[1] = _lastaux1;
-    status[2] = 5;
-    status[3] = 0;
-
-    bus_to_computer(status, sizeof(status), false);
+    bus_to_computer(_status_frame, sizeof(_status_frame), false);
 }
 
 void sioPrinter::set_printer_type(sioPrinter::printer_type printer_type)
@@ -296,6 +289,7 @@ void sioPrinter::sio_process(uint32_t commanddata, uint8_t checksum)
         case SIO_PRINTERCMD_WRITE:
             _lastaux1 = cmdFrame.aux1;
             _lastaux2 = cmdFrame.aux2;
+            _status_frame[1] = _lastaux1;
             _last_ms = fnSystem.millis();
             sio_late_ack();
             sio_write(_lastaux1, _lastaux2);
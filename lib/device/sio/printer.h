@@ -27,6 +27,9 @@ protected:
     uint8_t _lastaux1;
     uint8_t _lastaux2;
 
+    // STATUS frame, updated by WRITE: flag, AUX1 of last write, write timeout, unused
+    uint8_t _status_frame[4] = {0, 0, 5, 0};
+
 public:
     // todo: reconcile printer_type with paper_t
     enum printer_type
@@ -3,7 +3,7 @@
 #include "printerlist.h"
 
 // Global object to hold our printers
-printerlist fnPrinters;
+thread_local printerlist fnPrinters;
 
 void printerlist::set_entry(int index, sioPrinter *ptr, sioPrinter::printer_type ptype, int pport)
 {
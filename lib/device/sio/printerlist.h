@@ -27,6 +27,6 @@ public:
     int get_port(int index);
 };
 
-extern printerlist fnPrinters;
+extern thread_local printerlist fnPrinters;
 
 #endif // _PRINTERLIST_H
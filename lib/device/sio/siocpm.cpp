@@ -5,14 +5,26 @@
 #include "siocpm.h"
 
 #include "fnSystem.h"
-#include "fnUART.h"
-#include "fnWiFi.h"
 #include "fuji.h"
 #include "fnFS.h"
 #include "fnFsSD.h"
 
+// Console of CP/M thread (see abstraction_fujinet.h), serviced by sioCPM::sio_handle_cpm()
+static cpmConsoleQueue cpmConsoleIn;  // SIO -> CP/M
+static cpmConsoleQueue cpmConsoleOut; // CP/M -> SIO
+static std::atomic<bool> cpmQuit{false};
+// Z80run() checks it too, so a program which does not use console is stopped as well (see cpu.h)
+#define CPM_QUIT_REQUESTED() cpmQuit.load(std::memory_order_relaxed)
+// RunCPM keeps its state in globals, CP/M runs in one instance (-n option) at a time
+static std::atomic<sioCPM *> cpmOwner{nullptr};
+// Printer of that instance for BDOS printer output, see cpm.h
+static sioPrinter *cpmPrinter = nullptr;
+// Fuji device of that instance for host/device slot BDOS calls, see abstraction_fujinet.h
+static sioFuji *cpmFuji = nullptr;
+
 #include "../runcpm/globals.h"
 #include "../runcpm/abstraction_fujinet.h"
+
 #include "../runcpm/ram.h"     // ram.h - Implements the RAM
 #include "../runcpm/console.h" // console.h - implements console.
 #include "../runcpm/cpu.h"     // cpu.h - Implements the emulated CPU
@@ -30,30 +42,87 @@ void sioCPM::sio_status()
     return;
 }
 
-void sioCPM::sio_handle_cpm()
+// CP/M thread
+void sioCPM::_cpm_task()
 {
-    _puts(CCPHEAD);
-    _PatchCPM();
-    Status = 0;
+    // fnSDFAT of this thread, over SD directory of the instance
+    fnSDFAT.start(_sd_path.c_str());
+
+    Debug_println("CP/M started");
+    while (!cpmQuit)
+    {
+        _puts(CCPHEAD);
+        _PatchCPM();
+        Status = 0;
 #ifdef CCP_INTERNAL
-    _ccp();
+        _ccp();
 #else
-    if (!_sys_exists((uint8 *)CCPname))
+        if (!_sys_exists((uint8 *)CCPname))
+        {
+            _puts("Unable to load CP/M CCP.\r\nCPU halted.\r\n");
+            break;
+        }
+        _RamLoad((uint8 *)CCPname, CCPaddr);    // Loads the CCP binary file into memory
+        Z80reset();                             // Resets the Z80 CPU
+        SET_LOW_REGISTER(BC, _RamRead(0x0004)); // Sets C to the current drive/user
+        PC = CCPaddr;                           // Sets CP/M application jump point
+        Z80run();                               // Starts simulation
+#endif
+        if (Status == 1) // This is set by a call to BIOS 0 - ends CP/M
+            break;
+    }
+    Debug_println("CP/M ended");
+    _cpm_running = false;
+}
+
+int sioCPM::sio_handle_cpm()
+{
+    int count = 0;
+    uint8_t buf[64];
+    size_t len;
+
+    // Console output
+    while ((len = cpmConsoleOut.pop(buf, sizeof(buf))) > 0)
     {
-        _puts("Unable to load CP/M CCP.\r\nCPU halted.\r\n");
-        break;
+        fnSioCom.write(buf, len);
+        count += len;
     }
-    _RamLoad((uint8 *)CCPname, CCPaddr);    // Loads the CCP binary file into memory
-    Z80reset();                             // Resets the Z80 CPU
-    SET_LOW_REGISTER(BC, _RamRead(0x0004)); // Sets C to the current drive/user
-    PC = CCPaddr;                           // Sets CP/M application jump point
-    Z80run();                               // Starts simulation
-#endif
-    if (Status == 1) // This is set by a call to BIOS 0 - ends CP/M
+
+    // Console input, left in SIO buffer while CP/M does not read it
+    while (!cpmConsoleIn.full() && fnSioCom.available() > 0)
     {
-        cpmActive = false;
-        free(RAM);
+        int ch = fnSioCom.read();
+        if (ch < 0)
+            break;
+        cpmConsoleIn.push(ch);
+        count++;
     }
+
+    // CP/M ended, its output is written out above
+    if (!_cpm_running && cpmConsoleOut.empty())
+        _stop_cpm();
+
+    return count;
+}
+
+void sioCPM::_stop_cpm()
+{
+    if (_cpm_thread.joinable())
+    {
+        // console and Z80run() see the request, CP/M thread ends
+        cpmQuit = true;
+        _cpm_thread.join();
+        cpmQuit = false;
+    }
+    cpmConsoleIn.clear();
+    cpmConsoleOut.clear();
+    cpmActive = false;
+    cpmPrinter = nullptr;
+    cpmOwner = nullptr;
+#ifdef ESP_PLATFORM
+    free(RAM);
+    RAM = nullptr;
+#endif
 }
 
 void sioCPM::init_cpm(int baud)
@@ -61,12 +130,23 @@ void sioCPM::init_cpm(int baud)
     fnSioCom.set_baudrate(baud);
     Status = Debug = 0;
     Break = Step = -1;
+#ifdef ESP_PLATFORM
     RAM = (uint8_t *)malloc(MEMSIZE);
+#endif
     memset(RAM, 0, MEMSIZE);
     memset(filename, 0, sizeof(filename));
     memset(newname, 0, sizeof(newname));
     memset(fcbname, 0, sizeof(fcbname));
     memset(pattern, 0, sizeof(pattern));
+
+    cpmConsoleIn.clear();
+    cpmConsoleOut.clear();
+    cpmQuit = false;
+    cpmPrinter = SIO.getPrinter();
+    cpmFuji = &theFuji;
+    _sd_path = fnSDFAT.basepath();
+    _cpm_running = true;
+    _cpm_thread = std::thread(&sioCPM::_cpm_task, this);
 }
 
 void sioCPM::sio_process(uint32_t commanddata, uint8_t checksum)
@@ -80,6 +160,16 @@ void sioCPM::sio_process(uint32_t commanddata, uint8_t checksum)
         sio_ack();
         fnSystem.delay(10);
         sio_complete();
+        if (cpmActive)
+            break; // already running
+        {
+            sioCPM *owner = nullptr;
+            if (!cpmOwner.compare_exchange_strong(owner, this))
+            {
+                Debug_println("CP/M is running in another instance");
+                break;
+            }
+        }
         fnSystem.delay(5000);
         init_cpm(9600);
         cpmActive = true;
@@ -90,4 +180,10 @@ void sioCPM::sio_process(uint32_t commanddata, uint8_t checksum)
     }
 }
 
-#endif /* BUILD_ATARI */
\ No newline at end of file
+sioCPM::~sioCPM()
+{
+    if (_cpm_thread.joinable())
+        _stop_cpm();
+}
+
+#endif /* BUILD_ATARI */
@@ -1,29 +1,108 @@
-
 #ifndef SIOCPM_H
 #define SIOCPM_H
 
+#include <atomic>
+#include <string>
+#include <thread>
+
 #include "bus.h"
 
 
 #define FOLDERCHAR '/'
 
+#define CPM_CONSOLE_QUEUE_SIZE 1024 // power of 2
+
 // Silly typedefs that runcpm uses
 typedef uint8_t uint8;
 typedef uint16_t uint16;
 typedef uint32_t uint32;
 
+/*
+ Lock-free queue of console characters between SIO service loop and CP/M thread,
+ single producer and single consumer
+*/
+class cpmConsoleQueue
+{
+private:
+    uint8_t _buf[CPM_CONSOLE_QUEUE_SIZE];
+    std::atomic<uint32_t> _head{0}; // next write position, advanced by producer
+    std::atomic<uint32_t> _tail{0}; // next read position, advanced by consumer
+
+public:
+    bool empty() const
+    {
+        return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_relaxed);
+    };
+
+    // Producer
+    bool full() const
+    {
+        return _head.load(std::memory_order_relaxed) - _tail.load(std::memory_order_acquire) == CPM_CONSOLE_QUEUE_SIZE;
+    };
+
+    // Producer, returns false if the queue is full
+    bool push(uint8_t ch)
+    {
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        if (head - _tail.load(std::memory_order_acquire) == CPM_CONSOLE_QUEUE_SIZE)
+            return false;
+        _buf[head & (CPM_CONSOLE_QUEUE_SIZE - 1)] = ch;
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    };
+
+    // Consumer, returns false if the queue is empty
+    bool pop(uint8_t &ch)
+    {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        if (_head.load(std::memory_order_acquire) == tail)
+            return false;
+        ch = _buf[tail & (CPM_CONSOLE_QUEUE_SIZE - 1)];
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    };
+
+    // Consumer, up to size characters, returns their count
+    size_t pop(uint8_t *buf, size_t size)
+    {
+        size_t count = 0;
+        while (count < size && pop(buf[count]))
+            count++;
+        return count;
+    };
+
+    // Consumer, drop all waiting characters
+    void clear()
+    {
+        _tail.store(_head.load(std::memory_order_acquire), std::memory_order_release);
+    };
+};
+
+/*
+ CP/M runs on its own thread, so Z80 emulation does not block the SIO bus. Console input from SIO
+ and console output to SIO are passed through lock-free queues, which are serviced by
+ sio_handle_cpm() from SIO service loop while CP/M is active.
+*/
 class sioCPM : public virtualDevice
 {
 private:
+    std::thread _cpm_thread;
+    std::atomic<bool> _cpm_running{false}; // CP/M thread did not finish yet
+    std::string _sd_path;                  // SD directory of the instance, for CP/M thread
+
+    void _cpm_task();
+    void _stop_cpm();
 
     void sio_status() override;
     void sio_process(uint32_t commanddata, uint8_t checksum) override;
 
 public:
-    bool cpmActive = false; 
+    bool cpmActive = false;
     void init_cpm(int baud);
-    void sio_handle_cpm();
-    
+    // Pass console characters between SIO and CP/M, returns their count
+    int sio_handle_cpm();
+
+    ~sioCPM();
 };
 
-#endif /* SIOCPM_H */
\ No newline at end of file
+#endif /* SIOCPM_H */
@@ -2,14 +2,22 @@
 
 #include "voice.h"
 
+#include <mutex>
 #include <string>
 
 #include "utils.h"
 
+#include "../../include/debug.h"
+
 using namespace std;
 
 #define EOL 0x9B
 
+#define VOICE_QUEUE_MAX 16 // lines waiting for rendering, more are dropped
+
+// SAM renders with global state, voice devices of all instances (-n option) take turns
+static std::mutex sam_lock;
+
 void sioVoice::sio_sam_parameters()
 {
     string s = string((char *)lineBuffer); // change to lineBuffer
@@ -58,59 +66,105 @@ void sioVoice::sio_sam_parameters()
 
 void sioVoice::sio_sam()
 {
-    int n = 0;
-    char *a[16];
-    // int i = 0;
-
     memset(samBuffer, 0, sizeof(samBuffer));
-    memset(a, 0, sizeof(a));
 
-    // Construct parameter buffer.
-    a[n++] = (char *)("sam");
-    a[n++] = (char *)("-debug");
+    // Construct parameter list.
+    vector<string> a;
+    a.push_back("sam");
 
     sio_sam_parameters();
 
     if (sing == true)
-        a[n++] = (char *)("-sing");
+        a.push_back("-sing");
 
     if (!pitch.empty())
     {
-        a[n++] = (char *)("-pitch");
-        a[n++] = (char *)(pitch.c_str());
+        a.push_back("-pitch");
+        a.push_back(pitch);
     }
 
     if (!mouth.empty())
     {
-        a[n++] = (char *)("-mouth");
-        a[n++] = (char *)(mouth.c_str());
+        a.push_back("-mouth");
+        a.push_back(mouth);
     }
 
     if (phonetic == true)
-        a[n++] = (char *)("-phonetic");
+        a.push_back("-phonetic");
 
     if (!pitch.empty())
     {
-        a[n++] = (char *)("-pitch");
-        a[n++] = (char *)(pitch.c_str());
+        a.push_back("-pitch");
+        a.push_back(pitch);
     }
 
     if (!speed.empty())
     {
-        a[n++] = (char *)("-speed");
-        a[n++] = (char *)(speed.c_str());
+        a.push_back("-speed");
+        a.push_back(speed);
     }
 
     if (!throat.empty())
     {
-        a[n++] = (char *)("-throat");
-        a[n++] = (char *)(throat.c_str());
+        a.push_back("-throat");
+        a.push_back(throat);
     }
 
-    a[n++] = (char *)samBuffer;
-    sam(n, a);
+    a.push_back((char *)samBuffer);
+
+    std::lock_guard<std::mutex> lock(_render_lock);
+    if (_utterances.size() >= VOICE_QUEUE_MAX)
+    {
+        Debug_println("SAM: too many lines waiting, line dropped");
+        return;
+    }
+    _utterances.push_back(std::move(a));
+    if (!_render_thread.joinable())
+        _render_thread = std::thread(&sioVoice::_render_loop, this);
+    _render_cv.notify_one();
 };
 
+// Rendering thread
+void sioVoice::_render_loop()
+{
+    std::unique_lock<std::mutex> lock(_render_lock);
+    while (true)
+    {
+        _render_cv.wait(lock, [this] { return _render_quit || !_utterances.empty(); });
+        if (_render_quit)
+            break;
+
+        vector<string> args = std::move(_utterances.front());
+        _utterances.pop_front();
+        lock.unlock();
+
+        vector<char *> a;
+        for (string &arg : args)
+            a.push_back(&arg[0]);
+        {
+            std::lock_guard<std::mutex> sam_guard(sam_lock);
+            sam_set_sink(_sink);
+            sam((int)a.size(), a.data());
+        }
+
+        lock.lock();
+    }
+}
+
+sioVoice::~sioVoice()
+{
+    if (_render_thread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(_render_lock);
+            _render_quit = true;
+        }
+        _render_cv.notify_one();
+        _render_thread.join();
+    }
+    delete _sink;
+}
+
 void sioVoice::sio_write()
 {
     // act like a printer for POC
@@ -123,6 +177,9 @@ void sioVoice::sio_write()
 
     if (ck == sio_checksum(sioBuffer, n))
     {
+        // frame completes first, speech of the line is rendered on its own thread
+        sio_complete();
+
         // append sioBuffer onto lineBuffer until EOL is reached
         // move this logic to append \0 into sio_write
         uint8_t i = 0;
@@ -144,7 +201,6 @@ void sioVoice::sio_write()
             }
             i++;
         }
-        sio_complete();
     }
     else
     {
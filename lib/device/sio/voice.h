@@ -1,7 +1,12 @@
 #ifndef VOICE_H
 #define VOICE_H
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "bus.h"
 #include "samlib.h"
@@ -27,11 +32,23 @@ private:
     bool phonetic = false;
     std::string speed;
     std::string throat;
+    SamSink *_sink = nullptr;
+
+    // Speech is rendered and played on its own thread, so playback does not hold the SIO bus
+    std::thread _render_thread;
+    std::mutex _render_lock;
+    std::condition_variable _render_cv;
+    std::deque<std::vector<std::string>> _utterances; // SAM arguments of lines waiting for rendering
+    bool _render_quit = false;
 
     void sio_sam();
     void sio_sam_parameters();
+    void _render_loop();
 
 public:
+    // Destination of speech, the device takes its ownership
+    void set_sink(SamSink *sink) { _sink = sink; };
+    ~sioVoice();
 };
 
 #endif /* VOICE_H */
\ No newline at end of file
@@ -10,6 +10,9 @@
 
 #include "fnSystem.h"
 
+#define FTP_READY_DATA      0x01
+#define FTP_READY_CONTROL   0x02
+
 /*
 ftpparse(&fp,buf,len) tries to parse one line of LIST output.
 
@@ -642,6 +645,7 @@ fnFTP::fnFTP()
     _expect_control_response = false;
     control = new fnTcpClient();
     data = new fnTcpClient();
+    data->setRxBufferSize(FTP_DATA_BUFFER_SIZE);
 }
 
 fnFTP::~fnFTP()
@@ -779,7 +783,7 @@ bool fnFTP::reconnect()
     return login(username, password, hostname, control_port);
 }
 
-bool fnFTP::open_file(string path, bool stor)
+bool fnFTP::open_file(string path, bool stor, uint32_t offset)
 {
     if (!control->connected())
     {
@@ -787,6 +791,10 @@ bool fnFTP::open_file(string path, bool stor)
         return true;
     }
 
+    // Finish previous transfer, so its replies don't get mixed with ours
+    abort_transfer();
+    _transfer_id++;
+
     int retries = 2;
     while (get_data_port())
     {
@@ -801,6 +809,18 @@ bool fnFTP::open_file(string path, bool stor)
         return true;
     }
 
+    // Restart point for ranged read
+    if (stor == false && offset > 0)
+    {
+        REST(offset);
+        if (parse_response() || !is_positive_intermediate_reply())
+        {
+            Debug_printf("Server could not restart at %u. Response was: %s\n", offset, controlResponse.c_str());
+            data->stop();
+            return true;
+        }
+    }
+
     // Do command
     if (stor == true)
     {
@@ -839,6 +859,10 @@ bool fnFTP::open_directory(string path, string pattern)
         return true;
     }
 
+    // Finish previous transfer, so its replies don't get mixed with ours
+    abort_transfer();
+    _transfer_id++;
+
     int retries = 2;
     while (get_data_port())
     {
@@ -875,56 +899,22 @@ bool fnFTP::open_directory(string path, string pattern)
         return true;
     }
 
-    uint8_t buf[256];
+    _expect_control_response = true;
 
-    // if (buf == nullptr)
-    // {
-    //     Debug_printf("fnFTP::open_directory() - Could not allocate 2048 bytes.\n");
-    //     return true;
-    // }
-
-    int tmout_counter = 1 + FTP_TIMEOUT / 50;
-    bool got_response = false;
+    uint8_t buf[1024];
+    int num_read;
 
     // Reset buffer
     dirBuffer.str("");
     dirBuffer.clear();
     // Retrieve listing into buffer.
-    do
-    {
-        if (data->available() == 0)
-        {
-            if (--tmout_counter == 0)
-            {
-                // no data & no control message
-                Debug_printf("fnFTP::open_directory - Timeout\n");
-                break;
-            }
-            fnSystem.delay(50); // wait for more data or control message
-        }
-        if (data->available() > 0)
-        {
-            Debug_printf("Retrieving directory list\n");
-            while (data->available())
-            {
-                int len = data->available();
-                memset(buf, 0, sizeof(buf));
-                int num_read = data->read(buf, len > sizeof(buf) ? sizeof(buf) : len);
-                dirBuffer << string((const char *)buf, num_read);
-            }
-            tmout_counter = 1 + FTP_TIMEOUT / 50; // reset timeout counter
-        }
-        if (got_response == false && control->available())
-        {
-            got_response = !parse_response();
-        }
-    } while (data->available() > 0 || data->connected());
-
-    data->stop();
+    while ((num_read = read_data(buf, sizeof(buf))) > 0)
+        dirBuffer << string((const char *)buf, num_read);
 
-    if (tmout_counter == 0 || (got_response == false && parse_response()))
+    if (num_read < 0)
     {
         Debug_printf("fnFTP::open_directory(%s%s) Timed out waiting for 226 response.\n", path.c_str(), pattern.c_str());
+        abort_transfer();
         return true;
     }
 
@@ -932,6 +922,12 @@ bool fnFTP::open_directory(string path, string pattern)
 }
 
 bool fnFTP::read_directory(string &name, long &filesize, bool &is_dir)
+{
+    time_t mtime;
+    return read_directory(name, filesize, mtime, is_dir);
+}
+
+bool fnFTP::read_directory(string &name, long &filesize, time_t &mtime, bool &is_dir)
 {
     string line;
     struct ftpparse parse;
@@ -946,6 +942,7 @@ bool fnFTP::read_directory(string &name, long &filesize, bool &is_dir)
     ftpparse(&parse, (char *)line.c_str(), line.length());
     name = string(parse.name ? parse.name : "???");
     filesize = parse.size;
+    mtime = parse.mtimetype == FTPPARSE_MTIME_UNKNOWN ? 0 : parse.mtime;
     is_dir = (parse.flagtrycwd == 1);
     Debug_printf("Name: %s filesize: %lu\n", name.c_str(), filesize);
     return dirBuffer.eof();
@@ -962,6 +959,83 @@ bool fnFTP::read_file(uint8_t *buf, unsigned short len)
     return len != data->read(buf, len);
 }
 
+int fnFTP::read_data(uint8_t *buf, size_t len, int timeout_ms)
+{
+    uint64_t deadline = fnSystem.millis() + timeout_ms;
+
+    while (true)
+    {
+        int available = data->available();
+        if (available > 0)
+            return data->read(buf, len < (size_t)available ? len : available);
+
+        // completion reply may arrive before all data is read, failure reply ends the transfer
+        if (_expect_control_response && control->available())
+        {
+            _expect_control_response = false;
+            if (parse_response() || !is_positive_completion_reply())
+            {
+                Debug_printf("fnFTP::read_data - transfer failed: %s\n", controlResponse.c_str());
+                data->stop();
+                return -1;
+            }
+        }
+
+        if (!data->connected())
+        {
+            // all data read, transfer is complete with its reply
+            data->stop();
+            if (_expect_control_response)
+            {
+                _expect_control_response = false;
+                if (parse_response() || !is_positive_completion_reply())
+                {
+                    Debug_printf("fnFTP::read_data - transfer not completed: %s\n", controlResponse.c_str());
+                    return -1;
+                }
+            }
+            return 0;
+        }
+
+        long remaining = (long)(deadline - fnSystem.millis());
+        if (remaining <= 0)
+        {
+            Debug_printf("fnFTP::read_data - Timeout\n");
+            return -1;
+        }
+        wait_ready(remaining, true, _expect_control_response);
+    }
+}
+
+bool fnFTP::abort_transfer()
+{
+    bool res = false;
+
+    if (data->connected() || _expect_control_response || _stor)
+    {
+        Debug_printf("fnFTP::abort_transfer()\n");
+        // Closing data connection completes STOR. Unfinished RETR or LIST is aborted, server
+        // replies to the transfer (226 or 426) and to ABOR (226 or 225), both are read here,
+        // so neither is taken as reply to the next command
+        data->stop();
+        bool abor = _expect_control_response && !_stor;
+        if (abor)
+            ABOR();
+        if (_expect_control_response || _stor)
+        {
+            if (parse_response() || (abor && parse_response()))
+            {
+                Debug_printf("Timed out waiting for transfer reply, reconnecting.\n");
+                reconnect();
+                res = true;
+            }
+        }
+    }
+    _stor = false;
+    _expect_control_response = false;
+    return res;
+}
+
 bool fnFTP::write_file(uint8_t *buf, unsigned short len)
 {
     Debug_printf("fnFTP::write_file(%p,%u)\n", buf, len);
@@ -976,23 +1050,9 @@ bool fnFTP::write_file(uint8_t *buf, unsigned short len)
 
 bool fnFTP::close()
 {
-    bool res = false;
     Debug_printf("fnFTP::close()\n");
-    if (_stor)
-    {
-        if (data->connected())
-        {
-            data->stop();
-        }
-        if (parse_response())
-        {
-            Debug_printf("Timed out waiting for 226.\n");
-            res = true;
-        }
-    }
-    _stor = false;
-    _expect_control_response = false;
-    return res;
+    // STOR is completed by closing data connection, unfinished RETR is stopped
+    return abort_transfer();
 }
 
 int fnFTP::status()
@@ -1064,18 +1124,19 @@ int fnFTP::read_response_line(char *buf, int buflen)
 {
     int num_read = 0;
     int c;
-    int tmout_counter = 1 + FTP_TIMEOUT / 50;
+    uint64_t deadline = fnSystem.millis() + FTP_TIMEOUT;
 
     while(true)
     {
         if (control->available() == 0)
         {
-            if (--tmout_counter == 0)
+            long remaining = (long)(deadline - fnSystem.millis());
+            if (remaining <= 0 || !control->connected())
             {
                 Debug_printf("fnFTP::read_response_line() - Timeout waiting response\n");
                 return -1;
             }
-            fnSystem.delay(50);
+            wait_ready(remaining, false, true);
             continue;
         }
 
@@ -1098,11 +1159,42 @@ int fnFTP::read_response_line(char *buf, int buflen)
         // store char, ignore rest of too long response
         if (num_read < buflen)
             buf[num_read++] = (char) c;
-        tmout_counter = 1 + FTP_TIMEOUT / 50; // reset timeout counter
+        deadline = fnSystem.millis() + FTP_TIMEOUT; // reset timeout
     }
     return num_read;
 }
 
+int fnFTP::wait_ready(int timeout_ms, bool wait_data, bool wait_control)
+{
+    int data_fd = wait_data ? data->fd() : -1;
+    int control_fd = wait_control ? control->fd() : -1;
+    int max_fd = data_fd > control_fd ? data_fd : control_fd;
+
+    if (max_fd < 0)
+        return 0;
+
+    fd_set readfds;
+    FD_ZERO(&readfds);
+    if (data_fd >= 0)
+        FD_SET(data_fd, &readfds);
+    if (control_fd >= 0)
+        FD_SET(control_fd, &readfds);
+
+    struct timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+
+    if (select(max_fd + 1, &readfds, nullptr, nullptr, &tv) <= 0)
+        return 0;
+
+    int ready = 0;
+    if (data_fd >= 0 && FD_ISSET(data_fd, &readfds))
+        ready |= FTP_READY_DATA;
+    if (control_fd >= 0 && FD_ISSET(control_fd, &readfds))
+        ready |= FTP_READY_CONTROL;
+    return ready;
+}
+
 bool fnFTP::get_data_port()
 {
     size_t port_pos_beg, port_pos_end;
@@ -1182,6 +1274,12 @@ void fnFTP::EPSV()
     control->write("EPSV\r\n");
 }
 
+void fnFTP::REST(uint32_t offset)
+{
+    Debug_printf("fnFTP::REST(%u)\n", offset);
+    control->write("REST " + std::to_string(offset) + "\r\n");
+}
+
 void fnFTP::RETR(string path)
 {
     Debug_printf("fnFTP::RETR(%s)\n",path.c_str());
@@ -6,12 +6,15 @@
 #define FNFTP_H
 
 #include <sstream>
+#include <mutex>
+#include <time.h>
 
 #include "fnTcpClient.h"
 
 using namespace std;
 
 #define FTP_TIMEOUT 5000 // This is how long we wait for a reply packet from the server
+#define FTP_DATA_BUFFER_SIZE 65536 // receive buffer of data connection
 
 class fnFTP
 {
@@ -45,11 +48,13 @@ public:
 
     /**
      * Open file on FTP server
+     * Transfer which is still in progress is aborted first.
      * @param path to file to open.
      * @param stor TRUE means STOR, otherwise RETR
+     * @param offset position to start RETR at (REST), 0 for whole file
      * @return TRUE if error, FALSE if successful.
      */
-    bool open_file(string path, bool stor);
+    bool open_file(string path, bool stor, uint32_t offset = 0);
 
     /**
      * Open directory on FTP server, grab it, and return back.
@@ -67,6 +72,15 @@ public:
      */
     bool read_directory(string& name, long& filesize, bool &is_dir);
 
+    /**
+     * Read and return one parsed line of directory
+     * @param name pointer to output name
+     * @param filesize pointer to output filesize
+     * @param mtime pointer to output modification time, 0 if unknown
+     * @return TRUE if error, FALSE if successful
+     */
+    bool read_directory(string& name, long& filesize, time_t& mtime, bool &is_dir);
+
     /**
      * Read file from data socket into buffer.
      * @param buf target buffer
@@ -75,6 +89,34 @@ public:
      */
     bool read_file(uint8_t* buf, unsigned short len);
 
+    /**
+     * Read data of transfer opened by open_file() or open_directory(), waits until
+     * some data arrives, the transfer completes or timeout expires.
+     * @param buf target buffer
+     * @param len length of target buffer
+     * @param timeout_ms how long to wait for data
+     * @return number of bytes read, 0 when transfer completed, -1 on error or timeout
+     */
+    int read_data(uint8_t *buf, size_t len, int timeout_ms = FTP_TIMEOUT);
+
+    /**
+     * Stop transfer in progress, if any, so control connection can be used for next command.
+     * @return TRUE on error, FALSE on success.
+     */
+    bool abort_transfer();
+
+    /**
+     * @brief identifies current transfer, changes with every open_file() and open_directory()
+     * @return transfer sequence number
+     */
+    uint32_t transfer_id() { return _transfer_id; }
+
+    /**
+     * @brief is transfer still in progress (data connected or completion not received)
+     * @return TRUE if transfer is in progress
+     */
+    bool transfer_active() { return _expect_control_response || data->connected(); }
+
     /**
      * Write file from buffer into data socket.
      * @param buf source buffer
@@ -113,6 +155,12 @@ public:
      */
     bool reconnect();
 
+    /**
+     * Held for every use of the connection by those sharing it (file system and its open files),
+     * commands and replies of different users must not interleave.
+     */
+    std::recursive_mutex lock;
+
 protected:
 private:
     /**
@@ -129,6 +177,9 @@ private:
     /* FTP status code, taken from FTP server response */
     int _statusCode;
 
+    /* incremented with every transfer */
+    uint32_t _transfer_id = 0;
+
     /**
      * The port number. (21 by default)
      */
@@ -181,6 +232,15 @@ private:
      */
     int read_response_line(char *buf, int buflen);
 
+    /**
+     * Wait until data and/or control connection has something to read.
+     * @param timeout_ms how long to wait
+     * @param data TRUE to wait for data connection
+     * @param control TRUE to wait for control connection
+     * @return FTP_READY_* flags, 0 on timeout
+     */
+    int wait_ready(int timeout_ms, bool data, bool control);
+
     /**
      * Ask server to prepare a data port for us in extended passive mode.
      * Port is set and returned in data_port variable.
@@ -279,6 +339,12 @@ private:
      */
     void EPSV();
 
+    /**
+     * @brief Ask server to start next RETR at offset
+     * @param offset position in file
+     */
+    void REST(uint32_t offset);
+
     /**
      * @brief Ask server to retrieve path
      * @param path path to retrieve.
@@ -48,6 +48,10 @@
 #define FUJICMD_RANDOM_NUMBER 0xD3              /*  */
 #define FUJICMD_GET_TIME 0xD2                   /*  */
 #define FUJICMD_DEVICE_ENABLE_STATUS 0xD1       /*  */
+#define FUJICMD_FIND_IN_IMAGES 0xB1             /* Find disk images containing a file */
+#define FUJICMD_READ_FOUND_IMAGE 0xB0           /* Returns disk image found by FUJICMD_FIND_IN_IMAGES */
+#define FUJICMD_DISK_OVERLAY 0xB3               /* Merge or discard copy-on-write overlay of mounted disk image */
+#define FUJICMD_NEW_DISK_STATUS 0xB2            /* Returns result of FUJICMD_NEW_DISK continuing in background */
 #define FUJICMD_TEST 0x00
 
 #endif
\ No newline at end of file
@@ -0,0 +1,49 @@
+#include "fujiDiskCreator.h"
+
+#include <chrono>
+
+#include "../../include/debug.h"
+
+#include "fnSystem.h"
+
+void fujiDiskCreator::start(const create_fn &create)
+{
+    wait();
+
+    std::unique_lock<std::mutex> lock(_mtx);
+    _running = true;
+    _thread = std::thread([this, create]() {
+        uint64_t started = fnSystem.millis();
+        bool ok = create();
+        Debug_printf("fujiDiskCreator: image %s in %llu ms\n", ok ? "created" : "failed",
+                     (unsigned long long)(fnSystem.millis() - started));
+        std::unique_lock<std::mutex> lock(_mtx);
+        _ok = ok;
+        _running = false;
+        _cv.notify_all();
+    });
+}
+
+bool fujiDiskCreator::wait(int timeout_ms)
+{
+    std::unique_lock<std::mutex> lock(_mtx);
+    if (!_thread.joinable())
+        return true;
+
+    if (timeout_ms < 0)
+        _cv.wait(lock, [this]() { return !_running; });
+    else if (!_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this]() { return !_running; }))
+        return false;
+
+    lock.unlock();
+    _thread.join();
+    return true;
+}
+
+new_disk_status fujiDiskCreator::status()
+{
+    std::unique_lock<std::mutex> lock(_mtx);
+    if (_running)
+        return NEW_DISK_STATUS_BUSY;
+    return _ok ? NEW_DISK_STATUS_OK : NEW_DISK_STATUS_FAILED;
+}
@@ -0,0 +1,49 @@
+#ifndef _FUJI_DISK_CREATOR_
+#define _FUJI_DISK_CREATOR_
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#define NEW_DISK_WAIT_MS 1000 // how long NEW DISK command waits before creation continues in background
+
+// Status of the last disk creation, reported by Fuji NEW DISK STATUS command (single byte)
+enum new_disk_status : uint8_t
+{
+    NEW_DISK_STATUS_OK = 0,     // nothing was created yet or the last one succeeded
+    NEW_DISK_STATUS_BUSY,       // creation is still running
+    NEW_DISK_STATUS_FAILED      // the last creation failed
+};
+
+/*
+ Creates new disk image on its own thread, so NEW DISK command can complete while
+ slow host is still working on it and the computer can poll for the result.
+
+ Only one image is created at a time. The creating thread uses the host and the image file,
+ so anything else using hosts or disk images has to wait() for it first.
+*/
+class fujiDiskCreator
+{
+public:
+    typedef std::function<bool()> create_fn;
+
+    ~fujiDiskCreator() { wait(); };
+
+    // Run create on creating thread, the previous creation is finished first
+    void start(const create_fn &create);
+    // Wait until the creation is done, up to timeout_ms, or forever with -1
+    // Returns true when there is no creation running
+    bool wait(int timeout_ms = -1);
+
+    new_disk_status status();
+
+private:
+    std::thread _thread;
+    std::mutex _mtx;
+    std::condition_variable _cv;
+    bool _running = false;
+    bool _ok = true;
+};
+
+#endif // _FUJI_DISK_CREATOR_
@@ -1,6 +1,9 @@
 #include "fujiHost.h"
 
 #include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
 #include "compat_string.h"
 
 #include "../../include/debug.h"
@@ -12,6 +15,23 @@
 
 #include "utils.h"
 
+namespace
+{
+    // Running connection to remote host, shared by hosts of all instances which use it
+    struct shared_connection
+    {
+        fujiHostType type;
+        std::string hostname;
+        FileSystem *fs;
+        int users;
+    };
+
+    std::mutex connections_lock;
+    std::vector<shared_connection> connections;
+}
+
+static FileSystem *new_connection(fujiHostType type, const char *hostname);
+
 void fujiHost::unmount()
 {
     cleanup();
@@ -24,9 +44,9 @@ void fujiHost::cleanup()
     if (_fs != nullptr)
         _fs->dir_close();
 
-    // Delete the filesystem if it's not one of the global oens
-    if (_fs->is_global() == false)
-        delete _fs;
+    // Release the filesystem if it's not one of the global oens
+    if (_fs != nullptr && _fs->is_global() == false)
+        disconnect(_fs);
 
     _fs = nullptr;
 
@@ -178,7 +198,9 @@ fsdir_entry_t *fujiHost::dir_nextfile()
     case HOSTTYPE_TNFS:
     case HOSTTYPE_SMB:
     case HOSTTYPE_FTP:
-        return _fs->dir_read();
+        if (_fs != nullptr)
+            return _fs->dir_read();
+        break;
     case HOSTTYPE_UNINITIALIZED:
         break;
     }
@@ -304,6 +326,15 @@ int fujiHost::mount_local()
     return 0;
 }
 
+/* Replace filesystem of the host, previous one is released if it's not global
+*/
+void fujiHost::set_fs(FileSystem *fs)
+{
+    if (_fs != nullptr && _fs != fs && _fs->is_global() == false)
+        disconnect(_fs);
+    _fs = fs;
+}
+
 /* Returns:
     0 on success
    -1 on failure
@@ -324,22 +355,8 @@ int fujiHost::mount_tnfs()
     else
         set_type(HOSTTYPE_TNFS); // Only start fresh if not HOSTTYPE_TNFS
 
-    _fs = new FileSystemTNFS;
-
-    if (_fs == nullptr)
-    {
-        Debug_println("Couldn't create a new TNFSFS in fujiHost::mount_tnfs!");
-    }
-    else
-    {
-        Debug_println("Calling TNFS::begin");
-        if (((FileSystemTNFS *)_fs)->start(_hostname))
-        {
-            return 0;
-        }
-    }
-
-    return -1;
+    set_fs(connect(HOSTTYPE_TNFS, _hostname));
+    return _fs != nullptr ? 0 : -1;
 }
 
 int fujiHost::mount_smb()
@@ -358,29 +375,8 @@ int fujiHost::mount_smb()
     else
         set_type(HOSTTYPE_SMB); // Only start fresh if not HOSTTYPE_SMB
 
-    _fs = new FileSystemSMB;
-
-    if (_fs == nullptr)
-    {
-        Debug_println("Couldn't create a new FsSMB in fujiHost::mount_smb!");
-    }
-    else
-    {
-        Debug_println("Calling SMB::begin");
-        // ensure URL starts with lowercase 'smb'
-        char url[MAX_HOSTNAME_LEN];
-        strcpy(url, _hostname);
-        url[0] = 's';
-        url[1] = 'm';
-        url[2] = 'b';
-
-        if (((FileSystemSMB *)_fs)->start(url))
-        {
-            return 0;
-        }
-    }
-
-    return -1;
+    set_fs(connect(HOSTTYPE_SMB, _hostname));
+    return _fs != nullptr ? 0 : -1;
 }
 
 int fujiHost::mount_ftp()
@@ -399,23 +395,142 @@ int fujiHost::mount_ftp()
     else
         set_type(HOSTTYPE_FTP); // Only start fresh if not HOSTTYPE_FTP
 
-    _fs = new FileSystemFTP;
+    set_fs(connect(HOSTTYPE_FTP, _hostname));
+    return _fs != nullptr ? 0 : -1;
+}
 
-    if (_fs == nullptr)
+/* Returns the type of remote host the name refers to
+*/
+fujiHostType fujiHost::type_from_name(const char *hostname)
+{
+    if (0 == strncasecmp("smb://", hostname, 6))
+        return HOSTTYPE_SMB;
+
+    if (0 == strncasecmp("ftp://", hostname, 6))
+        return HOSTTYPE_FTP;
+
+    return HOSTTYPE_TNFS;
+}
+
+/* Returns running filesystem of given type connected to the host, a connection
+*  made before by any instance is reused. Remote file systems can be used from
+*  several threads.
+*  Doesn't use any host slot state, so hosts can be connected concurrently
+*  from other threads.
+*  Returns nullptr on failure
+*/
+FileSystem *fujiHost::connect(fujiHostType type, const char *hostname)
+{
     {
-        Debug_println("Couldn't create a new FsFTP in fujiHost::mount_ftp!");
+        std::lock_guard<std::mutex> lock(connections_lock);
+        for (shared_connection &c : connections)
+        {
+            if (c.type == type && c.hostname == hostname && c.fs->running())
+            {
+                c.users++;
+                Debug_printf("fujiHost: sharing connection to \"%s\" (%d users)\n", hostname, c.users);
+                return c.fs;
+            }
+        }
     }
-    else
+
+    FileSystem *fs = new_connection(type, hostname);
+    if (fs != nullptr)
     {
-        Debug_println("Calling FTP::begin");
+        std::lock_guard<std::mutex> lock(connections_lock);
+        connections.push_back(shared_connection{type, hostname, fs, 1});
+    }
+    return fs;
+}
 
-        if (((FileSystemFTP *)_fs)->start(_hostname))
+/* Releases filesystem returned by connect(), it's deleted when no one uses it.
+*  Filesystem which did not come from connect() is deleted right away.
+*/
+void fujiHost::disconnect(FileSystem *fs)
+{
+    {
+        std::lock_guard<std::mutex> lock(connections_lock);
+        for (auto it = connections.begin(); it != connections.end(); ++it)
         {
-            return 0;
+            if (it->fs != fs)
+                continue;
+            if (--it->users > 0)
+                return;
+            connections.erase(it);
+            break;
         }
     }
+    delete fs;
+}
+
+// Creates filesystem of given type and connects it to the host
+static FileSystem *new_connection(fujiHostType type, const char *hostname)
+{
+    switch (type)
+    {
+    case HOSTTYPE_TNFS:
+    {
+        FileSystemTNFS *fs = new FileSystemTNFS;
+        Debug_println("Calling TNFS::begin");
+        if (fs->start(hostname))
+            return fs;
+        delete fs;
+        break;
+    }
+    case HOSTTYPE_SMB:
+    {
+        FileSystemSMB *fs = new FileSystemSMB;
+        Debug_println("Calling SMB::begin");
+        // ensure URL starts with lowercase 'smb'
+        char url[MAX_HOSTNAME_LEN];
+        strlcpy(url, hostname, sizeof(url));
+        url[0] = 's';
+        url[1] = 'm';
+        url[2] = 'b';
+
+        if (fs->start(url))
+            return fs;
+        delete fs;
+        break;
+    }
+    case HOSTTYPE_FTP:
+    {
+        FileSystemFTP *fs = new FileSystemFTP;
+        Debug_println("Calling FTP::begin");
+        if (fs->start(hostname))
+            return fs;
+        delete fs;
+        break;
+    }
+    default:
+        break;
+    }
+    return nullptr;
+}
+
+/* Returns true if the host can be mounted without connecting to it,
+*  i.e. it's local or already connected
+*/
+bool fujiHost::connected()
+{
+    if (0 == strcmp(_sdhostname, _hostname))
+        return true;
+
+    return _type != HOSTTYPE_UNINITIALIZED && _type == type_from_name(_hostname)
+        && _fs != nullptr && _fs->running();
+}
+
+/* Mounts filesystem connected by connect(), the host takes its ownership.
+*  Returns true if successful
+*/
+bool fujiHost::mount(fujiHostType type, FileSystem *fs)
+{
+    Debug_printf("::mount {%d} \"%s\" connected %s\n", slotid, _hostname, fs != nullptr ? "ok" : "failed");
 
-    return -1;
+    if (_type != type)
+        set_type(type);
+    set_fs(fs);
+    return _fs != nullptr;
 }
 
 /* Returns true if successful
@@ -431,12 +546,14 @@ bool fujiHost::mount()
     if (0 == mount_local())
         return true;
 
-    if (0 == strncasecmp("smb://", _hostname, 6))
+    switch (type_from_name(_hostname))
+    {
+    case HOSTTYPE_SMB:
         return 0 == mount_smb();
-
-    if (0 == strncasecmp("ftp://", _hostname, 6))
+    case HOSTTYPE_FTP:
         return 0 == mount_ftp();
-
-    // Try mounting TNFS last
-    return 0 == mount_tnfs();
+    default:
+        // Try mounting TNFS last
+        return 0 == mount_tnfs();
+    }
 }
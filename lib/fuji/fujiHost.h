@@ -26,6 +26,7 @@ private:
 
     void cleanup();
     void unmount();
+    void set_fs(FileSystem *fs);
 
     int mount_local();
     int mount_tnfs();
@@ -47,6 +48,14 @@ public:
 
     bool mount();
 
+    // Connecting to remote host may be split from mount(), see fujiHostMounter
+    static fujiHostType type_from_name(const char *hostname);
+    // Connections are shared by hosts of all instances (-n option), release them with disconnect()
+    static FileSystem *connect(fujiHostType type, const char *hostname);
+    static void disconnect(FileSystem *fs);
+    bool connected();
+    bool mount(fujiHostType type, FileSystem *fs);
+
     // Host prefixes are used for host file operations that take a path (file_exists, file_open, dir_open)
     void set_prefix(const char *prefix);
     const char* get_prefix(char *buffer, size_t buffersize);
@@ -0,0 +1,131 @@
+#include "fujiHostMounter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "../../include/debug.h"
+
+#include "fnSystem.h"
+
+namespace
+{
+    // Connection in progress, shared by mounter and connecting thread
+    struct connect_job
+    {
+        fujiHost *host;
+        fujiHostType type;
+        std::string hostname;
+        FileSystem *fs = nullptr;
+        bool done = false;
+        bool abandoned = false;
+        uint64_t started;
+    };
+
+    struct connect_state
+    {
+        std::mutex mtx;
+        std::condition_variable cv;
+    };
+}
+
+void fujiHostMounter::add(fujiHost *host)
+{
+    if (std::find(_hosts.begin(), _hosts.end(), host) == _hosts.end())
+        _hosts.push_back(host);
+}
+
+int fujiHostMounter::mount(const ready_cb &ready)
+{
+    typedef std::chrono::steady_clock clk;
+
+    uint64_t start = fnSystem.millis();
+    clk::time_point deadline = clk::now() + std::chrono::milliseconds(_timeout_ms);
+    std::shared_ptr<connect_state> state = std::make_shared<connect_state>();
+    std::vector<std::shared_ptr<connect_job>> pending;
+    int mounted = 0;
+
+    for (fujiHost *host : _hosts)
+    {
+        // Local and already connected hosts don't need to wait for anything
+        if (host->connected())
+        {
+            bool ok = host->mount();
+            mounted += ok;
+            ready(host, ok);
+            continue;
+        }
+
+        std::shared_ptr<connect_job> job = std::make_shared<connect_job>();
+        job->host = host;
+        job->hostname = host->get_hostname();
+        job->type = fujiHost::type_from_name(job->hostname.c_str());
+        job->started = fnSystem.millis();
+        pending.push_back(job);
+
+        Debug_printf("fujiHostMounter: connecting host #%d \"%s\"\n", host->slotid, job->hostname.c_str());
+        std::thread([state, job]() {
+            FileSystem *fs = fujiHost::connect(job->type, job->hostname.c_str());
+            std::unique_lock<std::mutex> lock(state->mtx);
+            if (job->abandoned)
+            {
+                lock.unlock();
+                fujiHost::disconnect(fs);
+                return;
+            }
+            job->fs = fs;
+            job->done = true;
+            state->cv.notify_all();
+        }).detach();
+    }
+
+    while (!pending.empty())
+    {
+        std::vector<std::shared_ptr<connect_job>> finished;
+        {
+            std::unique_lock<std::mutex> lock(state->mtx);
+            auto any_done = [&pending]() {
+                return std::any_of(pending.begin(), pending.end(),
+                                   [](const std::shared_ptr<connect_job> &j) { return j->done; });
+            };
+            if (!state->cv.wait_until(lock, deadline, any_done))
+            {
+                // Give up on the rest, threads clean up after themselves
+                for (std::shared_ptr<connect_job> &job : pending)
+                    job->abandoned = true;
+                finished.swap(pending);
+            }
+            else
+            {
+                auto it = std::partition(pending.begin(), pending.end(),
+                                         [](const std::shared_ptr<connect_job> &j) { return !j->done; });
+                finished.assign(it, pending.end());
+                pending.erase(it, pending.end());
+            }
+        }
+
+        for (std::shared_ptr<connect_job> &job : finished)
+        {
+            bool ok = false;
+            if (job->abandoned)
+                Debug_printf("fujiHostMounter: host #%d \"%s\" timed out after %d ms\n",
+                             job->host->slotid, job->hostname.c_str(), _timeout_ms);
+            else
+            {
+                Debug_printf("fujiHostMounter: host #%d \"%s\" %s in %llu ms\n", job->host->slotid, job->hostname.c_str(),
+                             job->fs != nullptr ? "connected" : "failed", (unsigned long long)(fnSystem.millis() - job->started));
+                ok = job->host->mount(job->type, job->fs);
+            }
+            mounted += ok;
+            ready(job->host, ok);
+        }
+    }
+
+    Debug_printf("fujiHostMounter: %d of %d hosts mounted in %llu ms\n",
+                 mounted, (int)_hosts.size(), (unsigned long long)(fnSystem.millis() - start));
+    return mounted;
+}
@@ -0,0 +1,38 @@
+#ifndef _FUJI_HOST_MOUNTER_
+#define _FUJI_HOST_MOUNTER_
+
+#include <functional>
+#include <vector>
+
+#include "fujiHost.h"
+
+#define HOST_MOUNT_TIMEOUT_MS 15000 // how long to wait for single host to connect
+
+/*
+ Mounts several host slots at once. Remote hosts are resolved and connected
+ concurrently, each on its own thread, so slow or dead host doesn't delay the others.
+
+ The callback is called on the thread which runs mount() as soon as each host is mounted,
+ has failed or has timed out, so work depending on the host can start right away.
+ Connections which time out are abandoned, the host slot is left as it was and
+ the connection is closed when it eventually completes.
+*/
+class fujiHostMounter
+{
+public:
+    typedef std::function<void(fujiHost *host, bool mounted)> ready_cb;
+
+    fujiHostMounter(int timeout_ms = HOST_MOUNT_TIMEOUT_MS) : _timeout_ms(timeout_ms) {};
+
+    // Add host to be mounted, adding the same host again has no effect
+    void add(fujiHost *host);
+    // Mount all added hosts, returns when all of them are done or timed out
+    // Returns number of hosts mounted successfully
+    int mount(const ready_cb &ready);
+
+private:
+    int _timeout_ms;
+    std::vector<fujiHost *> _hosts;
+};
+
+#endif // _FUJI_HOST_MOUNTER_
@@ -0,0 +1,475 @@
+#ifdef BUILD_ATARI
+
+#include "fujiImageIndex.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <random>
+
+#include "../../include/debug.h"
+
+#include "compat_string.h"
+#include "fnFileCache.h"
+#include "fnFsSD.h"
+#include "fnSystem.h"
+#include "fujiHost.h"
+#include "utils.h"
+
+static_assert(sizeof(imageindex_header) == 32, "index header layout");
+static_assert(sizeof(imageindex_record) == 32, "index record layout");
+static_assert(sizeof(imageindex_image) == 16, "index image layout");
+
+// Our global index of disk image contents
+fujiImageIndex fnImageIndex;
+
+bool fujiImageIndexFile::open(const std::string &fullpath)
+{
+    close();
+#ifndef _WIN32
+    int fd = ::open(fullpath.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED)
+        {
+            _data = (const uint8_t *)p;
+            _size = st.st_size;
+        }
+    }
+    ::close(fd);
+#else
+    FILE *f = fopen(fullpath.c_str(), "rb");
+    if (f == nullptr)
+        return false;
+    uint8_t buf[4096];
+    size_t count;
+    while ((count = fread(buf, 1, sizeof(buf), f)) > 0)
+        _buf.insert(_buf.end(), buf, buf + count);
+    fclose(f);
+    if (!_buf.empty())
+    {
+        _data = _buf.data();
+        _size = _buf.size();
+    }
+#endif
+    if (_data == nullptr || !_validate())
+    {
+        Debug_printf("ImageIndex: invalid index %s\n", fullpath.c_str());
+        close();
+        return false;
+    }
+    return true;
+}
+
+void fujiImageIndexFile::close()
+{
+#ifndef _WIN32
+    if (_data != nullptr)
+        munmap((void *)_data, _size);
+#endif
+    _buf.clear();
+    _data = nullptr;
+    _size = 0;
+}
+
+// Everything found through header has to be inside the file
+bool fujiImageIndexFile::_validate()
+{
+    if (_size < sizeof(imageindex_header))
+        return false;
+    const imageindex_header &h = header();
+    if (memcmp(h.magic, IMAGEINDEX_MAGIC, sizeof(h.magic)) != 0 || h.version != IMAGEINDEX_VERSION
+        || h.record_size != sizeof(imageindex_record))
+        return false;
+    uint64_t records_end = sizeof(imageindex_header) + (uint64_t)h.record_count * sizeof(imageindex_record);
+    uint64_t images_end = (uint64_t)h.images_offset + (uint64_t)h.image_count * sizeof(imageindex_image);
+    if (h.images_offset < records_end || h.strings_offset < images_end || h.strings_offset >= _size
+        || _data[_size - 1] != '\0')
+        return false;
+    for (uint32_t i = 0; i < h.image_count; i++)
+        if (images()[i].path >= _size - h.strings_offset)
+            return false;
+    for (uint32_t i = 0; i < h.record_count; i++)
+        if (records()[i].image >= h.image_count)
+            return false;
+    return true;
+}
+
+fujiImageIndex::~fujiImageIndex()
+{
+    _stop = true;
+    if (_thread.joinable())
+        _thread.join();
+}
+
+// Indexes are shared by instances with SD in different directories
+std::string fujiImageIndex::_host_key(const char *hostname)
+{
+    return strcmp(hostname, "SD") == 0 ? std::string("SD:") + fnSDFAT.basepath() : hostname;
+}
+
+std::string fujiImageIndex::_index_path(const std::string &key)
+{
+    char name[32];
+    uint64_t hash = disk_contents_hash(DISK_CONTENTS_HASH_INIT, (const uint8_t *)key.data(), key.size());
+    snprintf(name, sizeof(name), "/%016llx.idx", (unsigned long long)hash);
+    return std::string(IMAGEINDEX_DIR) + name;
+}
+
+std::string fujiImageIndex::_full_path(const std::string &key)
+{
+    return std::string(fnFileCache.storage()->basepath()) + _index_path(key);
+}
+
+// Own connection to the host, host slots are used by the bus meanwhile
+FileSystem *fujiImageIndex::_connect(const std::string &key)
+{
+    if (key.compare(0, 3, "SD:") == 0)
+    {
+        FileSystemSDFAT *fs = new FileSystemSDFAT;
+        if (fs->start(key.c_str() + 3))
+            return fs;
+        delete fs;
+        return nullptr;
+    }
+    return fujiHost::connect(fujiHost::type_from_name(key.c_str()), key.c_str());
+}
+
+bool fujiImageIndex::_is_image(const char *filename)
+{
+    size_t l = strlen(filename);
+    return l > 4 && (strcasecmp(filename + l - 4, ".atr") == 0 || strcasecmp(filename + l - 4, ".xex") == 0);
+}
+
+bool fujiImageIndex::build(const char *hostname)
+{
+    if (hostname == nullptr || hostname[0] == '\0' || fnFileCache.storage() == nullptr)
+        return false;
+
+    std::lock_guard<std::mutex> lock(_lock);
+    if (!_building_key.empty())
+        return false;
+    if (_thread.joinable())
+        _thread.join();
+
+    _building_key = _host_key(hostname);
+    _scanned = 0;
+    _thread = std::thread(&fujiImageIndex::_build_task, this, _building_key);
+    return true;
+}
+
+bool fujiImageIndex::building(const char *hostname, uint32_t *images)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+    if (images != nullptr)
+        *images = _scanned;
+    return !_building_key.empty() && _building_key == _host_key(hostname);
+}
+
+void fujiImageIndex::_build_task(std::string key)
+{
+    uint64_t start = fnSystem.millis();
+    Debug_printf("ImageIndex: indexing \"%s\"\n", key.c_str());
+
+    FileSystem *fs = _connect(key);
+    if (fs == nullptr)
+        Debug_printf("ImageIndex: failed to connect \"%s\"\n", key.c_str());
+    else
+    {
+        builder b;
+        if (b.old.open(_full_path(key)))
+        {
+            const imageindex_header &h = b.old.header();
+            b.old_records.resize(h.image_count);
+            for (uint32_t i = 0; i < h.image_count; i++)
+                b.old_images[b.old.image_path(i)] = i;
+            for (uint32_t r = 0; r < h.record_count; r++)
+                b.old_records[b.old.records()[r].image].push_back(r);
+        }
+
+        _scan_dir(fs, "/", 0, b);
+        fujiHost::disconnect(fs);
+
+        if (_stop)
+            Debug_println("ImageIndex: indexing stopped");
+        else if (_write(key, b))
+            Debug_printf("ImageIndex: indexed %u files in %u images of \"%s\" in %lu ms\n",
+                         (unsigned)b.records.size(), (unsigned)b.images.size(), key.c_str(),
+                         (unsigned long)(fnSystem.millis() - start));
+    }
+
+    std::lock_guard<std::mutex> lock(_lock);
+    _building_key.clear();
+}
+
+void fujiImageIndex::_scan_dir(FileSystem *fs, const std::string &path, int depth, builder &b)
+{
+    // Directory is read whole first, only one can be open at a time
+    std::vector<dir_item> items;
+    if (!fs->dir_open(path.c_str(), "", 0))
+        return;
+    fsdir_entry *dp;
+    while ((dp = fs->dir_read()) != nullptr)
+    {
+        if (!strcmp(dp->filename, ".") || !strcmp(dp->filename, ".."))
+            continue;
+        if (!dp->isDir && !_is_image(dp->filename))
+            continue;
+        items.push_back(dir_item{dp->filename, dp->isDir, dp->size, dp->modified_time});
+    }
+    fs->dir_close();
+
+    for (const dir_item &item : items)
+    {
+        if (_stop)
+            return;
+        std::string item_path = path + (path.back() == '/' ? "" : "/") + item.name;
+        if (!item.isDir)
+            _scan_image(fs, item_path, item, b);
+        else if (depth < IMAGEINDEX_MAX_DEPTH)
+            _scan_dir(fs, item_path, depth + 1, b);
+    }
+}
+
+void fujiImageIndex::_scan_image(FileSystem *fs, const std::string &path, const dir_item &item, builder &b)
+{
+    imageindex_image image;
+    memset(&image, 0, sizeof(image));
+    image.path = b.strings.size();
+    image.size = item.size;
+    image.modified = (uint32_t)item.modified;
+    uint32_t image_num = b.images.size();
+
+    // Unchanged image is taken from the old index
+    auto old = b.old_images.find(path);
+    if (old != b.old_images.end())
+    {
+        const imageindex_image &old_image = b.old.images()[old->second];
+        if (old_image.size == image.size && old_image.modified == image.modified)
+        {
+            image.files = old_image.files;
+            image.dos = old_image.dos;
+            for (uint32_t r : b.old_records[old->second])
+            {
+                b.records.push_back(b.old.records()[r]);
+                b.records.back().image = image_num;
+            }
+            b.images.push_back(image);
+            b.strings.append(path.c_str(), path.size() + 1);
+            _scanned++;
+            return;
+        }
+    }
+
+    FileHandler *fh = fs->filehandler_open(path.c_str());
+    if (fh == nullptr)
+    {
+        Debug_printf("ImageIndex: failed to open %s\n", path.c_str());
+        return;
+    }
+    image.dos = DiskContents::read(fh, item.size, path.c_str(), b.files);
+    image.files = b.files.size();
+
+    for (const disk_content_file &f : b.files)
+    {
+        imageindex_record rec;
+        memset(&rec, 0, sizeof(rec));
+        strncpy(rec.name, f.name, sizeof(rec.name));
+        rec.size = f.size;
+        rec.hash = f.hash;
+        rec.image = image_num;
+        b.records.push_back(rec);
+    }
+    b.images.push_back(image);
+    b.strings.append(path.c_str(), path.size() + 1);
+    _scanned++;
+}
+
+// Index is written next to the old one and renamed over it, searches see either of them
+bool fujiImageIndex::_write(const std::string &key, builder &b)
+{
+    std::sort(b.records.begin(), b.records.end(), [](const imageindex_record &x, const imageindex_record &y) {
+        int c = strncmp(x.name, y.name, sizeof(x.name));
+        return c != 0 ? c < 0 : x.image < y.image;
+    });
+    // at least one NUL, so an index of no images is valid too
+    if (b.strings.empty())
+        b.strings.push_back('\0');
+
+    imageindex_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, IMAGEINDEX_MAGIC, sizeof(h.magic));
+    h.version = IMAGEINDEX_VERSION;
+    h.record_size = sizeof(imageindex_record);
+    h.record_count = b.records.size();
+    h.image_count = b.images.size();
+    h.images_offset = sizeof(h) + b.records.size() * sizeof(imageindex_record);
+    h.strings_offset = h.images_offset + b.images.size() * sizeof(imageindex_image);
+    h.built = (uint32_t)time(nullptr);
+
+    FileSystemSDFAT *storage = fnFileCache.storage();
+    if (storage == nullptr)
+        return false;
+    std::string path = _index_path(key);
+    // other instances may be writing the same index
+    std::random_device rd;
+    char suffix[24];
+    snprintf(suffix, sizeof(suffix), ".%08x.tmp", (unsigned)rd());
+    std::string temp_path = path + suffix;
+    storage->create_path(IMAGEINDEX_DIR);
+    FILE *f = storage->file_open(temp_path.c_str(), "wb");
+    if (f == nullptr)
+    {
+        Debug_printf("ImageIndex: failed to create %s\n", temp_path.c_str());
+        return false;
+    }
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1
+        && fwrite(b.records.data(), sizeof(imageindex_record), b.records.size(), f) == b.records.size()
+        && fwrite(b.images.data(), sizeof(imageindex_image), b.images.size(), f) == b.images.size()
+        && fwrite(b.strings.data(), 1, b.strings.size(), f) == b.strings.size();
+    ok = (fclose(f) == 0) && ok;
+
+    // the old index may be mapped, it stays readable until it is unmapped
+    b.old.close();
+    std::lock_guard<std::mutex> lock(_lock);
+    if (ok)
+    {
+        storage->remove(path.c_str()); // rename() does not replace existing file everywhere
+        ok = storage->rename(temp_path.c_str(), path.c_str());
+    }
+    if (!ok)
+    {
+        Debug_printf("ImageIndex: failed to write %s\n", path.c_str());
+        storage->remove(temp_path.c_str());
+        return false;
+    }
+    _generation++;
+    return true;
+}
+
+// Keeps the index of the host open for searches, called with _lock held
+bool fujiImageIndex::_open(const char *hostname)
+{
+    if (hostname == nullptr || fnFileCache.storage() == nullptr)
+    {
+        _file.close();
+        return false;
+    }
+    // the index may have been rebuilt by another process sharing the cache directory
+    std::string fullpath = _full_path(_host_key(hostname));
+    struct stat st;
+    if (stat(fullpath.c_str(), &st) != 0)
+    {
+        _file.close();
+        return false;
+    }
+    if (_file.is_open() && _file_path == fullpath && _file_generation == _generation
+        && _file_modified == st.st_mtime && _file_size == (uint64_t)st.st_size)
+        return true;
+    _file.close();
+    if (!_file.open(fullpath))
+        return false;
+    _file_path = fullpath;
+    _file_generation = _generation;
+    _file_modified = st.st_mtime;
+    _file_size = st.st_size;
+    return true;
+}
+
+void fujiImageIndex::_result(uint32_t r, result &res)
+{
+    const imageindex_record &rec = _file.records()[r];
+    res.image = _file.image_path(rec.image);
+    res.name.assign(rec.name, strnlen(rec.name, sizeof(rec.name)));
+    res.size = rec.size;
+    res.hash = rec.hash;
+    res.dos = (disk_dos_t)_file.images()[rec.image].dos;
+}
+
+bool fujiImageIndex::get_summary(const char *hostname, summary &s)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+    if (!_open(hostname))
+        return false;
+    const imageindex_header &h = _file.header();
+    s.built = h.built;
+    s.images = h.image_count;
+    s.files = h.record_count;
+    return true;
+}
+
+bool fujiImageIndex::find(const char *hostname, const char *pattern, std::vector<result> &results, size_t max_results)
+{
+    std::string upper = pattern != nullptr ? pattern : "";
+    std::transform(upper.begin(), upper.end(), upper.begin(), [](char ch) { return (char)toupper((unsigned char)ch); });
+    if (upper.empty())
+        upper = "*";
+
+    std::lock_guard<std::mutex> lock(_lock);
+    if (!_open(hostname))
+        return false;
+
+    uint64_t start = fnSystem.millis();
+    results.clear();
+
+    // Names are sorted, the part before the first wildcard selects a range of records
+    size_t wild = upper.find_first_of("*?");
+    std::string prefix = upper.substr(0, wild);
+    if (prefix.size() > DISK_CONTENTS_NAME_LEN)
+        return true;
+
+    const imageindex_record *begin = _file.records();
+    const imageindex_record *end = begin + _file.header().record_count;
+    const imageindex_record *it = std::lower_bound(begin, end, prefix, [](const imageindex_record &rec, const std::string &p) {
+        return strncmp(rec.name, p.c_str(), p.size()) < 0;
+    });
+
+    char name[DISK_CONTENTS_NAME_LEN + 1];
+    for (; it != end && results.size() < max_results; ++it)
+    {
+        if (strncmp(it->name, prefix.c_str(), prefix.size()) != 0)
+            break;
+        memcpy(name, it->name, DISK_CONTENTS_NAME_LEN);
+        name[DISK_CONTENTS_NAME_LEN] = '\0';
+        if (wild == std::string::npos ? upper != name : !util_wildcard_match(name, upper.c_str()))
+            continue;
+        results.push_back(result());
+        _result(it - begin, results.back());
+    }
+
+    Debug_printf("ImageIndex: %u files named \"%s\" found in %lu ms\n", (unsigned)results.size(), upper.c_str(),
+                 (unsigned long)(fnSystem.millis() - start));
+    return true;
+}
+
+bool fujiImageIndex::find_hash(const char *hostname, uint64_t hash, std::vector<result> &results, size_t max_results)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+    if (!_open(hostname))
+        return false;
+
+    results.clear();
+    const imageindex_header &h = _file.header();
+    for (uint32_t r = 0; r < h.record_count && results.size() < max_results; r++)
+    {
+        if (_file.records()[r].hash != hash)
+            continue;
+        results.push_back(result());
+        _result(r, results.back());
+    }
+    return true;
+}
+
+#endif // BUILD_ATARI
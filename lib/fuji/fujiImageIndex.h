@@ -0,0 +1,178 @@
+#ifndef _FUJI_IMAGE_INDEX_
+#define _FUJI_IMAGE_INDEX_
+
+#include <stdint.h>
+#include <time.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "fnFS.h"
+#include "atari/diskContents.h"
+
+#define IMAGEINDEX_DIR "/FujiNet/index"
+#define IMAGEINDEX_MAGIC "FNII"
+#define IMAGEINDEX_VERSION 1
+#define IMAGEINDEX_MAX_DEPTH 16 // host directories below the root
+
+/*
+ Index file, one per host, all numbers are little endian:
+   header
+   records[record_count]    files found in images, sorted by name
+   images[image_count]      scanned images
+   strings                  NUL terminated image paths
+ Records have fixed size and are sorted, so the file is searched where it is mapped
+ into memory, without parsing it.
+*/
+struct imageindex_header
+{
+    char magic[4];
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t record_count;
+    uint32_t image_count;
+    uint32_t images_offset;
+    uint32_t strings_offset;
+    uint32_t built;
+    uint32_t reserved;
+};
+
+struct imageindex_record
+{
+    char name[DISK_CONTENTS_NAME_LEN]; // NUL padded, not terminated when all 12 are used
+    uint32_t size;
+    uint64_t hash;
+    uint32_t image;
+    uint32_t reserved;
+};
+
+struct imageindex_image
+{
+    uint32_t path; // offset in strings
+    uint32_t size;
+    uint32_t modified;
+    uint16_t files;
+    uint8_t dos;
+    uint8_t reserved;
+};
+
+// Index file mapped into memory (read into memory where there is no mmap)
+class fujiImageIndexFile
+{
+private:
+    const uint8_t *_data = nullptr;
+    size_t _size = 0;
+    std::vector<uint8_t> _buf;
+
+    bool _validate();
+
+public:
+    ~fujiImageIndexFile() { close(); };
+
+    bool open(const std::string &fullpath);
+    void close();
+    bool is_open() const { return _data != nullptr; };
+
+    const imageindex_header &header() const { return *(const imageindex_header *)_data; };
+    const imageindex_record *records() const { return (const imageindex_record *)(_data + sizeof(imageindex_header)); };
+    const imageindex_image *images() const { return (const imageindex_image *)(_data + header().images_offset); };
+    const char *image_path(uint32_t image) const { return (const char *)_data + header().strings_offset + images()[image].path; };
+};
+
+/*
+ Index of files stored inside ATR and XEX images of a host, to find which image has some file
+ without opening the images. Index is built on its own thread from its own connection
+ to the host and kept next to the file cache, where instances sharing the cache directory
+ find it too. Images not changed since the last build (same path, size and modification
+ time) are taken from the old index instead of being read again.
+*/
+class fujiImageIndex
+{
+public:
+    struct result
+    {
+        std::string image;  // image path on the host
+        std::string name;   // file in the image
+        uint32_t size;
+        uint64_t hash;
+        disk_dos_t dos;
+    };
+
+    struct summary
+    {
+        time_t built;
+        uint32_t images;
+        uint32_t files;
+    };
+
+    ~fujiImageIndex();
+
+    // Start building index of the host, returns false if a build is running already
+    bool build(const char *hostname);
+    // Returns true if the host is being indexed, with count of images read so far
+    bool building(const char *hostname, uint32_t *images = nullptr);
+
+    // Functions below return false if the host is not indexed
+    bool get_summary(const char *hostname, summary &s);
+    // Files named like pattern with * and ? wildcards, case is ignored
+    bool find(const char *hostname, const char *pattern, std::vector<result> &results, size_t max_results);
+    // Files with the same data
+    bool find_hash(const char *hostname, uint64_t hash, std::vector<result> &results, size_t max_results);
+
+private:
+    struct dir_item
+    {
+        std::string name;
+        bool isDir;
+        uint32_t size;
+        time_t modified;
+    };
+
+    struct builder
+    {
+        fujiImageIndexFile old;
+        std::unordered_map<std::string, uint32_t> old_images; // old image numbers by path
+        std::vector<std::vector<uint32_t>> old_records;       // record numbers by old image
+        std::vector<imageindex_record> records;
+        std::vector<imageindex_image> images;
+        std::string strings;
+        std::vector<disk_content_file> files;
+    };
+
+    std::thread _thread;
+    std::mutex _lock;
+    std::string _building_key;
+    std::atomic<uint32_t> _scanned{0};
+    std::atomic<bool> _stop{false};
+
+    // Index opened last, reopened when it is rebuilt
+    fujiImageIndexFile _file;
+    std::string _file_path;
+    uint32_t _generation = 0;
+    uint32_t _file_generation = 0;
+    time_t _file_modified = 0;
+    uint64_t _file_size = 0;
+
+    // Hosts are identified by key, which is the hostname except for SD of the calling instance
+    static std::string _host_key(const char *hostname);
+    static std::string _index_path(const std::string &key);
+    static std::string _full_path(const std::string &key);
+    static FileSystem *_connect(const std::string &key);
+    static bool _is_image(const char *filename);
+
+    bool _open(const char *hostname);
+    void _result(uint32_t r, result &res);
+
+    void _build_task(std::string key);
+    void _scan_dir(FileSystem *fs, const std::string &path, int depth, builder &b);
+    void _scan_image(FileSystem *fs, const std::string &path, const dir_item &item, builder &b);
+    bool _write(const std::string &key, builder &b);
+};
+
+extern fujiImageIndex fnImageIndex;
+
+#endif // _FUJI_IMAGE_INDEX_
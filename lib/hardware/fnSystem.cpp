@@ -80,6 +80,10 @@ static void card_detect_intr_task(void* arg)
 // Global object to manage System
 SystemManager fnSystem;
 
+thread_local uint64_t SystemManager::_reboot_at = 0;
+thread_local int SystemManager::_reboot_code = EXIT_AND_RESTART;
+thread_local bool SystemManager::_instance = false;
+
 // keep reference timestamp
 uint64_t _get_start_millis()
 {
@@ -303,6 +307,13 @@ void SystemManager::reboot(uint32_t delay_ms, bool reboot)
 {
     if (delay_ms == 0)
     {
+        if (_instance)
+        {
+            // instance ends when its service loop sees the deferred reboot
+            Debug_println("SystemManager::reboot - ending instance ...");
+            _reboot_at = millis() + 1;
+            return;
+        }
         // do cleanup and exit
         Debug_println("SystemManager::reboot - exiting ...");
         SYSTEM_BUS.shutdown();
@@ -30,8 +30,10 @@ private:
     char _currenttime_string[40];
     int _hardware_version = 0; // unknown
     char _uname_string[128];
-    uint64_t _reboot_at = 0;
-    int _reboot_code = EXIT_AND_RESTART;
+    // Reboot of the program or of the instance running on this thread (-n option)
+    static thread_local uint64_t _reboot_at;
+    static thread_local int _reboot_code;
+    static thread_local bool _instance;
 
 public:
     SystemManager();
@@ -97,6 +99,10 @@ public:
 
     void reboot(uint32_t delay_ms = 0, bool reboot=true);
     bool check_deferred_reboot();
+    // Thread runs one of several instances, reboot ends the instance instead of the program
+    void set_instance() { _instance = true; };
+    // Exit code of the program or instance after deferred reboot
+    int reboot_code() { return _reboot_code; };
     uint32_t get_cpu_frequency();
     uint32_t get_free_heap_size();
     uint32_t get_psram_size();
@@ -1,7 +1,145 @@
 #include "htmlFilter.h"
 #include "utils.h"
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "../../include/debug.h"
 
+#define HTML_NAME_SET_MIN_SLOTS 16
+
+uint32_t HtmlNameSet::_hash(const char *s, size_t len)
+{
+	// FNV-1a
+	uint32_t h = 2166136261u;
+	for (size_t i = 0; i < len; i++) {
+		h ^= (uint8_t)s[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+void HtmlNameSet::insert(const std::string &name)
+{
+	if (name.empty()) {
+		if (!_has_empty) {
+			_has_empty = true;
+			_count++;
+		}
+		return;
+	}
+
+	// Keep the table at most half full, rehash into double size
+	if ((_count + 1) * 2 > _slots.size()) {
+		std::vector<std::string> old;
+		old.swap(_slots);
+		_slots.resize(old.empty() ? HTML_NAME_SET_MIN_SLOTS : old.size() * 2);
+		for (std::string &n : old) {
+			if (n.empty())
+				continue;
+			size_t mask = _slots.size() - 1;
+			size_t i = _hash(n.data(), n.length()) & mask;
+			while (!_slots[i].empty())
+				i = (i + 1) & mask;
+			_slots[i].swap(n);
+		}
+	}
+
+	size_t mask = _slots.size() - 1;
+	size_t i = _hash(name.data(), name.length()) & mask;
+	while (!_slots[i].empty()) {
+		if (_slots[i] == name)
+			return;
+		i = (i + 1) & mask;
+	}
+	_slots[i] = name;
+	_count++;
+}
+
+bool HtmlNameSet::contains(const std::string &name) const
+{
+	if (name.empty())
+		return _has_empty;
+	if (_slots.empty())
+		return false;
+
+	size_t mask = _slots.size() - 1;
+	size_t i = _hash(name.data(), name.length()) & mask;
+	while (!_slots[i].empty()) {
+		if (_slots[i] == name)
+			return true;
+		i = (i + 1) & mask;
+	}
+	return false;
+}
+
+void HtmlNameSet::clear()
+{
+	_slots.clear();
+	_count = 0;
+	_has_empty = false;
+}
+
+// Text character which is copied without any change, i.e. printable character
+// except '<' and '>' or a space which does not follow another space
+static inline bool is_plain_text(char c, char prev)
+{
+	return (c > 0x20 && c < 0x7D && c != '<' && c != '>') || (c == ' ' && prev != ' ');
+}
+
+// Length of the run of plain text characters
+static int plain_text_run(const char *p, int len, char prev)
+{
+	int n = 0;
+#if defined(__SSE2__)
+	if (len == 0 || !is_plain_text(p[0], prev))
+		return 0;
+
+	// Every block is checked for spaces against the bytes before it, which are part of the run
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i hi = _mm_set1_epi8(0x7D);
+	const __m128i lt = _mm_set1_epi8('<');
+	const __m128i gt = _mm_set1_epi8('>');
+	for (n = 1; n + 16 <= len; n += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(p + n));
+		__m128i prev_space = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + n - 1)), space);
+		__m128i printable = _mm_and_si128(_mm_cmpgt_epi8(v, space), _mm_cmplt_epi8(v, hi));
+		__m128i tag = _mm_or_si128(_mm_cmpeq_epi8(v, lt), _mm_cmpeq_epi8(v, gt));
+		__m128i plain = _mm_or_si128(_mm_andnot_si128(tag, printable),
+			_mm_andnot_si128(prev_space, _mm_cmpeq_epi8(v, space)));
+		int mask = _mm_movemask_epi8(plain);
+		if (mask != 0xFFFF)
+			return n + __builtin_ctz(~mask);
+	}
+	prev = p[n - 1];
+#endif
+	while (n < len && is_plain_text(p[n], prev))
+		prev = p[n++];
+	return n;
+}
+
+// Length of the run of characters before the first stop character
+static int skip_to_stop(const char *p, int len, int stop1, int stop2)
+{
+	int n = 0;
+#if defined(__SSE2__)
+	// x86 char is signed, (char)-1 matches the same bytes as the scalar loop below
+	const __m128i s1 = _mm_set1_epi8((char)stop1);
+	const __m128i s2 = _mm_set1_epi8((char)stop2);
+	for (; n + 16 <= len; n += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(p + n));
+		int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, s1), _mm_cmpeq_epi8(v, s2)));
+		if (mask != 0)
+			return n + __builtin_ctz(mask);
+	}
+#endif
+	while (n < len && p[n] != stop1 && p[n] != stop2)
+		n++;
+	return n;
+}
+
 HtmlFilter::HtmlFilter()
 {
 	_carryover_capacity = 0;
@@ -105,6 +243,26 @@ int HtmlFilter::filter_chunk(char* buffer, int buffer_len)
 	}
 
 	for (int i = dest_index; i < buffer_len; i++) {
+		// Fast path for plain text, copy everything up to the next tag, control
+		// character or repeated whitespace at once
+		if (_mode == FILTER_MODE_TEXT && !_skip_char && !_in_pre && _stop1 == '<' && _stop2 == -1) {
+			int n = plain_text_run(buffer + i, buffer_len - i, _prev_char);
+			if (n > 0) {
+				memmove(buffer + dest_index, buffer + i, n);
+				dest_index += n;
+				i += n;
+				_prev_char = buffer[dest_index - 1];
+				if (i == buffer_len)
+					break;
+			}
+		}
+		// Fast path for skipped content, jump to the next stop character
+		else if (_skip_char && _stop1 != '*' && _stop1 != ' ' && _stop2 != ' ') {
+			i += skip_to_stop(buffer + i, buffer_len - i, _stop1, _stop2);
+			if (i == buffer_len)
+				break;
+		}
+
 		// Keep looping until a stop character is reached
 		char c = buffer[i];
 
@@ -259,9 +417,9 @@ int HtmlFilter::filter_chunk(char* buffer, int buffer_len)
 				}
 
 				// Should we skip the tag?
-				if (_html_filter_tags_disallowed.count(_tag) || (
+				if (_html_filter_tags_disallowed.contains(_tag) || (
 					_html_filter_tags_allowed.size() > 0 &&
-					_html_filter_tags_allowed.count(_tag) == 0)
+					!_html_filter_tags_allowed.contains(_tag))
 					) {
 
 					Debug_printf(" <%s>", _tag.c_str());
@@ -321,9 +479,9 @@ int HtmlFilter::filter_chunk(char* buffer, int buffer_len)
 				util_string_tolower(_attr);
 
 				// Should we skip the attribute?
-				if (_html_filter_attrs_disallowed.count(_attr) || (
+				if (_html_filter_attrs_disallowed.contains(_attr) || (
 					_html_filter_attrs_allowed.size() > 0 &&
-					_html_filter_attrs_allowed.count(_attr) == 0)
+					!_html_filter_attrs_allowed.contains(_attr))
 					) {
 					Debug_printf(" %s", _attr.c_str());
 
@@ -28,10 +28,28 @@ Future Directives (work in progress):
 #ifndef HTMLFILTER_H
 #define HTMLFILTER_H
 
+#include <stdint.h>
 #include <string>
 #include <map>
 #include <sstream>
-#include <set>
+#include <vector>
+
+// Set of tag or attribute names, flat open addressing table with linear probing
+class HtmlNameSet
+{
+private:
+    std::vector<std::string> _slots; // empty string is free slot
+    size_t _count = 0;
+    bool _has_empty = false; // empty name can not be stored in slot
+
+    static uint32_t _hash(const char *s, size_t len);
+
+public:
+    void insert(const std::string &name);
+    bool contains(const std::string &name) const;
+    size_t size() const { return _count; }
+    void clear();
+};
 
 class HtmlFilter
 {
@@ -46,10 +64,10 @@ private:
         FILTER_MODE_SKIP_TO_TAG_END
     };
 
-    std::set<std::string> _html_filter_tags_allowed;
-    std::set<std::string> _html_filter_tags_disallowed;
-    std::set<std::string> _html_filter_attrs_allowed;
-    std::set<std::string> _html_filter_attrs_disallowed;
+    HtmlNameSet _html_filter_tags_allowed;
+    HtmlNameSet _html_filter_tags_disallowed;
+    HtmlNameSet _html_filter_attrs_allowed;
+    HtmlNameSet _html_filter_attrs_disallowed;
 
     bool _filter_attributes = false;
     bool _convert_to_internal_encoding = false;
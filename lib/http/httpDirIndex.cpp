@@ -0,0 +1,107 @@
+#include "httpDirIndex.h"
+
+#include <ctype.h>
+#include <string.h>
+
+#include <algorithm>
+
+fnHttpDirIndexCache fnDirIndexes;
+
+void fnHttpDirIndex::add(const fsdir_entry *dp, const char *enc_name, const char *esc_name)
+{
+    _entries.push_back(entry());
+    entry &e = _entries.back();
+    e.name = dp->filename;
+    e.folded = e.name;
+    std::transform(e.folded.begin(), e.folded.end(), e.folded.begin(), [](char ch) { return (char)tolower((unsigned char)ch); });
+    e.enc_name = enc_name;
+    e.esc_name = esc_name;
+    e.isDir = dp->isDir;
+    e.size = dp->size;
+    e.modified_time = dp->modified_time;
+
+    for (int k = 0; k < SORT_COUNT; k++)
+        _views[k].clear();
+}
+
+const std::vector<uint32_t> &fnHttpDirIndex::_view(sort_key key)
+{
+    std::vector<uint32_t> &view = _views[key];
+    if (view.size() == _entries.size())
+        return view;
+
+    view.resize(_entries.size());
+    for (uint32_t i = 0; i < view.size(); i++)
+        view[i] = i;
+
+    // directories first, then by key, equal keys by name
+    std::vector<entry> &entries = _entries;
+    std::sort(view.begin(), view.end(), [&entries, key](uint32_t a, uint32_t b) {
+        const entry &ea = entries[a];
+        const entry &eb = entries[b];
+        if (ea.isDir != eb.isDir)
+            return ea.isDir;
+        if (key == SORT_SIZE && ea.size != eb.size)
+            return ea.size < eb.size;
+        if (key == SORT_DATE && ea.modified_time != eb.modified_time)
+            return ea.modified_time < eb.modified_time;
+        return ea.folded < eb.folded;
+    });
+    return view;
+}
+
+void fnHttpDirIndex::select(sort_key key, bool descending, const char *query, bool prefix, std::vector<uint32_t> &result)
+{
+    std::unique_lock<std::mutex> lock(_views_lock);
+    const std::vector<uint32_t> &view = _view(key);
+
+    std::string q = query != nullptr ? query : "";
+    std::transform(q.begin(), q.end(), q.begin(), [](char ch) { return (char)tolower((unsigned char)ch); });
+
+    result.clear();
+    result.reserve(view.size());
+    for (uint32_t i : view)
+    {
+        const std::string &name = _entries[i].folded;
+        if (q.empty() || (prefix ? name.compare(0, q.size(), q) == 0 : name.find(q) != std::string::npos))
+            result.push_back(i);
+    }
+
+    lock.unlock();
+
+    if (descending)
+    {
+        // directories stay first
+        auto files = std::find_if(result.begin(), result.end(), [this](uint32_t i) { return !_entries[i].isDir; });
+        std::reverse(result.begin(), files);
+        std::reverse(files, result.end());
+    }
+}
+
+std::shared_ptr<fnHttpDirIndex> fnHttpDirIndexCache::find(const std::string &key)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+    for (auto it = _items.begin(); it != _items.end(); ++it)
+    {
+        if (it->key != key)
+            continue;
+        if (time(nullptr) - it->index->built() >= DIRINDEX_TTL_SECONDS)
+        {
+            _items.erase(it);
+            return nullptr;
+        }
+        // most recently used to the front
+        _items.splice(_items.begin(), _items, it);
+        return _items.front().index;
+    }
+    return nullptr;
+}
+
+void fnHttpDirIndexCache::store(const std::string &key, const std::shared_ptr<fnHttpDirIndex> &index)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+    _items.remove_if([&key](const item &i) { return i.key == key; });
+    _items.push_front(item{key, index});
+    while (_items.size() > DIRINDEX_CACHE_SIZE)
+        _items.pop_back();
+}
@@ -0,0 +1,88 @@
+#ifndef HTTPDIRINDEX_H
+#define HTTPDIRINDEX_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "fnFS.h"
+
+#define DIRINDEX_CACHE_SIZE 4       // directories kept indexed
+#define DIRINDEX_TTL_SECONDS 60     // index older than this is read from the host again
+
+/*
+ In-memory index of host directory for the web file browser. Directory is read from the host
+ once, names are URL encoded and HTML escaped as the entries are added, so a page of listing is
+ just copying prepared strings. Views sorted by name, size and date are built on first use,
+ search filters a sorted view. Complete index may be used by several instances at once.
+*/
+class fnHttpDirIndex
+{
+public:
+    enum sort_key
+    {
+        SORT_NAME = 0,
+        SORT_SIZE,
+        SORT_DATE,
+        SORT_COUNT
+    };
+
+    struct entry
+    {
+        std::string name;
+        std::string folded;     // lower case name for sorting and search
+        std::string enc_name;   // URL encoded name
+        std::string esc_name;   // HTML escaped name
+        bool isDir;
+        uint32_t size;
+        time_t modified_time;
+    };
+
+    fnHttpDirIndex() : _built(time(nullptr)) {};
+
+    void add(const fsdir_entry *dp, const char *enc_name, const char *esc_name);
+
+    // Entries matching query in sort order, directories first, empty query matches all
+    // With prefix the query has to match the beginning of name, otherwise any part of it
+    void select(sort_key key, bool descending, const char *query, bool prefix, std::vector<uint32_t> &result);
+
+    const entry &at(uint32_t i) const { return _entries[i]; };
+    size_t size() const { return _entries.size(); };
+    time_t built() const { return _built; };
+
+private:
+    std::vector<entry> _entries;
+    std::vector<uint32_t> _views[SORT_COUNT];
+    std::mutex _views_lock;
+    time_t _built;
+
+    const std::vector<uint32_t> &_view(sort_key key);
+};
+
+// Recently built indexes by host and path, least recently used is dropped
+// Shared by web interfaces of all instances (-n option)
+class fnHttpDirIndexCache
+{
+public:
+    // Index younger than DIRINDEX_TTL_SECONDS or nullptr
+    std::shared_ptr<fnHttpDirIndex> find(const std::string &key);
+    void store(const std::string &key, const std::shared_ptr<fnHttpDirIndex> &index);
+
+private:
+    struct item
+    {
+        std::string key;
+        std::shared_ptr<fnHttpDirIndex> index;
+    };
+    std::list<item> _items; // most recently used first
+    std::mutex _lock;
+};
+
+extern fnHttpDirIndexCache fnDirIndexes;
+
+#endif // HTTPDIRINDEX_H
@@ -23,7 +23,7 @@
 using namespace std;
 
 // Global HTTPD
-fnHttpService fnHTTPD;
+thread_local fnHttpService fnHTTPD;
 
 /* Send some meaningful(?) error message to client
 */
@@ -624,7 +624,7 @@ struct mg_mgr * fnHttpService::start_server(serverstate &srvstate)
 {
     std::string s_listening_address = Config.get_general_interface_url();
 
-    static struct mg_mgr s_mgr;
+    static thread_local struct mg_mgr s_mgr;
 
     struct mg_connection *c;
 
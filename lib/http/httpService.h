@@ -125,5 +125,5 @@ public:
     }
 };
 
-extern fnHttpService fnHTTPD;
+extern thread_local fnHttpService fnHTTPD;
 #endif // HTTPSERVICE_H
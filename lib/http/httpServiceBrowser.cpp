@@ -1,3 +1,8 @@
+#include <stdarg.h>
+
+#include <algorithm>
+#include <vector>
+
 #include "compat_string.h"
 
 #include "httpServiceBrowser.h"
@@ -9,6 +14,7 @@
 #include "fnFsFTP.h"
 #include "fnTaskManager.h"
 #include "fnConfig.h"
+#include "fnSystem.h"
 
 #include "debug.h"
 
@@ -89,8 +95,8 @@ int fnHttpServiceBrowser::browse_url_encode(const char *src, size_t src_len, cha
             if (j + 3 < dst_len)
             {
                 dst[j++] = '%';
-                dst[j++] = hex[src[i] >> 4];
-                dst[j] = hex[src[i] & 0x0f];
+                dst[j++] = hex[(unsigned char)src[i] >> 4];
+                dst[j] = hex[(unsigned char)src[i] & 0x0f];
             } else
             {
                 return -1;
@@ -134,7 +140,56 @@ int fnHttpServiceBrowser::browse_html_escape(const char *src, size_t src_len, ch
 }
 
 
-int fnHttpServiceBrowser::browse_listdir(mg_connection *c, mg_http_message *hm, FileSystem *fs, int slot, const char *host_path, unsigned pathlen)
+void fnHttpChunkWriter::printf(const char *fmt, ...)
+{
+    va_list ap, ap2;
+    va_start(ap, fmt);
+    va_copy(ap2, ap);
+    int n = vsnprintf(_buf + _len, sizeof(_buf) - _len, fmt, ap);
+    va_end(ap);
+
+    if (n >= 0 && (size_t)n >= sizeof(_buf) - _len)
+    {
+        // did not fit, send what is collected and format it again
+        flush();
+        if ((size_t)n < sizeof(_buf))
+            vsnprintf(_buf, sizeof(_buf), fmt, ap2);
+        else
+        {
+            std::vector<char> big(n + 1);
+            vsnprintf(big.data(), big.size(), fmt, ap2);
+            mg_http_write_chunk(_c, big.data(), n);
+            n = 0;
+        }
+    }
+    va_end(ap2);
+
+    if (n > 0)
+        _len += n;
+}
+
+void fnHttpChunkWriter::write(const char *data, size_t len)
+{
+    if (_len + len > sizeof(_buf))
+        flush();
+    if (len > sizeof(_buf))
+        mg_http_write_chunk(_c, data, len);
+    else
+    {
+        memcpy(_buf + _len, data, len);
+        _len += len;
+    }
+}
+
+void fnHttpChunkWriter::flush()
+{
+    if (_len > 0)
+        mg_http_write_chunk(_c, _buf, _len);
+    _len = 0;
+}
+
+int fnHttpServiceBrowser::browse_listdir(mg_connection *c, mg_http_message *hm, FileSystem *fs, int slot, const char *host_path, unsigned pathlen,
+                                         std::shared_ptr<fnHttpDirIndex> index)
 {
     char path[256];
     char enc_path[256]; // URL encoded path
@@ -254,6 +309,14 @@ int fnHttpServiceBrowser::browse_listdir(mg_connection *c, mg_http_message *hm,
                 }
             }
         }
+#ifdef BUILD_ATARI
+        else if (strcmp(action, "merge") == 0 || strcmp(action, "discard") == 0)
+        {
+            // write sectors kept in copy-on-write overlay to the image or drop them
+            if (drive_slot >=0 && drive_slot < MAX_DISK_DEVICES)
+                theFuji.sio_disk_overlay(false, drive_slot, strcmp(action, "discard") == 0);
+        }
+#endif
         else if (strcmp(action, "download") == 0)
         {
             FileHandler *fh = fs->filehandler_open(path);
@@ -273,43 +336,257 @@ int fnHttpServiceBrowser::browse_listdir(mg_connection *c, mg_http_message *hm,
         return browse_listdrives(c, slot, esc_path, enc_path);
     }
 
-    // no special action -> entering sub-directory
-    if (!fs->dir_open(path, "", 0))
+    // no special action -> entering sub-directory, read it from the host unless it's indexed already
+    if (index == nullptr)
     {
-        Debug_printf("Couldn't open host directory: %s\n", path);
-        mg_http_reply(c, 400, "", "Failed to open directory.\n");
-        return -1;
+        if (fs == nullptr || (index = build_dir_index(fs, path)) == nullptr)
+        {
+            Debug_printf("Couldn't open host directory: %s\n", path);
+            mg_http_reply(c, 400, "", "Failed to open directory.\n");
+            return -1;
+        }
+        fnDirIndexes.store(dir_index_key(slot, host_path, pathlen), index);
     }
 
     mg_printf(c, "%s\r\n", "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nTransfer-Encoding: chunked\r\n");
     print_head(c, slot);
     print_navi(c, slot, esc_path, enc_path);
-    mg_http_printf_chunk(
-        c,
-        "<table cellpadding=\"0\"><thead>"
-        "<tr><th>Size</th><th>Modified</th><th>Name</th></tr>"
-        "<tr><td colspan=\"3\"><hr></td></tr></thead><tbody>");
+    print_listing(c, hm, *index, slot, enc_path);
+    mg_http_write_chunk(c, "", 0);
+
+    return 0;
+}
+
+// Indexes are kept by host name and path as requested, trailing slashes don't matter
+// SD is told apart by its directory, indexes are shared by all instances (-n option)
+std::string fnHttpServiceBrowser::dir_index_key(int slot, const char *host_path, unsigned pathlen)
+{
+    while (pathlen > 0 && host_path[pathlen-1] == '/') --pathlen;
+    std::string key = theFuji.get_hosts(slot)->get_hostname();
+    if (key == "SD")
+        key = key + ':' + fnSDFAT.basepath();
+    key += '|';
+    key.append(host_path, pathlen);
+    return key;
+}
+
+std::shared_ptr<fnHttpDirIndex> fnHttpServiceBrowser::build_dir_index(FileSystem *fs, const char *path)
+{
+    if (!fs->dir_open(path, "", 0))
+        return nullptr;
+
+    uint64_t start = fnSystem.millis();
+    std::shared_ptr<fnHttpDirIndex> index = std::make_shared<fnHttpDirIndex>();
+    char enc_filename[384]; // URL encoded file name
+    char esc_filename[384]; // HTML escaped file name
 
-    // list directory
     fsdir_entry *dp;
     while ((dp = fs->dir_read()) != nullptr)
     {
-        // Debug_printf("%d %s\t%d\t%lu\n", dp->isDir, dp->filename, (int)dp->size, (unsigned long)dp->modified_time);
         // Do not show current dir and hidden files
         if (!strcmp(dp->filename, ".") || !strcmp(dp->filename, ".."))
             continue;
-        print_dentry(c, dp, slot, enc_path);
+
+        if (browse_url_encode(dp->filename, strlen(dp->filename), enc_filename, sizeof(enc_filename)) < 0)
+        {
+            enc_filename[0] = '\0';
+        }
+
+        if (browse_html_escape(dp->filename, strlen(dp->filename), esc_filename, sizeof(esc_filename)) < 0)
+        {
+            strcpy(esc_filename, "&lt;-- Name too long --&gt;");
+        }
+
+        index->add(dp, enc_filename, esc_filename);
     }
     fs->dir_close();
 
-    mg_http_printf_chunk(
-        c,
-        "</tbody><tfoot><tr><td colspan=\"3\"><hr></td></tr></tfoot>"
-        "</table></body></html>");
+    Debug_printf("Indexed %u entries of \"%s\" in %lu ms\n", (unsigned)index->size(), path,
+                 (unsigned long)(fnSystem.millis() - start));
+    return index;
+}
+
+// One page of directory listing: search form, entries table with sort links and page links
+void fnHttpServiceBrowser::print_listing(mg_connection *c, mg_http_message *hm, fnHttpDirIndex &index, int slot, const char *enc_path)
+{
+    static const char *sort_names[fnHttpDirIndex::SORT_COUNT] = {"name", "size", "date"};
+
+    char query[64] = "", prefix_str[3] = "", sort_str[6] = "", desc_str[3] = "", start_str[12] = "";
+    mg_http_get_var(&hm->query, "q", query, sizeof(query));
+    mg_http_get_var(&hm->query, "prefix", prefix_str, sizeof(prefix_str));
+    mg_http_get_var(&hm->query, "sort", sort_str, sizeof(sort_str));
+    mg_http_get_var(&hm->query, "desc", desc_str, sizeof(desc_str));
+    mg_http_get_var(&hm->query, "start", start_str, sizeof(start_str));
+
+    fnHttpDirIndex::sort_key key = fnHttpDirIndex::SORT_NAME;
+    for (int k = 0; k < fnHttpDirIndex::SORT_COUNT; k++)
+        if (strcmp(sort_str, sort_names[k]) == 0)
+            key = (fnHttpDirIndex::sort_key)k;
+    bool descending = desc_str[0] == '1';
+    bool prefix = prefix_str[0] == '1';
+
+    std::vector<uint32_t> selected;
+    index.select(key, descending, query, prefix, selected);
+
+    size_t start = strtoul(start_str, nullptr, 10);
+    if (start >= selected.size())
+        start = 0;
+    size_t end = std::min(start + BROWSE_PAGE_SIZE, selected.size());
+
+    char enc_query[sizeof(query) * 3];
+    char esc_query[sizeof(query) * 5];
+    if (browse_url_encode(query, strlen(query), enc_query, sizeof(enc_query)) < 0)
+        enc_query[0] = '\0';
+    if (browse_html_escape(query, strlen(query), esc_query, sizeof(esc_query)) < 0)
+        esc_query[0] = '\0';
+
+    fnHttpChunkWriter w(c);
+
+    w.printf("<form method=\"get\"><input type=\"text\" name=\"q\" value=\"%s\" placeholder=\"Search\"> "
+             "<label><input type=\"checkbox\" name=\"prefix\" value=\"1\"%s> name starts with</label> "
+             "<input type=\"hidden\" name=\"sort\" value=\"%s\"><input type=\"hidden\" name=\"desc\" value=\"%d\">"
+             "<input type=\"submit\" value=\"Find\"></form>",
+             esc_query, prefix ? " checked" : "", sort_names[key], descending);
+
+    // column headers sort by their column, again click on sorted column reverses the order
+    w.printf("<table cellpadding=\"0\"><thead><tr>");
+    static const char *col_sort[3] = {"size", "date", "name"};
+    static const char *col_title[3] = {"Size", "Modified", "Name"};
+    for (int i = 0; i < 3; i++)
+    {
+        bool current = strcmp(col_sort[i], sort_names[key]) == 0;
+        w.printf("<th><a href=\"?sort=%s&desc=%d&q=%s&prefix=%d\">%s%s</a></th>",
+                 col_sort[i], current && !descending, enc_query, prefix, col_title[i],
+                 current ? (descending ? " &#9660;" : " &#9650;") : "");
+    }
+    w.printf("</tr><tr><td colspan=\"3\"><hr></td></tr></thead><tbody>");
+
+    for (size_t i = start; i < end; i++)
+        print_dentry(w, index.at(selected[i]), slot, enc_path);
+
+    w.printf("</tbody><tfoot><tr><td colspan=\"3\"><hr></td></tr><tr><td colspan=\"3\">");
+    if (selected.empty())
+        w.printf("No entries");
+    else
+        w.printf("Entries %u-%u of %u", (unsigned)start + 1, (unsigned)end, (unsigned)selected.size());
+    if (selected.size() != index.size())
+        w.printf(" (%u in directory)", (unsigned)index.size());
+    if (start > 0)
+        w.printf(" <a href=\"?sort=%s&desc=%d&q=%s&prefix=%d&start=%u\">[&#171; Previous]</a>",
+                 sort_names[key], descending, enc_query, prefix, (unsigned)(start > BROWSE_PAGE_SIZE ? start - BROWSE_PAGE_SIZE : 0));
+    if (end < selected.size())
+        w.printf(" <a href=\"?sort=%s&desc=%d&q=%s&prefix=%d&start=%u\">[Next &#187;]</a>",
+                 sort_names[key], descending, enc_query, prefix, (unsigned)end);
+    w.printf(" <a href=\"?refresh=1\" title=\"Read directory from the host again\">[Reload]</a>");
+#ifdef BUILD_ATARI
+    w.printf(" <a href=\"?action=find\" title=\"Find files inside disk images of the host\">[Find in images]</a>");
+#endif
+    w.printf("</td></tr></tfoot></table></body></html>");
+}
+
+#ifdef BUILD_ATARI
+// Search of files inside disk images of the host, with build the index of the host is started first
+int fnHttpServiceBrowser::browse_image_index(mg_connection *c, mg_http_message *hm, int slot, bool build)
+{
+    static const char *dos_names[DISK_DOS_COUNT] = {"?", "DOS 2", "SpartaDOS", "XEX"};
+
+    std::string hostname = theFuji.get_hosts(slot)->get_hostname();
+    if (build)
+        fnImageIndex.build(hostname.c_str());
+
+    char query[64] = "", hash_str[20] = "";
+    mg_http_get_var(&hm->query, "q", query, sizeof(query));
+    mg_http_get_var(&hm->query, "hash", hash_str, sizeof(hash_str));
+
+    char enc_query[sizeof(query) * 3];
+    char esc_query[sizeof(query) * 5];
+    if (browse_url_encode(query, strlen(query), enc_query, sizeof(enc_query)) < 0)
+        enc_query[0] = '\0';
+    if (browse_html_escape(query, strlen(query), esc_query, sizeof(esc_query)) < 0)
+        esc_query[0] = '\0';
+
+    mg_printf(c, "%s\r\n", "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nTransfer-Encoding: chunked\r\n");
+    print_head(c, slot);
+    print_navi(c, slot, "/", "/");
+
+    fnHttpChunkWriter w(c);
+
+    uint32_t scanned;
+    bool building = fnImageIndex.building(hostname.c_str(), &scanned);
+    fujiImageIndex::summary summary;
+    bool indexed = fnImageIndex.get_summary(hostname.c_str(), summary);
+
+    w.printf("<p>");
+    if (building)
+        w.printf("Reading disk images, %u done. <a href=\"?action=find&q=%s\">[Refresh]</a> ", scanned, enc_query);
+    if (indexed)
+    {
+        char built[64];
+        strftime(built, sizeof(built), "%d-%b-%Y %H:%M", localtime(&summary.built));
+        w.printf("Index of %u files in %u disk images, built %s. ", summary.files, summary.images, built);
+    }
+    else if (!building)
+        w.printf("Disk images of this host are not indexed yet. ");
+    if (!building)
+        w.printf("<a href=\"?action=index&q=%s\" title=\"Read all disk images of the host\">[%s]</a>",
+                 enc_query, indexed ? "Rebuild index" : "Build index");
+    w.printf("</p>");
+
+    w.printf("<form method=\"get\"><input type=\"hidden\" name=\"action\" value=\"find\">"
+             "<input type=\"text\" name=\"q\" value=\"%s\" placeholder=\"FOO.COM, *.BAS\"> "
+             "<input type=\"submit\" value=\"Find in images\"></form>", esc_query);
+
+    std::vector<fujiImageIndex::result> results;
+    bool searched = false;
+    if (hash_str[0] != '\0')
+        searched = fnImageIndex.find_hash(hostname.c_str(), strtoull(hash_str, nullptr, 16), results, BROWSE_FIND_RESULTS);
+    else if (query[0] != '\0')
+        searched = fnImageIndex.find(hostname.c_str(), query, results, BROWSE_FIND_RESULTS);
+
+    if (searched)
+    {
+        w.printf("<table cellpadding=\"0\"><thead><tr><th>Name</th><th>Size</th><th>DOS</th><th>Image</th><th></th></tr>"
+                 "<tr><td colspan=\"5\"><hr></td></tr></thead><tbody>");
+        char enc_image[512], esc_image[768];
+        for (const fujiImageIndex::result &r : results)
+        {
+            // path separators stay in the link
+            std::string link;
+            if (browse_url_encode(r.image.c_str(), r.image.size(), enc_image, sizeof(enc_image)) >= 0)
+            {
+                link = enc_image;
+                size_t pos;
+                while ((pos = link.find("%2f")) != std::string::npos)
+                    link.replace(pos, 3, "/");
+            }
+            if (browse_html_escape(r.image.c_str(), r.image.size(), esc_image, sizeof(esc_image)) < 0)
+                strcpy(esc_image, "&lt;-- Path too long --&gt;");
+            // names from images are plain 8.3 names, escaping is still needed for "&" and "<"
+            char esc_name[DISK_CONTENTS_NAME_LEN * 5 + 1];
+            if (browse_html_escape(r.name.c_str(), r.name.size(), esc_name, sizeof(esc_name)) < 0)
+                esc_name[0] = '\0';
+            w.printf("<tr><td>%s</td><td>%u</td><td>%s</td>"
+                     "<td><a href=\"/browse/host/%d%s?action=slotlist\">%s</a></td>"
+                     "<td><a href=\"?action=find&hash=%016llx\" title=\"Images with the same file\">[Same file]</a></td></tr>",
+                     esc_name, (unsigned)r.size, dos_names[r.dos < DISK_DOS_COUNT ? r.dos : 0],
+                     slot + 1, link.c_str(), esc_image, (unsigned long long)r.hash);
+        }
+        w.printf("</tbody><tfoot><tr><td colspan=\"5\"><hr></td></tr><tr><td colspan=\"5\">");
+        if (results.empty())
+            w.printf("No files found");
+        else if (results.size() >= BROWSE_FIND_RESULTS)
+            w.printf("First %u files found", (unsigned)results.size());
+        else
+            w.printf("%u files found", (unsigned)results.size());
+        w.printf("</td></tr></tfoot></table>");
+    }
+    w.printf("</body></html>");
+    w.flush();
     mg_http_write_chunk(c, "", 0);
 
     return 0;
 }
+#endif
 
 int fnHttpServiceBrowser::browse_listdrives(mg_connection *c, int slot, const char *esc_path, const char *enc_path)
 {
@@ -327,6 +604,7 @@ int fnHttpServiceBrowser::browse_listdrives(mg_connection *c, int slot, const ch
     char slot_disk[10]; // "(Dn:)"
     int host_slot;
     bool is_mounted;
+    char overlay_links[200] = "";
     for(int drive_slot = 0; drive_slot < MAX_DISK_DEVICES; drive_slot++)
     {
         disk_id = (char) theFuji.get_disk_id(drive_slot);
@@ -337,11 +615,22 @@ int fnHttpServiceBrowser::browse_listdrives(mg_connection *c, int slot, const ch
             *slot_disk = '\0';
         host_slot = Config.get_mount_host_slot(drive_slot);
         is_mounted = (theFuji.get_disks(drive_slot)->fileh != nullptr);
+#ifdef BUILD_ATARI
+        // sectors written to read-only image, kept in overlay on SD
+        uint32_t overlay_sectors = is_mounted ? theFuji.get_disks(drive_slot)->disk_dev.overlay_sectors() : 0;
+        if (overlay_sectors > 0)
+            snprintf(overlay_links, sizeof overlay_links,
+                " <a title=\"Write %u changed sectors to the image\" href=\"?action=merge&slot=%d\">[ Merge ]</a>"
+                "<a title=\"Drop %u changed sectors\" href=\"?action=discard&slot=%d\">[ Discard ]</a>",
+                (unsigned)overlay_sectors, drive_slot+1, (unsigned)overlay_sectors, drive_slot+1);
+        else
+            *overlay_links = '\0';
+#endif
         mg_http_printf_chunk(c, "<tr>"
                 "<td>Drive Slot %d%s</td>"
                 "<td><a title=\"Mount Read-Only\" href=\"?action=newmount&slot=%d&mode=r\">[ R ]</a>"
                 "<a title=\"Mount Read-Write\" href=\"?action=newmount&slot=%d&mode=w\">[ W ]</a> "
-                "<a title=\"%s\" href=\"?action=%s&slot=%d\">[ %s ]</a></td>"
+                "<a title=\"%s\" href=\"?action=%s&slot=%d\">[ %s ]</a>%s</td>"
                 "<td>%s (%s)</td>"
             "</tr>",
             drive_slot+1, slot_disk,
@@ -352,6 +641,7 @@ int fnHttpServiceBrowser::browse_listdrives(mg_connection *c, int slot, const ch
             (host_slot == HOST_SLOT_INVALID) ? "none" : is_mounted ? "eject" : "mount",
             drive_slot+1,
             (host_slot == HOST_SLOT_INVALID) ? "-" : is_mounted ? "E" : "M",
+            overlay_links,
             // From what host is each disk mounted on and what disk is mounted - TODO escape host and path
             (host_slot == HOST_SLOT_INVALID) ? "" :
                 (Config.get_host_name(host_slot) + " :: "+ Config.get_mount_path(drive_slot)).c_str(),
@@ -439,42 +729,30 @@ void fnHttpServiceBrowser::print_navi(mg_connection *c, int slot, const char *es
     mg_http_printf_chunk(c, "</h2>");
 }
 
-void fnHttpServiceBrowser::print_dentry(mg_connection *c, fsdir_entry *dp, int slot, const char *enc_path)
+void fnHttpServiceBrowser::print_dentry(fnHttpChunkWriter &w, const fnHttpDirIndex::entry &e, int slot, const char *enc_path)
 {
     char size[64], mod[64];
-    const char *slash = dp->isDir ? "/" : "";
-    const char *form = dp->isDir ? "" : "?action=slotlist";
+    const char *slash = e.isDir ? "/" : "";
+    const char *form = e.isDir ? "" : "?action=slotlist";
     const char *sep = enc_path[strlen(enc_path)-1] == '/' ? "" : "/";
-    char enc_filename[128]; // URL encoded file name
-    char esc_filename[128]; // HTML escaped file name
-
-    if (browse_url_encode(dp->filename, strlen(dp->filename), enc_filename, sizeof(enc_filename)) < 0)
-    {
-        enc_filename[0] = '\0';
-    }
-
-    if (browse_html_escape(dp->filename, strlen(dp->filename), esc_filename, sizeof(esc_filename)) < 0)
-    {
-        strcpy(esc_filename, "&lt;-- Name too long --&gt;");
-    }
 
-    if (dp->isDir) {
+    if (e.isDir) {
         snprintf(size, sizeof(size), "%s", "[DIR]");
     } else {
-        if (dp->size < 1024) {
-            snprintf(size, sizeof(size), "%d", (int) dp->size);
-        } else if (dp->size < 0x100000) {
-            snprintf(size, sizeof(size), "%.1fk", (double) dp->size / 1024.0);
-        } else if (dp->size < 0x40000000) {
-            snprintf(size, sizeof(size), "%.1fM", (double) dp->size / 1048576);
+        if (e.size < 1024) {
+            snprintf(size, sizeof(size), "%d", (int) e.size);
+        } else if (e.size < 0x100000) {
+            snprintf(size, sizeof(size), "%.1fk", (double) e.size / 1024.0);
+        } else if (e.size < 0x40000000) {
+            snprintf(size, sizeof(size), "%.1fM", (double) e.size / 1048576);
         } else {
-            snprintf(size, sizeof(size), "%.1fG", (double) dp->size / 1073741824);
+            snprintf(size, sizeof(size), "%.1fG", (double) e.size / 1073741824);
         }
     }
-    strftime(mod, sizeof(mod), "%d-%b-%Y %H:%M", localtime(&dp->modified_time));
-    mg_http_printf_chunk(c,
+    strftime(mod, sizeof(mod), "%d-%b-%Y %H:%M", localtime(&e.modified_time));
+    w.printf(
         "<tr><td>%s</td><td>%s</td><td><a href=\"/browse/host/%d%s%s%s%s\">%s%s</a></td></tr>",
-        size, mod, slot+1, enc_path, sep, enc_filename, form, esc_filename, slash);
+        size, mod, slot+1, enc_path, sep, e.enc_name.c_str(), form, e.esc_name.c_str(), slash);
 }
 
 
@@ -517,6 +795,24 @@ int fnHttpServiceBrowser::process_browse_get(mg_connection *c, mg_http_message *
         mg_http_reply(c, 400, "", "Empty Host Slot\n");
         return -1;
     }
+
+    char action[10] = "", refresh[3] = "";
+    mg_http_get_var(&hm->query, "action", action, sizeof(action));
+    mg_http_get_var(&hm->query, "refresh", refresh, sizeof(refresh));
+
+#ifdef BUILD_ATARI
+    // Files inside disk images are searched in the index, without connecting to the host
+    if (strcmp(action, "find") == 0 || strcmp(action, "index") == 0)
+        return browse_image_index(c, hm, host_slot, strcmp(action, "index") == 0);
+#endif
+
+    // Directory listed lately is shown from its index, without connecting to the host
+    if (action[0] == '\0' && refresh[0] == '\0')
+    {
+        std::shared_ptr<fnHttpDirIndex> index = fnDirIndexes.find(dir_index_key(host_slot, host_path, pathlen));
+        if (index != nullptr)
+            return browse_listdir(c, hm, nullptr, host_slot, host_path, pathlen, index);
+    }
     if (strcmp("SD", hostname) == 0)
     {
         fs = new FileSystemSDFAT;
@@ -552,7 +848,7 @@ int fnHttpServiceBrowser::process_browse_get(mg_connection *c, mg_http_message *
     switch(host_type)
     {
     case HOSTTYPE_LOCAL:
-        started = ((FileSystemSDFAT *)fs)->start();
+        started = ((FileSystemSDFAT *)fs)->start(fnSDFAT.basepath());
         break;
     case HOSTTYPE_SMB:
         started = ((FileSystemSMB *)fs)->start(hostname);
@@ -1,19 +1,48 @@
 #ifndef HTTPSERVICEBROWSER_H
 #define HTTPSERVICEBROWSER_H
 
+#include <memory>
+
 #include "fnFS.h"
 #include "mongoose.h"
+#include "httpDirIndex.h"
+
+#define BROWSE_PAGE_SIZE 200    // directory entries per page
+#define BROWSE_CHUNK_SIZE 4096  // listing is sent in chunks of this size
+#define BROWSE_FIND_RESULTS 500 // files found in disk images shown
+
+// Collects small pieces of HTML into larger chunks of chunked transfer encoding
+class fnHttpChunkWriter
+{
+    mg_connection *_c;
+    char _buf[BROWSE_CHUNK_SIZE];
+    size_t _len = 0;
+
+public:
+    fnHttpChunkWriter(mg_connection *c) : _c(c) {};
+    ~fnHttpChunkWriter() { flush(); };
+
+    void printf(const char *fmt, ...);
+    void write(const char *data, size_t len);
+    void flush();
+};
 
 class fnHttpServiceBrowser
 {
     static int browse_url_encode(const char *src, size_t src_len, char *dst, size_t dst_len);
     static int browse_html_escape(const char *src, size_t src_len, char *dst, size_t dst_len);
 
-    static int browse_listdir(mg_connection *c, mg_http_message *hm, FileSystem *pFS, int slot, const char *host_path, unsigned pathlen);
+    static int browse_listdir(mg_connection *c, mg_http_message *hm, FileSystem *pFS, int slot, const char *host_path, unsigned pathlen,
+                              std::shared_ptr<fnHttpDirIndex> index = nullptr);
     static int browse_listdrives(mg_connection *c, int slot, const char *esc_path, const char *enc_path);
     static void print_head(mg_connection *c, int slot);
     static void print_navi(mg_connection *c, int slot, const char *esc_path, const char*enc_path, bool download = false);
-    static void print_dentry(mg_connection *c, fsdir_entry *dp, int slot, const char *enc_path);
+    static std::string dir_index_key(int slot, const char *host_path, unsigned pathlen);
+    static std::shared_ptr<fnHttpDirIndex> build_dir_index(FileSystem *fs, const char *path);
+    static void print_listing(mg_connection *c, mg_http_message *hm, fnHttpDirIndex &index, int slot, const char *enc_path);
+    static void print_dentry(fnHttpChunkWriter &w, const fnHttpDirIndex::entry &e, int slot, const char *enc_path);
+
+    static int browse_image_index(mg_connection *c, mg_http_message *hm, int slot, bool build);
 
     static int browse_sendfile(mg_connection *c, FileSystem *fs, FileHandler *fh, const char *filename, unsigned long filesize);
 
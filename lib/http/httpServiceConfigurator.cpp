@@ -226,6 +226,16 @@ void fnHttpServiceConfigurator::config_modem_sniffer_enabled(std::string modem_s
     Config.save();
 }
 
+void fnHttpServiceConfigurator::config_modem_sniffer_format(std::string modem_sniffer_format)
+{
+    Debug_printf("New Modem Sniffer Format Value: %s\n", modem_sniffer_format.c_str());
+
+    // Store
+    Config.store_modem_sniffer_format(Config.sniffer_format_from_string(modem_sniffer_format.c_str()));
+    // Save*
+    Config.save();
+}
+
 void fnHttpServiceConfigurator::config_boot_mode(std::string boot_mode)
 {
     Debug_printf("New CONFIG Boot Mode value: %s\n", boot_mode.c_str());
@@ -540,6 +550,10 @@ int fnHttpServiceConfigurator::process_config_post(const char *postdata, size_t
         {
             config_modem_sniffer_enabled(i->second);
         }
+        else if (i->first.compare("modem_sniffer_format") == 0)
+        {
+            config_modem_sniffer_format(i->second);
+        }
         else if (i->first.compare("serialport") == 0)
         {
             config_serial(i->second, std::string(), std::string());
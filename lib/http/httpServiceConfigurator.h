@@ -25,6 +25,7 @@ class fnHttpServiceConfigurator
     static void config_printer_enabled(std::string printer_enabled);
     static void config_modem_enabled(std::string modem_enabled);
     static void config_modem_sniffer_enabled(std::string modem_sniffer_enabled);
+    static void config_modem_sniffer_format(std::string modem_sniffer_format);
     static void config_serial(std::string port, std::string command, std::string proceed);
     static void config_netsio(std::string enable_netsio, std::string netsio_host_port);
 
@@ -22,6 +22,7 @@ const char *webdav_depths[] = {"0", "1", "infinity"};
 mgHttpClient::mgHttpClient()
 {
     _buffer = nullptr; //(char *)malloc(DEFAULT_HTTP_BUF_SIZE);
+    _use_html_filter = false;
 }
 
 // Close connection, destroy any resoruces
@@ -321,6 +322,28 @@ void mgHttpClient::_httpevent_handler(struct mg_connection *c, int ev, void *ev_
                 mg_send(c, client->_post_data, client->_post_datalen);
                 break;
             }
+            case HTTP_PROPFIND:
+            {
+                int body_len = client->_post_data != nullptr ? strlen(client->_post_data) : 0;
+                mg_printf(c, "PROPFIND %s HTTP/1.0\r\n"
+                                "Host: %.*s\r\n"
+                                "Depth: %s\r\n",
+                                mg_url_uri(url), (int)host.len, host.ptr,
+                                webdav_depths[client->_depth]);
+                // send auth header
+                if (!client->_username.empty())
+                    mg_http_bauth(c, client->_username.c_str(), client->_password.c_str());
+                // send request headers
+                for (const auto& rh: client->_request_headers)
+                    mg_printf(c, "%s: %s\r\n", rh.first.c_str(), rh.second.c_str());
+                // request body is XML
+                if (body_len > 0)
+                    mg_printf(c, "Content-Type: text/xml\r\n");
+                mg_printf(c, "Content-Length: %d\r\n", body_len);
+                mg_printf(c, "\r\n");
+                mg_send(c, client->_post_data, body_len);
+                break;
+            }
             default:
             {
 #ifdef VERBOSE_HTTP
@@ -374,6 +397,18 @@ void mgHttpClient::_httpevent_handler(struct mg_connection *c, int ev, void *ev_
             }
         }
 
+        // response body is streamed to consumer, pass what was not streamed yet
+        if (client->_body_cb != nullptr && client->_status_code >= 200 && client->_status_code < 300)
+        {
+            client->_stream_body(hm->body.ptr, hm->body.len);
+            client->_content_length = (int)client->_body_streamed;
+            client->_buffer_pos = 0;
+            client->_buffer_len = 0;
+            c->is_closing = 1;
+            client->_processed = true;
+            break;
+        }
+
         // allocate buffer for received data
         if (client->_buffer != nullptr) 
         {
@@ -418,6 +453,31 @@ void mgHttpClient::_httpevent_handler(struct mg_connection *c, int ev, void *ev_
 #ifdef VERBOSE_HTTP
         Debug_printf("mgHttpClient: HTTP chunk (partial msg)\n");
 #endif
+        if (client->_body_cb == nullptr || client->_processed)
+            break;
+
+        struct mg_http_message *hm = (struct mg_http_message *) ev_data;
+        if (client->_status_code < 0)
+            client->_status_code = std::stoi(std::string(hm->uri.ptr, hm->uri.len));
+        // only successful response is streamed, other responses are collected as usual
+        if (client->_status_code < 200 || client->_status_code >= 300)
+            break;
+
+        // pass the data to consumer and release them from connection receive buffer
+        client->_stream_body(hm->chunk.ptr, hm->chunk.len);
+        mg_http_delete_chunk(c, hm);
+
+        // mongoose will not see complete message of known length after chunks were deleted
+        if (hm->body.len != (size_t)~0 && !mg_http_get_header(hm, "Transfer-Encoding") &&
+            client->_body_streamed >= hm->body.len)
+        {
+            client->_content_length = (int)client->_body_streamed;
+            client->_buffer_pos = 0;
+            client->_buffer_len = 0;
+            c->recv.len = 0;
+            c->is_closing = 1;
+            client->_processed = true;
+        }
         break;
     }
 
@@ -742,10 +802,20 @@ void mgHttpClient::_perform_connect()
     _content_length = 0;
     _buffer_len = 0;
     _buffer_total_read = 0;
-    
+    _body_streamed = 0;
+
     mg_http_connect(_handle, _url.c_str(), _httpevent_handler, this);  // Create client connection
 }
 
+// Pass piece of response body to consumer
+void mgHttpClient::_stream_body(const char *data, size_t len)
+{
+    if (len == 0 || len == (size_t)~0)
+        return;
+    _body_cb(data, len, _body_cb_data);
+    _body_streamed += len;
+}
+
 /*
  Performs an HTTP transaction using esp_http_client_open() and subsequent "streaming" functions.
  Although this is more flexible than the esp_http_client_perform() method, there doesn't
@@ -845,7 +915,8 @@ int mgHttpClient::PUT(const char *put_data, int put_datalen)
     return _perform();
 }
 
-int mgHttpClient::PROPFIND(webdav_depth depth, const char *properties_xml)
+int mgHttpClient::PROPFIND(webdav_depth depth, const char *properties_xml,
+                           http_body_cb_t body_cb, void *body_cb_data)
 {
     Debug_println("mgHttpClient::PROPFIND");
     if (_handle == nullptr)
@@ -857,21 +928,17 @@ int mgHttpClient::PROPFIND(webdav_depth depth, const char *properties_xml)
     // // Set method
     // esp_http_client_set_method(_handle, esp_http_client_method_t::HTTP_METHOD_PROPFIND);
     _method = HTTP_PROPFIND;
-    // // Assume any request body will be XML
-    // esp_http_client_set_header(_handle, "Content-Type", "text/xml");
-    // // Set depth
-    // const char *pDepth = webdav_depths[0];
-    // if (depth == DEPTH_1)
-    //     pDepth = webdav_depths[1];
-    // else if (depth == DEPTH_INFINITY)
-    //     pDepth = webdav_depths[2];
-    // esp_http_client_set_header(_handle, "Depth", pDepth);
+    // Depth header and XML request body are sent on connect
+    _depth = depth;
+    _post_data = properties_xml;
+    _body_cb = body_cb;
+    _body_cb_data = body_cb_data;
 
-    // // esp_http_client_set_post_field() sets the content of the body of the transaction
-    // if (properties_xml != nullptr)
-    //     esp_http_client_set_post_field(_handle, properties_xml, strlen(properties_xml));
+    int status = _perform();
 
-    return _perform();
+    _body_cb = nullptr;
+    _body_cb_data = nullptr;
+    return status;
 }
 
 int mgHttpClient::DELETE()
@@ -16,8 +16,19 @@
 #undef DELETE
 #endif
 
+// Consumer of response body data as it arrives from server
+typedef void (*http_body_cb_t)(const char *data, size_t len, void *user_data);
+
 class mgHttpClient
 {
+public:
+    enum webdav_depth
+    {
+        DEPTH_0 = 0,
+        DEPTH_1,
+        DEPTH_INFINITY
+    };
+
 private:
     typedef std::map<std::string,std::string> header_map_t;
     typedef std::pair<std::string,std::string> header_entry_t;
@@ -83,6 +94,16 @@ private:
     const char *_post_data;
     int _post_datalen;
 
+    // WebDAV Depth header
+    webdav_depth _depth;
+
+    // successful response body is passed to consumer instead of being buffered
+    http_body_cb_t _body_cb = nullptr;
+    void *_body_cb_data = nullptr;
+    size_t _body_streamed;
+
+    void _stream_body(const char *data, size_t len);
+
     // static void _perform_subtask(void *param);
     // static esp_err_t _httpevent_handler(esp_http_client_event_t *evt);
     static void _httpevent_handler(struct mg_connection *c, int ev, void *ev_data, void *user_data);
@@ -100,13 +121,6 @@ public:
     mgHttpClient();
     ~mgHttpClient();
 
-    enum webdav_depth
-    {
-        DEPTH_0 = 0,
-        DEPTH_1,
-        DEPTH_INFINITY
-    };
-
     bool begin(std::string url);
     void close();
 
@@ -114,7 +128,10 @@ public:
     int HEAD();
     int POST(const char *post_data, int post_datalen);
     int PUT(const char *put_data, int put_datalen);
-    int PROPFIND(webdav_depth depth, const char *properties_xml);
+    // body_cb, if set, receives body of successful response in pieces as it arrives
+    // and available()/read() return no data for such response
+    int PROPFIND(webdav_depth depth, const char *properties_xml,
+                 http_body_cb_t body_cb = nullptr, void *body_cb_data = nullptr);
     int DELETE();
     int MKCOL();
     int COPY(const char *destination, bool overwrite, bool move = false);
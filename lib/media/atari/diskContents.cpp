@@ -0,0 +1,345 @@
+#ifdef BUILD_ATARI
+
+#include "diskContents.h"
+
+#include <ctype.h>
+#include <string.h>
+
+#include "../../include/debug.h"
+
+#include "utils.h"
+
+// Atari DOS 2.x and MyDOS
+#define DOS2_VTOC_SECTOR 360
+#define DOS2_DIR_SECTOR 361
+#define DOS2_DIR_SECTORS 8
+#define DOS2_DIR_ENTRY_SIZE 16
+#define DOS2_DIR_ENTRIES 8          // per sector, only first 128 bytes are used
+
+#define DOS2_FLAG_OPEN 0x01         // open for output
+#define DOS2_FLAG_DOS2 0x02         // created by DOS 2
+#define DOS2_FLAG_NO_FILE_NUM 0x04  // MyDOS, sector links use both bytes
+#define DOS2_FLAG_SUBDIR 0x10       // MyDOS subdirectory
+#define DOS2_FLAG_LOCKED 0x20
+#define DOS2_FLAG_IN_USE 0x40
+#define DOS2_FLAG_DELETED 0x80
+
+#define DOS2_MAX_FILE_NUM_SECTORS 1023 // larger disks can't have file numbers in sector links
+
+// SpartaDOS file system
+#define SPARTA_BOOT_MAIN_DIR 9      // first sector map of main directory
+#define SPARTA_BOOT_VERSION 32      // $11 SpartaDOS 1.1, $20 SpartaDOS 2.x, $21 SpartaDOS 2.1+
+#define SPARTA_MAP_HEADER 4         // next and previous sector map
+#define SPARTA_DIR_ENTRY_SIZE 23
+#define SPARTA_DIR_MAX_SIZE 65536
+
+#define SPARTA_FLAG_IN_USE 0x08
+#define SPARTA_FLAG_DELETED 0x10
+#define SPARTA_FLAG_SUBDIR 0x20
+
+#define XEX_READ_BUFFER_SIZE 4096
+
+// Reads sector into _atr._disk_sectorbuff, damaged images may not make us read forever
+// Returns TRUE if an error condition occurred
+bool DiskContents::_read_sector(uint16_t sectornum)
+{
+    uint16_t readcount;
+    if (sectornum == 0 || sectornum > _atr._disk_num_sectors || ++_sectors_read > _atr._disk_num_sectors * 2)
+        return true;
+    return _atr._read(sectornum, &readcount);
+}
+
+void DiskContents::_add_file(const uint8_t *name, const uint8_t *ext, uint32_t size, uint64_t hash)
+{
+    disk_content_file file;
+    int len = 0;
+    for (int i = 0; i < 8 && name[i] != ' '; i++)
+        file.name[len++] = toupper(name[i]);
+    if (ext[0] != ' ')
+    {
+        file.name[len++] = '.';
+        for (int i = 0; i < 3 && ext[i] != ' '; i++)
+            file.name[len++] = toupper(ext[i]);
+    }
+    file.name[len] = '\0';
+    file.size = size;
+    file.hash = hash;
+    _files->push_back(file);
+}
+
+// Used entry of DOS 2 directory with sane flags, name and first sector
+bool DiskContents::_dos2_valid_entry(const uint8_t *entry)
+{
+    uint16_t start = UINT16_FROM_HILOBYTES(entry[4], entry[3]);
+    if (start < 4 || start > _atr._disk_num_sectors)
+        return false;
+    if (entry[5] == ' ')
+        return false;
+    for (int i = 5; i < DOS2_DIR_ENTRY_SIZE; i++)
+        if (entry[i] < 0x20 || entry[i] > 0x7e)
+            return false;
+    return true;
+}
+
+// Follows sector links of the file, data sectors end with link and count of bytes used
+// Returns TRUE if an error condition occurred
+bool DiskContents::_dos2_read_file(uint16_t sector, bool no_file_number, uint32_t &size, uint64_t &hash)
+{
+    uint16_t data_len = _sector_size - 3;
+
+    size = 0;
+    hash = DISK_CONTENTS_HASH_INIT;
+    while (sector != 0)
+    {
+        if (_read_sector(sector))
+            return true;
+
+        const uint8_t *buf = _atr._disk_sectorbuff;
+        uint8_t count = buf[_sector_size - 1];
+        if (_sector_size == DISK_BYTES_PER_SECTOR_SINGLE)
+            count &= 0x7f;
+        if (count > data_len)
+            return true;
+
+        hash = disk_contents_hash(hash, buf, count);
+        size += count;
+
+        if (no_file_number)
+            sector = UINT16_FROM_HILOBYTES(buf[data_len], buf[data_len + 1]);
+        else
+            sector = UINT16_FROM_HILOBYTES((buf[data_len] & 0x03), buf[data_len + 1]);
+    }
+    return false;
+}
+
+// Returns TRUE if an error condition occurred (not a DOS 2 directory)
+bool DiskContents::_dos2_read_dir(uint16_t first_sector, int depth)
+{
+    struct dir_entry
+    {
+        uint8_t data[DOS2_DIR_ENTRY_SIZE];
+    };
+    std::vector<dir_entry> entries;
+
+    // Whole directory is read first, reading files moves the sector buffer
+    for (uint16_t s = first_sector; s < first_sector + DOS2_DIR_SECTORS; s++)
+    {
+        if (_read_sector(s))
+            return true;
+        for (int e = 0; e < DOS2_DIR_ENTRIES; e++)
+        {
+            const uint8_t *entry = &_atr._disk_sectorbuff[e * DOS2_DIR_ENTRY_SIZE];
+            if (entry[0] == 0) // never used, end of directory
+            {
+                s = first_sector + DOS2_DIR_SECTORS;
+                break;
+            }
+            if (entry[0] & DOS2_FLAG_DELETED)
+                continue;
+            if (!(entry[0] & DOS2_FLAG_IN_USE) || !_dos2_valid_entry(entry))
+                return true;
+            entries.push_back(dir_entry());
+            memcpy(entries.back().data, entry, DOS2_DIR_ENTRY_SIZE);
+        }
+    }
+
+    bool large_disk = _atr._disk_num_sectors > DOS2_MAX_FILE_NUM_SECTORS;
+    for (const dir_entry &e : entries)
+    {
+        const uint8_t *entry = e.data;
+        uint16_t start = UINT16_FROM_HILOBYTES(entry[4], entry[3]);
+        if (entry[0] & DOS2_FLAG_SUBDIR)
+        {
+            // damaged subdirectory does not spoil the rest of the disk
+            if (depth < DISK_CONTENTS_MAX_DEPTH)
+                _dos2_read_dir(start, depth + 1);
+            continue;
+        }
+        uint32_t size;
+        uint64_t hash;
+        if (_dos2_read_file(start, large_disk || (entry[0] & DOS2_FLAG_NO_FILE_NUM), size, hash))
+        {
+            Debug_printf("DiskContents: broken sector chain of \"%.8s.%.3s\"\n", &entry[5], &entry[13]);
+            continue;
+        }
+        _add_file(&entry[5], &entry[13], size, hash);
+    }
+    return false;
+}
+
+// Reads file through its sector maps into data and/or hash, sectors 0 in the map are not allocated
+// Returns TRUE if an error condition occurred
+bool DiskContents::_sparta_read_file(uint16_t map_sector, uint32_t length, std::vector<uint8_t> *data, uint64_t *hash)
+{
+    std::vector<uint8_t> map(_sector_size);
+    std::vector<uint8_t> zero(_sector_size, 0);
+
+    if (hash != nullptr)
+        *hash = DISK_CONTENTS_HASH_INIT;
+    while (length > 0 && map_sector != 0)
+    {
+        if (_read_sector(map_sector))
+            return true;
+        memcpy(map.data(), _atr._disk_sectorbuff, _sector_size);
+        map_sector = UINT16_FROM_HILOBYTES(map[1], map[0]);
+
+        for (int i = SPARTA_MAP_HEADER; i + 1 < _sector_size && length > 0; i += 2)
+        {
+            uint16_t sector = UINT16_FROM_HILOBYTES(map[i + 1], map[i]);
+            const uint8_t *buf = zero.data();
+            if (sector != 0)
+            {
+                if (_read_sector(sector))
+                    return true;
+                buf = _atr._disk_sectorbuff;
+            }
+            uint32_t count = length < _sector_size ? length : _sector_size;
+            if (data != nullptr)
+                data->insert(data->end(), buf, buf + count);
+            if (hash != nullptr)
+                *hash = disk_contents_hash(*hash, buf, count);
+            length -= count;
+        }
+    }
+    return length > 0;
+}
+
+// Returns TRUE if an error condition occurred
+bool DiskContents::_sparta_read_dir(uint16_t map_sector, int depth)
+{
+    // Directory is a file starting with entry of its own, which has the directory length
+    std::vector<uint8_t> dir;
+    if (_sparta_read_file(map_sector, SPARTA_DIR_ENTRY_SIZE, &dir, nullptr))
+        return true;
+    uint32_t length = dir[3] | (dir[4] << 8) | (dir[5] << 16);
+    if (length < SPARTA_DIR_ENTRY_SIZE || length > SPARTA_DIR_MAX_SIZE)
+        return true;
+    dir.clear();
+    if (_sparta_read_file(map_sector, length, &dir, nullptr))
+        return true;
+
+    for (uint32_t off = SPARTA_DIR_ENTRY_SIZE; off + SPARTA_DIR_ENTRY_SIZE <= dir.size(); off += SPARTA_DIR_ENTRY_SIZE)
+    {
+        const uint8_t *entry = &dir[off];
+        if (entry[0] == 0) // end of directory
+            break;
+        if ((entry[0] & SPARTA_FLAG_DELETED) || !(entry[0] & SPARTA_FLAG_IN_USE))
+            continue;
+
+        uint16_t map = UINT16_FROM_HILOBYTES(entry[2], entry[1]);
+        if (entry[0] & SPARTA_FLAG_SUBDIR)
+        {
+            if (depth < DISK_CONTENTS_MAX_DEPTH)
+                _sparta_read_dir(map, depth + 1);
+            continue;
+        }
+
+        uint32_t size = entry[3] | (entry[4] << 8) | (entry[5] << 16);
+        uint64_t hash;
+        if (_sparta_read_file(map, size, nullptr, &hash))
+        {
+            Debug_printf("DiskContents: broken sector map of \"%.8s.%.3s\"\n", &entry[6], &entry[14]);
+            continue;
+        }
+        _add_file(&entry[6], &entry[14], size, hash);
+    }
+    return false;
+}
+
+disk_dos_t DiskContents::_read_atr(FileHandler *f, uint32_t size)
+{
+    _atr._disk_filename[0] = '\0';
+    if (_atr.mount(f, size) != MEDIATYPE_ATR)
+    {
+        f->close();
+        return DISK_DOS_UNKNOWN;
+    }
+    _sector_size = _atr.sector_size(4);
+    if (_sector_size > DISK_BYTES_PER_SECTOR_DOUBLE)
+    {
+        _atr.unmount();
+        return DISK_DOS_UNKNOWN;
+    }
+
+    disk_dos_t dos = DISK_DOS_UNKNOWN;
+
+    // SpartaDOS keeps file system version and main directory in boot sector
+    if (!_read_sector(1))
+    {
+        const uint8_t *boot = _atr._disk_sectorbuff;
+        uint8_t version = boot[SPARTA_BOOT_VERSION];
+        uint16_t main_dir = UINT16_FROM_HILOBYTES(boot[SPARTA_BOOT_MAIN_DIR + 1], boot[SPARTA_BOOT_MAIN_DIR]);
+        if ((version == 0x11 || version == 0x20 || version == 0x21) && main_dir > 3 && main_dir <= _atr._disk_num_sectors)
+        {
+            if (!_sparta_read_dir(main_dir, 0))
+                dos = DISK_DOS_SPARTA;
+            else
+                _files->clear();
+        }
+    }
+
+    // DOS 2 has directory at fixed place, formatted disk has VTOC with DOS code
+    if (dos == DISK_DOS_UNKNOWN && _atr._disk_num_sectors >= DOS2_DIR_SECTOR + DOS2_DIR_SECTORS
+        && !_read_sector(DOS2_VTOC_SECTOR) && _atr._disk_sectorbuff[0] != 0)
+    {
+        if (!_dos2_read_dir(DOS2_DIR_SECTOR, 0))
+            dos = DISK_DOS_ATARI;
+        else
+            _files->clear();
+    }
+
+    _atr.unmount();
+    return dos;
+}
+
+// Executable is the only file of the image, named after the image in 8.3 form
+disk_dos_t DiskContents::_read_xex(FileHandler *f, const char *filename)
+{
+    uint8_t name[8], ext[3];
+    memset(name, ' ', sizeof(name));
+    memset(ext, ' ', sizeof(ext));
+
+    const char *base = strrchr(filename, '/');
+    base = base != nullptr ? base + 1 : filename;
+    const char *dot = strrchr(base, '.');
+    for (int i = 0; i < (int)sizeof(name) && base + i != dot && base[i] != '\0'; i++)
+        name[i] = base[i] == ' ' ? '_' : base[i];
+    for (int i = 0; dot != nullptr && i < (int)sizeof(ext) && dot[i + 1] != '\0'; i++)
+        ext[i] = dot[i + 1] == ' ' ? '_' : dot[i + 1];
+
+    std::vector<uint8_t> buf(XEX_READ_BUFFER_SIZE);
+    uint64_t hash = DISK_CONTENTS_HASH_INIT;
+    uint32_t size = 0;
+    size_t count;
+    f->seek(0, SEEK_SET);
+    while ((count = f->read(buf.data(), 1, buf.size())) > 0)
+    {
+        hash = disk_contents_hash(hash, buf.data(), count);
+        size += count;
+    }
+    f->close();
+
+    if (name[0] == ' ')
+        return DISK_DOS_UNKNOWN;
+    _add_file(name, ext, size, hash);
+    return DISK_DOS_XEX;
+}
+
+disk_dos_t DiskContents::read(FileHandler *f, uint32_t size, const char *filename, std::vector<disk_content_file> &files)
+{
+    DiskContents contents(files);
+    files.clear();
+
+    switch (MediaType::discover_disktype(filename))
+    {
+    case MEDIATYPE_ATR:
+        return contents._read_atr(f, size);
+    case MEDIATYPE_XEX:
+        return contents._read_xex(f, filename);
+    default:
+        f->close();
+        return DISK_DOS_UNKNOWN;
+    }
+}
+
+#endif // BUILD_ATARI
@@ -0,0 +1,74 @@
+#ifndef _DISK_CONTENTS_
+#define _DISK_CONTENTS_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <vector>
+
+#include "diskTypeAtr.h"
+
+#define DISK_CONTENTS_NAME_LEN 12   // "FILENAME.EXT"
+#define DISK_CONTENTS_MAX_DEPTH 8   // nested MyDOS and SpartaDOS directories
+
+#define DISK_CONTENTS_HASH_INIT 14695981039346656037ULL // FNV-1a 64 offset basis
+#define DISK_CONTENTS_HASH_PRIME 1099511628211ULL
+
+enum disk_dos_t : uint8_t
+{
+    DISK_DOS_UNKNOWN = 0,
+    DISK_DOS_ATARI,     // Atari DOS 2.x, MyDOS and compatible
+    DISK_DOS_SPARTA,    // SpartaDOS file system
+    DISK_DOS_XEX,       // executable, the image is its only file
+    DISK_DOS_COUNT
+};
+
+struct disk_content_file
+{
+    char name[DISK_CONTENTS_NAME_LEN + 1]; // upper case "NAME.EXT"
+    uint32_t size;
+    uint64_t hash; // of file data, same file in different images has the same hash
+};
+
+inline uint64_t disk_contents_hash(uint64_t hash, const uint8_t *buf, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+        hash = (hash ^ buf[i]) * DISK_CONTENTS_HASH_PRIME;
+    return hash;
+}
+
+/*
+ Lists files stored in Atari disk image by walking its DOS directories. Sectors are read
+ through MediaTypeATR, every file is read to the end to get its exact size and the hash
+ of its data. Files in subdirectories are listed by their names only.
+*/
+class DiskContents
+{
+private:
+    MediaTypeATR _atr;
+    uint16_t _sector_size = 0;
+    uint32_t _sectors_read = 0;
+    std::vector<disk_content_file> *_files = nullptr;
+
+    bool _read_sector(uint16_t sectornum);
+    void _add_file(const uint8_t *name, const uint8_t *ext, uint32_t size, uint64_t hash);
+
+    bool _dos2_valid_entry(const uint8_t *entry);
+    bool _dos2_read_dir(uint16_t first_sector, int depth);
+    bool _dos2_read_file(uint16_t sector, bool no_file_number, uint32_t &size, uint64_t &hash);
+
+    bool _sparta_read_dir(uint16_t map_sector, int depth);
+    bool _sparta_read_file(uint16_t map_sector, uint32_t length, std::vector<uint8_t> *data, uint64_t *hash);
+
+    disk_dos_t _read_atr(FileHandler *f, uint32_t size);
+    disk_dos_t _read_xex(FileHandler *f, const char *filename);
+
+public:
+    DiskContents(std::vector<disk_content_file> &files) : _files(&files) {};
+
+    // Lists files of ATR or XEX image (by file name extension), takes over the file and closes it
+    // Returns DISK_DOS_UNKNOWN if no known directory structure is found
+    static disk_dos_t read(FileHandler *f, uint32_t size, const char *filename, std::vector<disk_content_file> &files);
+};
+
+#endif // _DISK_CONTENTS_
@@ -0,0 +1,216 @@
+#ifdef BUILD_ATARI // temporary
+
+#include "diskOverlay.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include "../../include/debug.h"
+
+#include "fnFsSD.h"
+#include "utils.h"
+
+#define OVERLAY_MAGIC 0x564F4E46 // 'FNOV'
+#define OVERLAY_VERSION 1
+
+struct overlay_header
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t sector_size;
+    uint32_t num_sectors;
+    uint32_t image_size;
+};
+
+struct overlay_record
+{
+    uint16_t sectornum;
+    uint16_t len;
+};
+
+DiskOverlay::~DiskOverlay()
+{
+    close();
+}
+
+// Overlay file name is MD5 of host and image path
+std::string DiskOverlay::make_path(const char *hostname, const char *image_path)
+{
+    std::string key(hostname);
+    key += '\n';
+    key += image_path;
+
+    return std::string(OVERLAY_DIR "/") + util_md5_hex(key.data(), key.length()) + ".ovl";
+}
+
+bool DiskOverlay::open(const std::string &path, uint32_t num_sectors, uint16_t sector_size, uint32_t image_size)
+{
+    close();
+
+    if (!fnSDFAT.running() || num_sectors == 0 || num_sectors > 0xFFFF)
+        return false;
+
+    _path = path;
+    _num_sectors = num_sectors;
+    _sector_size = sector_size;
+    _image_size = image_size;
+    _count = 0;
+    _end = 0;
+    _bitmap.assign(num_sectors / 8 + 1, 0);
+    _offsets.assign(num_sectors + 1, 0);
+    _active = true;
+
+    if (fnSDFAT.exists(_path.c_str()) && !_load())
+    {
+        Debug_printf("Overlay \"%s\" does not match the image, discarding it\n", _path.c_str());
+        fnSDFAT.remove(_path.c_str());
+        _count = 0;
+        _end = 0;
+        _bitmap.assign(_bitmap.size(), 0);
+    }
+
+    Debug_printf("Overlay \"%s\" opened, %u sectors\n", _path.c_str(), _count);
+    return true;
+}
+
+void DiskOverlay::close()
+{
+    _close_file();
+    _active = false;
+}
+
+void DiskOverlay::_close_file()
+{
+    if (_fh != nullptr)
+    {
+        _fh->close();
+        _fh = nullptr;
+    }
+}
+
+void DiskOverlay::_set(uint16_t sectornum, uint32_t offset)
+{
+    if (!has(sectornum))
+        _count++;
+    _bitmap[sectornum >> 3] |= 1 << (sectornum & 7);
+    _offsets[sectornum] = offset;
+}
+
+// Returns FALSE if the file belongs to different image
+bool DiskOverlay::_load()
+{
+    _fh = fnSDFAT.filehandler_open(_path.c_str(), "rb+");
+    if (_fh == nullptr)
+        return false;
+
+    overlay_header hdr;
+    if (_fh->read(&hdr, sizeof(hdr), 1) != 1 || hdr.magic != OVERLAY_MAGIC || hdr.version != OVERLAY_VERSION
+        || hdr.sector_size != _sector_size || hdr.num_sectors != _num_sectors || hdr.image_size != _image_size)
+    {
+        _close_file();
+        return false;
+    }
+
+    uint32_t offset = sizeof(hdr);
+    overlay_record rec;
+    while (_fh->read(&rec, sizeof(rec), 1) == 1)
+    {
+        if (rec.sectornum == 0 || rec.sectornum > _num_sectors || rec.len > _sector_size
+            || _fh->seek(rec.len, SEEK_CUR) != 0)
+            break;
+        uint32_t data = offset + sizeof(rec);
+        // seeking past the end does not fail, make sure the data is there
+        if ((uint32_t)_fh->tell() != data + rec.len)
+            break;
+        _set(rec.sectornum, data);
+        offset = data + rec.len;
+    }
+    _end = offset;
+
+    if ((uint32_t)_fh->tell() != _end)
+        Debug_printf("Overlay record at %u is incomplete, dropping it\n", _end);
+    return true;
+}
+
+bool DiskOverlay::_create()
+{
+    fnSDFAT.create_path(OVERLAY_DIR);
+    _fh = fnSDFAT.filehandler_open(_path.c_str(), "wb+");
+    if (_fh == nullptr)
+    {
+        Debug_printf("Failed to create overlay \"%s\"\n", _path.c_str());
+        return false;
+    }
+
+    overlay_header hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = OVERLAY_MAGIC;
+    hdr.version = OVERLAY_VERSION;
+    hdr.sector_size = _sector_size;
+    hdr.num_sectors = _num_sectors;
+    hdr.image_size = _image_size;
+    if (_fh->write(&hdr, sizeof(hdr), 1) != 1)
+    {
+        Debug_printf("Failed to write overlay header (%d)\n", errno);
+        _close_file();
+        return false;
+    }
+    _end = sizeof(hdr);
+    return true;
+}
+
+// Returns TRUE if an error condition occurred
+bool DiskOverlay::read(uint16_t sectornum, uint8_t *buf, uint16_t len)
+{
+    if (_fh == nullptr || !has(sectornum))
+        return true;
+
+    return _fh->seek(_offsets[sectornum], SEEK_SET) != 0 || _fh->read(buf, 1, len) != len;
+}
+
+// Returns TRUE if an error condition occurred
+bool DiskOverlay::write(uint16_t sectornum, const uint8_t *buf, uint16_t len)
+{
+    if (!_active || sectornum == 0 || sectornum > _num_sectors || len > _sector_size)
+        return true;
+
+    if (_fh == nullptr && !_create())
+        return true;
+
+    bool err;
+    if (has(sectornum))
+    {
+        err = _fh->seek(_offsets[sectornum], SEEK_SET) != 0 || _fh->write(buf, 1, len) != len;
+    }
+    else
+    {
+        overlay_record rec;
+        rec.sectornum = sectornum;
+        rec.len = len;
+        err = _fh->seek(_end, SEEK_SET) != 0 || _fh->write(&rec, sizeof(rec), 1) != 1
+            || _fh->write(buf, 1, len) != len;
+        if (!err)
+        {
+            _set(sectornum, _end + sizeof(rec));
+            _end += sizeof(rec) + len;
+        }
+    }
+
+    if (_fh->flush() != 0)
+        err = true;
+    if (err)
+        Debug_printf("Overlay write of sector %u failed (%d)\n", sectornum, errno);
+    return err;
+}
+
+void DiskOverlay::discard()
+{
+    _close_file();
+    fnSDFAT.remove(_path.c_str());
+    _count = 0;
+    _end = 0;
+    _bitmap.assign(_bitmap.size(), 0);
+    Debug_printf("Overlay \"%s\" discarded\n", _path.c_str());
+}
+
+#endif /* BUILD_ATARI */
@@ -0,0 +1,65 @@
+#ifndef _DISK_OVERLAY_
+#define _DISK_OVERLAY_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "fnFile.h"
+
+#define OVERLAY_DIR "/FujiNet/overlay"
+
+/*
+ Copy-on-write overlay of read-only disk image, stored in FujiNet directory on SD.
+
+ Sectors written to the image are kept in the overlay file, reads of these sectors are served
+ from it and other sectors come from the image. The file starts with a header identifying
+ the image geometry, followed by records of sector number and sector data, appended in order
+ of first write. When the overlay is opened, records are scanned into sector bitmap and
+ offsets, record cut short by crash is dropped. Overlay of image with different geometry
+ is discarded. The file is created with the first write.
+*/
+class DiskOverlay
+{
+private:
+    FileHandler *_fh = nullptr;
+    std::string _path;
+    bool _active = false;
+    uint32_t _num_sectors = 0;
+    uint16_t _sector_size = 0;
+    uint32_t _image_size = 0;
+    uint32_t _count = 0;
+    uint32_t _end = 0;                  // file offset where next record is appended
+    std::vector<uint8_t> _bitmap;       // sectors present in overlay, bit per sector number
+    std::vector<uint32_t> _offsets;     // file offsets of sector data, by sector number
+
+    void _close_file();
+    void _set(uint16_t sectornum, uint32_t offset);
+    bool _load();
+    bool _create();
+
+public:
+    ~DiskOverlay();
+
+    static std::string make_path(const char *hostname, const char *image_path);
+
+    // Returns FALSE if the overlay can't be used
+    bool open(const std::string &path, uint32_t num_sectors, uint16_t sector_size, uint32_t image_size);
+    void close();
+
+    bool active() { return _active; };
+    uint32_t count() { return _count; };
+    bool has(uint16_t sectornum)
+    {
+        return _active && sectornum <= _num_sectors && (_bitmap[sectornum >> 3] & (1 << (sectornum & 7))) != 0;
+    };
+
+    // Return TRUE if an error condition occurred
+    bool read(uint16_t sectornum, uint8_t *buf, uint16_t len);
+    bool write(uint16_t sectornum, const uint8_t *buf, uint16_t len);
+
+    // Remove overlay file, image is seen unchanged again
+    void discard();
+};
+
+#endif // _DISK_OVERLAY_
@@ -54,7 +54,6 @@ protected:
     uint16_t _disk_sector_size = DISK_BYTES_PER_SECTOR_SINGLE;
     int32_t _disk_last_sector = INVALID_SECTOR_VALUE;
     uint8_t _disk_controller_status = DISK_CTRL_STATUS_CLEAR;
-    bool _disk_readonly = true;
     uint16_t _high_score_sector = 0; /* High score sector to allow write. 1-65535 */
     uint8_t _high_score_num_sectors = 0;
     
@@ -81,6 +80,7 @@ public:
     uint32_t _disk_num_sectors = 0;
 
     fujiHost *_disk_host = nullptr;
+    bool _disk_readonly = true;
     // FILE *_disk_hsfileh = nullptr;
 
     mediatype_t _disktype = MEDIATYPE_UNKNOWN;
@@ -97,6 +97,25 @@ public:
     // Returns TRUE if an error condition occurred
     virtual bool write(uint16_t sectornum, bool verify);
 
+    // Write out sectors held back by write-back caching
+    // Returns TRUE if an error condition occurred
+    virtual bool flush() { return false; };
+    // Called periodically while no command is pending
+    virtual void idle() {};
+    // Sectors are held back, so status() has work to do
+    virtual bool held() { return false; };
+
+    // Write sectors kept in copy-on-write overlay into the image and remove the overlay
+    // Returns TRUE if an error condition occurred
+    virtual bool overlay_merge() { return true; };
+    // Remove copy-on-write overlay, image is seen unchanged again
+    virtual void overlay_discard() {};
+    // Number of sectors kept in copy-on-write overlay
+    virtual uint32_t overlay_sectors() { return 0; };
+
+    // File of mounted image, overlay_merge() replaces it
+    FileHandler *fileh() { return _disk_fileh; };
+
     // Always returns 128 for the first 3 sectors, otherwise _sectorSize
     virtual uint16_t sector_size(uint16_t sectornum);
     
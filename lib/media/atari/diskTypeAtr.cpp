@@ -10,12 +10,34 @@
 #include "../../include/debug.h"
 
 #include "disk.h"
+#include "fnConfig.h"
+#include "fnFsSD.h"
 #include "fnSystem.h"
 
 #include "utils.h"
 
 #define ATR_MAGIC_HEADER 0x0296 // Sum of 'NICKATARI'
 
+MediaTypeATR::~MediaTypeATR()
+{
+    flush();
+}
+
+void MediaTypeATR::unmount()
+{
+    if (flush())
+    {
+        // held sectors are gone with the image, only their intent log can bring them back
+        std::string log_path;
+        if (_intent_log_path(log_path) && fnSDFAT.exists(log_path.c_str()))
+            Debug_printf("ATR UNMOUNT: %u held bytes not written, kept in \"%s\" for the next mount\n", _dirty_bytes, log_path.c_str());
+        else
+            Debug_printf("ATR UNMOUNT: %u held bytes not written and lost\n", _dirty_bytes);
+    }
+    _overlay.close();
+    MediaType::unmount();
+}
+
 // Returns byte offset of given sector number (1-based)
 uint32_t MediaTypeATR::_sector_to_offset(uint16_t sectorNum)
 {
@@ -56,6 +78,12 @@ bool MediaTypeATR::read(uint16_t sectornum, uint16_t *readcount)
 {
     Debug_printf("ATR READ %d / %d\n", sectornum, _disk_num_sectors);
 
+    return _read(sectornum, readcount);
+}
+
+// Returns TRUE if an error condition occurred
+bool MediaTypeATR::_read(uint16_t sectornum, uint16_t *readcount)
+{
     *readcount = 0;
 
     // Return an error if we're trying to read beyond the end of the disk
@@ -69,6 +97,28 @@ bool MediaTypeATR::read(uint16_t sectornum, uint16_t *readcount)
 
     memset(_disk_sectorbuff, 0, sizeof(_disk_sectorbuff));
 
+    // Sector may be held by write-back and not in the image yet
+    if (!_dirty.empty())
+    {
+        auto it = _dirty.find(_sector_to_offset(sectornum));
+        if (it != _dirty.end())
+        {
+            memcpy(_disk_sectorbuff, it->second.data(), sectorSize);
+            _disk_last_sector = INVALID_SECTOR_VALUE;
+            *readcount = sectorSize;
+            return false;
+        }
+    }
+
+    // Sectors written to read-only image are in the overlay
+    if (_overlay.has(sectornum))
+    {
+        bool err = _overlay.read(sectornum, _disk_sectorbuff, sectorSize);
+        _disk_last_sector = INVALID_SECTOR_VALUE;
+        *readcount = sectorSize;
+        return err;
+    }
+
     bool err = false;
     // Perform a seek if we're not reading the sector after the last one we read
     if (sectornum != _disk_last_sector + 1)
@@ -95,14 +145,76 @@ bool inHighScoreRange(int minimum, int maximum, int val)
     return ((minimum <= val) && (val <= maximum));
 }
 
+// Returns file to write sectors into, high score images are opened for writing each time
+FileHandler *MediaTypeATR::_begin_write()
+{
+    if (_high_score_sector == 0)
+        return _disk_fileh;
+
+    Debug_printf("High score mode activated, attempting write open\n");
+    if (_disk_host == nullptr)
+    {
+        Debug_printf("!!! Why is host slot null?\n");
+        return _disk_fileh;
+    }
+    return _disk_host->filehandler_open(_disk_filename, _disk_filename, strlen(_disk_filename) + 1, "r+");
+}
+
+void MediaTypeATR::_end_write(FileHandler *fh)
+{
+    int ret = fh->flush();
+    Debug_printf("ATR::write fsync:%d\n", ret);
+
+    if (fh != _disk_fileh)
+    {
+        Debug_printf("Closing high score sector.\n");
+        fh->close();
+    }
+}
+
 // Returns TRUE if an error condition occurred
-bool MediaTypeATR::write(uint16_t sectornum, bool verify)
+bool MediaTypeATR::_write_data(FileHandler *fh, uint32_t offset, const uint8_t *buf, uint32_t len)
 {
-    FileHandler *oldFileh, *hsFileh;
+    int e = fh->seek(offset, SEEK_SET);
+    if (e != 0)
+    {
+        Debug_printf("::write seek error %d\n", e);
+        return true;
+    }
+    size_t out = fh->write(buf, 1, len);
+    if (out != len)
+    {
+        Debug_printf("::write error %u, %d\n", (unsigned)out, errno);
+        return true;
+    }
+    return false;
+}
+
+// Keep sector from sector buffer until the next flush
+// Returns TRUE if an error condition occurred
+bool MediaTypeATR::_hold_sector(uint32_t offset, uint16_t len)
+{
+    // Don't take more while held sectors can't be written
+    if (_flush_failed && flush())
+        return true;
 
-    oldFileh = nullptr;
-    hsFileh = nullptr;
+    auto it = _dirty.find(offset);
+    if (it == _dirty.end())
+    {
+        it = _dirty.insert(std::make_pair(offset, std::vector<uint8_t>())).first;
+        _dirty_bytes += len;
+    }
+    it->second.assign(_disk_sectorbuff, _disk_sectorbuff + len);
+    _last_write_ms = fnSystem.millis();
+
+    if (_dirty_bytes >= ATR_WRITEBACK_MAX_DIRTY)
+        return flush();
+    return false;
+}
 
+// Returns TRUE if an error condition occurred
+bool MediaTypeATR::write(uint16_t sectornum, bool verify)
+{
     Debug_printf("ATR WRITE %d / %d\n", sectornum, _disk_num_sectors);
 
     // Return an error if we're trying to write beyond the end of the disk
@@ -112,66 +224,278 @@ bool MediaTypeATR::write(uint16_t sectornum, bool verify)
         return true;
     }
 
-    if (_high_score_sector != 0)
-    {
-        Debug_printf("High score mode activated, attempting write open\n");
-        if (_disk_host == nullptr)
-        {
-            Debug_printf("!!! Why is host slot null?\n");
-        }
-        else
-        {
-            oldFileh = _disk_fileh;
-            hsFileh = _disk_host->filehandler_open(_disk_filename, _disk_filename, strlen(_disk_filename) + 1, "r+");
-            _disk_fileh = hsFileh;
-        }
-    }
     uint16_t sectorSize = sector_size(sectornum);
     uint32_t offset = _sector_to_offset(sectornum);
 
     _disk_last_sector = INVALID_SECTOR_VALUE;
 
-    // Perform a seek if we're writing to the sector after the last one
-    int e;
-    if (sectornum != _disk_last_sector + 1)
+    if (_overlay.active())
+        return _overlay.write(sectornum, _disk_sectorbuff, sectorSize);
+
+    if (_write_back)
+        return _hold_sector(offset, sectorSize);
+
+    FileHandler *fh = _begin_write();
+    if (fh == nullptr)
+        return true;
+
+    bool err = _write_data(fh, offset, _disk_sectorbuff, sectorSize);
+    _end_write(fh);
+
+    if (err == false && fh == _disk_fileh)
+        _disk_last_sector = sectornum;
+
+    return err;
+}
+
+// Write out held sectors, merged into runs of contiguous sectors
+// Returns TRUE if an error condition occurred
+bool MediaTypeATR::flush()
+{
+    if (_dirty.empty())
+        return false;
+
+    uint64_t start_ms = fnSystem.millis();
+
+    std::vector<write_run> runs;
+    for (auto &d : _dirty)
     {
-        e = _disk_fileh->seek(offset, SEEK_SET);
-        if (e != 0)
+        if (runs.empty() || runs.back().offset + runs.back().data.size() != d.first)
         {
-            Debug_printf("::write seek error %d\n", e);
-            return true;
+            runs.push_back(write_run());
+            runs.back().offset = d.first;
         }
+        runs.back().data.insert(runs.back().data.end(), d.second.begin(), d.second.end());
     }
-    // Write the data
-    e = _disk_fileh->write(_disk_sectorbuff, 1, sectorSize);
-    if (e != sectorSize)
+
+    std::string log_path;
+    bool logged = _intent_log_path(log_path) && _write_intent_log(log_path, runs);
+
+    FileHandler *fh = _begin_write();
+    bool err = fh == nullptr;
+    for (const write_run &run : runs)
     {
-        Debug_printf("::write error %d, %d\n", e, errno);
-        return true;
+        if (err)
+            break;
+        err = _write_data(fh, run.offset, run.data.data(), run.data.size());
     }
+    if (fh != nullptr)
+        _end_write(fh);
 
-    int ret = _disk_fileh->flush();
-    Debug_printf("ATR::write fsync:%d\n", ret);
+    // Log is removed once the image has the data. On error it is kept with held sectors,
+    // which are written again with a new log, or replayed on the next mount (see unmount())
+    if (!err && !log_path.empty() && (logged || fnSDFAT.exists(log_path.c_str())))
+        fnSDFAT.remove(log_path.c_str());
 
-    if (_high_score_sector != 0)
+    _disk_last_sector = INVALID_SECTOR_VALUE;
+
+    if (err)
     {
-        Debug_printf("Closing high score sector.\n");
+        Debug_printf("ATR FLUSH failed, %u bytes held\n", _dirty_bytes);
+        _flush_failed = true;
+        _last_write_ms = fnSystem.millis();
+        return true;
+    }
 
-        if (hsFileh != nullptr)
-            hsFileh->close();
+    Debug_printf("ATR FLUSH %u bytes in %u runs, %lu ms\n", _dirty_bytes, (unsigned)runs.size(),
+                 (unsigned long)(fnSystem.millis() - start_ms));
+    _dirty.clear();
+    _dirty_bytes = 0;
+    _flush_failed = false;
+    return false;
+}
+
+// Returns TRUE if an error condition occurred
+bool MediaTypeATR::overlay_merge()
+{
+    if (!_overlay.active())
+        return true;
+    if (_overlay.count() == 0)
+        return false;
 
-        _disk_fileh = oldFileh;
+    Debug_printf("ATR OVERLAY MERGE %u sectors\n", _overlay.count());
+
+    // Image is mounted read-only, open it for writing just for the merge
+    FileHandler *fh = nullptr;
+    if (_disk_host != nullptr)
+        fh = _disk_host->filehandler_open(_disk_filename, _disk_filename, strlen(_disk_filename) + 1, "r+");
+    if (fh == nullptr)
+    {
+        Debug_println("Failed to open image for merging overlay");
+        return true;
+    }
+
+    uint8_t buf[DISK_SECTORBUF_SIZE];
+    bool err = false;
+    for (uint32_t sectornum = 1; sectornum <= _disk_num_sectors && err == false; sectornum++)
+    {
+        if (!_overlay.has(sectornum))
+            continue;
+        uint16_t len = sector_size(sectornum);
+        err = _overlay.read(sectornum, buf, len) || _write_data(fh, _sector_to_offset(sectornum), buf, len);
     }
+    if (fh->flush() != 0)
+        err = true;
+    fh->close();
 
-    _disk_last_sector = sectornum;
+    // Overlay is kept until the image has all of it
+    if (err)
+    {
+        Debug_println("ATR OVERLAY MERGE failed");
+        return true;
+    }
+    _overlay.discard();
+    _disk_last_sector = INVALID_SECTOR_VALUE;
 
+    // Mounted handle may still hold image data from before the merge in its caches
+    // (FTP cached copy, SMB read-ahead), read the image through a new one
+    FileHandler *base = _disk_host->filehandler_open(_disk_filename, _disk_filename, strlen(_disk_filename) + 1, "r");
+    if (base == nullptr)
+    {
+        Debug_println("Failed to reopen image after merging overlay");
+        return true;
+    }
+    _disk_fileh->close();
+    _disk_fileh = base;
     return false;
 }
 
+void MediaTypeATR::overlay_discard()
+{
+    Debug_println("ATR OVERLAY DISCARD");
+    _overlay.discard();
+    _disk_last_sector = INVALID_SECTOR_VALUE;
+}
+
+void MediaTypeATR::idle()
+{
+    if (!_dirty.empty() && fnSystem.millis() - _last_write_ms >= ATR_WRITEBACK_IDLE_MS)
+        flush();
+}
+
+// Intent log is kept only for images on SD, returns FALSE if there is none
+bool MediaTypeATR::_intent_log_path(std::string &path)
+{
+    if (_disk_host == nullptr || _disk_host->get_type() != HOSTTYPE_LOCAL || _disk_filename[0] == '\0')
+        return false;
+
+    path = _disk_filename;
+    path += ATR_INTENT_LOG_SUFFIX;
+    return true;
+}
+
+/*
+ Intent log layout, all values are 32-bit in host byte order:
+ magic, then for each run: image offset, length, data
+ and the commit record at the end: ATR_INTENT_LOG_COMMIT, total length of data.
+ Log without valid commit record was not completed and the image was not touched yet.
+*/
+#define ATR_INTENT_LOG_MAGIC 0x4C42574E // 'NWBL'
+#define ATR_INTENT_LOG_COMMIT 0xFFFFFFFF
+
+// Returns FALSE on error
+bool MediaTypeATR::_write_intent_log(const std::string &path, const std::vector<write_run> &runs)
+{
+    FileHandler *fh = fnSDFAT.filehandler_open(path.c_str(), FILE_WRITE);
+    if (fh == nullptr)
+    {
+        Debug_printf("Failed to create intent log \"%s\"\n", path.c_str());
+        return false;
+    }
+
+    uint32_t magic = ATR_INTENT_LOG_MAGIC;
+    uint32_t total = 0;
+    bool ok = fh->write(&magic, sizeof(magic), 1) == 1;
+    for (const write_run &run : runs)
+    {
+        uint32_t rec[2] = {run.offset, (uint32_t)run.data.size()};
+        ok = ok && fh->write(rec, sizeof(rec), 1) == 1
+                && fh->write(run.data.data(), 1, run.data.size()) == run.data.size();
+        total += run.data.size();
+    }
+    uint32_t commit[2] = {ATR_INTENT_LOG_COMMIT, total};
+    ok = ok && fh->write(commit, sizeof(commit), 1) == 1 && fh->flush() == 0;
+    fh->close();
+
+    if (!ok)
+    {
+        Debug_printf("Failed to write intent log \"%s\"\n", path.c_str());
+        fnSDFAT.remove(path.c_str());
+    }
+    return ok;
+}
+
+// Complete flush interrupted by crash, runs from committed log are written into the image again
+void MediaTypeATR::_replay_intent_log()
+{
+    std::string path;
+    if (!_intent_log_path(path) || !fnSDFAT.exists(path.c_str()))
+        return;
+
+    Debug_printf("Found intent log \"%s\"\n", path.c_str());
+
+    std::vector<write_run> runs;
+    bool committed = false;
+    FileHandler *fh = fnSDFAT.filehandler_open(path.c_str(), FILE_READ);
+    if (fh != nullptr)
+    {
+        uint32_t magic = 0;
+        uint32_t total = 0;
+        if (fh->read(&magic, sizeof(magic), 1) == 1 && magic == ATR_INTENT_LOG_MAGIC)
+        {
+            uint32_t rec[2];
+            while (fh->read(rec, sizeof(rec), 1) == 1)
+            {
+                if (rec[0] == ATR_INTENT_LOG_COMMIT)
+                {
+                    committed = rec[1] == total;
+                    break;
+                }
+                // Runs are never longer than the dirty limit plus the sector which reached it
+                if (rec[1] > ATR_WRITEBACK_MAX_DIRTY + DISK_SECTORBUF_SIZE)
+                    break;
+                runs.push_back(write_run());
+                runs.back().offset = rec[0];
+                runs.back().data.resize(rec[1]);
+                if (fh->read(runs.back().data.data(), 1, rec[1]) != rec[1])
+                    break;
+                total += rec[1];
+            }
+        }
+        fh->close();
+    }
+
+    if (committed)
+    {
+        FileHandler *fimg = fnSDFAT.filehandler_open(_disk_filename, "rb+");
+        bool err = fimg == nullptr;
+        for (const write_run &run : runs)
+        {
+            if (err)
+                break;
+            err = _write_data(fimg, run.offset, run.data.data(), run.data.size());
+        }
+        if (fimg != nullptr)
+        {
+            err = fimg->flush() != 0 || err;
+            fimg->close();
+        }
+        Debug_printf("Intent log replay %s, %u runs\n", err ? "failed" : "done", (unsigned)runs.size());
+    }
+    else
+        Debug_println("Intent log was not completed, ignoring it");
+
+    fnSDFAT.remove(path.c_str());
+}
+
 void MediaTypeATR::status(uint8_t statusbuff[4])
 {
     statusbuff[0] = DISK_DRIVE_STATUS_CLEAR;
 
+    // Held sectors are written before status is reported
+    if (flush())
+        statusbuff[0] |= DISK_DRIVE_STATUS_PUT_FAILED;
+
     if (_disk_sector_size > 128)
         statusbuff[0] |= DISK_DRIVE_STATUS_DOUBLE_DENSITY;
 
@@ -224,6 +548,8 @@ mediatype_t MediaTypeATR::mount(FileHandler *f, uint32_t disksize)
 
     _disktype = MEDIATYPE_UNKNOWN;
 
+    _replay_intent_log();
+
     uint16_t num_bytes_sector;
     uint32_t num_paragraphs;
     uint8_t buf[16];
@@ -274,6 +600,19 @@ mediatype_t MediaTypeATR::mount(FileHandler *f, uint32_t disksize)
     Debug_printf("mounted ATR: paragraphs=%d, sect_size=%d, sect_count=%d, disk_size=%d\n",
                  num_paragraphs, num_bytes_sector, _disk_num_sectors, disksize);
 
+    // Writes to read-only remote image are kept on SD, except for high score images
+    // which already write their high score sectors to the host
+    if (_disk_readonly && _high_score_sector == 0 && Config.get_general_disk_overlay()
+        && _disk_host != nullptr && _disk_host->get_type() != HOSTTYPE_LOCAL)
+    {
+        _overlay.open(DiskOverlay::make_path(_disk_host->get_hostname(), _disk_filename),
+                      _disk_num_sectors, _disk_sector_size, disksize);
+    }
+
+    _write_back = !_overlay.active() && Config.get_general_disk_write_back();
+    if (_write_back)
+        Debug_println("Write-back enabled");
+
     _disktype = MEDIATYPE_ATR;
 
     return _disktype;
@@ -328,10 +667,14 @@ bool MediaTypeATR::create(FileHandler *f, uint16_t sectorSize, uint16_t numSecto
     Debug_printf("Write header to ATR: sec_size=%d, sectors=%d, paragraphs=%d, bytes=%d\n",
                  sectorSize, numSectors, num_paragraphs, total_size);
 
-    uint32_t offset = f->write(&atrHeader, 1, sizeof(atrHeader));
+    if (f->write(&atrHeader, 1, sizeof(atrHeader)) != sizeof(atrHeader))
+    {
+        Debug_println("Error writing header");
+        return false;
+    }
 
-    // Write first three 128 uint8_t sectors
-    uint8_t blank[512] = {0};
+    // Write first three 128 uint8_t sectors, boot sectors are blank even where extended part isn't zeroed
+    uint8_t blank[128] = {0};
 
     if (sectorSize < 512)
     {
@@ -343,19 +686,14 @@ bool MediaTypeATR::create(FileHandler *f, uint16_t sectorSize, uint16_t numSecto
                 Debug_printf("Error writing sector %hhu\n", (uint8_t)i);
                 return false;
             }
-            offset += 128;
-            numSectors--;
         }
     }
 
-    // Write the rest of the sectors via sparse seek to the last sector
-    offset += (numSectors * sectorSize) - sectorSize;
-    f->seek(offset, SEEK_SET);
-    size_t out = f->write(blank, 1, sectorSize);
-
-    if (out != sectorSize)
+    // Other sectors are not written, the file is just extended to full size, which is instant
+    // on hosts with sparse files or native way of setting the size
+    if (f->truncate(sizeof(atrHeader) + total_size) != 0)
     {
-        Debug_println("Error writing last sector");
+        Debug_println("Error setting image size");
         return false;
     }
 
@@ -1,20 +1,78 @@
 #ifndef _MEDIATYPE_ATR_
 #define _MEDIATYPE_ATR_
 
+#include <map>
+#include <string>
+#include <vector>
+
 #include "diskType.h"
+#include "diskOverlay.h"
+
+#define ATR_WRITEBACK_IDLE_MS 1000      // held sectors are written after this time without writes
+#define ATR_WRITEBACK_MAX_DIRTY 32768   // bytes of held sectors which trigger writing them out
+#define ATR_INTENT_LOG_SUFFIX ".wbl"
+
+/*
+ With [General] disk_write_back enabled, written sectors are held in memory instead of being
+ written and flushed one by one. Held sectors are merged into runs of contiguous sectors and
+ written out when the bus is idle for ATR_WRITEBACK_IDLE_MS, when they grow over
+ ATR_WRITEBACK_MAX_DIRTY, on STATUS request and on unmount. For images on SD, the runs are
+ first stored in intent log next to the image, so a batch interrupted by crash is completed
+ on next mount.
 
+ With [General] disk_overlay enabled, writes to images mounted read-only from remote hosts go
+ to copy-on-write overlay on SD instead (see DiskOverlay), write-back is not used then. Images
+ with high score sector are not overlaid, their high score sectors keep going to the host.
+*/
 class MediaTypeATR : public MediaType
 {
 private:
+    struct write_run
+    {
+        uint32_t offset;
+        std::vector<uint8_t> data;
+    };
+
+    bool _write_back = false;
+    bool _flush_failed = false;
+    std::map<uint32_t, std::vector<uint8_t>> _dirty; // held sectors by image offset
+    uint32_t _dirty_bytes = 0;
+    uint64_t _last_write_ms = 0;
+
+    DiskOverlay _overlay;
+
     uint32_t _sector_to_offset(uint16_t sectorNum);
+    bool _read(uint16_t sectornum, uint16_t *readcount); // read() without logging
+
+    friend class DiskContents; // scans whole images with _read()
+
+    FileHandler *_begin_write();
+    void _end_write(FileHandler *fh);
+    bool _write_data(FileHandler *fh, uint32_t offset, const uint8_t *buf, uint32_t len);
+    bool _hold_sector(uint32_t offset, uint16_t len);
+
+    bool _intent_log_path(std::string &path);
+    bool _write_intent_log(const std::string &path, const std::vector<write_run> &runs);
+    void _replay_intent_log();
 
 public:
+    virtual ~MediaTypeATR();
+
     virtual bool read(uint16_t sectornum, uint16_t *readcount) override;
     virtual bool write(uint16_t sectornum, bool verify) override;
 
     virtual bool format(uint16_t *respopnsesize) override;
 
     virtual mediatype_t mount(FileHandler *f, uint32_t disksize) override;
+    virtual void unmount() override;
+
+    virtual bool flush() override;
+    virtual bool held() override { return !_dirty.empty(); };
+    virtual void idle() override;
+
+    virtual bool overlay_merge() override;
+    virtual void overlay_discard() override;
+    virtual uint32_t overlay_sectors() override { return _overlay.active() ? _overlay.count() : 0; };
 
     virtual void status(uint8_t statusbuff[4]) override;
 
@@ -30,6 +30,14 @@
 
 #define SECTOR_LINK_SIZE 3
 
+// XEX files up to this size are loaded into memory on mount and the whole virtual disk
+// is prepared in advance, bigger files are read sector by sector from the host
+#define XEX_PRELOAD_MAX_SIZE (1024 * 1024)
+
+// Layout of preloaded image
+#define XEX_IMAGE_DIRECTORY (BOOTLOADER_END * BOOT_SECTOR_SIZE)
+#define XEX_IMAGE_DATA (XEX_IMAGE_DIRECTORY + SECTOR_SIZE)
+
 /*
     The bootloader expects to find a file named "AUTORUN", so fake a directory
     with only that file.
@@ -78,6 +86,121 @@ void MediaTypeXEX::_fake_directory_entry()
     _disk_sectorbuff[15] = 0x20;
 }
 
+// Copy bootloader sector into _disk_sectorbuff
+void MediaTypeXEX::_boot_sector(uint16_t sectornum)
+{
+    int offset = BOOT_SECTOR_SIZE * (sectornum - 1);
+    int remain = _xex_bootloadersize - offset;
+    int bootcopy = BOOT_SECTOR_SIZE > remain ? remain : BOOT_SECTOR_SIZE;
+
+    Debug_printf("copying %d bytes from bootloader\n", bootcopy);
+    if (bootcopy > 0)
+        memcpy(_disk_sectorbuff, _xex_bootloader + offset, bootcopy);
+
+    // PicoBoot uses the first byte as a flag for whether it should read double or single density sectors
+    // Single = 0x80, Double = 0x00
+    if(SECTOR_SIZE == 256 && sectornum == 1 && _disk_sectorbuff[0] == 0x80)
+    {
+        Debug_print("setting PicoBoot double density flag\n");
+        _disk_sectorbuff[0] = 0x00;
+    }
+}
+
+/*
+    Read XEX data for given sector into _disk_sectorbuff and fill in the sector link.
+    Returns number of XEX bytes in the sector or -1 on error.
+*/
+int MediaTypeXEX::_data_sector(uint16_t sectornum)
+{
+    bool err = false;
+
+    int data_bytes = _disk_sector_size - SECTOR_LINK_SIZE;
+    // This is the number of bytes into the XEX file we should be reading
+    int xex_offset = data_bytes * (sectornum - FIRST_XEX_SECTOR);
+
+    // Perform a seek if we're not reading the sector after the last one we read
+    if (sectornum != _disk_last_sector + 1)
+    {
+        Debug_printf("seeking to offset %d in XEX\n", xex_offset);
+        err = _disk_fileh->seek(xex_offset, SEEK_SET) != 0;
+    }
+
+    if (err)
+        return -1;
+
+    Debug_printf("requesting %d bytes from XEX\n", data_bytes);
+    int read = _disk_fileh->read(_disk_sectorbuff, 1, data_bytes);
+    Debug_printf("received %d bytes\n", read);
+
+    // Fill in the sector link data pointing to the next sector
+    if(read >= 0)
+    {
+        // Provide number of bytes read
+        _disk_sectorbuff[_disk_sector_size - 1] = read;
+
+        // Only provide a next sector pointer if we read a full sector of data
+        if(read == data_bytes)
+        {
+            uint16_t next_sector = sectornum + 1;
+            _disk_sectorbuff[_disk_sector_size - 2] = LOBYTE_FROM_UINT16(next_sector);
+            _disk_sectorbuff[_disk_sector_size - 3] = HIBYTE_FROM_UINT16(next_sector);
+        }
+    }
+
+    return read;
+}
+
+/*
+    Load whole XEX file and build the virtual disk in memory:
+    bootloader sectors, directory sector and all linked data sectors.
+    Reads are then served from memory without any host access.
+*/
+bool MediaTypeXEX::_preload()
+{
+    uint16_t data_per_sector = _disk_sector_size - SECTOR_LINK_SIZE;
+    _xex_data_sectors = _disk_image_size / data_per_sector;
+    _xex_data_sectors += _disk_image_size % data_per_sector > 0 ? 1 : 0;
+
+    _xex_image = (uint8_t *)malloc(XEX_IMAGE_DATA + _xex_data_sectors * SECTOR_SIZE);
+    if (_xex_image == nullptr)
+    {
+        Debug_println("not enough memory to preload XEX");
+        return false;
+    }
+
+    for (uint16_t sectornum = 1; sectornum <= BOOTLOADER_END; sectornum++)
+    {
+        memset(_disk_sectorbuff, 0, sizeof(_disk_sectorbuff));
+        _boot_sector(sectornum);
+        memcpy(_xex_image + BOOT_SECTOR_SIZE * (sectornum - 1), _disk_sectorbuff, BOOT_SECTOR_SIZE);
+    }
+
+    memset(_disk_sectorbuff, 0, sizeof(_disk_sectorbuff));
+    _fake_directory_entry();
+    memcpy(_xex_image + XEX_IMAGE_DIRECTORY, _disk_sectorbuff, SECTOR_SIZE);
+
+    _disk_last_sector = INVALID_SECTOR_VALUE;
+    for (uint16_t i = 0; i < _xex_data_sectors; i++)
+    {
+        uint16_t sectornum = FIRST_XEX_SECTOR + i;
+        memset(_disk_sectorbuff, 0, sizeof(_disk_sectorbuff));
+        if (_data_sector(sectornum) <= 0)
+        {
+            Debug_printf("failed to preload XEX sector %d\n", sectornum);
+            free(_xex_image);
+            _xex_image = nullptr;
+            _disk_last_sector = INVALID_SECTOR_VALUE;
+            return false;
+        }
+        _disk_last_sector = sectornum;
+        memcpy(_xex_image + XEX_IMAGE_DATA + i * SECTOR_SIZE, _disk_sectorbuff, SECTOR_SIZE);
+    }
+    _disk_last_sector = INVALID_SECTOR_VALUE;
+
+    Debug_printf("preloaded XEX into %d data sectors\n", _xex_data_sectors);
+    return true;
+}
+
 // Returns TRUE if an error condition occurred
 bool MediaTypeXEX::read(uint16_t sectornum, uint16_t *readcount)
 {
@@ -88,25 +211,35 @@ bool MediaTypeXEX::read(uint16_t sectornum, uint16_t *readcount)
 
     bool err = false;
 
+    // Whole virtual disk is in memory
+    if (_xex_image != nullptr)
+    {
+        if (sectornum <= BOOTLOADER_END)
+        {
+            *readcount = BOOT_SECTOR_SIZE;
+            memcpy(_disk_sectorbuff, _xex_image + BOOT_SECTOR_SIZE * (sectornum - 1), BOOT_SECTOR_SIZE);
+            return false;
+        }
+
+        *readcount = _disk_sector_size;
+
+        if (sectornum >= DIRECTORY_START && sectornum <= DIRECTORY_END)
+            memcpy(_disk_sectorbuff, _xex_image + XEX_IMAGE_DIRECTORY, SECTOR_SIZE);
+        else if (sectornum < FIRST_XEX_SECTOR)
+            err = true; // there is no XEX data before the directory
+        else if (sectornum - FIRST_XEX_SECTOR < _xex_data_sectors)
+            memcpy(_disk_sectorbuff, _xex_image + XEX_IMAGE_DATA + (sectornum - FIRST_XEX_SECTOR) * SECTOR_SIZE, SECTOR_SIZE);
+        // else empty sector past the end of XEX
+
+        return err;
+    }
+
     // Load from our bootloader first
     if (sectornum <= BOOTLOADER_END)
     {
-        int offset = BOOT_SECTOR_SIZE * (sectornum - 1);
-        int remain = _xex_bootloadersize - offset;
-        int bootcopy = BOOT_SECTOR_SIZE > remain ? remain : BOOT_SECTOR_SIZE;
-
         *readcount = BOOT_SECTOR_SIZE;
 
-        Debug_printf("copying %d bytes from bootloader\n", bootcopy);
-        memcpy(_disk_sectorbuff, _xex_bootloader + offset, bootcopy);
-
-        // PicoBoot uses the first byte as a flag for whether it should read double or single density sectors
-        // Single = 0x80, Double = 0x00
-        if(SECTOR_SIZE == 256 && sectornum == 1 && _disk_sectorbuff[0] == 0x80)
-        {
-            Debug_print("setting PicoBoot double density flag\n");
-            _disk_sectorbuff[0] = 0x00;
-        }
+        _boot_sector(sectornum);
 
         // Note that we may not have read an entire sector's worth of bytes. That's okay.
         _disk_last_sector = INVALID_SECTOR_VALUE; // Reset this so we're forced to seek
@@ -124,40 +257,7 @@ bool MediaTypeXEX::read(uint16_t sectornum, uint16_t *readcount)
         return false;
     }
 
-    int data_bytes = _disk_sector_size - SECTOR_LINK_SIZE;
-    // This is the number of bytes into the XEX file we should be reading
-    int xex_offset = data_bytes * (sectornum - FIRST_XEX_SECTOR);
-
-    // Perform a seek if we're not reading the sector after the last one we read
-    if (sectornum != _disk_last_sector + 1)
-    {
-        Debug_printf("seeking to offset %d in XEX\n", xex_offset);
-        err = _disk_fileh->seek(xex_offset, SEEK_SET) != 0;
-    }
-
-    if (err == false)
-    {
-        Debug_printf("requesting %d bytes from XEX\n", data_bytes);
-        int read = _disk_fileh->read(_disk_sectorbuff, 1, data_bytes);
-        Debug_printf("received %d bytes\n", read);
-
-        // Fill in the sector link data pointing to the next sector
-        if(read >= 0)
-        {
-            // Provide number of bytes read
-            _disk_sectorbuff[_disk_sector_size - 1] = read;
-
-            // Only provide a next sector pointer if we read a full sector of data
-            if(read == data_bytes)
-            {
-                uint16_t next_sector = sectornum + 1;
-                _disk_sectorbuff[_disk_sector_size - 2] = LOBYTE_FROM_UINT16(next_sector);
-                _disk_sectorbuff[_disk_sector_size - 3] = HIBYTE_FROM_UINT16(next_sector);
-            }
-        }
-        else
-            err = true;
-    }
+    err = _data_sector(sectornum) < 0;
 
     if (err == false)
         _disk_last_sector = sectornum;
@@ -180,6 +280,12 @@ void MediaTypeXEX::unmount()
         _xex_bootloader = nullptr;
     }
 
+    if (_xex_image != nullptr)
+    {
+        free(_xex_image);
+        _xex_image = nullptr;
+    }
+
     // Call the parent unmount
     this->MediaType::unmount();
 }
@@ -217,6 +323,10 @@ mediatype_t MediaTypeXEX::mount(FileHandler *f, uint32_t disksize)
     if (_disk_num_sectors < 720)
         _disk_num_sectors = 720;
 
+    // Small XEX (most of them) is served from memory, no host round-trip per sector
+    if (_disk_image_size <= XEX_PRELOAD_MAX_SIZE)
+        _preload();
+
     Debug_printf("mounted XEX with %d-byte bootloader; XEX size=%d\n", _xex_bootloadersize, _disk_image_size);
     Debug_printf("disk sectors = %d\n", _disk_num_sectors);
 
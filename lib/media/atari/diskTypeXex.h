@@ -9,7 +9,14 @@ private:
     uint8_t *_xex_bootloader = nullptr;
     int _xex_bootloadersize = 0;
 
+    // Preloaded virtual disk: boot sectors, directory sector and linked data sectors
+    uint8_t *_xex_image = nullptr;
+    uint16_t _xex_data_sectors = 0;
+
     void _fake_directory_entry();
+    void _boot_sector(uint16_t sectornum);
+    int _data_sector(uint16_t sectornum);
+    bool _preload();
 
 public:
     virtual bool read(uint16_t sectornum, uint16_t *readcount) override;
@@ -26,6 +26,8 @@ ModemSniffer::~ModemSniffer()
 {
     Debug_printf("ModemSniffer::~ModemSniffer()\n");
 
+    stopWriter();
+
     if (_file != nullptr)
     {
         Debug_printf("Closing" SNIFFER_OUTPUT_FILE "\n");
@@ -36,6 +38,12 @@ ModemSniffer::~ModemSniffer()
 
 size_t ModemSniffer::getOutputSize()
 {
+    if (format == SNIFFER_FORMAT_BINARY)
+    {
+        std::lock_guard<std::mutex> lock(captureMutex);
+        return captureSize;
+    }
+
     if (_file != nullptr)
         return FileSystem::filesize(_file);
 
@@ -62,6 +70,9 @@ void ModemSniffer::closeOutput()
     //     fseek(_file, 0, SEEK_END);
     // }
 
+    // Binary capture: let the writer thread write out pending records
+    stopWriter();
+
     if (_file != nullptr)
     {
         // Close the file
@@ -76,6 +87,23 @@ FILE *ModemSniffer::closeOutputAndProvideReadHandle()
     Debug_print("ModemSniffer::closeOutputAndProvideReadHandle()\n");
 
     closeOutput();
+
+    if (format == SNIFFER_FORMAT_BINARY)
+    {
+        // Provide the text view of binary capture
+        FILE *capture = activeFS->file_open(SNIFFER_CAPTURE_FILE);
+        FILE *text = activeFS->file_open(SNIFFER_OUTPUT_FILE, FILE_WRITE_TEXT);
+        if (capture != nullptr && text != nullptr)
+        {
+            int records = convertCaptureToText(capture, text);
+            Debug_printf("Converted %d capture records\n", records);
+        }
+        if (capture != nullptr)
+            fclose(capture);
+        if (text != nullptr)
+            fclose(text);
+    }
+
     FILE *result = activeFS->file_open(SNIFFER_OUTPUT_FILE); // read-only.
     if (result == nullptr)
     {
@@ -87,19 +115,183 @@ FILE *ModemSniffer::closeOutputAndProvideReadHandle()
 
 void ModemSniffer::restartOutput()
 {
+    stopWriter();
+
     if (_file != nullptr)
         fclose(_file);
 
-    _file = activeFS->file_open(SNIFFER_OUTPUT_FILE, FILE_WRITE_TEXT); // This should create/truncate the file
+    if (format == SNIFFER_FORMAT_BINARY)
+    {
+        _file = activeFS->file_open(SNIFFER_CAPTURE_FILE, FILE_WRITE); // This should create/truncate the file
+        if (_file != nullptr)
+        {
+            uint8_t header[SNIFFER_CAPTURE_HEADER_SIZE];
+            memcpy(header, SNIFFER_CAPTURE_MAGIC, SNIFFER_CAPTURE_HEADER_SIZE - 1);
+            header[SNIFFER_CAPTURE_HEADER_SIZE - 1] = SNIFFER_CAPTURE_VERSION;
+            fwrite(header, 1, sizeof(header), _file);
+            startWriter();
+        }
+    }
+    else
+        _file = activeFS->file_open(SNIFFER_OUTPUT_FILE, FILE_WRITE_TEXT); // This should create/truncate the file
 
     Debug_printf("ModemSniffer::restartOutput(%p)\n", _file);
 }
 
+void ModemSniffer::setFormat(sniffer_format _format)
+{
+    if (_format >= SNIFFER_FORMAT_INVALID || _format == format)
+        return;
+
+    Debug_printf("ModemSniffer::setFormat(%d)\n", _format);
+
+    closeOutput();
+    format = _format;
+    direction = INIT;
+}
+
+void ModemSniffer::startWriter()
+{
+    captureStart = std::chrono::steady_clock::now();
+    captureBuffer.clear();
+    captureBuffer.reserve(SNIFFER_CAPTURE_BUFFER_SIZE);
+    writerBuffer.clear();
+    writerBuffer.reserve(SNIFFER_CAPTURE_BUFFER_SIZE);
+    captureSize = SNIFFER_CAPTURE_HEADER_SIZE;
+    droppedRecords = 0;
+    writerQuit = false;
+    writerRunning = true;
+    writerThread = std::thread(&ModemSniffer::writerLoop, this);
+}
+
+void ModemSniffer::stopWriter()
+{
+    if (!writerRunning)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(captureMutex);
+        writerQuit = true;
+    }
+    captureCond.notify_one();
+    writerThread.join();
+    writerRunning = false;
+
+    if (droppedRecords > 0)
+        Debug_printf("ModemSniffer: %lu records dropped, writer could not keep up\n", droppedRecords);
+}
+
+void ModemSniffer::writerLoop()
+{
+    std::unique_lock<std::mutex> lock(captureMutex);
+    while (true)
+    {
+        captureCond.wait_for(lock, std::chrono::milliseconds(SNIFFER_CAPTURE_FLUSH_MS), [this] {
+            return writerQuit || captureBuffer.size() >= SNIFFER_CAPTURE_BUFFER_SIZE;
+        });
+
+        if (!captureBuffer.empty())
+        {
+            // Take collected records and write them without holding the lock
+            writerBuffer.swap(captureBuffer);
+            lock.unlock();
+            fwrite(writerBuffer.data(), 1, writerBuffer.size(), _file);
+            fflush(_file);
+            writerBuffer.clear();
+            lock.lock();
+        }
+
+        if (writerQuit && captureBuffer.empty())
+            break;
+    }
+}
+
+void ModemSniffer::captureRecord(uint8_t dir, const uint8_t *buf, unsigned short len)
+{
+    if (_file == nullptr)
+    {
+        restartOutput();
+        if (_file == nullptr)
+            return;
+    }
+
+    uint64_t ts = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - captureStart).count();
+
+    std::lock_guard<std::mutex> lock(captureMutex);
+
+    if (captureBuffer.size() + SNIFFER_CAPTURE_RECORD_HEADER_SIZE + len > SNIFFER_CAPTURE_BUFFER_MAX)
+    {
+        droppedRecords++;
+        return;
+    }
+
+    uint8_t header[SNIFFER_CAPTURE_RECORD_HEADER_SIZE];
+    header[0] = dir;
+    for (int i = 0; i < 8; i++)
+        header[1 + i] = (uint8_t)(ts >> (8 * i));
+    header[9] = len & 0xFF;
+    header[10] = len >> 8;
+
+    captureBuffer.insert(captureBuffer.end(), header, header + sizeof(header));
+    captureBuffer.insert(captureBuffer.end(), buf, buf + len);
+    captureSize += sizeof(header) + len;
+
+    if (captureBuffer.size() >= SNIFFER_CAPTURE_BUFFER_SIZE)
+        captureCond.notify_one();
+}
+
+int ModemSniffer::convertCaptureToText(FILE *in, FILE *out)
+{
+    uint8_t header[SNIFFER_CAPTURE_RECORD_HEADER_SIZE];
+    std::vector<uint8_t> payload(0x10000); // up to 64K record, too big for the stack
+
+    if (fread(header, 1, SNIFFER_CAPTURE_HEADER_SIZE, in) != SNIFFER_CAPTURE_HEADER_SIZE ||
+        memcmp(header, SNIFFER_CAPTURE_MAGIC, SNIFFER_CAPTURE_HEADER_SIZE - 1) != 0 ||
+        header[SNIFFER_CAPTURE_HEADER_SIZE - 1] != SNIFFER_CAPTURE_VERSION)
+    {
+        Debug_println("Not a sniffer capture file");
+        return -1;
+    }
+
+    int records = 0;
+    uint8_t last_dir = 0;
+
+    while (fread(header, 1, sizeof(header), in) == sizeof(header))
+    {
+        uint8_t dir = header[0];
+        unsigned short len = header[9] | (header[10] << 8);
+        if (fread(payload.data(), 1, len, in) != len)
+            break; // truncated record
+
+        if (dir != last_dir)
+            fprintf(out, dir == SNIFFER_DIR_INPUT ? "\n\nINCOMING: " : "\n\nOUTGOING: ");
+        last_dir = dir;
+
+        for (int i = 0; i < len; i++)
+        {
+            if (payload[i] > 0x20 && payload[i] < 0x7F)
+                fprintf(out, "'%c' ", payload[i]);
+            else
+                fprintf(out, dir == SNIFFER_DIR_INPUT ? "%02x " : "%02X ", payload[i]);
+        }
+        records++;
+    }
+
+    return records;
+}
+
 void ModemSniffer::dumpInput(uint8_t *buf, unsigned short len)
 {
     if (enable == false)
         return;
 
+    if (format == SNIFFER_FORMAT_BINARY)
+    {
+        captureRecord(SNIFFER_DIR_INPUT, buf, len);
+        return;
+    }
+
     if (_file == nullptr)
     {
         restartOutput();
@@ -136,6 +328,12 @@ void ModemSniffer::dumpOutput(uint8_t *buf, unsigned short len)
     if (enable == false)
         return;
 
+    if (format == SNIFFER_FORMAT_BINARY)
+    {
+        captureRecord(SNIFFER_DIR_OUTPUT, buf, len);
+        return;
+    }
+
     if (_file == nullptr)
     {
         restartOutput();
@@ -8,6 +8,11 @@
 
 #include <cstdint>
 #include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 
 #include <stdio.h>
 
@@ -17,11 +22,47 @@
 using namespace std;
 
 #define SNIFFER_OUTPUT_FILE "/rs232dump"
+#define SNIFFER_CAPTURE_FILE "/rs232dump.cap"
+
+/*
+ * Binary capture format (SNIFFER_FORMAT_BINARY)
+ *
+ * File starts with 8 byte header: "FNSNIFF" followed by format version byte.
+ * Header is followed by records, all multi-byte values are little-endian:
+ *   uint8_t  direction (SNIFFER_DIR_INPUT or SNIFFER_DIR_OUTPUT)
+ *   uint64_t timestamp, microseconds from monotonic clock since capture start
+ *   uint16_t payload length
+ *   uint8_t  payload[length]
+ */
+#define SNIFFER_CAPTURE_MAGIC "FNSNIFF"
+#define SNIFFER_CAPTURE_VERSION 1
+#define SNIFFER_CAPTURE_HEADER_SIZE 8
+#define SNIFFER_CAPTURE_RECORD_HEADER_SIZE 11
+
+#define SNIFFER_DIR_INPUT 0x01
+#define SNIFFER_DIR_OUTPUT 0x02
+
+// Captured records are collected in memory and written by background thread
+// when buffer reaches this size or SNIFFER_CAPTURE_FLUSH_MS elapsed
+#define SNIFFER_CAPTURE_BUFFER_SIZE 65536
+// Records are dropped (and counted) if the writer falls behind this much
+#define SNIFFER_CAPTURE_BUFFER_MAX (16 * SNIFFER_CAPTURE_BUFFER_SIZE)
+#define SNIFFER_CAPTURE_FLUSH_MS 500
 
 class ModemSniffer
 {
 
 public:
+    /**
+     * Output format
+     */
+    enum sniffer_format
+    {
+        SNIFFER_FORMAT_TEXT = 0,    // human readable, written byte by byte
+        SNIFFER_FORMAT_BINARY,      // timestamped binary records, buffered
+        SNIFFER_FORMAT_INVALID
+    };
+
     /**
      * ctor
      * @param _fs a pointer to the active VFS filesystem object chosen at device start.
@@ -69,6 +110,24 @@ public:
      */
     bool getEnable() { return enable; }
 
+    /**
+     * Set output format, current output is closed if format changes
+     */
+    void setFormat(sniffer_format _format);
+
+    /**
+     * Get output format
+     */
+    sniffer_format getFormat() { return format; }
+
+    /**
+     * Convert binary capture to the text view produced by SNIFFER_FORMAT_TEXT
+     * @param in binary capture opened for reading
+     * @param out text output
+     * @return number of converted records or -1 if input is not a valid capture
+     */
+    static int convertCaptureToText(FILE *in, FILE *out);
+
 private:
     /**
      * Is sniffer enabled?
@@ -86,6 +145,30 @@ private:
         OUTPUT
     } direction;
 
+    /**
+     * Output format
+     */
+    sniffer_format format = SNIFFER_FORMAT_TEXT;
+
+    /**
+     * Binary capture, time of capture start and writer thread state
+     */
+    std::chrono::steady_clock::time_point captureStart;
+    std::vector<uint8_t> captureBuffer;     // records collected by dumpInput/dumpOutput
+    std::vector<uint8_t> writerBuffer;      // records being written by writer thread
+    std::thread writerThread;
+    std::mutex captureMutex;
+    std::condition_variable captureCond;
+    bool writerRunning = false;
+    bool writerQuit = false;
+    size_t captureSize = 0;
+    unsigned long droppedRecords = 0;
+
+    void captureRecord(uint8_t dir, const uint8_t *buf, unsigned short len);
+    void startWriter();
+    void stopWriter();
+    void writerLoop();
+
 protected:
     /**
      * Pointer to ESP32 filesystem
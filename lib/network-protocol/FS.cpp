@@ -8,6 +8,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <algorithm>
 
 #include "../../include/debug.h"
 
@@ -64,9 +65,10 @@ bool NetworkProtocolFS::open_file()
 
 bool NetworkProtocolFS::open_dir()
 {
-    char *entryBuffer = (char *)malloc(256);
+    char entryBuffer[256];
     openMode = DIR;
     dirBuffer.clear();
+    dirBufferPos = 0;
     update_dir_filename(opened_url);
 
     // assume everything if no filename.
@@ -105,8 +107,6 @@ bool NetworkProtocolFS::open_dir()
     if (error == NETWORK_ERROR_END_OF_FILE)
         error = NETWORK_ERROR_SUCCESS;
 
-    free(entryBuffer);
-
     return error != NETWORK_ERROR_SUCCESS;
 }
 
@@ -176,32 +176,22 @@ bool NetworkProtocolFS::read(unsigned short len)
 
 bool NetworkProtocolFS::read_file(unsigned short len)
 {
-    uint8_t *buf = (uint8_t *)malloc(len);
-
     Debug_printf("NetworkProtocolFS::read_file(%u)\n", len);
 
-    if (buf == nullptr)
-    {
-        Debug_printf("NetworkProtocolTNFS:read_file(%u) could not allocate.\n", len);
-        return true; // error
-    }
-
     if (receiveBuffer->length() == 0)
     {
-        // Do block read.
-        if (read_file_handle(buf, len) == true)
+        // Do block read straight into receive buffer, its capacity is kept between reads.
+        receiveBuffer->resize(len);
+        if (read_file_handle((uint8_t *)&(*receiveBuffer)[0], len) == true)
+        {
+            receiveBuffer->clear();
             return true;
-
-        // Append to receive buffer.
-        *receiveBuffer += string((char *)buf, len);
+        }
         fileSize -= len;
     }
     else
         error = NETWORK_ERROR_SUCCESS;
 
-    // Done with the temporary buffer.
-    free(buf);
-
     // Pass back to base class for translation.
     return NetworkProtocol::read(len);
 }
@@ -210,8 +200,10 @@ bool NetworkProtocolFS::read_dir(unsigned short len)
 {
     if (receiveBuffer->length() == 0)
     {
-        *receiveBuffer = dirBuffer.substr(0, len);
-        dirBuffer.erase(0, len);
+        // advance cursor, dirBuffer is released on next open
+        size_t n = std::min((size_t)len, dirBuffer.length() - dirBufferPos);
+        receiveBuffer->assign(dirBuffer, dirBufferPos, n);
+        dirBufferPos += n;
     }
 
     return NetworkProtocol::read(len);
@@ -263,9 +255,10 @@ bool NetworkProtocolFS::status_file(NetworkStatus *status)
 
 bool NetworkProtocolFS::status_dir(NetworkStatus *status)
 {
-    status->rxBytesWaiting = dirBuffer.length();
-    status->connected = dirBuffer.length() > 0 ? 1 : 0;
-    status->error = dirBuffer.length() > 0 ? error : NETWORK_ERROR_END_OF_FILE;
+    size_t remaining = dirBuffer.length() - dirBufferPos;
+    status->rxBytesWaiting = remaining > 65535 ? 65535 : remaining;
+    status->connected = remaining > 0 ? 1 : 0;
+    status->error = remaining > 0 ? error : NETWORK_ERROR_END_OF_FILE;
 
     NetworkProtocol::status(status);
 
@@ -154,6 +154,11 @@ protected:
      * Directory buffer
      */
     string dirBuffer;
+
+    /**
+     * Position of next directory byte to be read from dirBuffer
+     */
+    size_t dirBufferPos = 0;
     
     /**
      * Is open file a directory?
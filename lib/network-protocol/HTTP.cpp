@@ -142,54 +142,38 @@ bool NetworkProtocolHTTP::open_file_handle()
     return false;
 }
 
-bool NetworkProtocolHTTP::open_dir_handle()
+// PROPFIND response body is parsed as it arrives
+static void _propfind_body(const char *data, size_t len, void *user_data)
 {
-    char *buf;
-    unsigned short len, actual_len;
+    static_cast<WebDAV *>(user_data)->parse(data, len);
+}
 
+bool NetworkProtocolHTTP::open_dir_handle()
+{
     Debug_printf("NetworkProtocolHTTP::open_dir_handle()\n");
 
-    if (client != nullptr)
+    if (webDAV.begin())
     {
-        delete client;
-        client = new mgHttpClient();
-        client->begin(opened_url->toString());
+        error = NETWORK_ERROR_GENERAL;
+        return true;
     }
 
     // client->begin already called in mount()
-    resultCode = client->PROPFIND(mgHttpClient::webdav_depth::DEPTH_1, "<?xml version=\"1.0\"?>\r\n<D:propfind xmlns:D=\"DAV:\">\r\n<D:prop>\r\n<D:displayname />\r\n<D:getcontentlength /></D:prop>\r\n</D:propfind>\r\n");
+    resultCode = client->PROPFIND(mgHttpClient::webdav_depth::DEPTH_1,
+                                  "<?xml version=\"1.0\"?>\r\n<D:propfind xmlns:D=\"DAV:\">\r\n<D:prop>\r\n<D:displayname />\r\n<D:getcontentlength /></D:prop>\r\n</D:propfind>\r\n",
+                                  _propfind_body, &webDAV);
 
     if (resultCode > 399)
     {
         Debug_printf("Could not do PROPFIND. Result code %u\n", resultCode);
+        webDAV.end();
         fserror_to_error();
         return true;
     }
 
-    len = client->available();
-    buf = (char *)malloc(len);
-
-    if (buf == nullptr)
-    {
-        Debug_printf("Could not allocate %u bytes for PROPFIND data. Aborting\n", len);
-        error = NETWORK_ERROR_GENERAL;
-        return true;
-    }
-
-    // Grab the buffer.
-    actual_len = client->read((uint8_t *)buf, len);
-
-    if (actual_len != len)
+    if (webDAV.end())
     {
-        Debug_printf("Expected %u bytes, actually got %u bytes.\n", len, actual_len);
-        error = NETWORK_ERROR_GENERAL;
-        return true;
-    }
-
-    // Parse the buffer
-    if (parseDir(buf, len))
-    {
-        Debug_printf("Could not parse buffer, returning 144\n");
+        Debug_printf("Could not parse PROPFIND response, returning 144\n");
         error = NETWORK_ERROR_GENERAL;
         return true;
     }
@@ -197,13 +181,6 @@ bool NetworkProtocolHTTP::open_dir_handle()
     // Scoot to beginning of entries.
     dirEntryCursor = webDAV.entries.begin();
 
-    if (client != nullptr)
-    {
-        delete client;
-        client = new mgHttpClient();
-        client->begin(opened_url->toString());
-    }
-
     // Directory parsed, ready to be returned by read_dir_entry()
     return false;
 }
@@ -398,7 +375,7 @@ bool NetworkProtocolHTTP::read_dir_entry(char *buf, unsigned short len)
 
     if (dirEntryCursor != webDAV.entries.end())
     {
-        fileSize = atoi(dirEntryCursor->fileSize.c_str());
+        fileSize = dirEntryCursor->fileSize;
         strcpy(buf, dirEntryCursor->filename.c_str());
         dirEntryCursor++;
     }
@@ -634,40 +611,6 @@ void NetworkProtocolHTTP::http_transaction()
     fileSize = bodySize = client->available();
 }
 
-bool NetworkProtocolHTTP::parseDir(char *buf, unsigned short len)
-{
-    XML_Parser p = XML_ParserCreate(NULL);
-    XML_Status xs;
-    bool err = false;
-
-    if (p == nullptr)
-    {
-        Debug_printf("NetworkProtocolHTTP::parseDir - could not create expat parser. Aborting.\n");
-        return true;
-    }
-
-    // Put PROPFIND data to debug console
-    Debug_printf("PROPFIND DATA:\n\n%s\n", buf);
-
-    // Set everything up
-    XML_SetUserData(p, &webDAV);
-    XML_SetElementHandler(p, Start<WebDAV>, End<WebDAV>);
-    XML_SetCharacterDataHandler(p, Char<WebDAV>);
-
-    // And parse the damned buffer
-    xs = XML_Parse(p, buf, len, true);
-
-    if (xs == XML_STATUS_ERROR)
-    {
-        Debug_printf("DAV response XML Parse Error! msg: %s line: %lu\n", XML_ErrorString(XML_GetErrorCode(p)), XML_GetCurrentLineNumber(p));
-    }
-
-    if (p != nullptr)
-        XML_ParserFree(p);
-
-    return err;
-}
-
 bool NetworkProtocolHTTP::rename(EdUrlParser *url, cmdFrame_t *cmdFrame)
 {
     if (NetworkProtocolFS::rename(url, cmdFrame) == true)
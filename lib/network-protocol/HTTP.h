@@ -3,8 +3,6 @@
 
 #include "FS.h"
 
-#include <expat.h>
-
 #include "mgHttpClient.h"
 #include "WebDAV.h"
 
@@ -293,52 +291,6 @@ private:
      * @return true on ERROR FALSE on success
      */
     bool write_file_handle_data(uint8_t *buf, unsigned short len);
-
-    /**
-     * @brief Parse directory retrieved from PROPFIND
-     * @param buf the source buffer
-     * @param len the buffer length
-     * @return TRUE on error, FALSE on success.
-     */
-    bool parseDir(char *buf, unsigned short len);
 };
 
-/**
-     * @brief Template to wrap Start call.
-     * @param data pointer to parent class
-     * @param El the current element being parsed
-     * @param attr the array of attributes attached to element
-     */
-template <class T>
-void Start(void *data, const XML_Char *El, const XML_Char **attr)
-{
-    T *handler = static_cast<T *>(data);
-    handler->Start(El, attr);
-}
-
-/**
- * @brief Template to wrap End call
- * @param data pointer to parent class.
- * @param El the current element being parsed.
- **/
-template <class T>
-void End(void *data, const XML_Char *El)
-{
-    T *handler = static_cast<T *>(data);
-    handler->End(El);
-}
-
-/**
- * @brief template to wrap character data.
- * @param data pointer to parent class
- * @param s pointer to the character data
- * @param len length of character data at pointer
- **/
-template <class T>
-void Char(void *data, const XML_Char *s, int len)
-{
-    T *handler = static_cast<T *>(data);
-    handler->Char(s, len);
-}
-
 #endif /* NETWORKPROTOCOLHTTP_H */
\ No newline at end of file
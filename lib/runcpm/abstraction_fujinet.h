@@ -7,14 +7,19 @@
 
 #include <string.h>
 
+#include "compat_string.h"
+
 #include "globals.h"
 
 #include "../../include/debug.h"
 
 #include "fnSystem.h"
+#ifdef ESP_PLATFORM
 #include "fnWiFi.h"
+#else
+#include "fnDummyWiFi.h"
+#endif
 #include "fnFsSD.h"
-#include "fnUART.h"
 #include "fnTcpServer.h"
 #include "fnTcpClient.h"
 
@@ -495,49 +500,53 @@ uint8_t _sys_makedisk(uint8_t drive)
 /* Console abstraction functions */
 /*===============================================================================*/
 
+extern int32 Status; // cpu.h
+
+// Console runs on CP/M thread, characters are passed to/from SIO through cpmConsoleIn/cpmConsoleOut
+// queues by sioCPM::sio_handle_cpm()
+
 int _kbhit(void)
 {
-	return fnUartSIO.available();
+	return cpmConsoleIn.empty() ? 0 : 1;
 }
 
 uint8_t _getch(void)
 {
-	if (teeMode == true)
+	uint8_t ch;
+
+	while (true)
 	{
-		while (fnUartSIO.available() > 0)
+		if (teeMode == true && client.available())
 		{
-			if (client.available())
-			{
-				uint8_t ch;
-				client.read(&ch, 1);
-				return ch & 0x7F;
-			}
+			client.read(&ch, 1);
+			return ch & 0x7F;
 		}
-		return fnUartSIO.read() & 0x7F;
-	}
-	else
-	{
-		while (fnUartSIO.available() <= 0)
+		if (cpmConsoleIn.pop(ch))
+			return ch & 0x7F;
+		if (cpmQuit)
 		{
+			// CP/M is being stopped, let CCP or running program see the end request
+			Status = 1;
+			return '\r';
 		}
-		return fnUartSIO.read() & 0x7f;
+		fnSystem.delay(1);
 	}
 }
 
-uint8_t _getche(void)
+void _putch(uint8_t ch)
 {
-	uint8_t ch = _getch() & 0x7f;
-	fnUartSIO.write(ch);
+	// wait for SIO to take characters, output is limited by SIO speed
+	while (!cpmConsoleOut.push(ch & 0x7f) && !cpmQuit)
+		fnSystem.delay(1);
 	if (teeMode == true)
 		client.write(ch);
-	return ch;
 }
 
-void _putch(uint8_t ch)
+uint8_t _getche(void)
 {
-	fnUartSIO.write(ch & 0x7f);
-	if (teeMode == true)
-		client.write(ch);
+	uint8_t ch = _getch() & 0x7f;
+	_putch(ch);
+	return ch;
 }
 
 void _clrscr(void)
@@ -592,7 +601,7 @@ uint8_t bdos_readHostSlots(uint16_t addr)
 	memset(hostSlots, 0, sizeof(hostSlots));
 
 	for (int i = 0; i < 8; i++)
-		strlcpy(hostSlots[i], theFuji.get_hosts(i)->get_hostname(), 32);
+		strlcpy(hostSlots[i], cpmFuji->get_hosts(i)->get_hostname(), 32);
 
 	memset(&RAM[addr], 0, sizeof(hostSlots));
 	memcpy(&RAM[addr], &hostSlots, sizeof(hostSlots));
@@ -612,9 +621,9 @@ uint8_t bdos_readDeviceSlots(uint16_t addr)
 	// Load the data from our current device array
 	for (int i = 0; i < MAX_DISK_DEVICES; i++)
 	{
-		diskSlots[i].mode = theFuji.get_disks(i)->access_mode;
-		diskSlots[i].hostSlot = theFuji.get_disks(i)->host_slot;
-		strlcpy(diskSlots[i].filename, theFuji.get_disks(i)->filename, MAX_DISPLAY_FILENAME_LEN);
+		diskSlots[i].mode = cpmFuji->get_disks(i)->access_mode;
+		diskSlots[i].hostSlot = cpmFuji->get_disks(i)->host_slot;
+		strlcpy(diskSlots[i].filename, cpmFuji->get_disks(i)->filename, MAX_DISPLAY_FILENAME_LEN);
 	}
 
 	// Transfer to Z80 RAM.
@@ -562,7 +562,7 @@ uint8 _ccp_ext(void) {
             _ccp_initFCB(CmdFCB, 36);
             
             //put 'SUBMIT.COM' in CmdFCB
-            char *str = "SUBMIT  COM";
+            const char *str = "SUBMIT  COM";
             int s = (int)strlen(str);
             for (int i = 0; i < s; i++) {
                 _RamWrite(CmdFCB + i + 1, str[i]);
@@ -466,11 +466,11 @@ void _Bios(void) {
 
 		case 0x09: {    // 3 - CONIN - Console input
 			SET_HIGH_REGISTER(AF, _getch());
-#ifdef DEBUG
+#ifdef CPM_DEBUG
 			if (HIGH_REGISTER(AF) == 4) {
 				Debug = 1;
 			}
-#endif // ifdef DEBUG
+#endif // ifdef CPM_DEBUG
 			break;
 		}
 
@@ -546,12 +546,12 @@ void _Bios(void) {
 		}
 
 		default: {
-#ifdef DEBUG    // Show unimplemented BIOS calls only when debugging
+#ifdef CPM_DEBUG    // Show unimplemented BIOS calls only when debugging
 			_puts(	"\r\nUnimplemented BIOS call.\r\n");
 			_puts(	"C = 0x");
 			_puthex8(ch);
 			_puts("\r\n");
-#endif // ifdef DEBUG
+#endif // ifdef CPM_DEBUG
 			break;
 		}
 	} // switch
@@ -591,11 +591,11 @@ void _Bdos(void) {
 		 */
 		case C_READ: {
 			HL = _getche();
-#ifdef DEBUG
+#ifdef CPM_DEBUG
 			if (HL == 4) {
 				Debug = 1;
 			}
-#endif // ifdef DEBUG
+#endif // ifdef CPM_DEBUG
 			break;
 		}
 
@@ -642,7 +642,8 @@ void _Bdos(void) {
 			if (LOW_REGISTER(DE) != 0x0A)
 			{
 				trans_ch = LOW_REGISTER(DE) == 0x0D ? 0x9B : LOW_REGISTER(DE);
-				SIO.getPrinter()->print_from_cpm(LOW_REGISTER(DE));
+				if (cpmPrinter != nullptr)
+					cpmPrinter->print_from_cpm(LOW_REGISTER(DE));
 			}
 #endif /* BUILD_ATARI */
 #ifdef USE_LST
@@ -666,11 +667,11 @@ void _Bdos(void) {
 		case DIRECT_IO: {
 			if (LOW_REGISTER(DE) == 0xff) {
 				HL = _getchNB();
-#ifdef DEBUG
+#ifdef CPM_DEBUG
 				if (HL == 4) {
 					Debug = 1;
 				}
-#endif // ifdef DEBUG
+#endif // ifdef CPM_DEBUG
 			} else {
 				_putcon(LOW_REGISTER(DE));
 			}
@@ -766,7 +767,7 @@ void _Bdos(void) {
                     break;
                 }
 
-#ifdef DEBUG
+#ifdef CPM_DEBUG
                 if (chr == 4) {                             // ^D - DEBUG
                     Debug = 1;
 
@@ -775,7 +776,7 @@ void _Bdos(void) {
                     reType = chrsCnt;
                     postBS = chrsCnt - curCol;
                 }
-#endif // ifdef DEBUG
+#endif // ifdef CPM_DEBUG
 
                 if (chr == 5) {                             // ^E - goto beginning of next line
                     _puts("\n");
@@ -1346,12 +1347,12 @@ void _Bdos(void) {
 		   Unimplemented calls get listed
 		 */
 		default: {
-#ifdef DEBUG    // Show unimplemented BDOS calls only when debugging
+#ifdef CPM_DEBUG    // Show unimplemented BDOS calls only when debugging
 			_puts(	"\r\nUnimplemented BDOS call.\r\n");
 			_puts(	"C = 0x");
 			_puthex8(ch);
 			_puts("\r\n");
-#endif // ifdef DEBUG
+#endif // ifdef CPM_DEBUG
 			break;
 		}
 	} // switch
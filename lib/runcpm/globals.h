@@ -14,7 +14,7 @@
 //#define USE_LST
 
 /* Definitions for file/console based debugging */
-//#define DEBUG				// Enables the internal debugger (enabled by default on vstudio debug builds)
+//#define CPM_DEBUG			// Enables the internal debugger (enabled by default on vstudio debug builds)
 //#define iDEBUG			// Enables instruction logging onto iDebug.log (for development debug only)
 //#define DEBUGLOG			// Writes extensive call trace information to RunCPM.log
 //#define CONSOLELOG		// Writes debug information to console instead of file
@@ -24,6 +24,14 @@
 //#define LOGBDOS_ONLY 22	// If defines will log only this BDOS function number
 #define LogName "RunCPM.log"
 
+/* Definitions for speed of the Z80 core */
+#define THREADED_DISPATCH	// If this is defined, each instruction jumps directly to the next one
+							// through a table of label addresses instead of the central switch.
+							// Needs GCC/Clang computed goto, not used together with CPM_DEBUG/iDEBUG
+#define CACHE_REGISTERS		// If this is defined, the Z80 core keeps the main registers in local variables
+							// while running, the globals are updated around IN/OUT (BIOS/BDOS calls).
+							// Not used together with CPM_DEBUG/iDEBUG
+
 /* RunCPM version for the greeting header */
 #define VERSION	"5.8"
 #define VersionBCD 0x58
@@ -155,7 +163,11 @@ typedef unsigned int    uint32;
 #define MEMSIZE 64 * 1024	// RAM(plus ROM) needs to be 64K to avoid compatibility issues
 
 #ifdef RAM_FAST		// Makes all function calls to memory access into direct RAM access (less calls / less code)
-	static uint8 *RAM;
+#ifdef ESP_PLATFORM
+	static uint8 *RAM;			// Allocated when CP/M is started
+#else
+	static uint8 RAM[MEMSIZE];	// Fixed address, the CPU core indexes it without loading a pointer
+#endif
 	#define _RamSysAddr(a)		&RAM[a]
 	#define _RamRead(a)			RAM[a]
 	#define _RamRead16(a)		((RAM[(a & 0xffff) + 1] << 8) | RAM[a & 0xffff])
@@ -7,7 +7,7 @@
 #include "ReciterTabs.h"
 #include "samdebug.h"
 
-unsigned char A, X, Y;
+extern unsigned char A, X, Y;
 extern int debug;
 
 static unsigned char inputtemp[256]; // secure copy of input tab36096
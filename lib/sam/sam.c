@@ -1,8 +1,6 @@
 
 #include "sam.h"
 
-#include <esp_heap_caps.h>
-
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -43,9 +41,19 @@ unsigned char phonemeIndexOutput[60];  //tab47296
 unsigned char stressOutput[60];        //tab47365
 unsigned char phonemeLengthOutput[60]; //tab47416
 
-// contains the final soundbuffer
+// Position of the renderer in the sound output, in 1/50 samples
 int bufferpos = 0;
-char *buffer = NULL;
+
+// Rendered samples are passed to the output function in frames. Renderer writes up to
+// SAM_WRITE_AHEAD samples ahead of bufferpos and may overwrite them later, so only samples
+// which can still change are kept in the window.
+#define SAM_WRITE_AHEAD 5
+#define SAM_WINDOW_SIZE (SAM_FRAME_SIZE + 2 * SAM_WRITE_AHEAD)
+
+static unsigned char window[SAM_WINDOW_SIZE];
+static int window_start = 0; // sample number of window[0]
+static SamOutputFunc output_func = NULL;
+static void *output_ctx = NULL;
 
 void SetInput(char *_input)
 {
@@ -63,9 +71,50 @@ void SetPitch(unsigned char _pitch) { pitch = _pitch; }
 void SetMouth(unsigned char _mouth) { mouth = _mouth; }
 void SetThroat(unsigned char _throat) { throat = _throat; }
 void EnableSingmode() { singmode = 1; }
-char *GetBuffer() { return buffer; }
+
+void SetDefaults()
+{
+    speed = 72;
+    pitch = 64;
+    mouth = 128;
+    throat = 128;
+    singmode = 0;
+}
+
+void SetOutput(SamOutputFunc func, void *ctx)
+{
+    output_func = func;
+    output_ctx = ctx;
+}
+
+static void EmitSamples(int count)
+{
+    if (output_func != NULL && count > 0)
+        output_func(window, count, output_ctx);
+    memmove(window, window + count, SAM_WINDOW_SIZE - count);
+    memset(window + SAM_WINDOW_SIZE - count, 0, count);
+    window_start += count;
+}
+
+// Called by the renderer for every sample it produces
+void WriteSample(int index, unsigned char value)
+{
+    // Samples behind bufferpos are final, pass the oldest frame on when the window is full
+    while (index - window_start >= SAM_WINDOW_SIZE)
+        EmitSamples(SAM_FRAME_SIZE);
+    window[index - window_start] = value;
+}
+
+// Pass on the rest of the utterance
+static void FlushSamples()
+{
+    int end = bufferpos / 50;
+    while (end - window_start > SAM_FRAME_SIZE)
+        EmitSamples(SAM_FRAME_SIZE);
+    EmitSamples(end - window_start);
+}
+
 int GetBufferLength() { return bufferpos; }
-void FreeBuffer() { free(buffer); }
 
 void Init();
 int Parser1();
@@ -97,17 +146,8 @@ void Init()
     SetMouthThroat(mouth, throat);
 
     bufferpos = 0;
-    // TODO, check for free the memory, 10 seconds of output should be more than enough
-    //buffer = (char*)ps_malloc(22050 * 5);
-    // switch to ESP-IDF equivalent
-    buffer = (char *)heap_caps_malloc(22050 * 10, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-    /*
-    Due to a technical limitation, the maximum statically allocated DRAM usage is 160KB. 
-    The remaining 160KB (for a total of 320KB of DRAM) can only be allocated at runtime as heap.
-    https://docs.espressif.com/projects/esp-idf/en/latest/esp32/api-reference/system/mem_alloc.html
-    */
-
-    // printf("buffer pointer %d\n", buffer);
+    window_start = 0;
+    memset(window, 0, sizeof(window));
 
     /*
     freq2data = &mem[45136];
@@ -183,6 +223,7 @@ int SAMMain()
     }
 
     PrepareOutput();
+    FlushSamples();
 
     return 1;
 }
@@ -6,6 +6,13 @@ extern "C"
 {
 #endif
 
+// Samples are unsigned 8-bit mono at SAM_SAMPLE_RATE, passed to output function in frames
+// of SAM_FRAME_SIZE (last one of utterance may be shorter) as they are rendered
+#define SAM_SAMPLE_RATE 22050
+#define SAM_FRAME_SIZE 512
+
+    typedef void (*SamOutputFunc)(const unsigned char *samples, int count, void *ctx);
+
     void SetInput(char *_input);
     void SetSpeed(unsigned char _speed);
     void SetPitch(unsigned char _pitch);
@@ -13,12 +20,14 @@ extern "C"
     void SetThroat(unsigned char _throat);
     void EnableSingmode();
     void EnableDebug();
+    void SetDefaults();
+    void SetOutput(SamOutputFunc func, void *ctx);
 
     int SAMMain();
 
-    char *GetBuffer();
+    void WriteSample(int index, unsigned char value);
+    // Length of last utterance, in 1/50 samples
     int GetBufferLength();
-    void FreeBuffer();
     
     //char input[]={"/HAALAOAO MAYN NAAMAEAE IHSTT SAEBAASTTIHAAN \x9b\x9b\0"};
     //unsigned char input[]={"/HAALAOAO \x9b\0"};
@@ -1,60 +1,176 @@
-
 #include "samlib.h"
 
+#ifdef ESP_PLATFORM
 #include <freertos/FreeRTOS.h>
 #include <freertos/timers.h>
 #include <driver/gpio.h>
 #ifndef CONFIG_IDF_TARGET_ESP32S3
 #include <driver/dac.h>
 #endif
+#endif
 
-
+#include "compat_string.h"
 #include "fnSystem.h"
 
+#include "../../include/debug.h"
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
 #ifdef __cplusplus
 extern char input[256];
-extern char *buffer;
 #endif
 
 int debug = 0;
 
 #ifndef ESP_PLATFORM
 
-void WriteWav(char *filename, char *buffer, int bufferlength)
+static SamSink *_sink = nullptr;
+
+SamWavSink::SamWavSink(const char *filename)
+{
+    _file = fopen(filename, "wb");
+    if (_file == nullptr)
+        Debug_printf("SAM: failed to create \"%s\"\n", filename);
+    else
+        _write_header();
+}
+
+SamWavSink::~SamWavSink()
+{
+    if (_file != nullptr)
+        fclose(_file);
+}
+
+void SamWavSink::_write_header()
+{
+    uint32_t riff_len = _data_len + 36;
+    uint32_t fmt_len = 16;
+    uint16_t format = 1; // PCM
+    uint16_t channels = 1;
+    uint32_t sample_rate = SAM_SAMPLE_RATE;
+    uint32_t byte_rate = SAM_SAMPLE_RATE;
+    uint16_t block_align = 1;
+    uint16_t bits_per_sample = 8;
+
+    fseek(_file, 0, SEEK_SET);
+    fwrite("RIFF", 4, 1, _file);
+    fwrite(&riff_len, 4, 1, _file);
+    fwrite("WAVE", 4, 1, _file);
+    fwrite("fmt ", 4, 1, _file);
+    fwrite(&fmt_len, 4, 1, _file);
+    fwrite(&format, 2, 1, _file);
+    fwrite(&channels, 2, 1, _file);
+    fwrite(&sample_rate, 4, 1, _file);
+    fwrite(&byte_rate, 4, 1, _file);
+    fwrite(&block_align, 2, 1, _file);
+    fwrite(&bits_per_sample, 2, 1, _file);
+    fwrite("data", 4, 1, _file);
+    fwrite(&_data_len, 4, 1, _file);
+    fseek(_file, 0, SEEK_END);
+}
+
+void SamWavSink::write(const unsigned char *samples, int count)
+{
+    if (_file != nullptr && fwrite(samples, 1, count, _file) == (size_t)count)
+        _data_len += count;
+}
+
+void SamWavSink::end()
 {
-    FILE *file = fopen(filename, "wb");
-    if (file == NULL)
+    if (_file == nullptr)
         return;
-    //RIFF header
-    fwrite("RIFF", 4, 1, file);
-    unsigned int filesize = bufferlength + 12 + 16 + 8 - 8;
-    fwrite(&filesize, 4, 1, file);
-    fwrite("WAVE", 4, 1, file);
-
-    //format chunk
-    fwrite("fmt ", 4, 1, file);
-    unsigned int fmtlength = 16;
-    fwrite(&fmtlength, 4, 1, file);
-    unsigned short int format = 1; //PCM
-    fwrite(&format, 2, 1, file);
-    unsigned short int channels = 1;
-    fwrite(&channels, 2, 1, file);
-    unsigned int samplerate = 22050;
-    fwrite(&samplerate, 4, 1, file);
-    fwrite(&samplerate, 4, 1, file); // bytes/second
-    unsigned short int blockalign = 1;
-    fwrite(&blockalign, 2, 1, file);
-    unsigned short int bitspersample = 8;
-    fwrite(&bitspersample, 2, 1, file);
-
-    //data chunk
-    fwrite("data", 4, 1, file);
-    fwrite(&bufferlength, 4, 1, file);
-    fwrite(buffer, bufferlength, 1, file);
-
-    fclose(file);
+    _write_header();
+    fflush(_file);
+}
+
+// SIGPIPE is ignored by the program (see main.cpp), player may exit and broken pipe is a write error
+SamPipeSink::SamPipeSink(const char *command) : _command(command)
+{
+}
+
+SamPipeSink::~SamPipeSink()
+{
+    _close();
+}
+
+void SamPipeSink::_close()
+{
+    if (_pipe != nullptr)
+    {
+        pclose(_pipe);
+        _pipe = nullptr;
+    }
 }
-#endif // NOT ESP_PLATFORM
+
+void SamPipeSink::write(const unsigned char *samples, int count)
+{
+    // command is started with first utterance and restarted if it exits
+    if (_pipe == nullptr)
+    {
+        _pipe = popen(_command.c_str(), "w");
+        if (_pipe == nullptr)
+        {
+            Debug_printf("SAM: failed to start \"%s\"\n", _command.c_str());
+            return;
+        }
+    }
+    // frames are passed on immediately, player starts while the rest is rendered
+    if (fwrite(samples, 1, count, _pipe) != (size_t)count || fflush(_pipe) != 0)
+    {
+        Debug_printf("SAM: \"%s\" does not accept samples\n", _command.c_str());
+        _close();
+    }
+}
+
+void SamPipeSink::end()
+{
+    if (_pipe != nullptr && fflush(_pipe) != 0)
+        _close();
+}
+
+SamSink *sam_open_sink(const char *spec)
+{
+    if (strncmp(spec, "wav:", 4) == 0 && spec[4] != '\0')
+    {
+        SamWavSink *wav = new SamWavSink(spec + 4);
+        if (wav->is_open())
+            return wav;
+        delete wav;
+    }
+    else if (strncmp(spec, "pipe:", 5) == 0 && spec[5] != '\0')
+        return new SamPipeSink(spec + 5);
+    else
+        Debug_printf("SAM: unknown output \"%s\"\n", spec);
+    return nullptr;
+}
+
+void sam_set_sink(SamSink *sink)
+{
+    _sink = sink;
+}
+
+static void OutputSink(const unsigned char *samples, int count, void *ctx)
+{
+    ((SamSink *)ctx)->write(samples, count);
+}
+
+#else
+
+#ifndef CONFIG_IDF_TARGET_ESP32S3
+static void OutputDAC(const unsigned char *samples, int count, void *ctx)
+{
+    for (int i = 0; i < count; i++)
+    {
+        dac_output_voltage(DAC_CHANNEL_1, samples[i]);
+        fnSystem.delay_microseconds(40);
+    }
+}
+#endif
+
+#endif // ESP_PLATFORM
 
 void PrintUsage()
 {
@@ -104,88 +220,6 @@ void PrintUsage()
     */
 }
 
-#ifdef USESDL
-
-int pos = 0;
-void MixAudio(void *unused, Uint8 *stream, int len)
-{
-    int bufferpos = GetBufferLength();
-    char *buffer = GetBuffer();
-    int i;
-    if (pos >= bufferpos)
-        return;
-    if ((bufferpos - pos) < len)
-        len = (bufferpos - pos);
-    for (i = 0; i < len; i++)
-    {
-        stream[i] = buffer[pos];
-        pos++;
-    }
-}
-
-void OutputSound()
-{
-    int bufferpos = GetBufferLength();
-    bufferpos /= 50;
-    SDL_AudioSpec fmt;
-
-    fmt.freq = 22050;
-    fmt.format = AUDIO_U8;
-    fmt.channels = 1;
-    fmt.samples = 2048;
-    fmt.callback = MixAudio;
-    fmt.userdata = NULL;
-
-    /* Open the audio device and start playing sound! */
-    if (SDL_OpenAudio(&fmt, NULL) < 0)
-    {
-        printf("Unable to open audio: %s\n", SDL_GetError());
-        exit(1);
-    }
-    SDL_PauseAudio(0);
-    //SDL_Delay((bufferpos)/7);
-
-    while (pos < bufferpos)
-    {
-        SDL_Delay(100);
-    }
-
-    SDL_CloseAudio();
-}
-
-#else
-
-void OutputSound()
-{
-#ifdef ESP_PLATFORM
-#ifndef CONFIG_IDF_TARGET_ESP32S3
-    int n = GetBufferLength() / 50;
-    char *s = GetBuffer();
-
-    //fnSystem.dac_output_enable(SystemManager::dac_channel_t::DAC_CHANNEL_1);
-    //fnSystem.dac_output_voltage(SystemManager::dac_channel_t::DAC_CHANNEL_1, 100);
-
-    dac_output_enable(DAC_CHANNEL_1);
-
-    for (int i = 0; i < n; i++)
-    {
-        //dacWrite(DAC1, s[i]);
-        // fnSystem.dac_write(PIN_DAC1, s[i]);
-        dac_output_voltage(DAC_CHANNEL_1, s[i]);
-        //delayMicroseconds(40);
-        fnSystem.delay_microseconds(40);
-    }
-
-    //fnSystem.dac_output_disable(SystemManager::dac_channel_t::DAC_CHANNEL_1);
-    dac_output_disable(DAC_CHANNEL_1);
-
-    FreeBuffer();
-#endif
-#endif
-}
-
-#endif
-
 int sam(int argc, char **argv)
 {
     int i;
@@ -198,6 +232,10 @@ int sam(int argc, char **argv)
     for (i = 0; i < 256; i++)
         input[i] = 0;
 
+    // Every utterance starts with standard voice
+    SetDefaults();
+    debug = 0;
+
     if (argc <= 1)
     {
         PrintUsage();
@@ -293,34 +331,40 @@ int sam(int argc, char **argv)
 
         // printf("done phonetic processing\n");
 
-#ifdef USESDL
-    if (SDL_Init(SDL_INIT_AUDIO) < 0)
+#ifndef __cplusplus
+    SetInput(input);
+#endif
+
+#ifndef ESP_PLATFORM
+    SamSink *sink = _sink;
+    SamWavSink *wav = nullptr;
+    if (wavfilename != NULL)
     {
-        printf("Unable to init SDL: %s\n", SDL_GetError());
-        exit(1);
+        wav = new SamWavSink(wavfilename);
+        sink = wav;
     }
-    atexit(SDL_Quit);
+    SetOutput(sink != nullptr ? OutputSink : NULL, sink);
+#elif !defined(CONFIG_IDF_TARGET_ESP32S3)
+    dac_output_enable(DAC_CHANNEL_1);
+    SetOutput(OutputDAC, NULL);
 #endif
 
-#ifndef __cplusplus
-    SetInput(input);
-#endif
+    // Speech is output while it is rendered
+    int ok = SAMMain();
 
-    // printf("right before SAMMain");
+#ifndef ESP_PLATFORM
+    if (sink != nullptr)
+        sink->end();
+    delete wav;
+#elif !defined(CONFIG_IDF_TARGET_ESP32S3)
+    dac_output_disable(DAC_CHANNEL_1);
+#endif
 
-    if (!SAMMain())
+    if (!ok)
     {
         PrintUsage();
         return 1;
     }
-    // printf("right after SAMMain");
-
-#ifndef ESP_PLATFORM
-    if (wavfilename != NULL)
-        WriteWav(wavfilename, GetBuffer(), GetBufferLength() / 50);
-    else
-#endif // ESP_PLATFORM
-        OutputSound();
 
     return 0;
 }
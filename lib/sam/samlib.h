@@ -1,17 +1,15 @@
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
 
+#include <string>
+
 #include "reciter.h"
 #include "sam.h"
 #include "samdebug.h"
 
-#ifdef USESDL
-#include <SDL.h>
-#include <SDL_audio.h>
-#endif
-
 #ifdef ESP_PLATFORM
 #include "../../include/pinmap.h"
 #endif
@@ -21,16 +19,58 @@ extern char input[256];
 #endif
 
 #ifndef ESP_PLATFORM
-void WriteWav(char *filename, char *buffer, int bufferlength);
+
+// Destination of rendered speech, samples are written frame by frame as SAM renders them
+class SamSink
+{
+public:
+    virtual ~SamSink() {};
+    virtual void write(const unsigned char *samples, int count) = 0;
+    // End of utterance
+    virtual void end() {};
+};
+
+// WAV file, header is updated after each utterance so the file is always playable
+class SamWavSink : public SamSink
+{
+private:
+    FILE *_file = nullptr;
+    uint32_t _data_len = 0;
+
+    void _write_header();
+
+public:
+    SamWavSink(const char *filename);
+    virtual ~SamWavSink() override;
+    bool is_open() { return _file != nullptr; };
+    virtual void write(const unsigned char *samples, int count) override;
+    virtual void end() override;
+};
+
+// Raw unsigned 8-bit mono samples written to standard input of a command,
+// e.g. "aplay -q -t raw -f U8 -r 22050 -c 1" to play them on local audio device
+class SamPipeSink : public SamSink
+{
+private:
+    std::string _command;
+    FILE *_pipe = nullptr;
+
+    void _close();
+
+public:
+    SamPipeSink(const char *command);
+    virtual ~SamPipeSink() override;
+    virtual void write(const unsigned char *samples, int count) override;
+    virtual void end() override;
+};
+
+// Create sink from specification "wav:<file>" or "pipe:<command>", nullptr if it is not valid
+SamSink *sam_open_sink(const char *spec);
+// Output of sam() without -wav option
+void sam_set_sink(SamSink *sink);
+
 #endif // ESP_PLATFORM
 
 void PrintUsage();
 
-#ifdef USESDL
-void MixAudio(void *unused, Uint8 *stream, int len);
-void OutputSound();
-#else
-void OutputSound();
-#endif
-
 int sam(int argc, char **argv);
@@ -5,7 +5,7 @@
 #include "debug.h"
 
 // global task manager object
-fnTaskManager taskMgr;
+thread_local fnTaskManager taskMgr;
 
 
 fnTaskManager::fnTaskManager()
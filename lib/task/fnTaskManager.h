@@ -31,6 +31,6 @@ private:
 };
 
 // global task manager
-extern fnTaskManager taskMgr;
+extern thread_local fnTaskManager taskMgr;
 
 #endif // _FN_TASKMANAGER_H
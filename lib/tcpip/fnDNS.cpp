@@ -1,5 +1,7 @@
 #include "fnDNS.h"
 
+#include <string.h>
+
 // #include <lwip/netdb.h>
 
 #include "../../include/debug.h"
@@ -13,9 +15,13 @@ in_addr_t get_ip4_addr_by_name(const char *hostname)
     #ifdef DEBUG
     Debug_printf("Resolving hostname \"%s\"\n", hostname);
     #endif
-    struct hostent *info = gethostbyname(hostname);
+    // getaddrinfo() is thread safe, hosts may be resolved concurrently
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    struct addrinfo *info = nullptr;
 
-    if(info == nullptr)
+    if(getaddrinfo(hostname, nullptr, &hints, &info) != 0 || info == nullptr)
     {
         #ifdef DEBUG
         Debug_println("Name failed to resolve");
@@ -23,13 +29,12 @@ in_addr_t get_ip4_addr_by_name(const char *hostname)
     }
     else
     {
-        if(info->h_addr_list[0] != nullptr)
-        {
-            result = *((in_addr_t*)(info->h_addr_list[0]));
-            #ifdef DEBUG
-            Debug_printf("Resolved to address %s\n", compat_inet_ntoa(result));
-            #endif
-        }
+        result = ((struct sockaddr_in *)info->ai_addr)->sin_addr.s_addr;
+        #ifdef DEBUG
+        Debug_printf("Resolved to address %s\n", compat_inet_ntoa(result));
+        #endif
     }
+    if(info != nullptr)
+        freeaddrinfo(info);
     return result;
 }
\ No newline at end of file
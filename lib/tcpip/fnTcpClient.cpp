@@ -117,7 +117,7 @@ private:
     }
 
 public:
-    fnTcpClientRxBuffer(int fd, size_t size = 1436)
+    fnTcpClientRxBuffer(int fd, size_t size = FNTCP_RX_BUFFER_SIZE)
         : _size(size), _buffer(NULL), _pos(0), _fill(0), _fd(fd), _failed(false) {}
 
     ~fnTcpClientRxBuffer() { free(_buffer); }
@@ -241,6 +241,13 @@ int fnTcpClient::connect(in_addr_t ip, uint16_t port, int32_t timeout)
     }
 #endif
 
+    // Larger socket buffer lets the peer keep sending while we're busy
+    if (_rxBufferSize > FNTCP_RX_BUFFER_SIZE)
+    {
+        int rcvbuf = (int)_rxBufferSize;
+        setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, (char *)&rcvbuf, sizeof(rcvbuf));
+    }
+
     // Add O_NONBLOCK to our socket file descriptor
 #if defined(_WIN32)
     unsigned long on = 1;
@@ -351,7 +358,7 @@ int fnTcpClient::connect(in_addr_t ip, uint16_t port, int32_t timeout)
 #endif
     // Create a socket handle and recieve buffer objects
     _clientSocketHandle.reset(new fnTcpClientSocketHandle(sockfd));
-    _rxBuffer.reset(new fnTcpClientRxBuffer(sockfd));
+    _rxBuffer.reset(new fnTcpClientRxBuffer(sockfd, _rxBufferSize));
     _connected = true;
 
     return 1;
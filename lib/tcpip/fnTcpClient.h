@@ -7,6 +7,8 @@
 
 #include "compat_inet.h"
 
+#define FNTCP_RX_BUFFER_SIZE (1436)
+
 class fnTcpClientSocketHandle;
 class fnTcpClientRxBuffer;
 
@@ -16,6 +18,7 @@ protected:
     std::shared_ptr<fnTcpClientRxBuffer> _rxBuffer;
     std::shared_ptr<fnTcpClientSocketHandle> _clientSocketHandle;
     bool _connected = false;
+    size_t _rxBufferSize = FNTCP_RX_BUFFER_SIZE;
 
 public:
     fnTcpClient() {};
@@ -27,6 +30,8 @@ public:
 
     int connect(const char *host, uint16_t port, int32_t timeout = -1);
     int connect(in_addr_t addr, uint16_t port, int32_t timeout = -1);
+    // Size of receive buffer for bulk transfers, used by next connect()
+    void setRxBufferSize(size_t size) { _rxBufferSize = size; };
 
     size_t write(uint8_t data);
     size_t write(const uint8_t *buf, size_t size);
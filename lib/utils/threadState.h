@@ -0,0 +1,44 @@
+#ifndef _THREAD_STATE_H
+#define _THREAD_STATE_H
+
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+/*
+ State kept separately for every thread using an object, like position of directory
+ listing in a file system shared by SIO, web interface and background tasks.
+ References returned by get() stay valid until the same thread calls release().
+*/
+template <class T>
+class ThreadState
+{
+private:
+    std::mutex _lock;
+    std::unordered_map<std::thread::id, T> _states;
+
+public:
+    // State of calling thread, created on first use
+    T &get()
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        return _states[std::this_thread::get_id()];
+    };
+
+    // State of calling thread, nullptr if there is none
+    T *find()
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        auto it = _states.find(std::this_thread::get_id());
+        return it != _states.end() ? &it->second : nullptr;
+    };
+
+    // Drop state of calling thread
+    void release()
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        _states.erase(std::this_thread::get_id());
+    };
+};
+
+#endif // _THREAD_STATE_H
@@ -9,6 +9,8 @@
 #include "compat_string.h"
 #include "compat_gettimeofday.h"
 
+#include <openssl/evp.h>
+
 #include "../../include/debug.h"
 
 #include "samlib.h"
@@ -278,6 +280,20 @@ std::string util_long_entry(std::string filename, size_t fileSize, bool is_dir)
     return returned_entry;
 }
 
+// Returns MD5 of buffer as 32 lowercase hex digits, empty string on failure
+std::string util_md5_hex(const void *buf, size_t size)
+{
+    unsigned char md5_result[EVP_MAX_MD_SIZE];
+    unsigned int md5_len = 0;
+    if (EVP_Digest(buf, size, md5_result, &md5_len, EVP_md5(), nullptr) != 1)
+        return std::string();
+
+    char hex[EVP_MAX_MD_SIZE * 2 + 1];
+    for (unsigned int i = 0; i < md5_len; i++)
+        sprintf(&hex[i * 2], "%02x", md5_result[i]);
+    return std::string(hex, md5_len * 2);
+}
+
 /* Shortens the source string by splitting it in to shorter halves connected by "..." if it won't fit in the destination buffer.
    Returns number of bytes copied into buffer.
 */
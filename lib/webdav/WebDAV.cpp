@@ -6,11 +6,79 @@
 
 #include <cstring>
 
+#include "../../include/debug.h"
+
+
+WebDAV::~WebDAV()
+{
+    if (parser != nullptr)
+        XML_ParserFree(parser);
+}
+
+bool WebDAV::begin()
+{
+    if (parser != nullptr)
+        XML_ParserFree(parser);
+
+    entries.clear();
+    currentEntry = DAVEntry();
+    insideResponse = insideDisplayName = insideGetContentLength = false;
+    parseError = false;
+
+    parser = XML_ParserCreate(NULL);
+    if (parser == nullptr)
+    {
+        Debug_printf("WebDAV::begin - could not create expat parser. Aborting.\n");
+        return true;
+    }
+
+    XML_SetUserData(parser, this);
+    XML_SetElementHandler(parser, _start, _end);
+    XML_SetCharacterDataHandler(parser, _char);
+    return false;
+}
+
+bool WebDAV::parse(const char *buf, size_t len)
+{
+    if (parser == nullptr || parseError)
+        return true;
+
+    if (XML_Parse(parser, buf, len, false) == XML_STATUS_ERROR)
+    {
+        Debug_printf("DAV response XML Parse Error! msg: %s line: %lu\n",
+                     XML_ErrorString(XML_GetErrorCode(parser)), XML_GetCurrentLineNumber(parser));
+        parseError = true;
+    }
+    return parseError;
+}
+
+bool WebDAV::end()
+{
+    if (parser == nullptr)
+        return true;
+
+    if (!parseError && XML_Parse(parser, nullptr, 0, true) == XML_STATUS_ERROR)
+    {
+        Debug_printf("DAV response XML Parse Error! msg: %s line: %lu\n",
+                     XML_ErrorString(XML_GetErrorCode(parser)), XML_GetCurrentLineNumber(parser));
+        parseError = true;
+    }
+
+    XML_ParserFree(parser);
+    parser = nullptr;
+
+    Debug_printf("WebDAV: %u entries\n", (unsigned)entries.size());
+    return parseError;
+}
 
 void WebDAV::Start(const XML_Char *el, const XML_Char **attr)
 {
     if (strcmp(el, "D:response") == 0)
+    {
         insideResponse = true;
+        currentEntry.filename.clear();
+        currentEntry.fileSize = 0;
+    }
     else if (strcmp(el, "D:displayname") == 0)
         insideDisplayName = true;
     else if (strcmp(el, "D:getcontentlength") == 0)
@@ -30,13 +98,33 @@ void WebDAV::End(const XML_Char *el)
         insideGetContentLength = false;
 }
 
+// character data can arrive in several pieces, e.g. split between two response chunks
 void WebDAV::Char(const XML_Char *s, int len)
 {
     if (insideResponse == true)
     {
         if (insideDisplayName == true)
-            currentEntry.filename = string(s, len);
+            currentEntry.filename.append(s, len);
         else if (insideGetContentLength == true)
-            currentEntry.fileSize = string(s, len);
+        {
+            for (int i = 0; i < len; i++)
+                if (s[i] >= '0' && s[i] <= '9')
+                    currentEntry.fileSize = currentEntry.fileSize * 10 + (s[i] - '0');
+        }
     }
-}
\ No newline at end of file
+}
+
+void WebDAV::_start(void *data, const XML_Char *el, const XML_Char **attr)
+{
+    static_cast<WebDAV *>(data)->Start(el, attr);
+}
+
+void WebDAV::_end(void *data, const XML_Char *el)
+{
+    static_cast<WebDAV *>(data)->End(el);
+}
+
+void WebDAV::_char(void *data, const XML_Char *s, int len)
+{
+    static_cast<WebDAV *>(data)->Char(s, len);
+}
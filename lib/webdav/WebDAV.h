@@ -6,6 +6,8 @@
 #define WebDAV_H
 
 #include <expat.h>
+#include <stdint.h>
+#include <cstddef>
 #include <string>
 #include <vector>
 
@@ -30,9 +32,32 @@ public:
         /**
          * Entry filesize
          */
-        string fileSize;
+        uint32_t fileSize = 0;
     };
 
+    ~WebDAV();
+
+    /**
+     * @brief Start parsing new PROPFIND response, clears previous entries.
+     * @return TRUE on error, FALSE on success.
+     */
+    bool begin();
+
+    /**
+     * @brief Feed next part of PROPFIND response into the parser.
+     *        Entries are appended as soon as their D:response element ends.
+     * @param buf pointer to response data
+     * @param len length of response data
+     * @return TRUE on error, FALSE on success.
+     */
+    bool parse(const char *buf, size_t len);
+
+    /**
+     * @brief Finish parsing, release the parser.
+     * @return TRUE if response was not well-formed, FALSE on success.
+     */
+    bool end();
+
     /**
      * @brief Called when start tag is encountered.
      * @param el element to be processed
@@ -66,17 +91,32 @@ public:
     /**
      * Are we inside D:response?
      */
-    bool insideResponse;
+    bool insideResponse = false;
 
     /**
      * Are we inside D:displayname?
      */
-    bool insideDisplayName;
+    bool insideDisplayName = false;
 
     /**
      * Are we inside D:getcontentlength?
      */
-    bool insideGetContentLength;
+    bool insideGetContentLength = false;
+
+private:
+    /**
+     * expat parser, exists between begin() and end()
+     */
+    XML_Parser parser = nullptr;
+
+    /**
+     * Parse error was encountered, rest of the response is ignored
+     */
+    bool parseError = false;
+
+    static void _start(void *data, const XML_Char *el, const XML_Char **attr);
+    static void _end(void *data, const XML_Char *el);
+    static void _char(void *data, const XML_Char *s, int len);
 };
 
-#endif /* WebDAV_H */
\ No newline at end of file
+#endif /* WebDAV_H */
@@ -6,6 +6,19 @@
 // #include <stdlib.h>
 #include <signal.h>
 #include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#define mkdir(A, B) _mkdir(A)
+#endif
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "debug.h"
 #include "bus.h"
@@ -18,6 +31,8 @@
 #include "fnDummyWiFi.h"
 #include "fnFsSD.h"
 #include "fnFsSPIFFS.h"
+#include "fnFileCache.h"
+#include "tnfslibMountInfo.h"
 
 #include "httpService.h"
 
@@ -36,19 +51,40 @@
 
 // sioFuji theFuji; // moved to fuji.h/.cpp
 
+// Set by SIGINT and SIGTERM, service loops end and the program exits
+static volatile sig_atomic_t main_stopping = 0;
+
 void main_shutdown_handler()
 {
     Debug_println("Shutdown handler called");
     // Give devices an opportunity to clean up before rebooting
 
     SYSTEM_BUS.shutdown();
+    // Write configuration changes which are waiting for background save
+    Config.flush();
+}
+
+/*
+ Config, bus and devices are thread_local, each instance (-n option) has its own set on its
+ thread. They are destroyed when the thread ends or the program exits, the guard is created
+ after them by arm_shutdown(), so devices are shut down before any of them is destroyed.
+*/
+struct main_shutdown_guard
+{
+    ~main_shutdown_guard() { main_shutdown_handler(); };
+};
+
+static void arm_shutdown()
+{
+    static thread_local main_shutdown_guard guard;
+    (void)guard;
 }
 
 void sighandler(int signum)
 {
-    Debug_print("\n");
-    Debug_printf("Signal received (%d)\n", signum);
-    exit(0);
+    main_stopping = signum;
+    // service loop may be stuck, another signal ends the program right away
+    signal(signum, SIG_DFL);
 }
 
 void print_version()
@@ -64,12 +100,69 @@ void print_version()
 #endif
 }
 
-// Initial setup
+// SIO capture to replay instead of running service loop (-p option)
+const char *replay_capture = nullptr;
+// SIO capture to record (-r option)
+static const char *record_capture = nullptr;
+// Count of instances to run in this process (-n option), 0 to run just the program itself
+static int instance_count = 0;
+
+void fn_service_loop(void *param);
+
+// "fnconfig.ini" -> "fnconfig-2.ini", "SD" -> "SD-2"
+static std::string instance_path(std::string path, int num, bool is_dir)
+{
+    while (path.size() > 1 && (path.back() == '/' || path.back() == '\\'))
+        path.pop_back();
+    size_t slash = path.find_last_of("/\\");
+    size_t dot = is_dir ? std::string::npos : path.find_last_of('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        dot = path.size();
+    return path.substr(0, dot) + "-" + std::to_string(num) + path.substr(dot);
+}
+
+// "http://0.0.0.0:8000" -> "http://0.0.0.0:8001" for offset 1
+// Returns empty string if the URL has no port
+static std::string instance_url(const std::string &url, int offset)
+{
+    size_t host = url.find("//");
+    host = host == std::string::npos ? 0 : host + 2;
+    size_t end = url.find('/', host);
+    size_t colon = url.rfind(':', end == std::string::npos ? std::string::npos : end);
+    if (colon == std::string::npos || colon < host)
+        return std::string();
+    int port = atoi(url.c_str() + colon + 1);
+    if (port <= 0)
+        return std::string();
+    return url.substr(0, colon + 1) + std::to_string(port + offset) + (end == std::string::npos ? "" : url.substr(end));
+}
+
+static bool copy_file(const std::string &from, const std::string &to)
+{
+    FILE *fin = fopen(from.c_str(), "rb");
+    if (fin == nullptr)
+        return false;
+    FILE *fout = fopen(to.c_str(), "wb");
+    if (fout == nullptr)
+    {
+        fclose(fin);
+        return false;
+    }
+    char buf[4096];
+    size_t count;
+    bool ok = true;
+    while (ok && (count = fread(buf, 1, sizeof(buf), fin)) > 0)
+        ok = fwrite(buf, 1, count, fout) == count;
+    fclose(fin);
+    return (fclose(fout) == 0) && ok;
+}
+
+// Initial setup of the program, devices are set up by setup_instance()
 void main_setup(int argc, char *argv[])
 {
     // program arguments
     int opt;
-    while ((opt = getopt(argc, argv, "Vu:c:s:")) != -1) {
+    while ((opt = getopt(argc, argv, "Vu:c:s:C:n:r:p:")) != -1) {
         switch (opt) {
             case 'V':
                 print_version();
@@ -83,12 +176,30 @@ void main_setup(int argc, char *argv[])
             case 's':
                 Config.store_general_SD_path(optarg);
                 break;
+            case 'C':
+                Config.store_general_cache_path(optarg);
+                break;
+            case 'n':
+                instance_count = atoi(optarg);
+                break;
+            case 'r':
+                record_capture = optarg;
+                break;
+            case 'p':
+                replay_capture = optarg;
+                break;
             default: /* '?' */
-                fprintf(stderr, "Usage: %s [-V] [-u URL] [-c config_file] [-s SD_directory]\n", argv[0]);
+                fprintf(stderr, "Usage: %s [-V] [-u URL] [-c config_file] [-s SD_directory] [-C cache_directory] [-n instances] [-r record_SIO_file | -p replay_SIO_file]\n", argv[0]);
                 exit(EXIT_FAILURE);
         }
     }
 
+    if (instance_count > 0 && (record_capture != nullptr || replay_capture != nullptr))
+    {
+        fprintf(stderr, "Recording or replaying SIO (-r, -p) is not supported with instances (-n)\n");
+        exit(EXIT_FAILURE);
+    }
+
 #ifdef DEBUG
     // fnUartDebug.begin(DEBUG_SPEED);
     unsigned long startms = fnSystem.millis();
@@ -109,6 +220,7 @@ void main_setup(int argc, char *argv[])
 #endif // ATARI
 #endif // DEBUG
 
+
 /*
     // Install a reboot handler
     esp_register_shutdown_handler(main_shutdown_handler);
@@ -137,11 +249,13 @@ void main_setup(int argc, char *argv[])
     }
 #endif
 
-    atexit(main_shutdown_handler);
     signal(SIGINT, sighandler);
     signal(SIGTERM, sighandler);
 #if defined(_WIN32)
     signal(SIGBREAK, sighandler);
+#else
+    // writes to closed sockets and pipes (e.g. SAM player which exited) fail with EPIPE instead
+    signal(SIGPIPE, SIG_IGN);
 #endif
 
     fnSystem.check_hardware_ver();
@@ -150,11 +264,34 @@ void main_setup(int argc, char *argv[])
     // fnKeyManager.setup();
     // fnLedManager.setup();
 
+    // Web interface files and remote file cache are shared by all instances
     fnSPIFFS.start();
+    std::string cache_path = Config.get_general_cache_path();
+    fnFileCache.start(cache_path.empty() ? Config.get_general_SD_path().c_str() : cache_path.c_str());
+}
+
+/*
+ Starts SD, configuration, bus and devices of the program or of the instance number num
+ (-n option) on the calling thread. NetSIO port is stored into a new instance config.
+*/
+static void setup_instance(int num, int netsio_port)
+{
+#ifdef DEBUG
+    unsigned long startms = fnSystem.millis();
+#endif
+
     fnSDFAT.start(Config.get_general_SD_path().c_str());
 
     // Load our stored configuration
     Config.load();
+    if (netsio_port > 0)
+    {
+        Config.store_netsio_port(netsio_port);
+        Config.save();
+    }
+    // budget of the shared cache comes from the base config, see run_instances()
+    if (num == 0)
+        fnFileCache.set_size(Config.get_general_cache_size());
 
     // Now that our main service is running, try connecting to WiFi or BlueTooth
     if (Config.get_bt_status())
@@ -195,15 +332,33 @@ void main_setup(int argc, char *argv[])
     SIO.addDevice(ptr, SIO_DEVICEID_PRINTER + fnPrinters.get_port(0)); // P:
 
     sioR = new sioModem(ptrfs, Config.get_modem_sniffer_enabled()); // Config/User selected sniffer enable
+    sioR->get_modem_sniffer()->setFormat((ModemSniffer::sniffer_format)Config.get_modem_sniffer_format());
 
     SIO.addDevice(sioR, SIO_DEVICEID_RS232); // R:
 
-    // SIO.addDevice(&sioV, SIO_DEVICEID_FN_VOICE); // P3:
+    // SAM voice synthesizer, speech is streamed to configured WAV file or player command
+    if (!Config.get_general_voice_output().empty())
+    {
+        SamSink *voice_sink = sam_open_sink(Config.get_general_voice_output().c_str());
+        if (voice_sink != nullptr)
+        {
+            sioV.set_sink(voice_sink);
+            SIO.addDevice(&sioV, SIO_DEVICEID_FN_VOICE); // P4:
+        }
+    }
 
-    // SIO.addDevice(&sioZ, SIO_DEVICEID_CPM); // (ATR8000 CPM)
+    SIO.addDevice(&sioZ, SIO_DEVICEID_CPM); // (ATR8000 CPM)
 
     // Go setup SIO
     SIO.setup();
+
+    // Warm up host connections and mount disks now, like the firmware does once WiFi
+    // is connected, instead of waiting for the first MOUNT_ALL from the Atari
+    if (Config.get_general_config_enabled() == false)
+        theFuji.mount_all(false);
+
+    if (record_capture != nullptr)
+        fnSioCom.start_recording(record_capture);
 #endif // BUILD_ATARI
 
 #ifdef BUILD_CBM
@@ -271,6 +426,8 @@ void main_setup(int argc, char *argv[])
 
 #endif /* BUILD_APPLE */
 
+    arm_shutdown();
+
 #ifdef DEBUG
     unsigned long endms = fnSystem.millis();
     Debug_printf("Available heap: %u\n", fnSystem.get_free_heap_size());
@@ -278,6 +435,127 @@ void main_setup(int argc, char *argv[])
 #endif
 }
 
+// Instance running on its own thread, see run_instances()
+struct fn_instance
+{
+    int num;
+    std::string config_path;
+    std::string sd_path;
+    std::string url;
+    int netsio_port = 0;    // stored into a new config
+    std::thread thread;
+    bool running = false;
+    bool ended = false;     // service loop ended, thread is finishing
+    bool done = false;      // ended and not started again
+    int exit_code = 0;
+};
+
+static std::mutex instances_lock;
+static std::condition_variable instances_cv;
+
+static void instance_main(fn_instance *inst)
+{
+    fnSystem.set_instance();
+    Config.store_general_config_path(inst->config_path.c_str());
+    Config.store_general_SD_path(inst->sd_path.c_str());
+    Config.store_general_interface_url(inst->url.c_str());
+
+    setup_instance(inst->num, inst->netsio_port);
+    fn_service_loop(nullptr);
+
+    std::lock_guard<std::mutex> lock(instances_lock);
+    inst->exit_code = main_stopping ? EXIT_SUCCESS : fnSystem.reboot_code();
+    inst->ended = true;
+    instances_cv.notify_all();
+    // devices and config of the instance are shut down and destroyed as the thread ends
+}
+
+/*
+ Runs instances 1..count (-n option) in this process, each on its own thread with its own
+ config, bus and devices (thread_local globals), config file, SD directory, NetSIO port and web
+ interface port, numbered from the ports of the base config. Caches of remote files, image
+ indexes and directory listings and connections to remote hosts are shared by all of them.
+ An instance which reboots is started again, the program exits when all instances ended.
+*/
+static void run_instances(int count)
+{
+    std::string config_path = Config.get_general_config_path();
+    std::string sd_path = Config.get_general_SD_path();
+    std::string url = Config.get_general_interface_url();
+
+    // web interfaces of instances listen on consecutive ports
+    if (count > 1 && instance_url(url, 0).empty())
+    {
+        fprintf(stderr, "Web interface URL \"%s\" has no port, instances would listen on the same one\n", url.c_str());
+        exit(EXIT_FAILURE);
+    }
+
+    // base config numbers NetSIO ports of new instances and sets the size of shared cache
+    Config.load();
+    int netsio_port = Config.get_netsio_port();
+    fnFileCache.set_size(Config.get_general_cache_size());
+
+    std::vector<fn_instance> instances(count);
+    for (int i = 0; i < count; i++)
+    {
+        fn_instance &inst = instances[i];
+        inst.num = i + 1;
+        inst.config_path = instance_path(config_path, inst.num, false);
+        inst.sd_path = instance_path(sd_path, inst.num, true);
+        inst.url = inst.num == 1 ? url : instance_url(url, inst.num - 1);
+
+        struct stat st;
+        if (stat(inst.config_path.c_str(), &st) != 0)
+        {
+            copy_file(config_path, inst.config_path);
+            inst.netsio_port = netsio_port + i;
+        }
+        if (mkdir(inst.sd_path.c_str(), 0755) != 0 && errno != EEXIST)
+            fprintf(stderr, "Instance %d: failed to create %s: %s\n", inst.num, inst.sd_path.c_str(), strerror(errno));
+    }
+
+    std::unique_lock<std::mutex> lock(instances_lock);
+    while (true)
+    {
+        bool running = false;
+        for (fn_instance &inst : instances)
+        {
+            if (inst.ended)
+            {
+                // wait until its devices are shut down, NetSIO and web ports are free again
+                lock.unlock();
+                inst.thread.join();
+                lock.lock();
+                bool restart = inst.exit_code == EXIT_AND_RESTART && !main_stopping;
+                printf("Instance %d ended%s\n", inst.num, restart ? ", restarting" : "");
+                fflush(stdout);
+                inst.ended = false;
+                inst.running = false;
+                inst.done = !restart;
+                inst.netsio_port = 0;
+            }
+            if (inst.done || (main_stopping && !inst.running))
+                continue;
+            if (inst.running)
+            {
+                running = true;
+                continue;
+            }
+
+            printf("Instance %d: config %s, SD %s, web %s\n", inst.num, inst.config_path.c_str(), inst.sd_path.c_str(), inst.url.c_str());
+            fflush(stdout);
+            inst.running = true;
+            inst.thread = std::thread(instance_main, &inst);
+            running = true;
+        }
+        if (!running)
+            break;
+        // signals don't wake the wait, service loops see main_stopping and end the instances
+        instances_cv.wait_for(lock, std::chrono::milliseconds(100));
+    }
+    exit(EXIT_SUCCESS);
+}
+
 #ifdef BUILD_S100
 
 // theFuji.setup(&s100Bus);
@@ -288,7 +566,10 @@ void main_setup(int argc, char *argv[])
 // Main high-priority service loop
 void fn_service_loop(void *param)
 {
-    while (true)
+    // don't let the bus stall behind TNFS requests of background tasks retrying on dead server
+    tnfs_set_lock_wait(TNFS_BUS_LOCK_WAIT);
+
+    while (!main_stopping)
     {
         // We don't have any delays in this loop, so IDLE threads will be starved
         // Shouldn't be a problem, but something to keep in mind...
@@ -310,9 +591,7 @@ void fn_service_loop(void *param)
             // stop the web server first
             // web server is tested by script in restart.html to check if the program is running again
             fnHTTPD.stop();
-            // exit the program with special exit code (75)
-            // to indicate the program should be started again
-            fnSystem.reboot();
+            break;
         }
     }
 }
@@ -365,6 +644,24 @@ int main(int argc, char *argv[])
 {
     // Call our setup routine
     main_setup(argc, argv);
+    if (instance_count > 0)
+        run_instances(instance_count);
+
+    setup_instance(0, 0);
+#ifdef BUILD_ATARI
+    // Replay SIO capture and quit
+    if (replay_capture != nullptr)
+        exit(SIO.replay(replay_capture) == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+#endif
     // Enter service loop
     fn_service_loop(nullptr);
+
+    if (main_stopping)
+    {
+        Debug_printf("Signal received (%d)\n", (int)main_stopping);
+        exit(EXIT_SUCCESS);
+    }
+    // exit the program with special exit code (75)
+    // to indicate the program should be started again
+    fnSystem.reboot();
 }
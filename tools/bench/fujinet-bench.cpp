@@ -0,0 +1,909 @@
+/*
+ * fujinet-bench
+ *
+ * Headless NetSIO throughput benchmark. Plays the Atari side of NetSIO (the hub, normally
+ * Altirra with netsio.atdevice) on loopback UDP and drives running FujiNet-PC instance with
+ * scripted workloads:
+ *   - sequential and random sector reads from ATR at every requested HSIO index,
+ *     disk image is mounted from FujiNet-PC configuration (Mount slots)
+ *   - N: device reads of various sizes
+ *   - Fuji directory listings
+ * Results are printed as JSON: operations/sec, bytes/sec and p50/p99 latency in microseconds.
+ *
+ * FujiNet-PC must have NetSIO enabled and pointing to the benchmark:
+ *   [NetSIO]
+ *   enabled=1
+ *   host=127.0.0.1
+ *   port=9997
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../../lib/bus/sio/siocom/netsio_proto.h"
+
+#define BENCH_DEFAULT_PORT 9997
+#define BENCH_STANDARD_BAUDRATE 19200
+#define BENCH_CONNECT_TIMEOUT_MS 30000
+#define BENCH_SYNC_TIMEOUT_MS 5000
+#define BENCH_DATA_TIMEOUT_MS 10000
+#define BENCH_QUIET_MS 200          // data frame of unknown length ends when device is quiet this long
+#define BENCH_STATUS_POLL_MS 1      // delay between N: status polls while no data is waiting
+
+// SIO bytes
+#define SIO_ACK 'A'
+#define SIO_NAK 'N'
+#define SIO_COMPLETE 'C'
+#define SIO_ERROR 'E'
+
+// devices and commands used by benchmark
+#define SIO_DEVICEID_DISK 0x31
+#define SIO_DEVICEID_FUJINET 0x70
+#define SIO_DEVICEID_FN_NETWORK 0x71
+
+#define SIO_DISKCMD_READ 0x52
+#define SIO_DISKCMD_PERCOM_READ 0x4E
+
+#define FUJICMD_MOUNT_HOST 0xF9
+#define FUJICMD_OPEN_DIRECTORY 0xF7
+#define FUJICMD_READ_DIR_ENTRY 0xF6
+#define FUJICMD_CLOSE_DIRECTORY 0xF5
+#define FUJICMD_SET_HSIO_INDEX 0xE3
+#define FUJICMD_MOUNT_ALL 0xD7
+
+#define NETCMD_OPEN 'O'
+#define NETCMD_CLOSE 'C'
+#define NETCMD_READ 'R'
+#define NETCMD_STATUS 'S'
+
+#define DEVICESPEC_LEN 256
+#define DIR_ENTRY_LEN 36
+
+enum cmd_result
+{
+    CMD_OK = 0,
+    CMD_NAK,        // device refused the command
+    CMD_ERROR,      // device responded with ERROR
+    CMD_NO_DEVICE,  // no device handled the command (empty sync)
+    CMD_TIMEOUT,
+    CMD_CHECKSUM    // bad data frame checksum
+};
+
+static const char *cmd_result_names[] = {"ok", "nak", "error", "no device", "timeout", "checksum"};
+
+static uint8_t sio_checksum(const uint8_t *buf, size_t len)
+{
+    unsigned int chk = 0;
+    for (size_t i = 0; i < len; i++)
+        chk = ((chk + buf[i]) >> 8) + ((chk + buf[i]) & 0xff);
+    return (uint8_t)chk;
+}
+
+static uint64_t now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+ * Computer side of NetSIO
+ */
+class NetSioHub
+{
+private:
+    int _fd = -1;
+    struct sockaddr_in _peer;
+    bool _connected = false;
+    uint8_t _sync_num = 0;
+    uint32_t _baud = BENCH_STANDARD_BAUDRATE;
+    uint32_t _device_baud = 0;  // last baud rate announced by device
+    int _speed_changes = 0;     // number of SPEED_CHANGE messages from device
+
+    // sync response for current command
+    bool _sync_received;
+    uint8_t _sync_type;
+    uint8_t _sync_ack;
+    uint16_t _sync_write_size;
+
+    // data bytes sent by device
+    std::vector<uint8_t> _rx;
+    size_t _rx_pos = 0;
+
+    void send_msg(const uint8_t *msg, size_t len);
+    void send_byte_msg(uint8_t msg) { send_msg(&msg, 1); }
+    void send_data_block(const uint8_t *data, size_t len);
+    bool wait_sync(int timeout_ms);
+    int read_byte(int timeout_ms);
+    bool read_bytes(uint8_t *buf, size_t len, int timeout_ms);
+
+public:
+    ~NetSioHub();
+
+    bool listen(int port);
+    bool wait_connect(int timeout_ms);
+    // receive and handle NetSIO messages, returns false on timeout
+    bool handle(int timeout_ms);
+
+    uint32_t device_baud() { return _device_baud; }
+    int speed_changes() { return _speed_changes; }
+    void set_baudrate(uint32_t baud);
+
+    // full SIO command transaction, data_out (if any) is sent to device, data_in (if any) is read from device
+    cmd_result command(uint8_t device, uint8_t comnd, uint8_t aux1, uint8_t aux2,
+                       const uint8_t *data_out = nullptr, size_t out_len = 0,
+                       uint8_t *data_in = nullptr, size_t in_len = 0);
+    // data bytes sent after the last command() and not read by it, until device is quiet for quiet_ms
+    size_t receive_rest(std::vector<uint8_t> &data, int quiet_ms);
+    // command frame with bad checksum, as seen by device when computer talks at other speed
+    void bad_command_frame();
+};
+
+NetSioHub::~NetSioHub()
+{
+    if (_fd >= 0)
+        close(_fd);
+}
+
+bool NetSioHub::listen(int port)
+{
+    _fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (_fd < 0)
+    {
+        fprintf(stderr, "Failed to create socket: %s\n", strerror(errno));
+        return false;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        fprintf(stderr, "Failed to bind UDP port %d: %s\n", port, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void NetSioHub::send_msg(const uint8_t *msg, size_t len)
+{
+    if (!_connected)
+        return;
+    sendto(_fd, (const char *)msg, len, 0, (struct sockaddr *)&_peer, sizeof(_peer));
+}
+
+void NetSioHub::send_data_block(const uint8_t *data, size_t len)
+{
+    // device drops the last byte of data block (packet sequence number placeholder)
+    uint8_t txbuf[512];
+    while (len > 0)
+    {
+        size_t n = std::min(len, sizeof(txbuf) - 2);
+        txbuf[0] = NETSIO_DATA_BLOCK;
+        memcpy(txbuf + 1, data, n);
+        txbuf[n + 1] = 0;
+        send_msg(txbuf, n + 2);
+        data += n;
+        len -= n;
+    }
+}
+
+bool NetSioHub::handle(int timeout_ms)
+{
+    struct pollfd pfd;
+    pfd.fd = _fd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, timeout_ms) <= 0)
+        return false;
+
+    uint8_t rxbuf[1024];
+    struct sockaddr_in from;
+    socklen_t fromlen = sizeof(from);
+    ssize_t received = recvfrom(_fd, (char *)rxbuf, sizeof(rxbuf), 0, (struct sockaddr *)&from, &fromlen);
+    if (received <= 0)
+        return true;
+
+    // any message from device makes it our peer, device may reconnect from other port
+    if (!_connected || from.sin_port != _peer.sin_port || from.sin_addr.s_addr != _peer.sin_addr.s_addr)
+    {
+        _peer = from;
+        _connected = true;
+        fprintf(stderr, "NetSIO device %s:%d\n", inet_ntoa(from.sin_addr), ntohs(from.sin_port));
+    }
+
+    switch (rxbuf[0])
+    {
+    case NETSIO_PING_REQUEST:
+        send_byte_msg(NETSIO_PING_RESPONSE);
+        break;
+    case NETSIO_ALIVE_REQUEST:
+        send_byte_msg(NETSIO_ALIVE_RESPONSE);
+        break;
+    case NETSIO_DEVICE_CONNECT:
+        // let device know our speed
+        set_baudrate(_baud);
+        break;
+    case NETSIO_DEVICE_DISCONNECT:
+        _connected = false;
+        break;
+    case NETSIO_SPEED_CHANGE:
+        if (received >= 5)
+        {
+            _device_baud = rxbuf[1] | (rxbuf[2] << 8) | (rxbuf[3] << 16) | (rxbuf[4] << 24);
+            _speed_changes++;
+        }
+        break;
+    case NETSIO_SYNC_RESPONSE:
+        if (received >= 6 && rxbuf[1] == _sync_num)
+        {
+            _sync_received = true;
+            _sync_type = rxbuf[2];
+            _sync_ack = rxbuf[3];
+            _sync_write_size = rxbuf[4] | (rxbuf[5] << 8);
+        }
+        break;
+    case NETSIO_DATA_BYTE:
+        if (received >= 2)
+            _rx.push_back(rxbuf[1]);
+        break;
+    case NETSIO_DATA_BLOCK:
+        _rx.insert(_rx.end(), rxbuf + 1, rxbuf + received);
+        break;
+    default:
+        // PROCEED/INTERRUPT and others are not used by benchmark
+        break;
+    }
+    return true;
+}
+
+bool NetSioHub::wait_connect(int timeout_ms)
+{
+    uint64_t deadline = now_us() + (uint64_t)timeout_ms * 1000;
+    // wait for device, then give it time to announce its baud rate
+    while (!_connected || _device_baud == 0)
+    {
+        int64_t left = (int64_t)(deadline - now_us()) / 1000;
+        if (left <= 0)
+            return false;
+        handle((int)left);
+    }
+    return true;
+}
+
+void NetSioHub::set_baudrate(uint32_t baud)
+{
+    uint8_t txbuf[5];
+    txbuf[0] = NETSIO_SPEED_CHANGE;
+    txbuf[1] = baud & 0xff;
+    txbuf[2] = (baud >> 8) & 0xff;
+    txbuf[3] = (baud >> 16) & 0xff;
+    txbuf[4] = (baud >> 24) & 0xff;
+    send_msg(txbuf, sizeof(txbuf));
+    _baud = baud;
+}
+
+bool NetSioHub::wait_sync(int timeout_ms)
+{
+    uint64_t deadline = now_us() + (uint64_t)timeout_ms * 1000;
+    while (!_sync_received)
+    {
+        int64_t left = (int64_t)(deadline - now_us()) / 1000;
+        if (left <= 0)
+            return false;
+        handle((int)left);
+    }
+    return true;
+}
+
+int NetSioHub::read_byte(int timeout_ms)
+{
+    uint64_t deadline = now_us() + (uint64_t)timeout_ms * 1000;
+    while (_rx_pos >= _rx.size())
+    {
+        int64_t left = (int64_t)(deadline - now_us()) / 1000;
+        if (left <= 0)
+            return -1;
+        handle((int)left);
+    }
+    return _rx[_rx_pos++];
+}
+
+bool NetSioHub::read_bytes(uint8_t *buf, size_t len, int timeout_ms)
+{
+    uint64_t deadline = now_us() + (uint64_t)timeout_ms * 1000;
+    while (_rx.size() - _rx_pos < len)
+    {
+        int64_t left = (int64_t)(deadline - now_us()) / 1000;
+        if (left <= 0)
+            return false;
+        handle((int)left);
+    }
+    memcpy(buf, _rx.data() + _rx_pos, len);
+    _rx_pos += len;
+    return true;
+}
+
+cmd_result NetSioHub::command(uint8_t device, uint8_t comnd, uint8_t aux1, uint8_t aux2,
+                              const uint8_t *data_out, size_t out_len, uint8_t *data_in, size_t in_len)
+{
+    uint8_t frame[5] = {device, comnd, aux1, aux2, 0};
+    frame[4] = sio_checksum(frame, 4);
+
+    _rx.clear();
+    _rx_pos = 0;
+    _sync_received = false;
+    _sync_num++;
+
+    // command frame
+    send_byte_msg(NETSIO_COMMAND_ON);
+    send_data_block(frame, sizeof(frame));
+    uint8_t off_sync[2] = {NETSIO_COMMAND_OFF_SYNC, _sync_num};
+    send_msg(off_sync, sizeof(off_sync));
+
+    // ACK/NAK comes bundled in sync response
+    if (!wait_sync(BENCH_SYNC_TIMEOUT_MS))
+        return CMD_TIMEOUT;
+    if (_sync_type == NETSIO_EMPTY_SYNC)
+        return CMD_NO_DEVICE;
+    if (_sync_ack != SIO_ACK)
+        return CMD_NAK;
+
+    if (out_len > 0)
+    {
+        // data frame to device, device acknowledges it
+        std::vector<uint8_t> out(data_out, data_out + out_len);
+        out.push_back(sio_checksum(data_out, out_len));
+        send_data_block(out.data(), out.size());
+        int ack = read_byte(BENCH_DATA_TIMEOUT_MS);
+        if (ack < 0)
+            return CMD_TIMEOUT;
+        if (ack != SIO_ACK)
+            return CMD_NAK;
+    }
+
+    int complete = read_byte(BENCH_DATA_TIMEOUT_MS);
+    if (complete < 0)
+        return CMD_TIMEOUT;
+
+    if (in_len > 0)
+    {
+        // data frame is sent with ERROR too
+        uint8_t ck;
+        if (!read_bytes(data_in, in_len, BENCH_DATA_TIMEOUT_MS) || !read_bytes(&ck, 1, BENCH_DATA_TIMEOUT_MS))
+            return CMD_TIMEOUT;
+        if (ck != sio_checksum(data_in, in_len))
+            return CMD_CHECKSUM;
+    }
+
+    return complete == SIO_COMPLETE ? CMD_OK : CMD_ERROR;
+}
+
+size_t NetSioHub::receive_rest(std::vector<uint8_t> &data, int quiet_ms)
+{
+    while (handle(quiet_ms))
+        ;
+    data.assign(_rx.begin() + _rx_pos, _rx.end());
+    _rx_pos = _rx.size();
+    return data.size();
+}
+
+void NetSioHub::bad_command_frame()
+{
+    uint8_t frame[5] = {SIO_DEVICEID_DISK, 'S', 0, 0, 0};
+    frame[4] = sio_checksum(frame, 4) ^ 0xFF;
+
+    _sync_received = false;
+    _sync_num++;
+
+    send_byte_msg(NETSIO_COMMAND_ON);
+    send_data_block(frame, sizeof(frame));
+    uint8_t off_sync[2] = {NETSIO_COMMAND_OFF_SYNC, _sync_num};
+    send_msg(off_sync, sizeof(off_sync));
+
+    // frame is rejected, device replies with empty sync
+    wait_sync(BENCH_SYNC_TIMEOUT_MS);
+}
+
+/*
+ * Statistics
+ */
+struct bench_stats
+{
+    uint64_t ops = 0;
+    uint64_t bytes = 0;
+    uint64_t errors = 0;
+    uint64_t elapsed_us = 0;
+    std::vector<uint64_t> latencies;
+
+    void add(uint64_t latency_us, size_t nbytes)
+    {
+        ops++;
+        bytes += nbytes;
+        latencies.push_back(latency_us);
+    }
+
+    uint64_t percentile(int p)
+    {
+        if (latencies.empty())
+            return 0;
+        std::vector<uint64_t> sorted(latencies);
+        std::sort(sorted.begin(), sorted.end());
+        return sorted[(sorted.size() - 1) * p / 100];
+    }
+
+    // JSON object members, without braces
+    void print(FILE *out, const char *ops_name, const char *indent)
+    {
+        double secs = elapsed_us / 1e6;
+        fprintf(out, "%s\"%s\": %llu,\n", indent, ops_name, (unsigned long long)ops);
+        fprintf(out, "%s\"bytes\": %llu,\n", indent, (unsigned long long)bytes);
+        fprintf(out, "%s\"errors\": %llu,\n", indent, (unsigned long long)errors);
+        fprintf(out, "%s\"elapsed_sec\": %.6f,\n", indent, secs);
+        fprintf(out, "%s\"%s_per_sec\": %.2f,\n", indent, ops_name, secs > 0 ? ops / secs : 0.0);
+        fprintf(out, "%s\"bytes_per_sec\": %.2f,\n", indent, secs > 0 ? bytes / secs : 0.0);
+        fprintf(out, "%s\"latency_p50_us\": %llu,\n", indent, (unsigned long long)percentile(50));
+        fprintf(out, "%s\"latency_p99_us\": %llu", indent, (unsigned long long)percentile(99));
+    }
+};
+
+struct disk_run
+{
+    int hsio_index;
+    uint32_t baud;
+    bench_stats sequential;
+    bench_stats random;
+};
+
+struct network_run
+{
+    int read_size;
+    bench_stats reads;
+};
+
+struct bench_options
+{
+    int port = BENCH_DEFAULT_PORT;
+    int connect_timeout_ms = BENCH_CONNECT_TIMEOUT_MS;
+    int disk_unit = 1;                  // 0 = skip disk workload
+    int sector_count = 720;             // sectors per run, limited to disk size
+    std::vector<int> hsio_indexes = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 16};
+    std::string url;                    // empty = skip network workload
+    std::vector<int> read_sizes = {128, 256, 512, 1024, 4096};
+    int host_slot = 0;                  // -1 = skip directory workload
+    std::string dir_path = "/";
+    int dir_repeat = 5;
+    const char *output = nullptr;
+};
+
+static bool parse_int_list(const char *s, std::vector<int> &list)
+{
+    list.clear();
+    while (*s)
+    {
+        char *end;
+        long v = strtol(s, &end, 0);
+        if (end == s)
+            return false;
+        list.push_back((int)v);
+        s = end;
+        if (*s == ',')
+            s++;
+    }
+    return !list.empty();
+}
+
+/*
+ * HSIO switching
+ * The device toggles between standard and high speed after two bad command frames,
+ * the same way the Atari switches speed on real SIO bus.
+ */
+static bool toggle_speed(NetSioHub &hub)
+{
+    int changes = hub.speed_changes();
+    for (int i = 0; i < 4 && hub.speed_changes() == changes; i++)
+        hub.bad_command_frame();
+    // collect speed change if it is still on the way
+    while (hub.speed_changes() == changes && hub.handle(500))
+        ;
+    if (hub.speed_changes() == changes)
+        return false;
+    hub.set_baudrate(hub.device_baud());
+    return true;
+}
+
+static bool set_hsio_index(NetSioHub &hub, int index, uint32_t &baud)
+{
+    // HSIO index is changed at standard speed
+    if (hub.device_baud() != BENCH_STANDARD_BAUDRATE && !toggle_speed(hub))
+        return false;
+
+    cmd_result r = hub.command(SIO_DEVICEID_FUJINET, FUJICMD_SET_HSIO_INDEX, (uint8_t)index, 0);
+    if (r != CMD_OK)
+    {
+        fprintf(stderr, "SET HSIO INDEX %d failed: %s\n", index, cmd_result_names[r]);
+        return false;
+    }
+
+    if (!toggle_speed(hub))
+    {
+        fprintf(stderr, "Device did not switch to high speed (HSIO index %d)\n", index);
+        return false;
+    }
+    baud = hub.device_baud();
+    return true;
+}
+
+/*
+ * Workloads
+ */
+static bool disk_geometry(NetSioHub &hub, uint8_t device, int &sector_size, int &num_sectors)
+{
+    uint8_t percom[12];
+    cmd_result r = hub.command(device, SIO_DISKCMD_PERCOM_READ, 0, 0, nullptr, 0, percom, sizeof(percom));
+    if (r != CMD_OK)
+    {
+        fprintf(stderr, "Disk PERCOM read failed: %s\n", cmd_result_names[r]);
+        return false;
+    }
+    int tracks = percom[0];
+    int sectors_per_track = (percom[2] << 8) | percom[3];
+    int sides = percom[4] + 1;
+    sector_size = (percom[6] << 8) | percom[7];
+    num_sectors = tracks * sectors_per_track * sides;
+    if (sector_size == 0 || num_sectors == 0)
+    {
+        fprintf(stderr, "Disk has invalid geometry\n");
+        return false;
+    }
+    return true;
+}
+
+// Size of boot sectors 1-3 as sent by the disk, 128 bytes on most double density disks,
+// but some images and drives have full size boot sectors
+static int disk_boot_sector_size(NetSioHub &hub, uint8_t device, int sector_size)
+{
+    if (sector_size == 128)
+        return 128;
+
+    std::vector<uint8_t> frame;
+    cmd_result r = hub.command(device, SIO_DISKCMD_READ, 1, 0);
+    if (r == CMD_OK && hub.receive_rest(frame, BENCH_QUIET_MS) > 1)
+    {
+        int len = (int)frame.size() - 1;
+        if ((len == 128 || len == sector_size) && frame[len] == sio_checksum(frame.data(), len))
+            return len;
+    }
+    fprintf(stderr, "Disk boot sector read failed, assuming %d bytes\n", sector_size == 512 ? 512 : 128);
+    return sector_size == 512 ? 512 : 128;
+}
+
+static void disk_reads(NetSioHub &hub, uint8_t device, const std::vector<int> &sectors, int sector_size, int boot_size,
+                       bench_stats &stats)
+{
+    uint8_t buf[512];
+    uint64_t start = now_us();
+    for (int sector : sectors)
+    {
+        int len = sector <= 3 ? boot_size : sector_size;
+        uint64_t t = now_us();
+        cmd_result r = hub.command(device, SIO_DISKCMD_READ, sector & 0xFF, sector >> 8, nullptr, 0, buf, len);
+        if (r == CMD_OK)
+            stats.add(now_us() - t, len);
+        else
+            stats.errors++;
+    }
+    stats.elapsed_us = now_us() - start;
+}
+
+static bool disk_workload(NetSioHub &hub, const bench_options &opts, std::vector<disk_run> &runs)
+{
+    uint8_t device = SIO_DEVICEID_DISK + opts.disk_unit - 1;
+    int sector_size, num_sectors, boot_size;
+
+    // mount disk images from configuration, as CONFIG does before boot
+    cmd_result r = hub.command(SIO_DEVICEID_FUJINET, FUJICMD_MOUNT_ALL, 0, 0);
+    if (r != CMD_OK)
+        fprintf(stderr, "Mount all failed: %s\n", cmd_result_names[r]);
+
+    if (!disk_geometry(hub, device, sector_size, num_sectors))
+        return false;
+    boot_size = disk_boot_sector_size(hub, device, sector_size);
+
+    int count = std::min(opts.sector_count, num_sectors);
+    std::vector<int> sequential;
+    for (int i = 1; i <= count; i++)
+        sequential.push_back(i);
+    // same random sequence for every run and every benchmark invocation
+    std::vector<int> random;
+    std::mt19937 rng(0x5EC7);
+    std::uniform_int_distribution<int> dist(1, num_sectors);
+    for (int i = 0; i < count; i++)
+        random.push_back(dist(rng));
+
+    fprintf(stderr, "Disk D%d: %d sectors of %d bytes (boot sectors %d bytes), %d reads per run\n",
+            opts.disk_unit, num_sectors, sector_size, boot_size, count);
+
+    for (int index : opts.hsio_indexes)
+    {
+        disk_run run;
+        run.hsio_index = index;
+        if (!set_hsio_index(hub, index, run.baud))
+            continue;
+        fprintf(stderr, "HSIO index %d (%u baud)\n", index, run.baud);
+        disk_reads(hub, device, sequential, sector_size, boot_size, run.sequential);
+        disk_reads(hub, device, random, sector_size, boot_size, run.random);
+        runs.push_back(std::move(run));
+    }
+
+    // leave device at standard speed
+    if (hub.device_baud() != BENCH_STANDARD_BAUDRATE)
+        toggle_speed(hub);
+    return true;
+}
+
+static bool network_workload(NetSioHub &hub, const bench_options &opts, std::vector<network_run> &runs)
+{
+    uint8_t devicespec[DEVICESPEC_LEN];
+    memset(devicespec, 0, sizeof(devicespec));
+    strncpy((char *)devicespec, opts.url.c_str(), sizeof(devicespec) - 1);
+
+    std::vector<uint8_t> buf;
+    for (int size : opts.read_sizes)
+    {
+        if (size <= 0 || size > 0xFFFF)
+            continue;
+        buf.resize(size);
+
+        // open for read, no translation
+        cmd_result r = hub.command(SIO_DEVICEID_FN_NETWORK, NETCMD_OPEN, 4, 0, devicespec, sizeof(devicespec));
+        if (r != CMD_OK)
+        {
+            fprintf(stderr, "N: open \"%s\" failed: %s\n", opts.url.c_str(), cmd_result_names[r]);
+            return false;
+        }
+
+        network_run run;
+        run.read_size = size;
+        uint64_t start = now_us();
+        for (;;)
+        {
+            uint8_t status[4];
+            r = hub.command(SIO_DEVICEID_FN_NETWORK, NETCMD_STATUS, 0, 0, nullptr, 0, status, sizeof(status));
+            if (r != CMD_OK)
+            {
+                run.reads.errors++;
+                break;
+            }
+            int waiting = status[0] | (status[1] << 8);
+            if (waiting == 0)
+            {
+                if (!status[2]) // not connected, all read
+                    break;
+                // give device time to receive more, as Atari program waits between polls
+                usleep(BENCH_STATUS_POLL_MS * 1000);
+                continue;
+            }
+
+            int len = std::min(waiting, size);
+            uint64_t t = now_us();
+            r = hub.command(SIO_DEVICEID_FN_NETWORK, NETCMD_READ, len & 0xFF, len >> 8, nullptr, 0, buf.data(), len);
+            if (r != CMD_OK)
+            {
+                run.reads.errors++;
+                break;
+            }
+            run.reads.add(now_us() - t, len);
+        }
+        run.reads.elapsed_us = now_us() - start;
+        hub.command(SIO_DEVICEID_FN_NETWORK, NETCMD_CLOSE, 0, 0);
+
+        fprintf(stderr, "N: %d byte reads, %llu bytes\n", size, (unsigned long long)run.reads.bytes);
+        runs.push_back(std::move(run));
+    }
+    return true;
+}
+
+static bool directory_workload(NetSioHub &hub, const bench_options &opts, bench_stats &entries, bench_stats &listings)
+{
+    uint8_t slot = (uint8_t)opts.host_slot;
+    cmd_result r = hub.command(SIO_DEVICEID_FUJINET, FUJICMD_MOUNT_HOST, slot, 0);
+    if (r != CMD_OK)
+    {
+        fprintf(stderr, "Mount host slot %d failed: %s\n", opts.host_slot, cmd_result_names[r]);
+        return false;
+    }
+
+    uint8_t path[DEVICESPEC_LEN];
+    memset(path, 0, sizeof(path));
+    strncpy((char *)path, opts.dir_path.c_str(), sizeof(path) - 1);
+
+    uint64_t start = now_us();
+    for (int i = 0; i < opts.dir_repeat; i++)
+    {
+        uint64_t t_list = now_us();
+        size_t list_bytes = 0;
+        r = hub.command(SIO_DEVICEID_FUJINET, FUJICMD_OPEN_DIRECTORY, slot, 0, path, sizeof(path));
+        if (r != CMD_OK)
+        {
+            fprintf(stderr, "Open directory \"%s\" failed: %s\n", opts.dir_path.c_str(), cmd_result_names[r]);
+            listings.errors++;
+            continue;
+        }
+
+        for (;;)
+        {
+            uint8_t entry[DIR_ENTRY_LEN];
+            uint64_t t = now_us();
+            r = hub.command(SIO_DEVICEID_FUJINET, FUJICMD_READ_DIR_ENTRY, sizeof(entry), 0, nullptr, 0, entry, sizeof(entry));
+            if (r != CMD_OK)
+            {
+                entries.errors++;
+                break;
+            }
+            if (entry[0] == 0x7F && entry[1] == 0x7F) // end of directory
+                break;
+            entries.add(now_us() - t, sizeof(entry));
+            list_bytes += sizeof(entry);
+        }
+
+        hub.command(SIO_DEVICEID_FUJINET, FUJICMD_CLOSE_DIRECTORY, 0, 0);
+        listings.add(now_us() - t_list, list_bytes);
+    }
+    uint64_t elapsed = now_us() - start;
+    entries.elapsed_us = elapsed;
+    listings.elapsed_us = elapsed;
+    return true;
+}
+
+static void print_usage(const char *pgm)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -p PORT   UDP port to listen for FujiNet-PC (default %d)\n"
+        "  -t SEC    seconds to wait for FujiNet-PC to connect (default %d)\n"
+        "  -d UNIT   disk unit with mounted ATR, 0 = skip disk reads (default 1)\n"
+        "  -n COUNT  sectors read per run (default 720)\n"
+        "  -i LIST   comma separated HSIO indexes (default 0,1,2,3,4,5,6,7,8,9,10,16)\n"
+        "  -u URL    N: device URL to read, e.g. N:HTTP://127.0.0.1:8000/file.bin\n"
+        "  -s LIST   comma separated N: read sizes (default 128,256,512,1024,4096)\n"
+        "  -H SLOT   host slot for directory listing, -1 = skip (default 0)\n"
+        "  -D PATH   directory to list (default /)\n"
+        "  -r COUNT  directory listings (default 5)\n"
+        "  -o FILE   write JSON results to FILE instead of stdout\n",
+        pgm, BENCH_DEFAULT_PORT, BENCH_CONNECT_TIMEOUT_MS / 1000);
+}
+
+int main(int argc, char **argv)
+{
+    bench_options opts;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:t:d:n:i:u:s:H:D:r:o:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p':
+            opts.port = atoi(optarg);
+            break;
+        case 't':
+            opts.connect_timeout_ms = atoi(optarg) * 1000;
+            break;
+        case 'd':
+            opts.disk_unit = atoi(optarg);
+            break;
+        case 'n':
+            opts.sector_count = atoi(optarg);
+            break;
+        case 'i':
+            if (!parse_int_list(optarg, opts.hsio_indexes))
+            {
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'u':
+            opts.url = optarg;
+            break;
+        case 's':
+            if (!parse_int_list(optarg, opts.read_sizes))
+            {
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'H':
+            opts.host_slot = atoi(optarg);
+            break;
+        case 'D':
+            opts.dir_path = optarg;
+            break;
+        case 'r':
+            opts.dir_repeat = atoi(optarg);
+            break;
+        case 'o':
+            opts.output = optarg;
+            break;
+        default:
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    NetSioHub hub;
+    if (!hub.listen(opts.port))
+        return EXIT_FAILURE;
+
+    fprintf(stderr, "Waiting for FujiNet-PC on UDP port %d\n", opts.port);
+    if (!hub.wait_connect(opts.connect_timeout_ms))
+    {
+        fprintf(stderr, "FujiNet-PC did not connect\n");
+        return EXIT_FAILURE;
+    }
+
+    bool ok = true;
+    std::vector<disk_run> disk_runs;
+    std::vector<network_run> network_runs;
+    bench_stats dir_entries, dir_listings;
+
+    if (opts.disk_unit > 0 && opts.disk_unit <= 15)
+        ok &= disk_workload(hub, opts, disk_runs);
+    if (!opts.url.empty())
+        ok &= network_workload(hub, opts, network_runs);
+    if (opts.host_slot >= 0 && opts.host_slot < 8)
+        ok &= directory_workload(hub, opts, dir_entries, dir_listings);
+
+    FILE *out = stdout;
+    if (opts.output != nullptr && (out = fopen(opts.output, "w")) == nullptr)
+    {
+        fprintf(stderr, "Failed to create \"%s\": %s\n", opts.output, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    fprintf(out, "{\n  \"disk\": [");
+    for (size_t i = 0; i < disk_runs.size(); i++)
+    {
+        disk_run &run = disk_runs[i];
+        fprintf(out, "%s\n    {\n      \"unit\": %d,\n      \"hsio_index\": %d,\n      \"baud\": %u,\n",
+                i ? "," : "", opts.disk_unit, run.hsio_index, run.baud);
+        fprintf(out, "      \"sequential\": {\n");
+        run.sequential.print(out, "sectors", "        ");
+        fprintf(out, "\n      },\n      \"random\": {\n");
+        run.random.print(out, "sectors", "        ");
+        fprintf(out, "\n      }\n    }");
+    }
+    fprintf(out, "%s],\n  \"network\": [", disk_runs.empty() ? "" : "\n  ");
+    for (size_t i = 0; i < network_runs.size(); i++)
+    {
+        network_run &run = network_runs[i];
+        fprintf(out, "%s\n    {\n      \"read_size\": %d,\n", i ? "," : "", run.read_size);
+        run.reads.print(out, "reads", "      ");
+        fprintf(out, "\n    }");
+    }
+    fprintf(out, "%s],\n  \"directory\": {\n", network_runs.empty() ? "" : "\n  ");
+    fprintf(out, "    \"entries\": {\n");
+    dir_entries.print(out, "entries", "      ");
+    fprintf(out, "\n    },\n    \"listings\": {\n");
+    dir_listings.print(out, "listings", "      ");
+    fprintf(out, "\n    }\n  }\n}\n");
+
+    if (out != stdout)
+        fclose(out);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,330 @@
+/*
+ * htmlfilter-bench
+ *
+ * Micro-benchmark of HtmlFilter used by filtered N:HTTP reads. Feeds HTML pages through
+ * HtmlFilter::filter_chunk() in chunks of given sizes and measures throughput.
+ * Pages are either loaded from files given on command line or generated:
+ *   - article: mostly text paragraphs with some links and formatting
+ *   - portal:  deeply nested markup with many attributes, scripts and styles
+ * Results are printed as JSON: input bytes/sec, output bytes and p50/p99 chunk time in nanoseconds.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "htmlFilter.h"
+
+#define BENCH_DEFAULT_FILTER "encoding=Internal;dt=!--,!DOCTYPE,HTML,SCRIPT,NOSCRIPT,STYLE,META,LINK,SVG,IFRAME;" \
+    "da=ID,CLASS,STYLE,ONCLICK,DATA-ID,TARGET,REL"
+#define BENCH_DEFAULT_PAGE_SIZE (256 * 1024)
+#define BENCH_DEFAULT_RUNS 20
+#define BENCH_CARRYOVER_LEN 256
+
+// HtmlFilter uses string helpers from lib/utils, which pulls half of the firmware in,
+// provide the two which are needed
+void util_string_tolower(std::string &s)
+{
+    std::transform(s.begin(), s.end(), s.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+}
+
+void util_string_trim(std::string &s)
+{
+    s.erase(s.begin(), std::find_if(s.begin(), s.end(), [](int ch) { return !std::isspace(ch); }));
+    s.erase(std::find_if(s.rbegin(), s.rend(), [](int ch) { return !std::isspace(ch); }).base(), s.end());
+}
+
+struct page
+{
+    std::string name;
+    std::string html;
+};
+
+static const char *words[] = {
+    "the", "Atari", "computer", "network", "adapter", "disk", "image", "of", "and", "cassette",
+    "printer", "modem", "to", "SIO", "bus", "with", "a", "drive", "sector", "firmware"
+};
+
+static void add_text(std::string &out, std::mt19937 &rng, int nwords)
+{
+    for (int i = 0; i < nwords; i++)
+    {
+        if (i)
+            out += (rng() % 13 == 0) ? ", " : " ";
+        out += words[rng() % (sizeof(words) / sizeof(words[0]))];
+    }
+    out += '.';
+}
+
+static std::string page_head(const char *title)
+{
+    std::string out = "<!DOCTYPE html>\n<html lang=\"en\">\n<head>\n";
+    out += "  <meta charset=\"utf-8\">\n  <meta name=\"viewport\" content=\"width=device-width\">\n";
+    out += "  <title>"; out += title; out += "</title>\n";
+    out += "  <link rel=\"stylesheet\" href=\"/static/site.css\">\n";
+    out += "  <style>\n    body { margin: 0; font-family: sans-serif; }\n    .nav > li { display: inline; }\n  </style>\n";
+    out += "  <script>\n    window.dataLayer = window.dataLayer || []; if (a < b && c > d) { track('view'); }\n  </script>\n";
+    out += "</head>\n";
+    return out;
+}
+
+static std::string make_article(size_t size, std::mt19937 &rng)
+{
+    std::string out = page_head("Article");
+    out += "<body>\n<div id=\"main\" class=\"content\">\n<h1>FujiNet</h1>\n";
+    while (out.size() < size)
+    {
+        out += "<p>";
+        int sentences = 3 + rng() % 5;
+        for (int s = 0; s < sentences; s++)
+        {
+            add_text(out, rng, 8 + rng() % 12);
+            out += ' ';
+            if (rng() % 4 == 0)
+            {
+                out += "<a href=\"/wiki/page";
+                out += std::to_string(rng() % 1000);
+                out += "\" title=\"Link\">";
+                add_text(out, rng, 2);
+                out += "</a> ";
+            }
+            if (rng() % 6 == 0)
+            {
+                out += "<b>";
+                add_text(out, rng, 3);
+                out += "</b><br/>\n";
+            }
+        }
+        out += "</p>\n";
+    }
+    out += "</div>\n</body>\n</html>\n";
+    return out;
+}
+
+static std::string make_portal(size_t size, std::mt19937 &rng)
+{
+    std::string out = page_head("Portal");
+    out += "<body class=\"home\">\n";
+    while (out.size() < size)
+    {
+        int id = rng() % 100000;
+        out += "  <div class=\"card\" id=\"c" + std::to_string(id) + "\" data-id='" + std::to_string(id) + "'>\n";
+        out += "    <!-- card " + std::to_string(id) + " -->\n";
+        out += "    <ul class=\"nav\">\n";
+        for (int i = 0; i < 4; i++)
+        {
+            out += "      <li><a href=\"/section/" + std::to_string(rng() % 50) + "\" target=_blank rel=\"noopener\" onclick=\"go(this)\">";
+            add_text(out, rng, 2);
+            out += "</a></li>\n";
+        }
+        out += "    </ul>\n";
+        out += "    <img src=\"/img/" + std::to_string(id) + ".png\" alt=\"Picture\" />\n";
+        out += "    <svg width=\"16\" height=\"16\"><path d=\"M0 0L16 16\"/></svg>\n";
+        out += "    <span style=\"color: red\">";
+        add_text(out, rng, 6);
+        out += "</span>\n";
+        if (rng() % 3 == 0)
+            out += "    <script type=\"text/javascript\">load(" + std::to_string(id) + ");</script>\n";
+        out += "  </div>\n";
+    }
+    out += "</body>\n</html>\n";
+    return out;
+}
+
+static bool load_page(const char *path, page &p)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == nullptr)
+        return false;
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        p.html.append(buf, n);
+    fclose(f);
+    p.name = path;
+    return true;
+}
+
+static std::vector<int> parse_int_list(const char *arg)
+{
+    std::vector<int> result;
+    std::string s(arg);
+    size_t pos = 0;
+    while (pos <= s.size())
+    {
+        size_t end = s.find(',', pos);
+        if (end == std::string::npos)
+            end = s.size();
+        if (end > pos)
+            result.push_back(atoi(s.substr(pos, end - pos).c_str()));
+        pos = end + 1;
+    }
+    return result;
+}
+
+struct run_result
+{
+    std::string page;
+    int chunk_size;
+    unsigned long long in_bytes = 0;
+    unsigned long long out_bytes = 0;
+    double secs = 0;
+    std::vector<uint64_t> chunk_ns;
+
+    uint64_t percentile(int p)
+    {
+        if (chunk_ns.empty())
+            return 0;
+        std::sort(chunk_ns.begin(), chunk_ns.end());
+        return chunk_ns[(chunk_ns.size() - 1) * p / 100];
+    }
+};
+
+static void bench_page(const page &p, int chunk_size, int runs, const char *filter_spec, run_result &res)
+{
+    typedef std::chrono::steady_clock clk;
+
+    // filter_chunk() prepends carry-over, chunk buffer needs room for it
+    std::vector<char> buffer(chunk_size + BENCH_CARRYOVER_LEN);
+
+    res.page = p.name;
+    res.chunk_size = chunk_size;
+
+    for (int r = 0; r < runs; r++)
+    {
+        HtmlFilter filter(BENCH_CARRYOVER_LEN);
+        filter.set_filter(filter_spec);
+        filter.reset_state();
+
+        clk::time_point run_start = clk::now();
+        for (size_t pos = 0; pos < p.html.size(); pos += chunk_size)
+        {
+            int len = (int)std::min((size_t)chunk_size, p.html.size() - pos);
+            memcpy(buffer.data(), p.html.data() + pos, len);
+
+            clk::time_point t0 = clk::now();
+            int out = filter.filter_chunk(buffer.data(), len);
+            clk::time_point t1 = clk::now();
+
+            res.chunk_ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+            res.in_bytes += len;
+            res.out_bytes += out;
+        }
+        res.secs += std::chrono::duration<double>(clk::now() - run_start).count();
+    }
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [options] [file.html ...]\n"
+            "  -c <list>   chunk sizes, comma separated (default 128,512,4096)\n"
+            "  -n <runs>   runs per page and chunk size (default %d)\n"
+            "  -S <bytes>  size of generated pages (default %d)\n"
+            "  -F <spec>   filter specification (default \"%s\")\n"
+            "  -o <file>   write JSON results to file (default stdout)\n"
+            "Without files, generated article and portal pages are used.\n",
+            prog, BENCH_DEFAULT_RUNS, BENCH_DEFAULT_PAGE_SIZE, BENCH_DEFAULT_FILTER);
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<int> chunk_sizes = {128, 512, 4096};
+    int runs = BENCH_DEFAULT_RUNS;
+    size_t page_size = BENCH_DEFAULT_PAGE_SIZE;
+    const char *filter_spec = BENCH_DEFAULT_FILTER;
+    const char *output = nullptr;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "c:n:S:F:o:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'c':
+            chunk_sizes = parse_int_list(optarg);
+            break;
+        case 'n':
+            runs = atoi(optarg);
+            break;
+        case 'S':
+            page_size = atoi(optarg);
+            break;
+        case 'F':
+            filter_spec = optarg;
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<page> pages;
+    for (int i = optind; i < argc; i++)
+    {
+        page p;
+        if (!load_page(argv[i], p))
+        {
+            fprintf(stderr, "Failed to read \"%s\"\n", argv[i]);
+            return 1;
+        }
+        pages.push_back(p);
+    }
+    if (pages.empty())
+    {
+        std::mt19937 rng(1);
+        pages.push_back({"article", make_article(page_size, rng)});
+        pages.push_back({"portal", make_portal(page_size, rng)});
+    }
+
+    std::vector<run_result> results;
+    for (const page &p : pages)
+    {
+        for (int chunk_size : chunk_sizes)
+        {
+            if (chunk_size <= 0)
+                continue;
+            fprintf(stderr, "%s: %u bytes, %d byte chunks\n", p.name.c_str(), (unsigned)p.html.size(), chunk_size);
+            results.push_back(run_result());
+            bench_page(p, chunk_size, runs, filter_spec, results.back());
+        }
+    }
+
+    FILE *out = stdout;
+    if (output != nullptr && (out = fopen(output, "w")) == nullptr)
+    {
+        fprintf(stderr, "Failed to create \"%s\"\n", output);
+        return 1;
+    }
+
+    fprintf(out, "{\n  \"htmlfilter\": [");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        run_result &res = results[i];
+        fprintf(out, "%s\n    {\n", i ? "," : "");
+        fprintf(out, "      \"page\": \"%s\",\n", res.page.c_str());
+        fprintf(out, "      \"chunk_size\": %d,\n", res.chunk_size);
+        fprintf(out, "      \"bytes_in\": %llu,\n", res.in_bytes);
+        fprintf(out, "      \"bytes_out\": %llu,\n", res.out_bytes);
+        fprintf(out, "      \"bytes_per_sec\": %.2f,\n", res.secs > 0 ? res.in_bytes / res.secs : 0.0);
+        fprintf(out, "      \"chunk_p50_ns\": %llu,\n", (unsigned long long)res.percentile(50));
+        fprintf(out, "      \"chunk_p99_ns\": %llu\n", (unsigned long long)res.percentile(99));
+        fprintf(out, "    }");
+    }
+    fprintf(out, "%s]\n}\n", results.empty() ? "" : "\n  ");
+
+    if (out != stdout)
+        fclose(out);
+    return 0;
+}
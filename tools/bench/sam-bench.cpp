@@ -0,0 +1,181 @@
+/*
+ * sam-bench
+ *
+ * Render throughput benchmark of SAM speech synthesizer used by the voice device (P4:).
+ * Renders phrases given on command line (or built-in ones) the way sioVoice does and measures:
+ *   - time to first frame: from start of rendering until the first SAM_FRAME_SIZE samples
+ *     are passed to the output, this is the delay before speech starts on the audio sink
+ *   - render rate: rendered samples/sec and how many times faster than real time it is
+ * Results are printed as JSON, times in microseconds.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <getopt.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "sam.h"
+#include "reciter.h"
+
+#define BENCH_DEFAULT_RUNS 20
+
+// SAM globals normally provided by samlib.cpp, which pulls half of the firmware in
+extern char input[256];
+int debug = 0;
+
+typedef std::chrono::steady_clock clk;
+
+static const char *default_phrases[] = {
+    "Hello, I am Sam.",
+    "FujiNet is a network adapter for the Atari eight bit computers.",
+    "The quick brown fox jumps over the lazy dog while the cat watches from the window sill.",
+};
+
+struct render_state
+{
+    clk::time_point start;
+    clk::time_point first_frame;
+    bool got_frame;
+    unsigned long long samples;
+};
+
+static void output(const unsigned char *samples, int count, void *ctx)
+{
+    render_state *st = (render_state *)ctx;
+    if (!st->got_frame)
+    {
+        st->first_frame = clk::now();
+        st->got_frame = true;
+    }
+    st->samples += count;
+}
+
+struct run_result
+{
+    std::string phrase;
+    unsigned long long samples = 0;
+    double secs = 0;
+    std::vector<uint64_t> first_frame_us;
+
+    uint64_t percentile(int p)
+    {
+        if (first_frame_us.empty())
+            return 0;
+        std::sort(first_frame_us.begin(), first_frame_us.end());
+        return first_frame_us[(first_frame_us.size() - 1) * p / 100];
+    }
+};
+
+static bool bench_phrase(const char *phrase, int runs, run_result &res)
+{
+    res.phrase = phrase;
+    for (int r = 0; r < runs; r++)
+    {
+        render_state st;
+        st.got_frame = false;
+        st.samples = 0;
+        SetDefaults();
+        SetOutput(output, &st);
+
+        // text to phonemes is part of the delay before speech starts
+        st.start = clk::now();
+        memset(input, 0, 256);
+        strncpy(input, phrase, 254);
+        for (int i = 0; input[i] != 0; i++)
+            input[i] = toupper((int)input[i]);
+        strncat(input, "[", 255 - strlen(input));
+        if (!TextToPhonemes((unsigned char *)input) || !SAMMain())
+            return false;
+        clk::time_point end = clk::now();
+
+        res.secs += std::chrono::duration<double>(end - st.start).count();
+        res.samples += st.samples;
+        res.first_frame_us.push_back(
+            std::chrono::duration_cast<std::chrono::microseconds>((st.got_frame ? st.first_frame : end) - st.start).count());
+    }
+    return true;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [options] [phrase ...]\n"
+            "  -n <runs>   runs per phrase (default %d)\n"
+            "  -o <file>   write JSON results to file (default stdout)\n"
+            "Without phrases, built-in English phrases are used.\n",
+            prog, BENCH_DEFAULT_RUNS);
+}
+
+int main(int argc, char **argv)
+{
+    int runs = BENCH_DEFAULT_RUNS;
+    const char *output_path = nullptr;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:o:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            runs = atoi(optarg);
+            break;
+        case 'o':
+            output_path = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<const char *> phrases;
+    for (int i = optind; i < argc; i++)
+        phrases.push_back(argv[i]);
+    if (phrases.empty())
+        phrases.assign(default_phrases, default_phrases + sizeof(default_phrases) / sizeof(default_phrases[0]));
+
+    std::vector<run_result> results;
+    for (const char *phrase : phrases)
+    {
+        fprintf(stderr, "\"%s\": %d runs\n", phrase, runs);
+        results.push_back(run_result());
+        if (!bench_phrase(phrase, runs, results.back()))
+        {
+            fprintf(stderr, "Failed to render \"%s\"\n", phrase);
+            return 1;
+        }
+    }
+
+    FILE *out = stdout;
+    if (output_path != nullptr && (out = fopen(output_path, "w")) == nullptr)
+    {
+        fprintf(stderr, "Failed to create \"%s\"\n", output_path);
+        return 1;
+    }
+
+    fprintf(out, "{\n  \"sam\": [");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        run_result &res = results[i];
+        double audio_secs = (double)res.samples / SAM_SAMPLE_RATE;
+        fprintf(out, "%s\n    {\n", i ? "," : "");
+        fprintf(out, "      \"phrase\": \"%s\",\n", res.phrase.c_str());
+        fprintf(out, "      \"audio_ms\": %.1f,\n", runs > 0 ? audio_secs * 1000 / runs : 0.0);
+        fprintf(out, "      \"samples_per_sec\": %.0f,\n", res.secs > 0 ? res.samples / res.secs : 0.0);
+        fprintf(out, "      \"realtime_factor\": %.1f,\n", res.secs > 0 ? audio_secs / res.secs : 0.0);
+        fprintf(out, "      \"first_frame_p50_us\": %llu,\n", (unsigned long long)res.percentile(50));
+        fprintf(out, "      \"first_frame_p99_us\": %llu\n", (unsigned long long)res.percentile(99));
+        fprintf(out, "    }");
+    }
+    fprintf(out, "%s]\n}\n", results.empty() ? "" : "\n  ");
+
+    if (out != stdout)
+        fclose(out);
+    return 0;
+}
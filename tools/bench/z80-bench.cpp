@@ -0,0 +1,302 @@
+/*
+ * z80-bench
+ *
+ * Instruction throughput benchmark of RunCPM Z80 core used by CP/M device.
+ * The core is compiled twice, as reference core with central switch dispatch and global
+ * registers, and as fast core with THREADED_DISPATCH and CACHE_REGISTERS, and the same program
+ * is timed on both. Final registers, memory and console output of both runs are compared,
+ * so the benchmark also checks the fast core.
+ *
+ * The program is a CP/M .COM file given on command line (e.g. ZEXDOC.COM, which exercises
+ * all documented instructions and reports CRC errors itself), or a built-in CRC-16 loop.
+ * Only BDOS console output (functions 2 and 9) is provided, the program ends with jump to 0.
+ * Results are printed as JSON, times in milliseconds.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "globals.h"
+
+#define BENCH_DEFAULT_RUNS 5
+
+#define TPA_START 0x0100
+#define BDOS_ENTRY 0xfe00
+
+typedef std::chrono::steady_clock clk;
+
+static std::string console;
+
+static void bench_bdos(int32 BC, int32 DE)
+{
+    switch (LOW_REGISTER(BC))
+    {
+    case 2: // console output
+        console += (char)LOW_REGISTER(DE);
+        break;
+    case 9: // print string
+        for (uint16 a = DE; RAM[a] != '$'; a++)
+            console += (char)RAM[a];
+        break;
+    }
+}
+
+// Reference core, central switch and global registers
+namespace ref
+{
+#undef THREADED_DISPATCH
+#undef CACHE_REGISTERS
+void _Bios(void);
+void _Bdos(void);
+void _HardwareOut(const uint32 Port, const uint32 Value) {}
+uint32 _HardwareIn(const uint32 Port) { return 0; }
+#include "cpu.h"
+void _Bios(void) { Status = 1; }
+void _Bdos(void) { bench_bdos(BC, DE); }
+}
+
+// Fast core, threaded dispatch and registers cached in locals
+#undef CPU_H
+#define THREADED_DISPATCH
+#define CACHE_REGISTERS
+namespace fast
+{
+void _Bios(void);
+void _Bdos(void);
+void _HardwareOut(const uint32 Port, const uint32 Value) {}
+uint32 _HardwareIn(const uint32 Port) { return 0; }
+#include "cpu.h"
+void _Bios(void) { Status = 1; }
+void _Bdos(void) { bench_bdos(BC, DE); }
+}
+
+/*
+ Built-in program, CRC-16/CCITT of 16K buffer, 16 passes, byte CRC in subroutine
+    0100 3E 10        LD A,16
+    0102 32 56 01     LD (passes),A
+    0105 21 00 20     outer: LD HL,2000h
+    0108 11 01 20     LD DE,2001h
+    010B 01 FF 3F     LD BC,3FFFh
+    010E 3A 56 01     LD A,(passes)
+    0111 77           LD (HL),A
+    0112 ED B0        LDIR
+    0114 DD 21 00 20  LD IX,2000h
+    0118 01 00 40     LD BC,4000h
+    011B 21 FF FF     LD HL,0FFFFh
+    011E DD 7E 00     crcloop: LD A,(IX+0)
+    0121 81           ADD A,C
+    0122 CD 40 01     CALL crcbyte
+    0125 DD 23        INC IX
+    0127 0B           DEC BC
+    0128 78           LD A,B
+    0129 B1           OR C
+    012A 20 F2        JR NZ,crcloop
+    012C 22 57 01     LD (result),HL
+    012F 21 56 01     LD HL,passes
+    0132 35           DEC (HL)
+    0133 20 D0        JR NZ,outer
+    0135 0E 09        LD C,9
+    0137 11 59 01     LD DE,msg
+    013A CD 05 00     CALL 5
+    013D C3 00 00     JP 0
+    0140 AC           crcbyte: XOR H
+    0141 67           LD H,A
+    0142 1E 08        LD E,8
+    0144 CB 25        bitloop: SLA L
+    0146 CB 14        RL H
+    0148 30 08        JR NC,nox
+    014A 7C           LD A,H
+    014B EE 10        XOR 10h
+    014D 67           LD H,A
+    014E 7D           LD A,L
+    014F EE 21        XOR 21h
+    0151 6F           LD L,A
+    0152 1D           nox: DEC E
+    0153 20 EF        JR NZ,bitloop
+    0155 C9           RET
+    0156 00           passes: DB 0
+    0157 00 00        result: DW 0
+    0159              msg: DB 'CRC done',13,10,'$'
+*/
+static const uint8 builtin_program[] = {
+    0x3E, 0x10, 0x32, 0x56, 0x01, 0x21, 0x00, 0x20, 0x11, 0x01, 0x20, 0x01, 0xFF, 0x3F, 0x3A, 0x56,
+    0x01, 0x77, 0xED, 0xB0, 0xDD, 0x21, 0x00, 0x20, 0x01, 0x00, 0x40, 0x21, 0xFF, 0xFF, 0xDD, 0x7E,
+    0x00, 0x81, 0xCD, 0x40, 0x01, 0xDD, 0x23, 0x0B, 0x78, 0xB1, 0x20, 0xF2, 0x22, 0x57, 0x01, 0x21,
+    0x56, 0x01, 0x35, 0x20, 0xD0, 0x0E, 0x09, 0x11, 0x59, 0x01, 0xCD, 0x05, 0x00, 0xC3, 0x00, 0x00,
+    0xAC, 0x67, 0x1E, 0x08, 0xCB, 0x25, 0xCB, 0x14, 0x30, 0x08, 0x7C, 0xEE, 0x10, 0x67, 0x7D, 0xEE,
+    0x21, 0x6F, 0x1D, 0x20, 0xEF, 0xC9, 0x00, 0x00, 0x00,
+    'C', 'R', 'C', ' ', 'd', 'o', 'n', 'e', 13, 10, '$'};
+
+struct run_state
+{
+    std::string console;
+    uint32 regs[8];
+    uint32 ram_hash;
+
+    bool operator==(const run_state &o) const
+    {
+        return console == o.console && memcmp(regs, o.regs, sizeof(regs)) == 0 && ram_hash == o.ram_hash;
+    }
+};
+
+static void load_program(const std::vector<uint8> &program)
+{
+    memset(RAM, 0, MEMSIZE);
+    // warm boot: OUT (0FFh),A calls BIOS, which ends the run
+    RAM[0x0000] = 0xD3;
+    RAM[0x0001] = 0xFF;
+    // BDOS: JP BDOS_ENTRY, which is also top of TPA for the program, IN A,(0FFh) calls BDOS
+    RAM[0x0005] = 0xC3;
+    RAM[0x0006] = BDOS_ENTRY & 0xff;
+    RAM[0x0007] = BDOS_ENTRY >> 8;
+    RAM[BDOS_ENTRY] = 0xDB;
+    RAM[BDOS_ENTRY + 1] = 0xFF;
+    RAM[BDOS_ENTRY + 2] = 0xC9;
+    memcpy(&RAM[TPA_START], program.data(), program.size());
+    console.clear();
+}
+
+static uint32 ram_hash()
+{
+    uint32 h = 2166136261u; // FNV-1a
+    for (int i = 0; i < MEMSIZE; i++)
+        h = (h ^ RAM[i]) * 16777619u;
+    return h;
+}
+
+#define BENCH_RUN(ns, program, state, secs)                                       \
+    do                                                                           \
+    {                                                                            \
+        load_program(program);                                                   \
+        ns::Z80reset();                                                          \
+        ns::PC = TPA_START;                                                      \
+        ns::SP = BDOS_ENTRY - 2; /* return address 0 on stack */                \
+        clk::time_point start = clk::now();                                      \
+        ns::Z80run();                                                            \
+        secs = std::chrono::duration<double>(clk::now() - start).count();       \
+        uint32 regs[8] = {(uint32)ns::AF, (uint32)ns::BC, (uint32)ns::DE,        \
+                          (uint32)ns::HL, (uint32)ns::IX, (uint32)ns::IY,        \
+                          (uint32)ns::SP, (uint32)ns::PC};                       \
+        memcpy(state.regs, regs, sizeof(regs));                                  \
+        state.console = console;                                                 \
+        state.ram_hash = ram_hash();                                             \
+    } while (0)
+
+static double median(std::vector<double> &v)
+{
+    std::sort(v.begin(), v.end());
+    return v.empty() ? 0 : v[v.size() / 2];
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [options] [program.com]\n"
+            "  -n <runs>   runs per core (default %d)\n"
+            "  -o <file>   write JSON results to file (default stdout)\n"
+            "  -v          print console output of the program\n"
+            "Without program, built-in CRC-16 loop is run.\n",
+            prog, BENCH_DEFAULT_RUNS);
+}
+
+int main(int argc, char **argv)
+{
+    int runs = BENCH_DEFAULT_RUNS;
+    const char *output_path = nullptr;
+    bool verbose = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:o:vh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            runs = atoi(optarg);
+            break;
+        case 'o':
+            output_path = optarg;
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (runs < 1)
+        runs = 1;
+
+    std::vector<uint8> program;
+    const char *program_name = "builtin crc16";
+    if (optind < argc)
+    {
+        program_name = argv[optind];
+        FILE *f = fopen(program_name, "rb");
+        if (f == nullptr)
+        {
+            fprintf(stderr, "Failed to open \"%s\"\n", program_name);
+            return 1;
+        }
+        uint8 buf[1024];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+            program.insert(program.end(), buf, buf + n);
+        fclose(f);
+        if (program.empty() || program.size() > BDOS_ENTRY - TPA_START)
+        {
+            fprintf(stderr, "\"%s\" does not fit into TPA\n", program_name);
+            return 1;
+        }
+    }
+    else
+        program.assign(builtin_program, builtin_program + sizeof(builtin_program));
+
+    std::vector<double> ref_secs, fast_secs;
+    run_state ref_state, fast_state;
+    bool match = true;
+
+    // cores take turns, so both see the same machine conditions
+    for (int r = 0; r < runs; r++)
+    {
+        double secs;
+        fprintf(stderr, "run %d/%d\n", r + 1, runs);
+        BENCH_RUN(ref, program, ref_state, secs);
+        ref_secs.push_back(secs);
+        if (verbose && r == 0)
+            fputs(ref_state.console.c_str(), stderr);
+        BENCH_RUN(fast, program, fast_state, secs);
+        fast_secs.push_back(secs);
+        if (!(ref_state == fast_state))
+            match = false;
+    }
+
+    FILE *out = stdout;
+    if (output_path != nullptr && (out = fopen(output_path, "w")) == nullptr)
+    {
+        fprintf(stderr, "Failed to create \"%s\"\n", output_path);
+        return 1;
+    }
+
+    double ref_ms = median(ref_secs) * 1000;
+    double fast_ms = median(fast_secs) * 1000;
+    fprintf(out, "{\n  \"z80\": {\n");
+    fprintf(out, "    \"program\": \"%s\",\n", program_name);
+    fprintf(out, "    \"runs\": %d,\n", runs);
+    fprintf(out, "    \"reference_ms_p50\": %.1f,\n", ref_ms);
+    fprintf(out, "    \"fast_ms_p50\": %.1f,\n", fast_ms);
+    fprintf(out, "    \"speedup\": %.2f,\n", fast_ms > 0 ? ref_ms / fast_ms : 0.0);
+    fprintf(out, "    \"results_match\": %s\n", match ? "true" : "false");
+    fprintf(out, "  }\n}\n");
+
+    if (out != stdout)
+        fclose(out);
+    return match ? 0 : 2;
+}
@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+# FujiNet - Convert binary modem sniffer capture to text view
+#
+# sniffer2txt.py CAPTURE [OUTPUT]
+#   CAPTURE  binary capture file (rs232dump.cap) written with sniffer_format=binary
+#   OUTPUT   text output, stdout if omitted
+#
+# Output matches the text written by sniffer with sniffer_format=text.
+# Record format is described in lib/modem-sniffer/modem-sniffer.h
+
+import struct, sys
+
+MAGIC = b"FNSNIFF"
+VERSION = 1
+DIR_INPUT = 0x01
+RECORD_HEADER = struct.Struct("<BQH")
+
+
+def convert(fin, fout, timestamps=False):
+    header = fin.read(len(MAGIC) + 1)
+    if len(header) != len(MAGIC) + 1 or header[:-1] != MAGIC or header[-1] != VERSION:
+        raise ValueError("not a sniffer capture file")
+
+    records = 0
+    last_dir = None
+    while True:
+        rh = fin.read(RECORD_HEADER.size)
+        if len(rh) < RECORD_HEADER.size:
+            break
+        direction, ts, length = RECORD_HEADER.unpack(rh)
+        payload = fin.read(length)
+        if len(payload) < length:
+            break # truncated record
+
+        if direction != last_dir:
+            fout.write("\n\nINCOMING: " if direction == DIR_INPUT else "\n\nOUTGOING: ")
+            if timestamps:
+                fout.write("[%d.%06d] " % (ts // 1000000, ts % 1000000))
+        last_dir = direction
+
+        hexfmt = "%02x " if direction == DIR_INPUT else "%02X "
+        fout.write("".join("'%c' " % b if 0x20 < b < 0x7F else hexfmt % b for b in payload))
+        records += 1
+    return records
+
+
+def main():
+    args = [a for a in sys.argv[1:] if a != "-t"]
+    if len(args) not in (1, 2):
+        sys.stderr.write("Usage: %s [-t] CAPTURE [OUTPUT]\n  -t  include record timestamps\n" % sys.argv[0])
+        sys.exit(1)
+    with open(args[0], "rb") as fin:
+        fout = open(args[1], "w") if len(args) == 2 else sys.stdout
+        try:
+            convert(fin, fout, "-t" in sys.argv[1:])
+        except ValueError as e:
+            sys.stderr.write("%s: %s\n" % (args[0], e))
+            sys.exit(1)
+        finally:
+            if fout is not sys.stdout:
+                fout.close()
+
+
+if __name__ == "__main__":
+    main()